@@ -17,16 +17,20 @@ public:
     void RotateViewTheta(float dx);
     void RotateViewPhi(float dy);
 
-    void MoveForewards();
-    void MoveBackwards();
-    void MoveLeftwards();
-    void MoveRightwards();
-    void MoveUpwards();
-    void MoveDownwards();
+    // Movem a cmera pela distncia percorrida em "delta_time" segundos.
+    void MoveForewards(float delta_time);
+    void MoveBackwards(float delta_time);
+    void MoveLeftwards(float delta_time);
+    void MoveRightwards(float delta_time);
+    void MoveUpwards(float delta_time);
+    void MoveDownwards(float delta_time);
 
     void OnScreenResize(int width, int height);
     void SetProjectionType(ProjectionType projection_type);
     void Zoom(float factor);
+    void SetPose(glm::vec4 center_point, float view_theta, float view_phi);
+    void SetCenterPoint(glm::vec4 center_point);
+    void SetViewDistance(float distance); // Distncia do plano distante
 
     glm::vec4 CenterPoint() const;
     glm::vec4 ViewVector() const;
@@ -40,7 +44,7 @@ private:
     float view_phi;
     float view_rho;
     glm::vec4 up_vector;
-    float move_speed;
+    float move_speed; // Unidades por segundo
     float rotate_speed;
     float zoom_speed;
     float nearplane;
@@ -0,0 +1,149 @@
+#ifndef BENCHMARK_HPP
+#define BENCHMARK_HPP
+
+#include <vector>
+#include <cstdint>
+#include <ostream>
+#include <glm/vec3.hpp>
+#include "Camera.hpp"
+
+// Pose da câmera em um quadro do roteiro. Entre dois quadros-chave a pose é
+// interpolada linearmente.
+struct BenchmarkCameraKey
+{
+    size_t    frame;
+    glm::vec3 position;
+    float     view_theta;
+    float     view_phi;
+};
+
+struct BenchmarkEdit
+{
+    enum Kind {
+        EDIT_BREAK,
+        EDIT_PLACE
+    };
+
+    size_t    frame;
+    Kind      kind;
+    glm::vec3 position;
+};
+
+// Roteiro do modo de benchmark. Formato do arquivo (uma diretiva por linha,
+// "#" inicia um comentário):
+//
+//   frames   <N>
+//   timestep <segundos>
+//   camera   <quadro> <x> <y> <z> <theta> <phi>
+//   break    <quadro> <x> <y> <z>
+//   place    <quadro> <x> <y> <z>
+//
+class BenchmarkScript
+{
+public:
+    size_t num_frames;
+    double timestep;
+    std::vector<BenchmarkCameraKey> camera_keys; // Ordenados por quadro
+    std::vector<BenchmarkEdit>      edits;       // Ordenadas por quadro
+
+    BenchmarkScript();
+
+    // Retorna false (e imprime o erro) se o arquivo não puder ser lido.
+    bool Load(const char *filename);
+
+    void ApplyCamera(size_t frame, Camera &camera) const;
+};
+
+// Estatísticas coletadas durante o benchmark.
+class BenchmarkStats
+{
+public:
+    void AddFrame(double frame_ms, size_t draw_calls, size_t triangles);
+    void AddInputLatency(double latency_ms);
+
+    // Imprime min/média/p99 dos tempos de quadro, médias de chamadas de
+    // desenho e triângulos e a latência de entrada, no formato CSV.
+    void PrintCsv(std::ostream &output) const;
+
+private:
+    std::vector<double> frame_ms;
+    std::vector<size_t> draw_calls;
+    std::vector<size_t> triangles;
+    std::vector<double> input_latency_ms;
+};
+
+// Mede a escalabilidade do JobSystem: executa a mesma carga (contagem das
+// faces visíveis do mundo, repetida várias vezes) com 1, 2, 4, ... até
+// max_workers trabalhadoras e imprime tempo, speedup e estatísticas das
+// trabalhadoras no formato CSV.
+void RunJobScalingBenchmark(std::ostream &output, size_t max_workers);
+
+// Dimensões padrão do mundo gerado por RunTerrainBenchmark().
+#define TERRAIN_BENCHMARK_SIZE_X 512
+#define TERRAIN_BENCHMARK_SIZE_Y 128
+#define TERRAIN_BENCHMARK_SIZE_Z 512
+
+// Mede a geração de terreno: gera um mundo com as dimensões dadas usando o
+// g_JobSystem (que deve estar iniciado) e imprime o tempo total e os chunks
+// gerados por segundo, no total e por thread, no formato CSV.
+void RunTerrainBenchmark(std::ostream &output, size_t size_x, size_t size_y, size_t size_z, uint32_t seed);
+
+// Dimensões do mundo usado por RunRegionBenchmark() (4M blocos).
+#define REGION_BENCHMARK_SIZE_X 256
+#define REGION_BENCHMARK_SIZE_Y 64
+#define REGION_BENCHMARK_SIZE_Z 256
+
+// Mede a gravação e a leitura de arquivos de região: gera um mundo, salva
+// todos os chunks em directory, lê todos de volta com um RegionStore novo e
+// imprime os tempos e as taxas em blocos por segundo no formato CSV.
+void RunRegionBenchmark(std::ostream &output, const char *directory, uint32_t seed);
+
+// Número de alterações gravadas por RunJournalBenchmark(), e de alterações
+// medidas com a regravação da região inteira a cada alteração.
+#define JOURNAL_BENCHMARK_EDITS 1000000
+#define JOURNAL_BENCHMARK_REGION_EDITS 200
+
+// Mede o diário de alterações: grava uma sequência longa de alterações em
+// directory, como o MouseButtonCallback() faria, e mede a recuperação do
+// diário na abertura. Para comparação, mede também a taxa de alterações
+// salvando cada uma com a regravação do seu arquivo de região. Imprime o
+// resultado no formato CSV.
+void RunJournalBenchmark(std::ostream &output, const char *directory, uint32_t seed);
+
+// Alterações de blocos feitas entre a cópia e a restauração do mundo em
+// RunSnapshotBenchmark().
+#define SNAPSHOT_BENCHMARK_EDITS 10000
+
+// Mede a cópia do mundo com chunks compartilhados: gera um mundo com as
+// dimensões de RunTerrainBenchmark(), faz uma cópia, altera blocos
+// espalhados pelo mundo e restaura a cópia. Para comparação, mede também a
+// cópia de todos os blocos. Imprime o resultado no formato CSV.
+void RunSnapshotBenchmark(std::ostream &output, uint32_t seed);
+
+// Dimensões do mundo e número de alterações de RunLightBenchmark().
+#define LIGHT_BENCHMARK_SIZE_X 256
+#define LIGHT_BENCHMARK_SIZE_Y 128
+#define LIGHT_BENCHMARK_SIZE_Z 256
+#define LIGHT_BENCHMARK_EDITS 2000
+
+// Mede a iluminação: ilumina um mundo gerado por inteiro, e então aplica
+// alterações de blocos (blocos quebrados e colocados na superfície,
+// lâmpadas em cavernas) com a atualização incremental. No final, compara
+// a luz incremental com uma nova iluminação completa. Imprime o resultado
+// no formato CSV.
+void RunLightBenchmark(std::ostream &output, uint32_t seed);
+
+// Distância de visão e altura do mundo de RunLodBenchmark(). O mundo tem o
+// dobro da distância de visão de lado.
+#define LOD_BENCHMARK_VIEW_DISTANCE 512
+#define LOD_BENCHMARK_SIZE_Y 64
+
+// Mede os níveis de detalhe das malhas: gera um mundo com a câmera no
+// centro, sobre o terreno, e constrói as malhas de todos os chunks até a
+// distância de visão, primeiro todas de blocos e depois com o nível de
+// detalhe dado pela distância à câmera. Imprime, para os dois casos, os
+// chunks de cada nível, os triângulos, os bytes de vértices e o tempo de
+// construção no formato CSV.
+void RunLodBenchmark(std::ostream &output, uint32_t seed);
+
+#endif // BENCHMARK_HPP
@@ -1,16 +1,26 @@
 #ifndef BLOCK_HPP
 #define BLOCK_HPP
 
+#include <atomic>
+#include <vector>
+#include <memory>
 #include <glm/vec3.hpp>
 
-#define WORLD_SIZE_X 32
-#define WORLD_SIZE_Y 32
-#define WORLD_SIZE_Z 32
+// Aresta de um chunk, em blocos. O mundo é guardado em chunks contíguos na
+// memória, e as dimensões do mundo são sempre múltiplos de CHUNK_SIZE.
+#define CHUNK_SIZE 16
 
-enum Block {
+// Dimensões do mundo padrão, usado quando nenhum tamanho é pedido.
+#define WORLD_DEFAULT_SIZE_X 32
+#define WORLD_DEFAULT_SIZE_Y 32
+#define WORLD_DEFAULT_SIZE_Z 32
+
+// Um byte por bloco.
+enum Block : unsigned char {
     BLOCK_AIR,
     BLOCK_STONE,
-    BLOCK_GRASS
+    BLOCK_GRASS,
+    BLOCK_LAMP   // Emite luz (veja LightEngine)
 };
 
 struct WorldPoint {
@@ -25,18 +35,88 @@ public:
     glm::vec3 ToGlm();
 };
 
+struct WorldChunk {
+    Block blocks[CHUNK_SIZE][CHUNK_SIZE][CHUNK_SIZE];
+};
+
+// Os chunks podem não estar carregados (ex: longe da câmera, veja
+// ChunkStreamer). Chunks não carregados são lidos como ar, e não podem ser
+// alterados.
+//
+// As cópias do mundo compartilham os chunks (copy-on-write): copiar custa
+// um ponteiro por chunk, e o acesso não const a um chunk compartilhado o
+// copia antes. Somente os chunks alterados depois da cópia ocupam memória
+// novamente. Leituras que não alteram o mundo devem usar o acesso const.
 struct WorldBlockMatrix {
 private:
-    Block blocks[WORLD_SIZE_X][WORLD_SIZE_Y][WORLD_SIZE_Z];
+    size_t size_x, size_y, size_z;
+    size_t chunks_x, chunks_y, chunks_z;
+    std::vector<std::shared_ptr<WorldChunk> > chunks;
+    size_t loaded_chunks;
+
+    static const Block air;
+
+    inline size_t ChunkIndex(size_t chunk_x, size_t chunk_y, size_t chunk_z) const
+    {
+        return (chunk_x * this->chunks_y + chunk_y) * this->chunks_z + chunk_z;
+    }
 
 public:
+    // Mundo padrão, com a metade de baixo preenchida com pedra.
     WorldBlockMatrix();
 
-    static const WorldPoint SIZE;
+    // Mundo somente com ar, com todos os chunks carregados ou nenhum. As
+    // dimensões são arredondadas para cima até um múltiplo de CHUNK_SIZE.
+    WorldBlockMatrix(size_t size_x, size_t size_y, size_t size_z, bool loaded = true);
+
+    // A cópia compartilha os chunks com o original.
+    WorldBlockMatrix(WorldBlockMatrix const &other) = default;
+    WorldBlockMatrix &operator = (WorldBlockMatrix const &other) = default;
+    WorldBlockMatrix(WorldBlockMatrix &&other) = default;
+    WorldBlockMatrix &operator = (WorldBlockMatrix &&other) = default;
+
+    WorldPoint Size() const;
+    WorldPoint SizeInChunks() const;
+
+    bool   IsChunkLoaded(size_t chunk_x, size_t chunk_y, size_t chunk_z) const;
+    size_t LoadedChunks() const;
 
+    // Copia os blocos dados para o chunk, carregando-o se necessário.
+    void LoadChunk(size_t chunk_x, size_t chunk_y, size_t chunk_z, WorldChunk const &data);
+    void UnloadChunk(size_t chunk_x, size_t chunk_y, size_t chunk_z);
+
+    // Passa a compartilhar o chunk de other, que tem as mesmas dimensões, e
+    // o carrega ou descarrega como em other. Retorna false se o chunk já era
+    // o mesmo.
+    bool ShareChunk(WorldBlockMatrix const &other, size_t chunk_x, size_t chunk_y, size_t chunk_z);
+
+    // O chunk, ou NULL se não está carregado. Os blocos não são alterados
+    // enquanto houver outra referência ao chunk.
+    std::shared_ptr<const WorldChunk> SharedChunk(size_t chunk_x, size_t chunk_y, size_t chunk_z) const;
+
+    // O chunk deve estar carregado. Um chunk compartilhado é copiado antes.
+    inline WorldChunk &Chunk(size_t chunk_x, size_t chunk_y, size_t chunk_z)
+    {
+        std::shared_ptr<WorldChunk> &chunk = this->chunks[this->ChunkIndex(chunk_x, chunk_y, chunk_z)];
+        if (chunk.use_count() > 1)
+            chunk = std::make_shared<WorldChunk>(*chunk);
+        else
+            // As cópias feitas por outras threads terminaram antes de
+            // liberarem as suas referências.
+            std::atomic_thread_fence(std::memory_order_acquire);
+        return *chunk;
+    }
+
+    inline WorldChunk const &Chunk(size_t chunk_x, size_t chunk_y, size_t chunk_z) const
+    {
+        return *this->chunks[this->ChunkIndex(chunk_x, chunk_y, chunk_z)];
+    }
+
+    // O chunk do ponto deve estar carregado.
     inline Block &operator [] (WorldPoint point)
     {
-        return this->blocks[point.x][point.y][point.z];
+        WorldChunk &chunk = this->Chunk(point.x / CHUNK_SIZE, point.y / CHUNK_SIZE, point.z / CHUNK_SIZE);
+        return chunk.blocks[point.x % CHUNK_SIZE][point.y % CHUNK_SIZE][point.z % CHUNK_SIZE];
     }
 
     inline Block &operator [] (glm::vec3 point)
@@ -46,7 +126,10 @@ public:
 
     inline Block const &operator [] (WorldPoint point) const
     {
-        return this->blocks[point.x][point.y][point.z];
+        WorldChunk const *chunk = this->chunks[this->ChunkIndex(point.x / CHUNK_SIZE, point.y / CHUNK_SIZE, point.z / CHUNK_SIZE)].get();
+        if (chunk == NULL)
+            return air;
+        return chunk->blocks[point.x % CHUNK_SIZE][point.y % CHUNK_SIZE][point.z % CHUNK_SIZE];
     }
 
     inline Block const &operator [] (glm::vec3 point) const
@@ -54,9 +137,12 @@ public:
         return (*this)[WorldPoint(point)];
     }
 
+    // Verdadeiro se o ponto está dentro do mundo e em um chunk carregado.
     bool IsPointInWorld(glm::vec3 point)const;
 
-
+    // Coordenada y do bloco sólido mais alto da coluna, ou -1 se a coluna
+    // só tem ar.
+    int TopSolidY(size_t x, size_t z) const;
 };
 
 #endif // BLOCK_HPP
@@ -0,0 +1,286 @@
+#ifndef CHUNKMESH_HPP
+#define CHUNKMESH_HPP
+
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <glad/glad.h>
+#include <glm/vec4.hpp>
+#include <glm/mat4x4.hpp>
+
+#include "blocks.hpp"
+#include "jobs.hpp"
+#include "light.hpp"
+#include "occlusion.hpp"
+#include "gpumemory.hpp"
+
+// Bytes de malha enviados à GPU por quadro. Malhas prontas além disso ficam
+// para os próximos quadros, para que uma rajada de edições não cause um
+// quadro longo.
+#define CHUNK_UPLOAD_BUDGET_BYTES (256 * 1024)
+
+// Número máximo de chunks sendo construídos ao mesmo tempo.
+#define CHUNK_MAX_JOBS_IN_FLIGHT 16
+
+// Número máximo de chunks, os mais próximos da câmera, cujas faces sólidas
+// são rasterizadas como oclusores a cada quadro.
+#define CHUNK_MAX_OCCLUDER_CHUNKS 256
+
+// Níveis de detalhe das malhas: no nível n, a malha é feita de células de
+// 2^n blocos de lado. CHUNK_SIZE deve ser múltiplo da maior célula.
+#define CHUNK_LOD_LEVELS 4
+
+// Distância da câmera ao centro do chunk a partir da qual o nível 1 é usado.
+// Cada nível seguinte começa no dobro da distância do anterior.
+#define CHUNK_LOD_DISTANCE 64.0f
+
+// Quanto a distância deve passar do limite entre dois níveis para que o
+// chunk troque de nível, para que a malha não seja refeita a cada passo da
+// câmera sobre o limite.
+#define CHUNK_LOD_HYSTERESIS 8.0f
+
+// Cópia imutável dos blocos e da luz de um chunk e da camada de blocos
+// vizinhos, usada pela construção da malha fora da thread de renderização.
+struct ChunkSnapshot
+{
+    static const int SIZE = CHUNK_SIZE + 2;
+
+    int           chunk_x, chunk_y, chunk_z;
+    unsigned char blocks[SIZE][SIZE][SIZE]; // Índices deslocados de 1
+    unsigned char light[SIZE][SIZE][SIZE];  // Veja LightSky() e LightBlock()
+
+    // Sem light, todas as células recebem a luz máxima do céu.
+    ChunkSnapshot(WorldBlockMatrix const &world, LightEngine const *light, int chunk_x, int chunk_y, int chunk_z);
+
+    inline Block At(int x, int y, int z) const
+    {
+        return (Block)this->blocks[x + 1][y + 1][z + 1];
+    }
+
+    inline unsigned char LightAt(int x, int y, int z) const
+    {
+        return this->light[x + 1][y + 1][z + 1];
+    }
+};
+
+// Vértice da malha de um chunk (16 bytes). As posições são os cantos dos
+// blocos no sistema do mundo, deslocado de meio bloco (veja
+// ChunkRenderer::Draw()), para que todas as malhas sejam desenhadas com a
+// mesma matriz; o shader converte os inteiros para float. O mundo pode ter
+// até 65535 blocos em cada eixo.
+struct ChunkVertex
+{
+    GLushort position[3]; // x, y, z (o shader recebe w = 1)
+    GLubyte occlusion;    // Oclusão ambiente do canto: 0 (mais escuro) a 3 (sem oclusão)
+    GLubyte padding;      // Alinha os atributos seguintes a 4 bytes
+    GLbyte  normal[4];    // x, y, z, 0
+    GLubyte texcoords[2]; // 0 ou 1 (até 2^lod nas malhas reduzidas, repetindo a textura)
+    GLubyte light[2];     // Luz do céu e dos blocos no ar em frente à face, de 0 a LIGHT_MAX
+};
+
+// Gera as faces dos blocos sólidos vizinhas a ar (4 vértices por face), com
+// a luz da célula de ar em frente a cada face e a oclusão ambiente de cada
+// canto, dada pelos 3 blocos que tocam o canto na camada em frente à face.
+// Com skirts, os blocos sólidos da borda do chunk recebem a face da borda
+// mesmo com o vizinho sólido (veja BuildChunkLodMesh()).
+// Não usa OpenGL e pode executar em qualquer thread.
+void BuildChunkMesh(ChunkSnapshot const &snapshot, std::vector<ChunkVertex> &vertices, bool skirts = false);
+
+// Nível de detalhe de um chunk cujo centro está a distance da câmera.
+int ChunkLodForDistance(float distance);
+
+// Troca os blocos do chunk pelos de uma grade de células de 2^lod blocos de
+// lado: uma célula é sólida se ao menos metade dos seus blocos é sólida, e
+// recebe o tipo mais comum entre eles. A camada de blocos vizinhos e a luz
+// não mudam.
+void DownsampleChunkSnapshot(ChunkSnapshot &snapshot, int lod);
+
+// Gera as faces das células de um snapshot reduzido por
+// DownsampleChunkSnapshot(), com 2^lod blocos de lado, sem oclusão ambiente
+// e com a maior luz da camada em frente a cada face.
+//
+// As células sólidas da borda do chunk sempre recebem a face da borda
+// (saia), qualquer que seja o vizinho: a malha do chunk vizinho é de outra
+// grade, que não coincide com a camada vista daqui, e decidir a face pelos
+// blocos do vizinho deixaria frestas entre as duas malhas. Com saias dos
+// dois lados, cada ponto sólido da fronteira é coberto pela malha do seu
+// próprio chunk.
+void BuildChunkLodMesh(ChunkSnapshot const &snapshot, int lod, std::vector<ChunkVertex> &vertices);
+
+// Faces do chunk cuja camada de blocos na borda é toda sólida: o bit
+// 2 * eixo é a face negativa do eixo e o bit 2 * eixo + 1, a positiva. Essas
+// faces ocultam tudo o que está atrás delas.
+unsigned ChunkOccluderFaces(ChunkSnapshot const &snapshot);
+
+// Pares de faces do chunk ligados por ar dentro do chunk, um bit por par
+// (veja ChunkFacePairBit()). Uma face está em uma região de ar se algum dos
+// seus blocos de borda pertence à região.
+unsigned ChunkFaceConnections(ChunkSnapshot const &snapshot);
+
+// Bit de ChunkFaceConnections() do par de faces diferentes a e b, numeradas
+// como em ChunkOccluderFaces(). Os 15 pares ocupam os bits 0 a 14.
+unsigned ChunkFacePairBit(int face_a, int face_b);
+
+// Todos os pares de faces ligados.
+#define CHUNK_ALL_FACES_CONNECTED 0x7FFFu
+
+// Resultado da seleção de chunks visíveis do último quadro.
+struct ChunkCullingStats
+{
+    size_t meshes;           // Chunks com malha
+    size_t outside_frustum;  // Fora do frustum da câmera
+    size_t unreachable;      // Dentro do frustum, mas sem caminho de ar até a câmera
+    size_t occluded;         // Alcançáveis, mas ocultos
+    size_t occluder_faces;   // Faces sólidas rasterizadas
+    float  cpu_ms;           // Tempo de Cull()
+};
+
+// Mantém as malhas dos chunks de uma cópia do mundo, uma malha por chunk,
+// refeita somente quando um de seus blocos muda. Deve ser usado somente
+// pela thread que tem o contexto OpenGL.
+//
+// As malhas ficam nas arenas de g_GpuMemory, e todas usam o mesmo buffer de
+// índices: cada malha é desenhada a partir do seu primeiro vértice (base
+// vertex). Os chunks visíveis de cada arena são desenhados com uma única chamada a
+// glMultiDrawElementsBaseVertex(), cujas listas são refeitas a cada quadro;
+// o número de chamadas não depende do número de chunks visíveis.
+//
+// Chunks alterados são marcados com MarkBlockDirty() e recebem uma nova
+// versão. Update() envia os chunks marcados, do mais próximo ao mais
+// distante da câmera, para o JobSystem, junto de uma cópia imutável dos seus
+// blocos. Upload() envia à GPU as malhas prontas, até o limite de bytes do
+// quadro, e descarta as que foram construídas para uma versão antiga.
+class ChunkRenderer
+{
+public:
+    ChunkRenderer();
+    ~ChunkRenderer();
+
+    // Cria o buffer de índices compartilhado e marca os chunks carregados do
+    // mundo.
+    void Init(WorldBlockMatrix const &world);
+
+    void MarkBlockDirty(WorldPoint point);
+    void MarkChunkDirty(int chunk_x, int chunk_y, int chunk_z);
+
+    // Um chunk carregado muda também as faces da borda dos vizinhos. Um
+    // chunk descarregado perde a sua malha; os vizinhos não são refeitos.
+    void OnChunkLoaded(int chunk_x, int chunk_y, int chunk_z);
+    void OnChunkUnloaded(int chunk_x, int chunk_y, int chunk_z);
+
+    // Com light, a luz é gravada nos vértices das malhas. Os chunks cujo
+    // nível de detalhe muda com a distância à câmera são refeitos.
+    void Update(WorldBlockMatrix const &world, LightEngine const *light, glm::vec4 camera_position);
+    void Upload(size_t budget_bytes);
+
+    // Sem níveis de detalhe, todas as malhas são feitas de blocos.
+    void SetLodEnabled(bool enabled);
+
+    // Marca como visíveis somente os chunks dentro do frustum de
+    // view_projection que podem ser vistos de camera_position por algum
+    // caminho de ar entre as faces dos chunks e que não estão ocultos pelas
+    // faces sólidas dos chunks mais próximos.
+    void Cull(glm::mat4 const &view_projection, glm::vec4 camera_position);
+
+    // Desenha as malhas já enviadas dos chunks visíveis, com o programa de
+    // GPU atual, uma chamada por arena de g_GpuMemory.
+    void Draw(GLint model_uniform);
+
+    // Desenha somente as posições das malhas que ficam dentro do volume de
+    // recorte de light_matrix em x e y e não estão além do plano distante,
+    // para o passe de profundidade das sombras. O programa atual deve ler
+    // somente o atributo 0.
+    void DrawDepth(GLint model_uniform, glm::mat4 const &light_matrix);
+
+    // Estatísticas para o HUD.
+    size_t DirtyChunks() const;
+    size_t JobsInFlight() const;
+    size_t ReadyMeshes() const;
+    size_t DiscardedMeshes() const;
+    ChunkCullingStats const &CullingStats() const;
+
+private:
+    struct Chunk
+    {
+        unsigned version; // Incrementada a cada alteração
+        bool     dirty;
+        bool     has_mesh;   // Alguma malha (talvez vazia) foi enviada
+        GpuAllocation vertices; // Intervalo da malha em g_GpuMemory, que pode mudar de lugar
+        size_t   num_indices;
+        unsigned occluder_faces;   // Veja ChunkOccluderFaces()
+        unsigned face_connections; // Veja ChunkFaceConnections()
+        bool     visible;          // Resultado do último Cull()
+        int      lod;              // Nível de detalhe da malha pedida
+        bool     skirts;           // A malha pedida tem saias (veja NeedsSkirts())
+    };
+
+    // VAOs de uma arena de g_GpuMemory e as listas da chamada de desenho
+    // das malhas que estão nela.
+    struct ArenaDraws
+    {
+        GLuint vertex_array_object_id;
+        GLuint depth_vertex_array_object_id; // Somente a posição, no mesmo buffer
+        std::vector<GLsizei> draw_counts;
+        std::vector<GLint>   draw_base_vertices;
+    };
+
+    struct MeshResult
+    {
+        int                      chunk;
+        unsigned                 version;
+        std::vector<ChunkVertex> vertices;
+        unsigned                 occluder_faces;
+        unsigned                 face_connections;
+    };
+
+    // Passo da busca pelos chunks alcançáveis a partir da câmera.
+    struct CaveStep
+    {
+        int      chunk;
+        int      entry_face; // Face pela qual a busca entrou no chunk, ou -1
+        unsigned directions; // Bits das faces pelas quais a busca já saiu
+    };
+
+    std::vector<Chunk> chunks;
+    int    chunks_x, chunks_y, chunks_z;
+    GLuint index_buffer_id;
+    size_t index_capacity;
+
+    std::vector<ArenaDraws>     arena_draws;
+    std::vector<GLvoid const *> draw_offsets; // Todos nulos: os índices começam do zero
+
+    TaskGroup jobs;
+    size_t    jobs_in_flight;
+    size_t    discarded_meshes;
+    bool      lod_enabled;
+
+    // Malhas prontas, preenchidas pelas trabalhadoras.
+    std::mutex              ready_mutex;
+    std::vector<MeshResult> ready;
+
+    // Malhas já recolhidas que não couberam no limite de envio.
+    std::vector<MeshResult> pending_uploads;
+
+    OcclusionCuller                      culler;
+    std::vector<std::pair<float, int> >  occluder_chunks;
+    std::vector<bool>                    reachable;
+    std::vector<CaveStep>                cave_steps;
+    ChunkCullingStats                    culling_stats;
+
+    int ChunkIndex(int chunk_x, int chunk_y, int chunk_z) const;
+    int SelectLod(int current_lod, float distance) const;
+
+    // Malhas reduzidas sempre têm saias. As de blocos precisam delas somente
+    // quando um vizinho é reduzido, já que entre duas malhas de blocos as
+    // faces da borda coincidem.
+    bool NeedsSkirts(int chunk_x, int chunk_y, int chunk_z) const;
+    void FindReachableChunks(glm::vec4 camera_position);
+    void EnsureIndexCapacity(size_t num_quads);
+    void UploadMesh(Chunk &chunk, std::vector<ChunkVertex> const &vertices);
+    void FreeMesh(Chunk &chunk);
+    void AddDraw(Chunk const &chunk);
+    void SubmitDraws(bool depth_only);
+};
+
+#endif // CHUNKMESH_HPP
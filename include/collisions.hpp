@@ -14,7 +14,6 @@ struct CollisionFace {
 bool FacingNonAirBlock(CollisionFace &output, Camera const &camera, WorldBlockMatrix const &world_block_matrix);
 bool coordenadaCruza(glm::vec3 a,float tA, glm::vec3 b, float tB, int axis);
 bool colisaoCuboCubo(glm::vec3 centroCubo1, float t1, glm::vec3 centroCubo2, float t2);
-bool IsPointInWorld(glm::vec3 point);
 bool colisaoCuboPlanoOrdinais(glm::vec3 centroCubo, float t, int axis, float coordAxis);
 //Apenas faz teste com o planos ortogonais aos eixos x,y,z pois so os unicos que usamos
 
@@ -0,0 +1,104 @@
+#ifndef FRAMESTATE_HPP
+#define FRAMESTATE_HPP
+
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+
+#include <glm/vec4.hpp>
+
+#include "Camera.hpp"
+#include "blocks.hpp"
+#include "streaming.hpp"
+
+// Alteração de um bloco do mundo, repassada à cópia do mundo mantida pela
+// thread de renderização.
+struct BlockEdit
+{
+    WorldPoint position;
+    Block      block;
+
+    BlockEdit(WorldPoint position, Block block);
+};
+
+// Tudo o que a thread de renderização precisa para desenhar um quadro. É
+// preenchido pela thread de simulação e não é mais alterado depois de
+// publicado.
+struct FrameSnapshot
+{
+    size_t    frame_number;
+    Camera    camera;       // Câmera já interpolada entre os passos da simulação
+    glm::vec4 cow_position;
+
+    unsigned  stones_in_inventory;
+    bool      show_info_text;
+
+    int framebuffer_width;
+    int framebuffer_height;
+    int window_width;
+    int window_height;
+
+    // Blocos alterados desde o quadro anterior.
+    std::vector<BlockEdit> block_edits;
+
+    // Chunks carregados e descarregados pelo ChunkStreamer neste quadro,
+    // aplicados depois de block_edits.
+    std::vector<ChunkLoad>  chunk_loads;
+    std::vector<WorldPoint> chunk_unloads;
+    StreamingStats          streaming;
+
+    // Momento (Profiler::NowMicroseconds()) do evento de entrada mais antigo
+    // que aparece pela primeira vez neste quadro, ou negativo se não houve
+    // entrada.
+    double input_us;
+
+    FrameSnapshot();
+};
+
+// Troca de quadros entre a thread de simulação (produtora) e a de
+// renderização (consumidora), com três cópias de FrameSnapshot: uma sendo
+// escrita, uma pronta e uma sendo desenhada. As cópias trocam de papel sem
+// serem copiadas, de forma que as duas threads nunca acessam a mesma cópia.
+//
+// Publish() espera enquanto o quadro pronto ainda não foi consumido. Assim a
+// simulação fica no máximo um quadro à frente da renderização: o quadro N+1
+// é simulado enquanto o quadro N é desenhado, e nenhum quadro é descartado
+// (o que o benchmark e a reprodução precisam).
+class FrameExchange
+{
+public:
+    FrameExchange();
+
+    // Cópia onde a thread de simulação monta o próximo quadro.
+    FrameSnapshot &WriteSlot();
+
+    // Entrega o quadro montado em WriteSlot() à renderização.
+    void Publish();
+
+    // Espera um novo quadro. Retorna false quando Close() foi chamado e
+    // todos os quadros publicados já foram consumidos.
+    bool Acquire(FrameSnapshot const *&snapshot);
+
+    // Indica que nenhum outro quadro será publicado.
+    void Close();
+
+    // Tempo que cada thread passou esperando pela outra, em milissegundos.
+    double ProducerWaitMs() const;
+    double ConsumerWaitMs() const;
+
+private:
+    FrameSnapshot slots[3];
+    int  write_index;
+    int  ready_index;
+    int  read_index;
+    bool ready_pending;
+    bool closed;
+
+    double producer_wait_ms;
+    double consumer_wait_ms;
+
+    mutable std::mutex      mutex;
+    std::condition_variable ready_changed;
+};
+
+#endif // FRAMESTATE_HPP
@@ -5,4 +5,7 @@
 
 GLuint CreateGpuProgram(GLuint vertex_shader_id, GLuint fragment_shader_id);
 
+// Cria e compila um shader a partir de código GLSL contido em uma string.
+GLuint CreateGpuShaderFromSource(GLenum shader_type, const GLchar *source);
+
 #endif // GPU_HPP
@@ -0,0 +1,130 @@
+#ifndef GPUMEMORY_HPP
+#define GPUMEMORY_HPP
+
+#include <deque>
+#include <vector>
+#include <cstddef>
+
+#include <glad/glad.h>
+
+#include "rangeallocator.hpp"
+
+// Bytes de cada arena (32 MiB). Alocações maiores ganham uma arena só delas.
+#define GPU_ARENA_BYTES (32 * 1024 * 1024)
+
+// A cada tantos quadros, a arena mais fragmentada é compactada, movendo no
+// máximo GPU_COMPACTION_BUDGET_BYTES. Arenas com fragmentação menor que
+// GPU_COMPACTION_MIN_FRAGMENTATION não são compactadas.
+#define GPU_COMPACTION_INTERVAL_FRAMES 30
+#define GPU_COMPACTION_BUDGET_BYTES (1024 * 1024)
+#define GPU_COMPACTION_MIN_FRAGMENTATION 0.25f
+
+// Identifica uma alocação de GpuMemory. Continua o mesmo quando a
+// compactação move a alocação.
+typedef size_t GpuAllocation;
+#define GPU_INVALID_ALLOCATION ((GpuAllocation)-1)
+
+struct GpuMemoryStats
+{
+    size_t arenas;
+    size_t capacity_bytes;
+    size_t used_bytes;         // Inclui os intervalos esperando a GPU
+    size_t free_bytes;
+    size_t largest_free_bytes;
+    size_t free_ranges;
+    size_t pending_free_bytes; // Liberados, esperando a GPU terminar de usá-los
+    size_t moved_bytes;        // Total movido pela compactação
+};
+
+// Gerenciador dos buffers de vértices e de índices da GPU. Em vez de um
+// buffer por malha, as malhas ocupam intervalos de poucas arenas grandes,
+// repartidas por RangeAllocator. Uma arena é um buffer comum, que pode ser
+// ligado a GL_ARRAY_BUFFER ou a GL_ELEMENT_ARRAY_BUFFER.
+//
+// Free() não devolve o intervalo à arena na hora: os comandos já enviados
+// podem ainda ler dele. EndFrame() cerca as liberações de cada quadro com
+// glFenceSync, e o intervalo só volta a ser alocado depois que a cerca é
+// sinalizada, sem que a CPU espere a GPU.
+//
+// Alocações movable podem ser movidas pela compactação, que copia os dados
+// para o início da arena com glCopyBufferSubData. Quem as desenha deve ler
+// Offset() a cada quadro em vez de guardar o valor.
+//
+// Todos os métodos usam OpenGL e devem ser chamados com o contexto ativo.
+class GpuMemory
+{
+public:
+    GpuMemory();
+
+    // Intervalo de bytes bytes com início múltiplo de alignment, que pode
+    // ser o tamanho de um vértice, para que Offset() / alignment sirva de
+    // vértice base.
+    GpuAllocation Allocate(size_t bytes, size_t alignment, bool movable);
+    void Free(GpuAllocation allocation);
+
+    // Escreve bytes bytes a partir de offset dentro da alocação, pelo anel de
+    // g_StreamBuffer. Usa GL_COPY_READ_BUFFER e GL_COPY_WRITE_BUFFER e não
+    // muda os buffers ligados a outros alvos.
+    void Upload(GpuAllocation allocation, size_t offset, size_t bytes, void const *data);
+
+    size_t Arena(GpuAllocation allocation) const;
+    size_t Offset(GpuAllocation allocation) const;
+    size_t NumArenas() const;
+    GLuint ArenaBuffer(size_t arena) const;
+
+    // Deve ser chamado uma vez por quadro, depois da troca de buffers.
+    void EndFrame();
+
+    // Fração do espaço livre da arena que não está no seu maior intervalo
+    // livre: 0 quando todo o espaço livre é contíguo.
+    float Fragmentation(size_t arena) const;
+
+    GpuMemoryStats Stats() const;
+
+private:
+    struct MemoryArena
+    {
+        GLuint         buffer_id;
+        RangeAllocator allocator;
+    };
+
+    struct Allocation
+    {
+        size_t arena;
+        size_t offset;
+        size_t bytes;
+        size_t alignment;
+        bool   movable;
+        bool   live;
+    };
+
+    struct Range
+    {
+        size_t arena;
+        size_t offset;
+        size_t bytes;
+    };
+
+    // Intervalos liberados em um quadro, esperando a cerca.
+    struct FencedFrees
+    {
+        GLsync             fence;
+        std::vector<Range> ranges;
+    };
+
+    std::vector<MemoryArena>   arenas;
+    std::vector<Allocation>    allocations;
+    std::vector<GpuAllocation> unused_handles;
+    std::vector<Range>         frame_frees;
+    std::deque<FencedFrees>    fenced_frees;
+    size_t                     pending_free_bytes;
+    size_t                     moved_bytes;
+    unsigned                   frame_number;
+
+    size_t AddArena(size_t bytes);
+    void Compact(size_t arena, size_t budget_bytes);
+};
+
+extern GpuMemory g_GpuMemory;
+
+#endif // GPUMEMORY_HPP
@@ -0,0 +1,40 @@
+#ifndef HEADLESS_HPP
+#define HEADLESS_HPP
+
+#include <vector>
+#include <glad/glad.h>
+
+// Framebuffer fora da tela usado no modo sem janela (--headless). A janela da
+// GLFW continua existindo, mas fica invisível; todo o quadro é renderizado
+// neste framebuffer, que pode ser salvo como PNG.
+class OffscreenTarget
+{
+public:
+    OffscreenTarget();
+
+    bool Create(int width, int height);
+
+    // Direciona a renderização para este framebuffer.
+    void Bind() const;
+
+    // Lê o conteúdo atual e grava em um arquivo PNG.
+    bool SaveToPng(const char *filename);
+
+    int Width() const;
+    int Height() const;
+
+private:
+    GLuint framebuffer_id;
+    GLuint color_renderbuffer_id;
+    GLuint depth_renderbuffer_id;
+    int    width;
+    int    height;
+    std::vector<unsigned char> pixels;
+};
+
+// Grava uma imagem RGB de 8 bits por canal como PNG. As linhas são dadas de
+// cima para baixo. Usa blocos "stored" do deflate (sem compressão), o que
+// dispensa dependências externas.
+bool WritePng(const char *filename, int width, int height, const unsigned char *rgb);
+
+#endif // HEADLESS_HPP
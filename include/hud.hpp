@@ -0,0 +1,68 @@
+#ifndef HUD_HPP
+#define HUD_HPP
+
+#include <string>
+#include <vector>
+
+#include <glad/glad.h>
+
+// Rótulo de texto do HUD. A posição é dada em unidades de layout de texto
+// (larguras de caractere e alturas de linha), de forma que pode ser recalculada
+// quando a janela é redimensionada.
+struct HudLabel
+{
+    enum Anchor {
+        ANCHOR_TOP_LEFT,
+        ANCHOR_TOP_RIGHT
+    };
+
+    std::string text;
+    Anchor      anchor;
+    float       column;  // Distância horizontal da borda, em larguras de caractere
+    float       line;    // Distância vertical do topo, em alturas de linha
+    float       scale;
+    bool        visible;
+
+    size_t      first_vertex;    // Início da faixa de vértices do rótulo no VBO
+    size_t      num_vertices;    // Vértices efetivamente gerados pelo texto atual
+    size_t      vertex_capacity; // Vértices reservados para o rótulo no VBO
+    bool        dirty;
+};
+
+// HUD em modo retido: cada rótulo mantém sua faixa de vértices em um VBO
+// persistente, e somente rótulos cujo texto mudou são montados novamente.
+// Rótulos inalterados são desenhados diretamente do buffer.
+class Hud
+{
+public:
+    typedef size_t LabelId;
+
+    Hud();
+
+    void Init();
+
+    LabelId AddLabel(HudLabel::Anchor anchor, float column, float line, float scale = 1.0f);
+
+    // Não faz nada se o texto for igual ao atual.
+    void SetText(LabelId label, const std::string &text);
+    void SetVisible(LabelId label, bool visible);
+
+    void Draw();
+
+private:
+    std::vector<HudLabel> labels;
+    std::vector<float>    vertices;  // Cópia em CPU do conteúdo do VBO
+    std::vector<GLint>    draw_firsts;
+    std::vector<GLsizei>  draw_counts;
+
+    GLuint   vertex_array_object_id;
+    GLuint   vertex_buffer_id;
+    size_t   vertex_buffer_capacity; // Em vértices
+    unsigned layout_version;
+    bool     needs_repack;
+
+    void LayoutLabel(HudLabel &label);
+    void Repack();
+};
+
+#endif // HUD_HPP
@@ -0,0 +1,83 @@
+#ifndef INPUTLOG_HPP
+#define INPUTLOG_HPP
+
+#include <cstdio>
+#include <cstdint>
+#include <vector>
+
+// Tipos de registro do log de entrada. Os valores fazem parte do formato do
+// arquivo e não devem ser alterados.
+enum InputEventType {
+    INPUT_EVENT_FRAME = 0,        // Início de um quadro, com a duração do quadro
+    INPUT_EVENT_KEY = 1,          // KeyCallback(): key, scancode, action, mods
+    INPUT_EVENT_MOUSE_BUTTON = 2, // MouseButtonCallback(): button, action, mods
+    INPUT_EVENT_CURSOR_POS = 3,   // CursorPosCallback(): x, y e o centro da janela
+    INPUT_EVENT_SCROLL = 4        // ScrollCallback(): x, y
+};
+
+struct InputEvent
+{
+    InputEventType type;
+    uint32_t       frame;  // Quadro em que o evento foi recebido
+    double         time;   // Segundos desde o início da gravação (duração, para INPUT_EVENT_FRAME)
+    int32_t        ints[4];
+    double         x;
+    double         y;
+};
+
+// Grava em um arquivo binário compacto todos os eventos recebidos pelos
+// callbacks da GLFW. Cada registro guarda somente os campos do seu tipo.
+//
+// Formato: cabeçalho "FCGI" + versão (uint32), seguido dos registros
+// [tipo (uint8), quadro (uint32), tempo (double), campos do tipo]. Os valores
+// são gravados na ordem de bytes da máquina.
+class InputRecorder
+{
+public:
+    InputRecorder();
+    ~InputRecorder();
+
+    bool Open(const char *filename);
+    void Close();
+    bool IsOpen() const;
+
+    void RecordFrame(uint32_t frame, double frame_seconds);
+    void RecordKey(int key, int scancode, int action, int mods);
+    void RecordMouseButton(int button, int action, int mods);
+    void RecordCursorPos(double xpos, double ypos, int window_center_x, int window_center_y);
+    void RecordScroll(double xoffset, double yoffset);
+
+private:
+    FILE    *file;
+    uint32_t current_frame;
+    double   start_time;
+
+    void Write(InputEvent const &event);
+};
+
+// Lê um log gravado por InputRecorder e entrega os eventos quadro a quadro.
+class InputReplayer
+{
+public:
+    InputReplayer();
+
+    bool Open(const char *filename);
+
+    // Número de quadros do log.
+    uint32_t NumFrames() const;
+
+    // Duração gravada para o quadro. Reproduzir exatamente as mesmas
+    // durações faz a simulação executar exatamente os mesmos passos.
+    double FrameSeconds(uint32_t frame) const;
+
+    // Retorna, um por vez, os eventos recebidos durante o quadro dado. Deve
+    // ser chamado com quadros em ordem crescente.
+    bool NextEvent(uint32_t frame, InputEvent &event);
+
+private:
+    std::vector<InputEvent> events;
+    std::vector<double>     frame_seconds;
+    size_t                  next_event;
+};
+
+#endif // INPUTLOG_HPP
@@ -0,0 +1,138 @@
+#ifndef JOBS_HPP
+#define JOBS_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class JobSystem;
+
+// Conjunto de tarefas que pode ser esperado como uma unidade. Continuações
+// registradas com JobSystem::ContinueWith() são submetidas quando a última
+// tarefa do grupo termina.
+class TaskGroup
+{
+public:
+    TaskGroup();
+
+    // Verdadeiro se todas as tarefas do grupo terminaram.
+    bool IsDone() const;
+
+private:
+    friend class JobSystem;
+
+    struct Continuation
+    {
+        std::function<void()> function;
+        TaskGroup            *group;
+    };
+
+    mutable std::mutex        mutex;
+    std::condition_variable   done;
+    size_t                    pending;
+    std::vector<Continuation> continuations;
+
+    TaskGroup(TaskGroup const &);
+    TaskGroup &operator=(TaskGroup const &);
+};
+
+// Estatísticas acumuladas de uma thread trabalhadora.
+struct JobWorkerStats
+{
+    uint64_t tasks_run;
+    uint64_t steals;
+    double   idle_ms;
+};
+
+// Conjunto de threads trabalhadoras com roubo de tarefas. Cada trabalhadora
+// tem sua própria fila: ela retira as tarefas mais recentes do fim da fila
+// (que ainda estão no cache), e as trabalhadoras ociosas roubam as mais
+// antigas do início da fila das outras. Tarefas submetidas de fora do
+// conjunto (thread principal ou de renderização) são distribuídas entre as
+// filas em rodízio.
+//
+// Uma thread que espera um grupo (Wait(), ParallelFor()) executa tarefas
+// pendentes enquanto espera, de forma que tarefas podem submeter e esperar
+// outras tarefas sem bloquear o conjunto.
+class JobSystem
+{
+public:
+    JobSystem();
+    ~JobSystem();
+
+    // Cria as trabalhadoras. Com num_workers igual a zero usa um núcleo a
+    // menos que o total da máquina (a thread principal também trabalha).
+    void Start(size_t num_workers = 0);
+
+    // Executa as tarefas pendentes e termina as trabalhadoras.
+    void Stop();
+
+    size_t NumWorkers() const;
+
+    // Submete uma tarefa. Se group não for NULL, a tarefa passa a fazer parte
+    // do grupo.
+    void Submit(std::function<void()> const &task, TaskGroup *group = NULL);
+
+    // Submete task quando todas as tarefas de group terminarem.
+    void ContinueWith(TaskGroup &group, std::function<void()> const &task, TaskGroup *continuation_group = NULL);
+
+    // Espera todas as tarefas do grupo, executando tarefas enquanto isso.
+    void Wait(TaskGroup &group);
+
+    // Executa body(first, last) sobre [begin, end) dividido em blocos de até
+    // grain elementos, e espera todos terminarem. Com grain igual a zero o
+    // tamanho dos blocos é escolhido a partir do número de trabalhadoras.
+    void ParallelFor(size_t begin, size_t end, size_t grain, std::function<void(size_t, size_t)> const &body);
+
+    JobWorkerStats WorkerStats(size_t worker) const;
+    void ResetStats();
+
+private:
+    struct Task
+    {
+        std::function<void()> function;
+        TaskGroup            *group;
+    };
+
+    struct Worker
+    {
+        std::mutex       mutex;
+        std::deque<Task> tasks;
+        std::thread      thread;
+
+        std::atomic<uint64_t> tasks_run;
+        std::atomic<uint64_t> steals;
+        std::atomic<uint64_t> idle_us;
+        std::atomic<uint64_t> idle_start; // Início da espera em andamento, ou 0
+
+        Worker();
+    };
+
+    std::vector<Worker *> workers;
+    std::atomic<bool>     running;
+    std::atomic<size_t>   queued_tasks;
+    std::atomic<size_t>   next_queue;
+
+    std::mutex              sleep_mutex;
+    std::condition_variable work_available;
+
+    void WorkerLoop(size_t index);
+    void Push(Task const &task);
+    bool PopLocal(size_t index, Task &task);
+    bool Steal(size_t thief, Task &task);
+    bool FindTask(Task &task);
+    void Run(Task &task);
+    void FinishTask(TaskGroup *group);
+
+    JobSystem(JobSystem const &);
+    JobSystem &operator=(JobSystem const &);
+};
+
+extern JobSystem g_JobSystem;
+
+#endif // JOBS_HPP
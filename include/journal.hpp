@@ -0,0 +1,77 @@
+#ifndef JOURNAL_HPP
+#define JOURNAL_HPP
+
+#include <cstdio>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "blocks.hpp"
+
+// Número de entradas do diário que dispara uma compactação.
+#define JOURNAL_COMPACT_ENTRIES 4096
+
+// Alteração de um bloco registrada no diário.
+struct JournalEntry
+{
+    uint32_t x, y, z;
+    Block    old_block;
+    Block    new_block;
+    uint64_t tick;      // Passo da simulação em que o bloco foi alterado
+};
+
+// Diário das alterações de blocos, gravado somente no final do arquivo
+// "journal.log" do diário do mundo. Cada alteração custa uma entrada, em vez
+// da regravação da região inteira, e é repassada ao sistema operacional
+// imediatamente: se o programa terminar sem salvar o mundo, as alterações
+// são recuperadas na próxima execução.
+//
+// A compactação salva as alterações nos arquivos de região: BeginCompaction()
+// separa as entradas atuais em "journal.old" e começa um novo diário; depois
+// que as regiões foram gravadas, EndCompaction() apaga "journal.old".
+//
+// Formato: cabeçalho "FCGJ" + versão (uint32), seguido das entradas [x, y, z
+// (uint32), bloco anterior, bloco novo (uint8), passo (uint64)], na ordem de
+// bytes da máquina.
+class EditJournal
+{
+public:
+    EditJournal();
+    ~EditJournal();
+
+    // Abre o diário em directory. As entradas de execuções anteriores que
+    // não foram compactadas são devolvidas em recovered, e continuam no
+    // diário até a próxima compactação.
+    bool Open(const char *directory, std::vector<JournalEntry> &recovered);
+    void Close();
+    bool IsOpen() const;
+
+    void Append(WorldPoint position, Block old_block, Block new_block, uint64_t tick);
+
+    // As entradas em carry_over (ex: recuperadas e ainda não aplicadas ao
+    // mundo) são copiadas para o novo diário.
+    void BeginCompaction(std::vector<JournalEntry> const &carry_over);
+    void EndCompaction();
+    bool IsCompacting() const;
+
+    // Entradas e bytes do diário atual.
+    size_t NumEntries() const;
+    size_t Bytes() const;
+
+private:
+    std::string directory;
+    FILE       *file;
+    size_t      num_entries;
+    bool        compacting;
+
+    std::string LogPath() const;
+    std::string OldPath() const;
+    bool StartLog(std::string const &path, std::vector<JournalEntry> const &entries);
+    void Write(JournalEntry const &entry);
+};
+
+// Lê as entradas de um arquivo de diário. Uma entrada incompleta (ex: o
+// programa terminou durante a gravação) encerra a leitura.
+bool ReadJournalFile(std::string const &path, std::vector<JournalEntry> &entries);
+
+#endif // JOURNAL_HPP
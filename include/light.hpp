@@ -0,0 +1,116 @@
+#ifndef LIGHT_HPP
+#define LIGHT_HPP
+
+#include <memory>
+#include <vector>
+
+#include "blocks.hpp"
+
+// Maior nível de luz. A luz do céu entra com LIGHT_MAX pelo topo do mundo, e
+// cada bloco de ar atravessado reduz a luz em 1, exceto a luz do céu
+// descendo na vertical.
+#define LIGHT_MAX 15
+
+// Nível de luz emitido por um bloco (0 para blocos que não emitem luz).
+unsigned char BlockLightEmission(Block block);
+
+// Luz de uma célula: luz do céu nos 4 bits altos, luz dos blocos nos 4 bits
+// baixos.
+inline unsigned char LightSky(unsigned char light)   { return light >> 4; }
+inline unsigned char LightBlock(unsigned char light) { return light & 0x0F; }
+
+// Propagação da luz do céu e dos blocos emissores pelo ar de uma cópia do
+// mundo, por busca em largura.
+//
+// Os níveis de luz são guardados por chunk carregado; chunks descarregados
+// não recebem nem transmitem luz. As alterações de blocos são incrementais:
+// BlockChanged() apaga a luz que passava pelo bloco (e tudo que dependia
+// dela) e pede que os vizinhos iluminem a região apagada de novo. Colunas
+// carregadas são iluminadas por inteiro, recebendo também a luz das colunas
+// vizinhas. O trabalho pedido é feito por Update().
+//
+// Os chunks cuja luz mudou (e os vizinhos que têm faces iluminadas por ela)
+// são devolvidos por TakeChangedChunks(), para que as suas malhas sejam
+// refeitas.
+class LightEngine
+{
+public:
+    LightEngine();
+
+    // Ilumina os chunks carregados do mundo. O mundo deve continuar
+    // existindo enquanto a iluminação for usada.
+    void Init(WorldBlockMatrix const &world);
+
+    // Deve ser chamado depois de o bloco ser alterado no mundo.
+    void BlockChanged(WorldPoint point);
+
+    // Um chunk foi carregado. A sua coluna é iluminada por inteiro.
+    void ChunkLoaded(size_t chunk_x, size_t chunk_y, size_t chunk_z);
+
+    // Um chunk carregado teve os seus blocos trocados; previous são os
+    // blocos anteriores. Somente os blocos diferentes são iluminados de novo.
+    void ChunkReplaced(size_t chunk_x, size_t chunk_y, size_t chunk_z, WorldChunk const &previous);
+
+    // Um chunk foi descarregado. A luz que ele espalhou pelos vizinhos é
+    // apagada em Update(), e os vizinhos são devolvidos por
+    // TakeChangedChunks().
+    void ChunkUnloaded(size_t chunk_x, size_t chunk_y, size_t chunk_z);
+
+    // Propaga a luz alterada desde a última chamada.
+    void Update();
+
+    // Descarta a iluminação e ilumina de novo todos os chunks carregados.
+    void RecomputeAll();
+
+    // Luz da célula (veja LightSky() e LightBlock()), ou 0 fora do mundo ou
+    // em chunks descarregados.
+    unsigned char Light(int x, int y, int z) const;
+
+    void TakeChangedChunks(std::vector<WorldPoint> &chunks);
+
+private:
+    struct ChunkLight
+    {
+        unsigned char light[CHUNK_SIZE][CHUNK_SIZE][CHUNK_SIZE];
+    };
+
+    struct Cell
+    {
+        int x, y, z;
+    };
+
+    struct Removal
+    {
+        int           x, y, z;
+        unsigned char level;
+    };
+
+    WorldBlockMatrix const *world;
+    int size_x, size_y, size_z;
+    int chunks_x, chunks_y, chunks_z;
+
+    std::vector<std::unique_ptr<ChunkLight> > chunks;
+
+    std::vector<size_t>  pending_columns;
+    std::vector<bool>    column_pending;
+
+    std::vector<Cell>    add_queue;
+    std::vector<Removal> sky_removal_queue;
+    std::vector<Removal> block_removal_queue;
+
+    std::vector<bool>       chunk_changed;
+    std::vector<WorldPoint> changed_chunks;
+
+    unsigned char const *LightCell(int x, int y, int z) const;
+    unsigned char *LightCell(int x, int y, int z);
+    bool IsTransparent(int x, int y, int z) const;
+    void SetLight(int x, int y, int z, unsigned char *cell, unsigned char light);
+    void MarkChanged(int x, int y, int z);
+    void MarkChunkChanged(int chunk_x, int chunk_y, int chunk_z);
+    void SeedSources(int x, int y, int z);
+    void LightColumn(size_t column);
+    void PropagateRemovals(std::vector<Removal> &queue, bool sky);
+    void PropagateAdds();
+};
+
+#endif // LIGHT_HPP
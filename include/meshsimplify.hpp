@@ -0,0 +1,30 @@
+#ifndef MESHSIMPLIFY_HPP
+#define MESHSIMPLIFY_HPP
+
+#include <vector>
+
+#include <glad/glad.h>
+#include <glm/vec3.hpp>
+
+// Simplifica uma malha de triângulos indexada por contrações de arestas,
+// escolhidas pela métrica de erro quádrica (Garland e Heckbert): cada
+// vértice acumula os planos dos triângulos que o tocam, ponderados pela
+// área, e o custo de mover o vértice é a média dos quadrados das distâncias
+// aos planos acumulados.
+//
+// Cada contração leva um vértice até o outro extremo da aresta, sem criar
+// vértices novos: os índices devolvidos usam os mesmos vértices da malha
+// original, e todos os níveis de detalhe podem compartilhar o mesmo buffer
+// de vértices. Vértices com a mesma posição de outro vértice (costuras de
+// normais ou de textura) não são movidos, para que a malha não abra nas
+// costuras. As bordas abertas recebem planos perpendiculares à malha, que
+// as mantêm no lugar.
+//
+// Para ao chegar a target_triangles triângulos, quando a próxima contração
+// afastaria a superfície mais que max_error (a raiz do custo, nas unidades
+// das posições) ou quando nenhuma contração é possível sem inverter um
+// triângulo. Não usa OpenGL.
+void SimplifyMesh(std::vector<glm::vec3> const &positions, std::vector<GLuint> const &indices,
+                  size_t target_triangles, float max_error, std::vector<GLuint> &simplified);
+
+#endif // MESHSIMPLIFY_HPP
@@ -0,0 +1,68 @@
+#ifndef OCCLUSION_HPP
+#define OCCLUSION_HPP
+
+#include <vector>
+
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+#include <glm/mat4x4.hpp>
+
+// Resolução do buffer de profundidade dos oclusores. A largura deve ser
+// múltipla de 4 (a rasterização processa 4 pixels por vez) e as duas
+// dimensões, potências de 2.
+#define OCCLUSION_WIDTH  256
+#define OCCLUSION_HEIGHT 128
+
+// Oclusão feita na CPU: os oclusores (quadriláteros opacos) são rasterizados
+// em um buffer de profundidade de baixa resolução, e as caixas são testadas
+// contra uma pirâmide em que cada texel guarda a maior profundidade (a mais
+// distante) dos 4 texels do nível de baixo. Uma caixa está oculta se o seu
+// ponto mais próximo está atrás de todos os texels que a cobrem; basta ler
+// poucos texels do nível em que a caixa ocupa no máximo 2x2 texels.
+//
+// As profundidades são as coordenadas z em NDC, que variam linearmente na
+// tela tanto na projeção perspectiva quanto na ortográfica.
+class OcclusionCuller
+{
+public:
+    OcclusionCuller();
+
+    // Limpa o buffer de profundidade para a câmera dada.
+    void Begin(glm::mat4 const &view_projection);
+
+    // Rasteriza um quadrilátero plano, com os cantos em ordem, no sistema
+    // global. Quadriláteros que cruzam o plano próximo são ignorados.
+    void AddOccluderQuad(glm::vec3 const corners[4]);
+
+    // Deve ser chamado depois dos oclusores e antes de IsOccluded().
+    void BuildPyramid();
+
+    // A caixa tem algum ponto dentro do frustum da câmera? O teste é
+    // conservador: algumas caixas fora do frustum são aceitas.
+    bool IsInFrustum(glm::vec3 const &box_min, glm::vec3 const &box_max) const;
+
+    // A caixa está atrás dos oclusores em toda a área que ocupa na tela?
+    bool IsOccluded(glm::vec3 const &box_min, glm::vec3 const &box_max) const;
+
+    // Triângulos rasterizados desde Begin().
+    size_t OccluderTriangles() const;
+
+private:
+    struct ScreenVertex
+    {
+        float x, y, z;
+    };
+
+    glm::mat4 view_projection;
+    size_t    occluder_triangles;
+
+    // levels[0] é o buffer de profundidade; cada nível tem metade da
+    // largura e da altura do anterior.
+    std::vector<std::vector<float> > levels;
+    std::vector<int> level_widths;
+    std::vector<int> level_heights;
+
+    void RasterizeTriangle(ScreenVertex const &v0, ScreenVertex v1, ScreenVertex v2);
+};
+
+#endif // OCCLUSION_HPP
@@ -0,0 +1,174 @@
+#ifndef PROFILER_HPP
+#define PROFILER_HPP
+
+#include <string>
+#include <vector>
+#include <mutex>
+#include <chrono>
+
+#include <glad/glad.h>
+
+// Número de quadros mostrados no gráfico de tempo de quadro.
+#define PROFILER_HISTORY_FRAMES 240
+
+// Número de quadros que aguardamos antes de ler o resultado das consultas de
+// tempo da GPU. Isso evita que a CPU espere a GPU terminar o quadro.
+#define PROFILER_GPU_FRAMES_IN_FLIGHT 4
+
+// Número máximo de escopos de GPU por quadro.
+#define PROFILER_MAX_GPU_SCOPES 16
+
+// Limite de eventos guardados para o arquivo de trace, para que sessões
+// longas não consumam memória indefinidamente.
+#define PROFILER_MAX_TRACE_EVENTS 2000000
+
+// Evento no formato "Trace Event" do Chrome (aberto pelo Perfetto e por
+// chrome://tracing). Tempos em microssegundos.
+struct ProfilerTraceEvent
+{
+    const char *name;
+    double      start_us;
+    double      duration_us;
+    int         thread;
+};
+
+class Profiler
+{
+public:
+    Profiler();
+
+    // Cria as consultas e o programa de GPU do gráfico. Deve ser chamado com
+    // o contexto OpenGL ativo, depois de g_StreamBuffer.Init().
+    void Init();
+
+    // Se habilitado, os eventos são guardados e escritos por WriteChromeTrace().
+    void EnableTrace(bool enabled);
+    bool WriteChromeTrace(const char *filename) const;
+
+    void BeginFrame();
+    void EndFrame();
+
+    // Pode ser chamado de qualquer thread.
+    void RecordCpuScope(const char *name, double start_us, double end_us);
+
+    // Escopos de GPU não podem ser aninhados (GL_TIME_ELAPSED não permite).
+    void BeginGpuScope(const char *name);
+    void EndGpuScope();
+
+    double NowMicroseconds() const;
+
+    // Contabiliza uma chamada de desenho no quadro atual.
+    void CountDrawCall(size_t num_triangles);
+
+    // Dados do último quadro completo.
+    float  LastFrameMs() const;
+    size_t LastFrameDrawCalls() const;
+    size_t LastFrameTriangles() const;
+
+    // Latência entre um evento de entrada e o fim da apresentação do primeiro
+    // quadro que o reflete. Deve ser chamado pela thread que chama EndFrame().
+    void RecordInputLatency(double input_us, double presented_us);
+
+    // Médias do último segundo, em milissegundos. A latência é zero se não
+    // houve entrada no último segundo.
+    float AverageCpuFrameMs() const;
+    float AverageGpuFrameMs() const;
+    float AverageInputLatencyMs() const;
+
+    // Média do último segundo do tempo de GPU dos escopos com o nome dado,
+    // em milissegundos (zero se o escopo não foi medido).
+    float AverageGpuScopeMs(const char *name) const;
+
+    void DrawGraph();
+
+private:
+    struct GpuScope
+    {
+        const char *name;
+        double      cpu_start_us;
+        GLuint      query_id;
+    };
+
+    struct GpuScopeAverage
+    {
+        const char *name;
+        double      accum_ms;
+        int         frames;
+        float       average_ms;
+    };
+
+    struct GpuFrame
+    {
+        GpuScope scopes[PROFILER_MAX_GPU_SCOPES];
+        size_t   num_scopes;
+        size_t   history_index;
+        bool     pending;
+    };
+
+    std::chrono::steady_clock::time_point epoch;
+
+    mutable std::mutex            trace_mutex;
+    bool                          trace_enabled;
+    std::vector<ProfilerTraceEvent> trace_events;
+
+    GpuFrame gpu_frames[PROFILER_GPU_FRAMES_IN_FLIGHT];
+    size_t   frame_number;
+    bool     gpu_scope_open;
+    bool     gpu_initialized;
+
+    double frame_start_us;
+    float  cpu_frame_ms[PROFILER_HISTORY_FRAMES];
+    float  gpu_frame_ms[PROFILER_HISTORY_FRAMES];
+    size_t history_head;
+
+    size_t frame_draw_calls;
+    size_t frame_triangles;
+    size_t last_frame_draw_calls;
+    size_t last_frame_triangles;
+
+    double average_window_start_us;
+    double average_cpu_accum_ms;
+    double average_gpu_accum_ms;
+    int    average_cpu_frames;
+    int    average_gpu_frames;
+    double average_latency_accum_ms;
+    int    average_latency_events;
+    float  average_cpu_ms;
+    float  average_gpu_ms;
+    float  average_latency_ms;
+
+    std::vector<GpuScopeAverage> gpu_scope_averages;
+
+    GLuint graph_program_id;
+    GLint  graph_color_uniform;
+    GLuint graph_vertex_array_object_id;
+    std::vector<float> graph_vertices;
+
+    void CollectGpuFrame(GpuFrame &frame);
+    void PushTraceEvent(const char *name, double start_us, double duration_us, int thread);
+};
+
+extern Profiler g_Profiler;
+
+// Marcador RAII de escopo de CPU: mede o tempo entre a construção e a
+// destruição do objeto.
+class ProfileScope
+{
+public:
+    explicit ProfileScope(const char *name);
+    ~ProfileScope();
+
+private:
+    const char *name;
+    double      start_us;
+};
+
+// Marcador RAII de escopo de GPU.
+class GpuProfileScope
+{
+public:
+    explicit GpuProfileScope(const char *name);
+    ~GpuProfileScope();
+};
+
+#endif // PROFILER_HPP
@@ -0,0 +1,38 @@
+#ifndef RANGEALLOCATOR_HPP
+#define RANGEALLOCATOR_HPP
+
+#include <map>
+#include <cstddef>
+
+// Sub-alocação de intervalos de [0, capacity), usada para repartir um
+// buffer grande da GPU entre várias malhas. Os intervalos livres ficam em
+// uma lista ordenada pelo início; Allocate() usa o primeiro que couber, e
+// Free() junta o intervalo liberado aos vizinhos livres. As unidades são as
+// do chamador (vértices, bytes, ...). Não usa OpenGL.
+class RangeAllocator
+{
+public:
+    static const size_t INVALID = (size_t)-1;
+
+    explicit RangeAllocator(size_t capacity = 0);
+
+    // Início de um intervalo livre de size unidades, múltiplo de alignment
+    // (qualquer número positivo), ou INVALID. O espaço pulado para alinhar
+    // continua livre.
+    size_t Allocate(size_t size, size_t alignment = 1);
+
+    // Devolve um intervalo obtido de Allocate(), com o mesmo tamanho.
+    void Free(size_t offset, size_t size);
+
+    size_t Capacity() const;
+    size_t UsedSize() const;
+    size_t LargestFreeRange() const;
+    size_t NumFreeRanges() const;
+
+private:
+    size_t capacity;
+    size_t used;
+    std::map<size_t, size_t> free_ranges; // Início -> tamanho
+};
+
+#endif // RANGEALLOCATOR_HPP
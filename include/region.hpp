@@ -0,0 +1,173 @@
+#ifndef REGION_HPP
+#define REGION_HPP
+
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "blocks.hpp"
+
+// Chunks em x e em z guardados em cada arquivo de região. Cada região tem
+// todos os chunks da altura do mundo.
+#define REGION_SIZE 8
+
+// Espera antes de tentar de novo a gravação de uma região que falhou.
+#define REGION_RETRY_MS 1000
+
+// Arquivos de região mantidos abertos por RegionStore::Load(). Acima disso,
+// os que não estão sendo lidos são fechados.
+#define REGION_MAX_OPEN_FILES 64
+
+// Compacta os blocos do chunk com RLE: pares [repetições (1 a 255), bloco].
+void EncodeChunkRle(WorldChunk const &chunk, std::vector<unsigned char> &encoded);
+
+// Retorna false se os dados não formam exatamente um chunk.
+bool DecodeChunkRle(unsigned char const *data, size_t size, WorldChunk &chunk);
+
+// Arquivo mapeado na memória, somente para leitura.
+class MappedFile
+{
+public:
+    MappedFile();
+    ~MappedFile();
+
+    bool Open(std::string const &path);
+    void Close();
+
+    unsigned char const *Data() const;
+    size_t Size() const;
+
+private:
+    unsigned char const *data;
+    size_t size;
+#ifdef _WIN32
+    void *file_handle;
+    void *mapping_handle;
+#endif
+
+    MappedFile(MappedFile const &);
+    MappedFile &operator = (MappedFile const &);
+};
+
+// Arquivo de região, lido através de um MappedFile.
+//
+// Formato: cabeçalho "FCGR" + versão (uint32) + chunks na altura (uint32) +
+// reservado (uint32), seguido da tabela de REGION_SIZE * chunks_y *
+// REGION_SIZE entradas [deslocamento (uint32), tamanho (uint32)], na ordem
+// (x, y, z) local, e dos chunks compactados com EncodeChunkRle(). Um tamanho
+// zero indica um chunk que não está no arquivo. Os valores são gravados na
+// ordem de bytes da máquina.
+class RegionFile
+{
+public:
+    bool Open(std::string const &path, size_t chunks_y);
+    void Close();
+
+    // Dados compactados de um chunk, válidos enquanto o arquivo estiver
+    // aberto. Retorna false se o chunk não está no arquivo.
+    bool ChunkData(size_t local_x, size_t chunk_y, size_t local_z, unsigned char const *&data, size_t &size) const;
+
+private:
+    MappedFile file;
+    size_t chunks_y;
+};
+
+// Escreve um arquivo de região com os chunks dados (vazios para chunks
+// ausentes), substituindo o anterior somente depois de gravado por inteiro.
+bool WriteRegionFile(std::string const &path, size_t chunks_y, std::vector<std::vector<unsigned char> > const &chunks);
+
+// Renomeia from para to, substituindo to se ele existir, em um único passo:
+// uma interrupção deixa um dos dois arquivos inteiro no lugar de to.
+bool Region_ReplaceFile(std::string const &from, std::string const &to);
+
+// Guarda chunks do mundo compactados. Com um diretório, os chunks são
+// gravados em arquivos de região por uma thread própria, e ficam na memória
+// somente até serem gravados; sem diretório, ficam somente na memória. Pode
+// ser usado por várias threads ao mesmo tempo.
+class RegionStore
+{
+public:
+    RegionStore();
+    ~RegionStore();
+
+    // Cria o diretório se necessário. directory pode ser NULL.
+    bool Open(const char *directory, WorldPoint size_in_chunks);
+
+    // Compacta o chunk e agenda a gravação da sua região. Não espera a
+    // gravação.
+    void Save(size_t chunk_x, size_t chunk_y, size_t chunk_z, WorldChunk const &chunk);
+
+    // Retorna false se o chunk nunca foi salvo.
+    bool Load(size_t chunk_x, size_t chunk_y, size_t chunk_z, WorldChunk &chunk) const;
+
+    // Espera a gravação de todas as regiões agendadas, ou até uma gravação
+    // falhar.
+    void Flush();
+
+    // Verdadeiro se não há regiões agendadas nem sendo gravadas.
+    bool IsIdle() const;
+
+    // Geração do último Save(). IsWritten(generation) é verdadeiro quando
+    // todos os chunks salvos até essa geração estão nos arquivos: uma região
+    // cuja gravação falhou volta para a fila, e os seus chunks continuam
+    // pendentes.
+    uint64_t SaveGeneration() const;
+    bool IsWritten(uint64_t generation) const;
+
+    // Chunks mantidos na memória (ainda não gravados, ou sem diretório).
+    size_t PendingChunks() const;
+    size_t PendingBytes() const;
+
+    size_t RegionsWritten() const;
+
+private:
+    struct PendingChunk
+    {
+        std::vector<unsigned char> data;
+        uint64_t                   generation; // Incrementada a cada Save()
+    };
+
+    std::string directory;
+    bool        persistent;
+    size_t      chunks_x, chunks_y, chunks_z;
+
+    mutable std::mutex mutex;
+    std::condition_variable changed;
+    std::unordered_map<size_t, PendingChunk> pending;
+    size_t           pending_bytes;
+    uint64_t         generation;
+    std::set<size_t> dirty_regions;
+    bool             writing;
+    bool             stopping;
+    size_t           regions_written;
+    size_t           failed_writes;
+    std::thread      writer;
+
+    // Arquivos de região abertos por Load(), um por região, ou nulo se a
+    // região não tem arquivo. Load() lê os chunks fora de file_mutex, com a
+    // sua própria referência ao arquivo; WriteRegion() retira a região e
+    // espera as leituras em andamento (file_released) antes de substituir o
+    // arquivo, que no Windows não pode estar mapeado.
+    mutable std::mutex file_mutex;
+    mutable std::condition_variable file_released;
+    mutable std::unordered_map<size_t, std::shared_ptr<RegionFile> > open_files;
+
+    size_t ChunkKey(size_t chunk_x, size_t chunk_y, size_t chunk_z) const;
+    size_t RegionKey(size_t chunk_x, size_t chunk_z) const;
+    std::string RegionPath(size_t region_x, size_t region_z) const;
+    void WriterThread();
+    bool WriteRegion(size_t region);
+};
+
+// Semente e dimensões de um mundo salvo, no arquivo "world.txt" do
+// diretório. Retorna false se o arquivo não existe.
+bool ReadWorldInfo(const char *directory, uint32_t &seed, WorldPoint &size);
+bool WriteWorldInfo(const char *directory, uint32_t seed, WorldPoint size);
+
+#endif // REGION_HPP
@@ -5,6 +5,19 @@
 #include <tiny_obj_loader.h>
 #include <Camera.hpp>
 
+#include "gpumemory.hpp"
+
+// Níveis de detalhe gerados para cada objeto. Cada nível tem cerca de
+// SCENE_LOD_TRIANGLE_RATIO dos triângulos do anterior; objetos que quase não
+// podem ser simplificados recebem menos níveis.
+#define SCENE_LOD_LEVELS 4
+#define SCENE_LOD_TRIANGLE_RATIO 0.25f
+
+// Diâmetro projetado na tela, em pixels, abaixo do qual o nível 1 é usado.
+// Cada nível seguinte é usado quando o diâmetro cai à metade: a área cai a
+// um quarto, como o número de triângulos.
+#define SCENE_LOD_FULL_DETAIL_PIXELS 256.0f
+
 class SceneObject
 {
 public:
@@ -16,17 +29,34 @@ public:
     glm::vec3    bbox_min; // Axis-Aligned Bounding Box do objeto
     glm::vec3    bbox_max;
 
-    void Draw(GLint bbox_min_uniform, GLint bbox_max_uniform) const;
+    // Níveis de detalhe, no mesmo buffer de índices e com os mesmos vértices.
+    // O nível 0 é o modelo completo (first_index e num_indices).
+    size_t       num_lods;
+    size_t       lod_first_index[SCENE_LOD_LEVELS];
+    size_t       lod_num_indices[SCENE_LOD_LEVELS];
+
+    // Nível de detalhe para o objeto desenhado com as matrizes dadas, pelo
+    // diâmetro da esfera que envolve a AABB projetado na tela.
+    size_t SelectLod(glm::mat4 const &model, glm::mat4 const &view, glm::mat4 const &projection, int viewport_height) const;
+
+    void Draw(GLint bbox_min_uniform, GLint bbox_max_uniform, size_t lod = 0) const;
 };
 
 struct VirtualScene {
 private:
     std::map<std::string, SceneObject> objects;
+    std::vector<GLuint>                vertex_array_object_ids;
+    std::vector<GpuAllocation>         allocations;
 public:
     VirtualScene();
+    ~VirtualScene();
 
     void insert(SceneObject new_scene_object);
 
+    // Os VAOs e os intervalos de g_GpuMemory dos modelos são liberados
+    // junto com a cena.
+    void insert_buffers(GLuint vertex_array_object_id, std::vector<GpuAllocation> const &allocations);
+
     SceneObject const &operator [] (char const *name) const;
 };
 
@@ -0,0 +1,72 @@
+#ifndef SHADOWMAP_HPP
+#define SHADOWMAP_HPP
+
+#include <glad/glad.h>
+#include <glm/vec4.hpp>
+#include <glm/mat4x4.hpp>
+
+#include "chunkmesh.hpp"
+
+// Número de cascatas. Deve ser o mesmo valor de SHADOW_CASCADES em
+// "shader_fragment.glsl".
+#define SHADOW_CASCADES 3
+
+// Resolução de cada cascata, em texels.
+#define SHADOW_MAP_SIZE 1024
+
+// Unidade de textura do mapa de sombras (a unidade 31 é usada pelo texto).
+#define SHADOW_TEXTURE_UNIT 30
+
+// Mistura entre divisões uniformes (0) e logarítmicas (1) do frustum.
+#define SHADOW_SPLIT_LAMBDA 0.75f
+
+// Sentido do ponto para o sol, no sistema de coordenadas global.
+#define SHADOW_SUN_DIRECTION glm::vec4(1.0f, 1.0f, 0.0f, 0.0f)
+
+// Sombras do sol por mapas de sombra em cascata: o frustum da câmera é
+// dividido em fatias ao longo da profundidade, e cada fatia recebe uma
+// projeção ortográfica do sol que a envolve.
+//
+// Cada cascata envolve a esfera que contém a sua fatia. O raio da esfera não
+// depende da orientação da câmera, e o centro é arredondado para um número
+// inteiro de texels no espaço da luz; assim, a mesma posição do mundo cai
+// sempre no mesmo texel e as bordas das sombras não tremem quando a câmera
+// se move ou gira.
+//
+// O passe de profundidade reusa os buffers das malhas dos chunks, lendo
+// somente a posição de cada vértice (3 bytes), e desenha somente os chunks
+// dentro de cada cascata.
+class CascadedShadowMap
+{
+public:
+    CascadedShadowMap();
+    ~CascadedShadowMap();
+
+    // Cria a textura, o framebuffer e o programa de profundidade. Deve ser
+    // chamado com o contexto OpenGL ativo.
+    bool Init();
+
+    // Ajusta as cascatas ao frustum de view e projection.
+    void Fit(glm::mat4 const &view, glm::mat4 const &projection, glm::vec4 sun_direction);
+
+    // Desenha a profundidade das malhas dos chunks em cada cascata. O
+    // framebuffer, o viewport e o programa atuais são restaurados.
+    void Render(ChunkRenderer &chunk_renderer);
+
+    // Envia as cascatas para o programa de GPU atual, que deve declarar os
+    // uniforms de "shader_fragment.glsl", e liga a textura.
+    void Bind(GLuint program_id) const;
+
+private:
+    GLuint texture_id;
+    GLuint framebuffer_id;
+    GLuint program_id;
+    GLint  model_uniform;
+    GLint  light_matrix_uniform;
+
+    glm::mat4 light_matrices[SHADOW_CASCADES];  // Do mundo para o recorte da luz
+    float     split_distances[SHADOW_CASCADES]; // Fim de cada fatia, à frente da câmera
+    float     texel_sizes[SHADOW_CASCADES];     // Tamanho de um texel no mundo
+};
+
+#endif // SHADOWMAP_HPP
@@ -0,0 +1,65 @@
+#ifndef SIMULATION_HPP
+#define SIMULATION_HPP
+
+#include <glm/vec4.hpp>
+#include "Camera.hpp"
+
+// Taxa padrão da simulação, em passos por segundo.
+#define SIMULATION_DEFAULT_TICK_RATE 60.0
+
+// Maior tempo de quadro considerado pela simulação. Quadros mais longos (ex:
+// a janela foi arrastada) não geram uma avalanche de passos atrasados.
+#define SIMULATION_MAX_FRAME_SECONDS 0.25
+
+// Estado das teclas mantidas pressionadas. É atualizado pelos callbacks de
+// entrada e lido pela simulação no início de cada passo.
+struct InputState
+{
+    bool move_forward;
+    bool move_backward;
+    bool move_left;
+    bool move_right;
+    bool move_up;
+    bool move_down;
+
+    InputState();
+};
+
+// Laço de simulação com passo fixo. O tempo de cada quadro é acumulado, e
+// são executados tantos passos de duração fixa quanto couberem nele. A
+// renderização interpola entre os dois últimos passos, de forma que o custo
+// e o resultado da simulação não dependem da taxa de quadros.
+class Simulation
+{
+public:
+    explicit Simulation(double tick_rate = SIMULATION_DEFAULT_TICK_RATE);
+
+    void   SetTickRate(double tick_rate);
+    double TickRate() const;
+    double TickDuration() const;
+
+    // Acumula o tempo do quadro e executa os passos pendentes. Retorna o
+    // número de passos executados.
+    size_t Advance(double frame_seconds, InputState const &input, Camera &camera);
+
+    // Fração do próximo passo já decorrida, em [0, 1).
+    double InterpolationAlpha() const;
+
+    // Tempo de jogo e posição da câmera interpolados para a renderização.
+    double    InterpolatedTime() const;
+    glm::vec4 InterpolatedCameraPosition() const;
+
+    size_t TotalTicks() const;
+
+private:
+    double    tick_duration;
+    double    accumulator;
+    double    time;
+    size_t    total_ticks;
+    glm::vec4 previous_camera_position;
+    glm::vec4 current_camera_position;
+
+    void Tick(InputState const &input, Camera &camera);
+};
+
+#endif // SIMULATION_HPP
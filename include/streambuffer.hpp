@@ -0,0 +1,94 @@
+#ifndef STREAMBUFFER_HPP
+#define STREAMBUFFER_HPP
+
+#include <deque>
+#include <cstddef>
+
+#include <glad/glad.h>
+
+// Quadros que a GPU pode estar processando enquanto a CPU prepara o próximo,
+// e bytes enviados por quadro que cabem no anel sem que a CPU espere. O
+// limite de envio das malhas dos chunks (CHUNK_UPLOAD_BUDGET_BYTES) e o
+// texto cabem com folga.
+#define STREAM_FRAMES_IN_FLIGHT 3
+#define STREAM_FRAME_BYTES (2 * 1024 * 1024)
+
+struct StreamBufferStats
+{
+    size_t bytes;  // Bytes escritos no anel
+    size_t writes; // Chamadas a Write()
+    size_t stalls; // Vezes em que a CPU esperou a GPU liberar espaço
+};
+
+// Anel em um único buffer da GPU para os dados enviados a cada quadro: os
+// vértices do texto e do gráfico do profiler, e as cópias das malhas e dos
+// rótulos do HUD a caminho dos seus buffers. Cada escrita mapeia somente o
+// seu intervalo com GL_MAP_UNSYNCHRONIZED_BIT (OpenGL 3.3 não tem
+// mapeamento persistente), então o driver não espera a GPU nem copia o
+// buffer.
+//
+// Quem garante que a GPU não está lendo o intervalo é o próprio anel:
+// EndFrame() cerca com glFenceSync os bytes escritos no quadro, e um
+// intervalo só é reescrito depois que a cerca do quadro que o usou é
+// sinalizada. Com STREAM_FRAMES_IN_FLIGHT quadros de STREAM_FRAME_BYTES, as
+// cercas já foram sinalizadas quando o anel dá a volta; se não foram, a CPU
+// espera, e a espera é contada em StreamBufferStats::stalls.
+//
+// Deve ser usado somente pela thread que tem o contexto OpenGL.
+class StreamBuffer
+{
+public:
+    static const size_t INVALID = (size_t)-1;
+
+    StreamBuffer();
+
+    // Cria o buffer. Deve ser chamado com o contexto OpenGL ativo.
+    void Init(size_t capacity = STREAM_FRAMES_IN_FLIGHT * STREAM_FRAME_BYTES);
+
+    GLuint Buffer() const;
+
+    // Copia data para o anel e devolve o início do intervalo em Buffer(),
+    // múltiplo de alignment, que pode ser usado pelos comandos do quadro
+    // atual. Devolve INVALID se o anel não foi criado ou se bytes não cabe
+    // nele.
+    size_t Write(void const *data, size_t bytes, size_t alignment);
+
+    // Escreve data no anel e pede à GPU que a copie para offset em
+    // buffer_id, sem esperar que a GPU termine de ler buffer_id. Devolve
+    // false se Write() falhar; o chamador deve enviar os dados de outro modo.
+    bool CopyToBuffer(GLuint buffer_id, size_t offset, void const *data, size_t bytes);
+
+    // Deve ser chamado uma vez por quadro, depois da troca de buffers.
+    void EndFrame();
+
+    StreamBufferStats const &LastFrameStats() const;
+    size_t TotalStalls() const;
+
+private:
+    // Bytes escritos em um quadro, incluindo os pulados para alinhar ou
+    // para voltar ao início, e a cerca dos comandos que os leem.
+    struct FrameRegion
+    {
+        GLsync fence;
+        size_t bytes;
+    };
+
+    GLuint buffer_id;
+    size_t capacity;
+    size_t head;        // Próximo byte a escrever
+    size_t used;        // Bytes entre o quadro mais antigo em uso e head
+    size_t frame_bytes; // Bytes ocupados no quadro atual, ainda sem cerca
+
+    std::deque<FrameRegion> frames;
+
+    StreamBufferStats frame_stats;
+    StreamBufferStats last_frame_stats;
+    size_t            total_stalls;
+
+    void FenceCurrentFrame();
+    bool RetireOldestFrame(bool wait);
+};
+
+extern StreamBuffer g_StreamBuffer;
+
+#endif // STREAMBUFFER_HPP
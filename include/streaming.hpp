@@ -0,0 +1,153 @@
+#ifndef STREAMING_HPP
+#define STREAMING_HPP
+
+#include <list>
+#include <unordered_map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <glm/vec4.hpp>
+
+#include "blocks.hpp"
+#include "jobs.hpp"
+#include "terrain.hpp"
+#include "region.hpp"
+#include "journal.hpp"
+
+// Raio padrão, em chunks, da região carregada em volta da câmera.
+#define STREAMING_DEFAULT_RADIUS 8
+
+// Memória padrão para os chunks carregados, em MiB. Colunas fora do raio só
+// são descarregadas quando este limite é ultrapassado.
+#define STREAMING_DEFAULT_BUDGET_MB 64
+
+// Colunas sendo carregadas ao mesmo tempo e colunas descarregadas por
+// quadro, para que nenhum quadro fique longo ao andar pelo mundo.
+#define STREAMING_MAX_LOADS_IN_FLIGHT 16
+#define STREAMING_MAX_EVICTIONS_PER_FRAME 16
+
+// Chunk carregado, repassado à cópia do mundo mantida pela thread de
+// renderização. Os blocos não são mais alterados depois de carregados.
+struct ChunkLoad
+{
+    int chunk_x, chunk_y, chunk_z;
+    std::shared_ptr<const WorldChunk> data;
+};
+
+// Estado do ChunkStreamer, mostrado no HUD.
+struct StreamingStats
+{
+    size_t resident_chunks;
+    size_t resident_bytes;
+    size_t stored_chunks;   // Chunks salvos mantidos na memória pelo RegionStore
+    size_t stored_bytes;
+    size_t loads_in_flight; // Colunas sendo carregadas
+
+    StreamingStats();
+};
+
+// Mantém carregadas as colunas de chunks a até um raio da câmera. Deve ser
+// usado somente pela thread dona do mundo.
+//
+// Colunas que faltam são pedidas da mais próxima para a mais distante, e
+// carregadas pelo JobSystem: lidas do RegionStore se já foram salvas, ou
+// geradas pelo TerrainGenerator. Update() instala no mundo as colunas
+// prontas e, se a memória dos chunks carregados passa do limite, descarrega
+// as colunas fora do raio usadas há mais tempo (LRU). Somente as colunas
+// alteradas são salvas; as demais são geradas de novo quando necessário.
+class ChunkStreamer
+{
+public:
+    explicit ChunkStreamer(TerrainGenerator const &generator);
+    ~ChunkStreamer();
+
+    // Com save_directory, as colunas alteradas são salvas em arquivos de
+    // região nesse diretório e lidas de lá nas próximas execuções.
+    bool Init(WorldBlockMatrix &world, int radius_chunks, size_t budget_bytes, const char *save_directory);
+
+    // Indica que um bloco carregado foi alterado.
+    void MarkModified(WorldPoint block);
+
+    // Salva as colunas carregadas alteradas desde o último salvamento. A
+    // gravação dos arquivos é feita em segundo plano.
+    void SaveModified();
+
+    // Espera a gravação de tudo que foi salvo, ou até uma gravação falhar.
+    void FlushSaves();
+
+    // Marca do que já foi salvo. SavesWritten(mark) é verdadeiro quando tudo
+    // que foi salvo até a marca já está nos arquivos de região; gravações
+    // que falharam são repetidas, e até lá não contam.
+    uint64_t SaveMark() const;
+    bool SavesWritten(uint64_t mark) const;
+
+    // Alterações recuperadas do diário, aplicadas a cada coluna quando ela é
+    // carregada. Deve ser chamado antes de carregar as colunas alteradas.
+    void AddRecoveredEdits(std::vector<JournalEntry> const &entries);
+
+    // Alterações recuperadas de colunas que ainda não foram carregadas.
+    std::vector<JournalEntry> UnappliedEdits() const;
+
+    // Os chunks carregados e descarregados são acrescentados a loads e
+    // unloads, para serem repassados a outras cópias do mundo.
+    void Update(glm::vec4 camera_position, std::vector<ChunkLoad> &loads, std::vector<WorldPoint> &unloads);
+
+    // Carrega todas as colunas dentro do raio antes de retornar (ex: onde a
+    // câmera começa).
+    void LoadAroundNow(glm::vec4 camera_position, std::vector<ChunkLoad> &loads, std::vector<WorldPoint> &unloads);
+
+    // Volta os chunks do mundo aos de snapshot, uma cópia do mundo feita
+    // antes. Os chunks trocados são acrescentados a loads, e as suas colunas
+    // passam a ser alteradas. Colunas que não estavam carregadas na cópia
+    // ficam como estão.
+    void Restore(WorldBlockMatrix const &snapshot, std::vector<ChunkLoad> &loads);
+
+    // Espera os carregamentos em andamento (ex: antes de parar o JobSystem).
+    void WaitForLoads();
+
+    StreamingStats Stats() const;
+
+private:
+    // Resultado de um carregamento: os chunks da coluna, de baixo para cima.
+    struct ColumnLoad
+    {
+        size_t column;
+        std::shared_ptr<std::vector<WorldChunk> > chunks;
+    };
+
+    enum ColumnState { COLUMN_UNLOADED, COLUMN_LOADING, COLUMN_RESIDENT };
+
+    TerrainGenerator  generator;
+    WorldBlockMatrix *world;
+    size_t chunks_x, chunks_y, chunks_z;
+    int    radius;
+    size_t budget_bytes;
+
+    std::vector<ColumnState> states;
+    std::vector<bool>        modified;
+
+    // Alterações recuperadas, por coluna.
+    std::unordered_map<size_t, std::vector<JournalEntry> > recovered_edits;
+
+    // Colunas carregadas, da usada mais recentemente para a mais antiga.
+    std::list<size_t> lru;
+    std::vector<std::list<size_t>::iterator> lru_positions;
+
+    RegionStore store;
+
+    TaskGroup jobs;
+    size_t    loads_in_flight;
+    size_t    missing_columns; // Colunas dentro do raio ainda não pedidas
+
+    std::mutex              ready_mutex;
+    std::vector<ColumnLoad> ready;
+
+    void SaveColumn(size_t column);
+    void LoadColumn(size_t column, std::vector<WorldChunk> &chunks) const;
+    void Install(ColumnLoad const &load, std::vector<ChunkLoad> &loads);
+    void Evict(size_t column, std::vector<WorldPoint> &unloads);
+    void Touch(size_t column);
+};
+
+#endif // STREAMING_HPP
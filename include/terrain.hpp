@@ -0,0 +1,58 @@
+#ifndef TERRAIN_HPP
+#define TERRAIN_HPP
+
+#include <cstdint>
+
+#include "blocks.hpp"
+
+// Semente e dimensões do mundo usadas quando não são dadas na linha de comando.
+#define TERRAIN_DEFAULT_SEED   1337u
+#define TERRAIN_DEFAULT_SIZE_X 128
+#define TERRAIN_DEFAULT_SIZE_Y 64
+#define TERRAIN_DEFAULT_SIZE_Z 128
+
+// Parâmetros do relevo. A altura do terreno varia em torno de
+// TERRAIN_BASE_HEIGHT (fração da altura do mundo), com amplitude
+// TERRAIN_HEIGHT_AMPLITUDE.
+#define TERRAIN_BASE_HEIGHT      0.45f
+#define TERRAIN_HEIGHT_AMPLITUDE 0.35f
+#define TERRAIN_HEIGHT_FREQUENCY (1.0f / 96.0f)
+#define TERRAIN_HEIGHT_OCTAVES   4
+
+// Cavernas: o ruído 3D acima do limiar abre uma caverna. Os blocos logo
+// abaixo da superfície não são escavados.
+#define TERRAIN_CAVE_FREQUENCY   (1.0f / 24.0f)
+#define TERRAIN_CAVE_OCTAVES     2
+#define TERRAIN_CAVE_THRESHOLD   0.28f
+#define TERRAIN_CAVE_MIN_DEPTH   4
+
+// Ruído de gradiente 3D, com valores aproximadamente em [-1, 1]. Os quatro
+// pontos são avaliados juntos com SSE2 quando disponível.
+float TerrainNoise(float x, float y, float z, uint32_t seed);
+void  TerrainNoise4(float const x[4], float const y[4], float const z[4], uint32_t seed, float out[4]);
+
+// Verdadeiro se TerrainNoise4() usa instruções SIMD neste executável.
+bool TerrainUsesSimd();
+
+// Gerador de terreno com semente: mapa de altura com várias oitavas de ruído,
+// grama no topo de cada coluna e pedra abaixo, com cavernas escavadas por um
+// ruído 3D. O resultado depende somente da semente e da posição, e não da
+// ordem em que os chunks são gerados.
+class TerrainGenerator
+{
+public:
+    explicit TerrainGenerator(uint32_t seed);
+
+    // Preenche os chunks_y chunks de uma coluna (chunk_x, chunk_z), de baixo
+    // para cima. Não acessa o mundo, e pode executar em qualquer thread.
+    void GenerateColumn(size_t chunk_x, size_t chunk_z, WorldChunk *const *column, size_t chunks_y) const;
+
+    // Preenche o mundo todo, uma coluna de chunks por tarefa do g_JobSystem.
+    // Todos os chunks devem estar carregados.
+    void Generate(WorldBlockMatrix &world) const;
+
+private:
+    uint32_t seed;
+};
+
+#endif // TERRAIN_HPP
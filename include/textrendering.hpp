@@ -0,0 +1,54 @@
+#ifndef TEXTRENDERING_HPP
+#define TEXTRENDERING_HPP
+
+#include <string>
+#include <vector>
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include <glm/mat4x4.hpp>
+#include <glm/vec4.hpp>
+
+// Dimensões da janela já convertidas para a escala do texto. É atualizado
+// somente quando a janela é redimensionada (ver FramebufferSizeCallback()),
+// de forma que o layout do texto não precisa consultar o sistema de janelas.
+struct TextLayoutContext
+{
+    int   window_width;
+    int   window_height;
+    float sx;          // Tamanho de um pixel em NDC no eixo X (já multiplicado por textscale)
+    float sy;          // Tamanho de um pixel em NDC no eixo Y (já multiplicado por textscale)
+    float line_height;
+    float char_width;
+    unsigned version;  // Incrementado a cada redimensionamento
+};
+
+// Funções auxiliares para renderizar texto dentro da janela OpenGL. Estas
+// funções estão definidas no arquivo "textrendering.cpp". TextRendering_Init()
+// deve ser chamada depois de g_StreamBuffer.Init().
+void TextRendering_Init();
+void TextRendering_OnWindowResize(int width, int height);
+TextLayoutContext const &TextRendering_LayoutContext();
+
+// Configuram o estado OpenGL (programa, blending, teste de profundidade) usado
+// para desenhar texto. Quem desenha vértices gerados por
+// TextRendering_LayoutString() com seu próprio VAO deve chamar estas funções
+// antes e depois do desenho.
+void TextRendering_BeginDraw();
+void TextRendering_EndDraw();
+
+// Gera os vértices (x, y, s, t) dos triângulos de uma string, adicionando-os
+// ao final de "vertices". Retorna o número de vértices gerados.
+size_t TextRendering_LayoutString(std::vector<float> &vertices, const std::string &str, float x, float y, float scale = 1.0f);
+
+float TextRendering_LineHeight(GLFWwindow *window);
+float TextRendering_CharWidth(GLFWwindow *window);
+void TextRendering_PrintString(GLFWwindow *window, const std::string &str, float x, float y, float scale = 1.0f);
+void TextRendering_PrintMatrix(GLFWwindow *window, glm::mat4 M, float x, float y, float scale = 1.0f);
+void TextRendering_PrintVector(GLFWwindow *window, glm::vec4 v, float x, float y, float scale = 1.0f);
+void TextRendering_PrintMatrixVectorProduct(GLFWwindow *window, glm::mat4 M, glm::vec4 v, float x, float y, float scale = 1.0f);
+void TextRendering_PrintMatrixVectorProductMoreDigits(GLFWwindow *window, glm::mat4 M, glm::vec4 v, float x, float y, float scale = 1.0f);
+void TextRendering_PrintMatrixVectorProductDivW(GLFWwindow *window, glm::mat4 M, glm::vec4 v, float x, float y, float scale = 1.0f);
+
+#endif // TEXTRENDERING_HPP
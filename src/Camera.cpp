@@ -6,12 +6,12 @@
 float pi = acos(-1.0f);
 Camera::Camera():
     projection_type(PERSPECTIVE_PROJ),
-    center_point(4.0f, WORLD_SIZE_Y / 2.0f + 1.0f, 4.0f, 1.0f),
+    center_point(4.0f, WORLD_DEFAULT_SIZE_Y / 2.0f + 1.0f, 4.0f, 1.0f),
     view_theta(0.0f),
     view_phi(0.0f),
     view_rho(2.5f),
     up_vector(0.0f, 1.0f, 0.0f, 0.0f),
-    move_speed(0.10001f),
+    move_speed(3.0f),
     rotate_speed(0.005f),
     zoom_speed(0.1f),
     nearplane(-0.1f),
@@ -42,35 +42,35 @@ void Camera::RotateViewPhi(float dy)
         this->view_phi = phimin;
 }
 
-void Camera::MoveForewards()
+void Camera::MoveForewards(float delta_time)
 {
-    this->center_point += -this->WVectorProjectedToXZ() * this->move_speed;
+    this->center_point += -this->WVectorProjectedToXZ() * this->move_speed * delta_time;
 }
 
-void Camera::MoveBackwards()
+void Camera::MoveBackwards(float delta_time)
 {
-    this->center_point += this->WVectorProjectedToXZ() * this->move_speed;
+    this->center_point += this->WVectorProjectedToXZ() * this->move_speed * delta_time;
 }
 
 
-void Camera::MoveLeftwards()
+void Camera::MoveLeftwards(float delta_time)
 {
-    this->center_point += -this->UVector() * glm::vec4(1.0f, 0.0f, 1.0f, 1.0f) * this->move_speed;
+    this->center_point += -this->UVector() * glm::vec4(1.0f, 0.0f, 1.0f, 1.0f) * this->move_speed * delta_time;
 }
 
-void Camera::MoveRightwards()
+void Camera::MoveRightwards(float delta_time)
 {
-    this->center_point += this->UVector() * glm::vec4(1.0f, 0.0f, 1.0f, 1.0f) * this->move_speed;
+    this->center_point += this->UVector() * glm::vec4(1.0f, 0.0f, 1.0f, 1.0f) * this->move_speed * delta_time;
 }
 
-void Camera::MoveUpwards()
+void Camera::MoveUpwards(float delta_time)
 {
-    this->center_point += glm::vec4(0,1,0,0) * this->move_speed;
+    this->center_point += glm::vec4(0,1,0,0) * this->move_speed * delta_time;
 }
 
-void Camera::MoveDownwards()
+void Camera::MoveDownwards(float delta_time)
 {
-    this->center_point -= glm::vec4(0,1,0,0) * this->move_speed;
+    this->center_point -= glm::vec4(0,1,0,0) * this->move_speed * delta_time;
 }
 
 void Camera::SetProjectionType(ProjectionType projection_type)
@@ -107,6 +107,23 @@ void Camera::Zoom(float factor)
     }
 }
 
+void Camera::SetPose(glm::vec4 center_point, float view_theta, float view_phi)
+{
+    this->center_point = center_point;
+    this->view_theta = view_theta;
+    this->view_phi = view_phi;
+}
+
+void Camera::SetCenterPoint(glm::vec4 center_point)
+{
+    this->center_point = center_point;
+}
+
+void Camera::SetViewDistance(float distance)
+{
+    this->farplane = -distance;
+}
+
 glm::vec4 Camera::CenterPoint() const
 {
     return this->center_point;
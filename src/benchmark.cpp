@@ -0,0 +1,707 @@
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <cmath>
+
+#include "benchmark.hpp"
+#include "blocks.hpp"
+#include "jobs.hpp"
+#include "terrain.hpp"
+#include "region.hpp"
+#include "journal.hpp"
+#include "light.hpp"
+#include "chunkmesh.hpp"
+
+static bool BenchmarkCameraKeyLess(BenchmarkCameraKey const &a, BenchmarkCameraKey const &b)
+{
+    return a.frame < b.frame;
+}
+
+static bool BenchmarkEditLess(BenchmarkEdit const &a, BenchmarkEdit const &b)
+{
+    return a.frame < b.frame;
+}
+
+BenchmarkScript::BenchmarkScript():
+    num_frames(1000),
+    timestep(1.0 / 60.0)
+{
+}
+
+bool BenchmarkScript::Load(const char *filename)
+{
+    std::ifstream file(filename);
+    if (!file.is_open())
+    {
+        std::cerr << "ERROR: Cannot open benchmark script \"" << filename << "\"." << std::endl;
+        return false;
+    }
+
+    std::string line;
+    size_t line_number = 0;
+
+    while (std::getline(file, line))
+    {
+        line_number++;
+
+        size_t comment = line.find('#');
+        if (comment != std::string::npos)
+            line.erase(comment);
+
+        std::istringstream stream(line);
+        std::string directive;
+        if (!(stream >> directive))
+            continue;
+
+        bool ok;
+        if (directive == "frames")
+        {
+            ok = static_cast<bool>(stream >> this->num_frames);
+        }
+        else if (directive == "timestep")
+        {
+            ok = static_cast<bool>(stream >> this->timestep) && this->timestep > 0.0;
+        }
+        else if (directive == "camera")
+        {
+            BenchmarkCameraKey key;
+            ok = static_cast<bool>(stream >> key.frame >> key.position.x >> key.position.y >> key.position.z >> key.view_theta >> key.view_phi);
+            if (ok)
+                this->camera_keys.push_back(key);
+        }
+        else if (directive == "break" || directive == "place")
+        {
+            BenchmarkEdit edit;
+            edit.kind = directive == "break" ? BenchmarkEdit::EDIT_BREAK : BenchmarkEdit::EDIT_PLACE;
+            ok = static_cast<bool>(stream >> edit.frame >> edit.position.x >> edit.position.y >> edit.position.z);
+            if (ok)
+                this->edits.push_back(edit);
+        }
+        else
+        {
+            ok = false;
+        }
+
+        if (!ok)
+        {
+            std::cerr << "ERROR: Invalid directive in \"" << filename << "\" line " << line_number << ": " << line << std::endl;
+            return false;
+        }
+    }
+
+    std::stable_sort(this->camera_keys.begin(), this->camera_keys.end(), BenchmarkCameraKeyLess);
+    std::stable_sort(this->edits.begin(), this->edits.end(), BenchmarkEditLess);
+
+    return true;
+}
+
+void BenchmarkScript::ApplyCamera(size_t frame, Camera &camera) const
+{
+    if (this->camera_keys.empty())
+        return;
+
+    // Encontramos o primeiro quadro-chave depois do quadro atual.
+    size_t next = 0;
+    while (next < this->camera_keys.size() && this->camera_keys[next].frame <= frame)
+        next++;
+
+    BenchmarkCameraKey const *a;
+    BenchmarkCameraKey const *b;
+    if (next == 0)
+        a = b = &this->camera_keys.front();
+    else if (next == this->camera_keys.size())
+        a = b = &this->camera_keys.back();
+    else
+    {
+        a = &this->camera_keys[next - 1];
+        b = &this->camera_keys[next];
+    }
+
+    float t = 0.0f;
+    if (b->frame > a->frame)
+        t = (float)(frame - a->frame) / (float)(b->frame - a->frame);
+
+    glm::vec3 position = a->position + t * (b->position - a->position);
+    float view_theta = a->view_theta + t * (b->view_theta - a->view_theta);
+    float view_phi = a->view_phi + t * (b->view_phi - a->view_phi);
+
+    camera.SetPose(glm::vec4(position, 1.0f), view_theta, view_phi);
+}
+
+void BenchmarkStats::AddFrame(double frame_ms, size_t draw_calls, size_t triangles)
+{
+    this->frame_ms.push_back(frame_ms);
+    this->draw_calls.push_back(draw_calls);
+    this->triangles.push_back(triangles);
+}
+
+void BenchmarkStats::AddInputLatency(double latency_ms)
+{
+    this->input_latency_ms.push_back(latency_ms);
+}
+
+void BenchmarkStats::PrintCsv(std::ostream &output) const
+{
+    output << "frames,min_ms,avg_ms,p99_ms,max_ms,avg_draw_calls,avg_triangles,input_events,avg_input_latency_ms,max_input_latency_ms" << std::endl;
+
+    size_t count = this->frame_ms.size();
+    if (count == 0)
+    {
+        output << "0,0,0,0,0,0,0,0,0,0" << std::endl;
+        return;
+    }
+
+    std::vector<double> sorted = this->frame_ms;
+    std::sort(sorted.begin(), sorted.end());
+
+    double total_ms = 0.0;
+    double total_draw_calls = 0.0;
+    double total_triangles = 0.0;
+    for (size_t i = 0; i < count; ++i)
+    {
+        total_ms += this->frame_ms[i];
+        total_draw_calls += this->draw_calls[i];
+        total_triangles += this->triangles[i];
+    }
+
+    size_t p99_index = std::min(count - 1, (size_t)(0.99 * count));
+
+    double total_latency_ms = 0.0;
+    double max_latency_ms = 0.0;
+    for (size_t i = 0; i < this->input_latency_ms.size(); ++i)
+    {
+        total_latency_ms += this->input_latency_ms[i];
+        max_latency_ms = std::max(max_latency_ms, this->input_latency_ms[i]);
+    }
+    size_t latency_count = this->input_latency_ms.size();
+
+    output << count << ","
+           << sorted.front() << ","
+           << total_ms / count << ","
+           << sorted[p99_index] << ","
+           << sorted.back() << ","
+           << total_draw_calls / count << ","
+           << total_triangles / count << ","
+           << latency_count << ","
+           << (latency_count > 0 ? total_latency_ms / latency_count : 0.0) << ","
+           << max_latency_ms << std::endl;
+}
+
+// Número de vezes que a carga do benchmark de escalabilidade percorre o mundo.
+#define JOB_BENCHMARK_REPETITIONS 200
+
+// Conta as faces de blocos sólidos vizinhas a ar na fatia x do mundo.
+static size_t Benchmark_CountVisibleFaces(WorldBlockMatrix const &world, size_t x)
+{
+    static const int offsets[6][3] = {
+        { 1, 0, 0 }, { -1, 0, 0 }, { 0, 1, 0 }, { 0, -1, 0 }, { 0, 0, 1 }, { 0, 0, -1 }
+    };
+
+    WorldPoint size = world.Size();
+    size_t faces = 0;
+    for (size_t y = 0; y < size.y; ++y)
+    {
+        for (size_t z = 0; z < size.z; ++z)
+        {
+            if (world[WorldPoint(x, y, z)] == BLOCK_AIR)
+                continue;
+
+            for (int i = 0; i < 6; ++i)
+            {
+                glm::vec3 neighbor(x + offsets[i][0], y + offsets[i][1], z + offsets[i][2]);
+                if (!world.IsPointInWorld(neighbor) || world[neighbor] == BLOCK_AIR)
+                    faces++;
+            }
+        }
+    }
+    return faces;
+}
+
+void RunJobScalingBenchmark(std::ostream &output, size_t max_workers)
+{
+    WorldBlockMatrix world;
+    size_t size_x = world.Size().x;
+    size_t num_slices = JOB_BENCHMARK_REPETITIONS * size_x;
+
+    std::vector<size_t> worker_counts;
+    for (size_t workers = 1; workers < max_workers; workers *= 2)
+        worker_counts.push_back(workers);
+    worker_counts.push_back(max_workers);
+
+    output << "workers,ms,speedup,tasks,steals,idle_ms,faces" << std::endl;
+
+    double baseline_ms = 0.0;
+    for (size_t i = 0; i < worker_counts.size(); ++i)
+    {
+        g_JobSystem.Start(worker_counts[i]);
+
+        std::vector<size_t> faces(num_slices, 0);
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+        g_JobSystem.ParallelFor(0, num_slices, 0, [&world, &faces, size_x](size_t first, size_t last) {
+            for (size_t slice = first; slice < last; ++slice)
+                faces[slice] = Benchmark_CountVisibleFaces(world, slice % size_x);
+        });
+
+        std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+        double ms = elapsed.count();
+        if (i == 0)
+            baseline_ms = ms;
+
+        uint64_t tasks = 0, steals = 0;
+        double idle_ms = 0.0;
+        for (size_t w = 0; w < g_JobSystem.NumWorkers(); ++w)
+        {
+            JobWorkerStats stats = g_JobSystem.WorkerStats(w);
+            tasks += stats.tasks_run;
+            steals += stats.steals;
+            idle_ms += stats.idle_ms;
+        }
+
+        size_t total_faces = 0;
+        for (size_t slice = 0; slice < num_slices; ++slice)
+            total_faces += faces[slice];
+
+        output << worker_counts[i] << ","
+               << ms << ","
+               << baseline_ms / ms << ","
+               << tasks << ","
+               << steals << ","
+               << idle_ms << ","
+               << total_faces / JOB_BENCHMARK_REPETITIONS << std::endl;
+    }
+
+    g_JobSystem.Stop();
+}
+
+void RunTerrainBenchmark(std::ostream &output, size_t size_x, size_t size_y, size_t size_z, uint32_t seed)
+{
+    WorldBlockMatrix world(size_x, size_y, size_z);
+    TerrainGenerator generator(seed);
+
+    WorldPoint chunks = world.SizeInChunks();
+    size_t num_chunks = chunks.x * chunks.y * chunks.z;
+    size_t threads = g_JobSystem.NumWorkers() + 1; // A thread que chama Wait() também executa tarefas
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    generator.Generate(world);
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+
+    double ms = elapsed.count();
+    double chunks_per_second = num_chunks / (ms / 1000.0);
+
+    WorldPoint size = world.Size();
+    output << "size_x,size_y,size_z,threads,simd,chunks,ms,chunks_per_s,chunks_per_s_per_thread" << std::endl;
+    output << size.x << ","
+           << size.y << ","
+           << size.z << ","
+           << threads << ","
+           << (TerrainUsesSimd() ? 1 : 0) << ","
+           << num_chunks << ","
+           << ms << ","
+           << chunks_per_second << ","
+           << chunks_per_second / threads << std::endl;
+}
+
+void RunRegionBenchmark(std::ostream &output, const char *directory, uint32_t seed)
+{
+    WorldBlockMatrix world(REGION_BENCHMARK_SIZE_X, REGION_BENCHMARK_SIZE_Y, REGION_BENCHMARK_SIZE_Z);
+    TerrainGenerator(seed).Generate(world);
+
+    WorldPoint chunks = world.SizeInChunks();
+    size_t num_chunks = chunks.x * chunks.y * chunks.z;
+    size_t num_blocks = num_chunks * CHUNK_SIZE * CHUNK_SIZE * CHUNK_SIZE;
+
+    // Gravação: compactação na thread que salva, e escrita dos arquivos na
+    // thread do RegionStore.
+    double save_ms;
+    size_t regions;
+    {
+        RegionStore store;
+        if (!store.Open(directory, chunks))
+            return;
+
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        for (size_t x = 0; x < chunks.x; ++x)
+            for (size_t y = 0; y < chunks.y; ++y)
+                for (size_t z = 0; z < chunks.z; ++z)
+                    store.Save(x, y, z, world.Chunk(x, y, z));
+        store.Flush();
+        std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+
+        save_ms = elapsed.count();
+        regions = store.RegionsWritten();
+    }
+
+    // Leitura: um RegionStore novo não tem nada na memória, e lê tudo dos
+    // arquivos mapeados.
+    double load_ms;
+    size_t mismatches = 0;
+    {
+        RegionStore store;
+        if (!store.Open(directory, chunks))
+            return;
+
+        WorldChunk chunk;
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        for (size_t x = 0; x < chunks.x; ++x)
+        {
+            for (size_t y = 0; y < chunks.y; ++y)
+            {
+                for (size_t z = 0; z < chunks.z; ++z)
+                {
+                    if (!store.Load(x, y, z, chunk)
+                        || memcmp(&chunk, &world.Chunk(x, y, z), sizeof(WorldChunk)) != 0)
+                        mismatches++;
+                }
+            }
+        }
+        std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+        load_ms = elapsed.count();
+    }
+
+    output << "blocks,chunks,region_writes,save_ms,save_mblocks_per_s,load_ms,load_mblocks_per_s,mismatches" << std::endl;
+    output << num_blocks << ","
+           << num_chunks << ","
+           << regions << ","
+           << save_ms << ","
+           << num_blocks / (save_ms * 1000.0) << ","
+           << load_ms << ","
+           << num_blocks / (load_ms * 1000.0) << ","
+           << mismatches << std::endl;
+}
+
+void RunJournalBenchmark(std::ostream &output, const char *directory, uint32_t seed)
+{
+    WorldPoint size(REGION_SIZE * CHUNK_SIZE, REGION_BENCHMARK_SIZE_Y, REGION_SIZE * CHUNK_SIZE);
+    WorldBlockMatrix world(size.x, size.y, size.z);
+    TerrainGenerator(seed).Generate(world);
+
+    // Sequência de alterações determinística, espalhada pela região.
+    std::vector<JournalEntry> edits(JOURNAL_BENCHMARK_EDITS);
+    uint32_t state = seed;
+    for (size_t i = 0; i < edits.size(); ++i)
+    {
+        state = state * 1664525u + 1013904223u;
+        edits[i].x = (state >> 8) % size.x;
+        state = state * 1664525u + 1013904223u;
+        edits[i].y = (state >> 8) % size.y;
+        state = state * 1664525u + 1013904223u;
+        edits[i].z = (state >> 8) % size.z;
+        edits[i].old_block = world[WorldPoint(edits[i].x, edits[i].y, edits[i].z)];
+        edits[i].new_block = edits[i].old_block == BLOCK_AIR ? BLOCK_STONE : BLOCK_AIR;
+        edits[i].tick = i;
+    }
+
+    // Gravação no diário, que começa vazio.
+    double append_ms;
+    size_t journal_bytes;
+    {
+        EditJournal journal;
+        std::vector<JournalEntry> recovered;
+        if (!journal.Open(directory, recovered))
+            return;
+        journal.BeginCompaction(std::vector<JournalEntry>());
+        journal.EndCompaction();
+
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < edits.size(); ++i)
+        {
+            JournalEntry const &edit = edits[i];
+            journal.Append(WorldPoint(edit.x, edit.y, edit.z), edit.old_block, edit.new_block, edit.tick);
+        }
+        std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+
+        append_ms = elapsed.count();
+        journal_bytes = journal.Bytes();
+    }
+
+    // Recuperação: a abertura lê e regrava todas as entradas.
+    double replay_ms;
+    size_t replayed;
+    {
+        EditJournal journal;
+        std::vector<JournalEntry> recovered;
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        if (!journal.Open(directory, recovered))
+            return;
+        std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+
+        replay_ms = elapsed.count();
+        replayed = recovered.size();
+
+        // O diário do benchmark não deve ser recuperado por um mundo salvo
+        // no mesmo diretório.
+        journal.BeginCompaction(std::vector<JournalEntry>());
+        journal.EndCompaction();
+    }
+
+    // Comparação: cada alteração regrava o arquivo de região inteiro.
+    WorldPoint chunks = world.SizeInChunks();
+    std::vector< std::vector<unsigned char> > encoded(chunks.x * chunks.y * chunks.z);
+    for (size_t x = 0; x < chunks.x; ++x)
+        for (size_t y = 0; y < chunks.y; ++y)
+            for (size_t z = 0; z < chunks.z; ++z)
+                EncodeChunkRle(world.Chunk(x, y, z), encoded[(x * chunks.y + y) * chunks.z + z]);
+
+    std::string region_path = std::string(directory) + "/journal_benchmark.fcgr";
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < JOURNAL_BENCHMARK_REGION_EDITS; ++i)
+    {
+        JournalEntry const &edit = edits[i];
+        WorldPoint position(edit.x, edit.y, edit.z);
+        world[position] = edit.new_block;
+
+        size_t x = position.x / CHUNK_SIZE, y = position.y / CHUNK_SIZE, z = position.z / CHUNK_SIZE;
+        encoded[(x * chunks.y + y) * chunks.z + z].clear();
+        EncodeChunkRle(world.Chunk(x, y, z), encoded[(x * chunks.y + y) * chunks.z + z]);
+        if (!WriteRegionFile(region_path, chunks.y, encoded))
+            return;
+    }
+    std::chrono::duration<double, std::milli> region_elapsed = std::chrono::steady_clock::now() - start;
+    remove(region_path.c_str());
+
+    output << "edits,append_ms,edits_per_s,journal_mb,replay_ms,replayed,region_rewrite_edits_per_s" << std::endl;
+    output << edits.size() << ","
+           << append_ms << ","
+           << edits.size() / (append_ms / 1000.0) << ","
+           << journal_bytes / (1024.0 * 1024.0) << ","
+           << replay_ms << ","
+           << replayed << ","
+           << JOURNAL_BENCHMARK_REGION_EDITS / (region_elapsed.count() / 1000.0) << std::endl;
+}
+
+void RunSnapshotBenchmark(std::ostream &output, uint32_t seed)
+{
+    WorldBlockMatrix world(TERRAIN_BENCHMARK_SIZE_X, TERRAIN_BENCHMARK_SIZE_Y, TERRAIN_BENCHMARK_SIZE_Z);
+    TerrainGenerator(seed).Generate(world);
+
+    WorldPoint size = world.Size();
+    WorldPoint chunks = world.SizeInChunks();
+    size_t num_chunks = chunks.x * chunks.y * chunks.z;
+
+    // Cópia de todos os blocos, como era feita antes dos chunks
+    // compartilhados.
+    std::vector<WorldChunk> deep_copy(num_chunks);
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    {
+        WorldBlockMatrix const &source = world;
+        for (size_t x = 0; x < chunks.x; ++x)
+            for (size_t y = 0; y < chunks.y; ++y)
+                for (size_t z = 0; z < chunks.z; ++z)
+                    deep_copy[(x * chunks.y + y) * chunks.z + z] = source.Chunk(x, y, z);
+    }
+    std::chrono::duration<double, std::milli> deep_copy_elapsed = std::chrono::steady_clock::now() - start;
+
+    start = std::chrono::steady_clock::now();
+    WorldBlockMatrix snapshot = world;
+    std::chrono::duration<double, std::micro> snapshot_elapsed = std::chrono::steady_clock::now() - start;
+
+    // Alterações espalhadas: cada chunk alterado pela primeira vez é copiado.
+    uint32_t state = seed;
+    start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < SNAPSHOT_BENCHMARK_EDITS; ++i)
+    {
+        state = state * 1664525u + 1013904223u;
+        size_t x = (state >> 8) % size.x;
+        state = state * 1664525u + 1013904223u;
+        size_t y = (state >> 8) % size.y;
+        state = state * 1664525u + 1013904223u;
+        size_t z = (state >> 8) % size.z;
+
+        Block &block = world[WorldPoint(x, y, z)];
+        block = block == BLOCK_AIR ? BLOCK_STONE : BLOCK_AIR;
+    }
+    std::chrono::duration<double, std::milli> edit_elapsed = std::chrono::steady_clock::now() - start;
+
+    size_t copied_chunks = 0;
+    for (size_t x = 0; x < chunks.x; ++x)
+        for (size_t y = 0; y < chunks.y; ++y)
+            for (size_t z = 0; z < chunks.z; ++z)
+                if (world.SharedChunk(x, y, z) != snapshot.SharedChunk(x, y, z))
+                    copied_chunks++;
+
+    size_t restored_chunks = 0;
+    start = std::chrono::steady_clock::now();
+    for (size_t x = 0; x < chunks.x; ++x)
+        for (size_t y = 0; y < chunks.y; ++y)
+            for (size_t z = 0; z < chunks.z; ++z)
+                if (world.ShareChunk(snapshot, x, y, z))
+                    restored_chunks++;
+    std::chrono::duration<double, std::micro> restore_elapsed = std::chrono::steady_clock::now() - start;
+
+    size_t mismatches = 0;
+    {
+        WorldBlockMatrix const &restored = world;
+        for (size_t x = 0; x < chunks.x; ++x)
+            for (size_t y = 0; y < chunks.y; ++y)
+                for (size_t z = 0; z < chunks.z; ++z)
+                    if (memcmp(&restored.Chunk(x, y, z), &deep_copy[(x * chunks.y + y) * chunks.z + z], sizeof(WorldChunk)) != 0)
+                        mismatches++;
+    }
+
+    output << "chunks,deep_copy_ms,snapshot_us,edits,edit_ms,copied_chunks,restore_us,restored_chunks,mismatches" << std::endl;
+    output << num_chunks << ","
+           << deep_copy_elapsed.count() << ","
+           << snapshot_elapsed.count() << ","
+           << SNAPSHOT_BENCHMARK_EDITS << ","
+           << edit_elapsed.count() << ","
+           << copied_chunks << ","
+           << restore_elapsed.count() << ","
+           << restored_chunks << ","
+           << mismatches << std::endl;
+}
+
+void RunLightBenchmark(std::ostream &output, uint32_t seed)
+{
+    WorldBlockMatrix world(LIGHT_BENCHMARK_SIZE_X, LIGHT_BENCHMARK_SIZE_Y, LIGHT_BENCHMARK_SIZE_Z);
+    TerrainGenerator(seed).Generate(world);
+    WorldPoint size = world.Size();
+
+    LightEngine light;
+    light.Init(world);
+
+    std::vector<WorldPoint> changed_chunks;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    light.RecomputeAll();
+    std::chrono::duration<double, std::milli> full_elapsed = std::chrono::steady_clock::now() - start;
+    light.TakeChangedChunks(changed_chunks);
+
+    // Alterações: um bloco da superfície quebrado, um bloco colocado acima
+    // da superfície, e um bloco abaixo da superfície trocado por ar ou por
+    // uma lâmpada.
+    uint32_t state = seed;
+    size_t remeshed_chunks = 0;
+    std::chrono::duration<double, std::milli> incremental_elapsed(0.0);
+    for (size_t i = 0; i < LIGHT_BENCHMARK_EDITS; ++i)
+    {
+        state = state * 1664525u + 1013904223u;
+        size_t x = (state >> 8) % size.x;
+        state = state * 1664525u + 1013904223u;
+        size_t z = (state >> 8) % size.z;
+        state = state * 1664525u + 1013904223u;
+
+        int top = world.TopSolidY(x, z);
+        size_t y;
+        Block block;
+        switch (i % 4)
+        {
+        case 0:  y = std::max(top, 0); block = BLOCK_AIR; break;
+        case 1:  y = std::min<size_t>(top + 1, size.y - 1); block = BLOCK_STONE; break;
+        case 2:  y = (state >> 8) % std::max(top, 1); block = BLOCK_AIR; break;
+        default: y = (state >> 8) % std::max(top, 1); block = BLOCK_LAMP; break;
+        }
+
+        world[WorldPoint(x, y, z)] = block;
+
+        start = std::chrono::steady_clock::now();
+        light.BlockChanged(WorldPoint(x, y, z));
+        light.Update();
+        incremental_elapsed += std::chrono::steady_clock::now() - start;
+
+        light.TakeChangedChunks(changed_chunks);
+        remeshed_chunks += changed_chunks.size();
+    }
+
+    // A luz incremental deve ser igual à iluminação completa do mundo final.
+    std::vector<unsigned char> incremental(size.x * size.y * size.z);
+    for (size_t x = 0; x < size.x; ++x)
+        for (size_t y = 0; y < size.y; ++y)
+            for (size_t z = 0; z < size.z; ++z)
+                incremental[(x * size.y + y) * size.z + z] = light.Light(x, y, z);
+
+    light.RecomputeAll();
+    size_t mismatches = 0;
+    for (size_t x = 0; x < size.x; ++x)
+        for (size_t y = 0; y < size.y; ++y)
+            for (size_t z = 0; z < size.z; ++z)
+                if (incremental[(x * size.y + y) * size.z + z] != light.Light(x, y, z))
+                    mismatches++;
+
+    double incremental_us = incremental_elapsed.count() * 1000.0 / LIGHT_BENCHMARK_EDITS;
+
+    output << "cells,full_ms,edits,incremental_us_per_edit,speedup,chunks_remeshed_per_edit,mismatches" << std::endl;
+    output << size.x * size.y * size.z << ","
+           << full_elapsed.count() << ","
+           << LIGHT_BENCHMARK_EDITS << ","
+           << incremental_us << ","
+           << full_elapsed.count() * 1000.0 / incremental_us << ","
+           << (double)remeshed_chunks / LIGHT_BENCHMARK_EDITS << ","
+           << mismatches << std::endl;
+}
+
+void RunLodBenchmark(std::ostream &output, uint32_t seed)
+{
+    WorldBlockMatrix world(2 * LOD_BENCHMARK_VIEW_DISTANCE, LOD_BENCHMARK_SIZE_Y, 2 * LOD_BENCHMARK_VIEW_DISTANCE);
+    TerrainGenerator(seed).Generate(world);
+    WorldPoint size = world.Size();
+    WorldPoint chunks = world.SizeInChunks();
+
+    float camera_x = size.x / 2.0f;
+    float camera_z = size.z / 2.0f;
+    float camera_y = world.TopSolidY(size.x / 2, size.z / 2) + 2.0f;
+
+    output << "mode,chunks,lod0_chunks,lod1_chunks,lod2_chunks,lod3_chunks,triangles,vertex_bytes,mesh_ms" << std::endl;
+
+    std::vector<ChunkVertex> vertices;
+    for (int use_lod = 0; use_lod < 2; ++use_lod)
+    {
+        size_t lod_chunks[CHUNK_LOD_LEVELS] = {};
+        size_t num_chunks = 0;
+        size_t triangles = 0;
+        size_t vertex_bytes = 0;
+        std::chrono::duration<double, std::milli> elapsed(0.0);
+
+        for (size_t x = 0; x < chunks.x; ++x)
+        {
+            for (size_t y = 0; y < chunks.y; ++y)
+            {
+                for (size_t z = 0; z < chunks.z; ++z)
+                {
+                    // Mesmo centro usado por ChunkRenderer::Update().
+                    float dx = (x + 0.5f) * CHUNK_SIZE - 0.5f - camera_x;
+                    float dy = (y + 0.5f) * CHUNK_SIZE - 0.5f - camera_y;
+                    float dz = (z + 0.5f) * CHUNK_SIZE - 0.5f - camera_z;
+                    float distance = sqrtf(dx * dx + dy * dy + dz * dz);
+                    if (distance > LOD_BENCHMARK_VIEW_DISTANCE)
+                        continue;
+
+                    int lod = use_lod ? ChunkLodForDistance(distance) : 0;
+
+                    // A cópia dos blocos também é feita pela thread de
+                    // renderização, fora das trabalhadoras; não é medida.
+                    ChunkSnapshot snapshot(world, NULL, x, y, z);
+                    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+                    if (lod == 0)
+                    {
+                        BuildChunkMesh(snapshot, vertices);
+                    }
+                    else
+                    {
+                        DownsampleChunkSnapshot(snapshot, lod);
+                        BuildChunkLodMesh(snapshot, lod, vertices);
+                    }
+                    elapsed += std::chrono::steady_clock::now() - start;
+
+                    num_chunks++;
+                    lod_chunks[lod]++;
+                    triangles += vertices.size() / 4 * 2;
+                    vertex_bytes += vertices.size() * sizeof(ChunkVertex);
+                }
+            }
+        }
+
+        output << (use_lod ? "lod" : "blocks") << ","
+               << num_chunks << ","
+               << lod_chunks[0] << ","
+               << lod_chunks[1] << ","
+               << lod_chunks[2] << ","
+               << lod_chunks[3] << ","
+               << triangles << ","
+               << vertex_bytes << ","
+               << elapsed.count() << std::endl;
+    }
+}
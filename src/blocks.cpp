@@ -1,8 +1,6 @@
 #include "blocks.hpp"
 #include <math.h>
 
-const WorldPoint WorldBlockMatrix::SIZE = WorldPoint(WORLD_SIZE_X, WORLD_SIZE_Y, WORLD_SIZE_Z);
-
 WorldPoint::WorldPoint(size_t x, size_t y, size_t z): x(x), y(y), z(z)
 {
 }
@@ -17,27 +15,127 @@ glm::vec3 WorldPoint::ToGlm()
     return glm::vec3(this->x, this->y, this->z);
 }
 
-WorldBlockMatrix::WorldBlockMatrix(): blocks { BLOCK_AIR }
+WorldBlockMatrix::WorldBlockMatrix():
+    WorldBlockMatrix(WORLD_DEFAULT_SIZE_X, WORLD_DEFAULT_SIZE_Y, WORLD_DEFAULT_SIZE_Z)
 {
-    for(size_t x = 0;x<WORLD_SIZE_X;x++){
-        for(size_t y = 0;y<WORLD_SIZE_Y/2;y++){
-            for(size_t z = 0;z<WORLD_SIZE_Z;z++){
+    for(size_t x = 0;x<this->size_x;x++){
+        for(size_t y = 0;y<this->size_y/2;y++){
+            for(size_t z = 0;z<this->size_z;z++){
                 (*this)[WorldPoint(x,y,z)] = BLOCK_STONE;
             }
         }
     }
 }
 
+const Block WorldBlockMatrix::air = BLOCK_AIR;
+
+WorldBlockMatrix::WorldBlockMatrix(size_t size_x, size_t size_y, size_t size_z, bool loaded):
+    chunks_x((size_x + CHUNK_SIZE - 1) / CHUNK_SIZE),
+    chunks_y((size_y + CHUNK_SIZE - 1) / CHUNK_SIZE),
+    chunks_z((size_z + CHUNK_SIZE - 1) / CHUNK_SIZE),
+    loaded_chunks(0)
+{
+    this->size_x = this->chunks_x * CHUNK_SIZE;
+    this->size_y = this->chunks_y * CHUNK_SIZE;
+    this->size_z = this->chunks_z * CHUNK_SIZE;
+
+    this->chunks.resize(this->chunks_x * this->chunks_y * this->chunks_z);
+
+    if (loaded)
+    {
+        WorldChunk empty = { { { { BLOCK_AIR } } } };
+        for (size_t i = 0; i < this->chunks.size(); ++i)
+            this->chunks[i] = std::make_shared<WorldChunk>(empty);
+        this->loaded_chunks = this->chunks.size();
+    }
+}
+
+bool WorldBlockMatrix::IsChunkLoaded(size_t chunk_x, size_t chunk_y, size_t chunk_z) const
+{
+    return this->chunks[this->ChunkIndex(chunk_x, chunk_y, chunk_z)] != NULL;
+}
+
+size_t WorldBlockMatrix::LoadedChunks() const
+{
+    return this->loaded_chunks;
+}
+
+void WorldBlockMatrix::LoadChunk(size_t chunk_x, size_t chunk_y, size_t chunk_z, WorldChunk const &data)
+{
+    std::shared_ptr<WorldChunk> &chunk = this->chunks[this->ChunkIndex(chunk_x, chunk_y, chunk_z)];
+    if (chunk && chunk.use_count() == 1)
+    {
+        *chunk = data;
+        return;
+    }
+
+    if (!chunk)
+        this->loaded_chunks++;
+    chunk = std::make_shared<WorldChunk>(data);
+}
+
+void WorldBlockMatrix::UnloadChunk(size_t chunk_x, size_t chunk_y, size_t chunk_z)
+{
+    std::shared_ptr<WorldChunk> &chunk = this->chunks[this->ChunkIndex(chunk_x, chunk_y, chunk_z)];
+    if (!chunk)
+        return;
+
+    chunk.reset();
+    this->loaded_chunks--;
+}
+
+bool WorldBlockMatrix::ShareChunk(WorldBlockMatrix const &other, size_t chunk_x, size_t chunk_y, size_t chunk_z)
+{
+    size_t index = this->ChunkIndex(chunk_x, chunk_y, chunk_z);
+    std::shared_ptr<WorldChunk> &chunk = this->chunks[index];
+    std::shared_ptr<WorldChunk> const &other_chunk = other.chunks[index];
+    if (chunk == other_chunk)
+        return false;
+
+    if (!chunk)
+        this->loaded_chunks++;
+    if (!other_chunk)
+        this->loaded_chunks--;
+    chunk = other_chunk;
+    return true;
+}
+
+std::shared_ptr<const WorldChunk> WorldBlockMatrix::SharedChunk(size_t chunk_x, size_t chunk_y, size_t chunk_z) const
+{
+    return this->chunks[this->ChunkIndex(chunk_x, chunk_y, chunk_z)];
+}
+
+WorldPoint WorldBlockMatrix::Size() const
+{
+    return WorldPoint(this->size_x, this->size_y, this->size_z);
+}
+
+WorldPoint WorldBlockMatrix::SizeInChunks() const
+{
+    return WorldPoint(this->chunks_x, this->chunks_y, this->chunks_z);
+}
+
 bool WorldBlockMatrix::IsPointInWorld(glm::vec3 point)const{
-    return (point.x > -0.5
+    bool inside = (point.x > -0.5
              && point.y > -0.5
              && point.z > -0.5
-             && point.x < WORLD_SIZE_X -0.5
-             && point.y < WORLD_SIZE_Y -0.5
-             && point.z < WORLD_SIZE_Z -0.5
+             && point.x < this->size_x -0.5
+             && point.y < this->size_y -0.5
+             && point.z < this->size_z -0.5
               );
+    if (!inside)
+        return false;
 
+    WorldPoint world_point(point);
+    return this->IsChunkLoaded(world_point.x / CHUNK_SIZE, world_point.y / CHUNK_SIZE, world_point.z / CHUNK_SIZE);
 }
 
-
-
+int WorldBlockMatrix::TopSolidY(size_t x, size_t z) const
+{
+    for (int y = this->size_y - 1; y >= 0; --y)
+    {
+        if ((*this)[WorldPoint(x, y, z)] != BLOCK_AIR)
+            return y;
+    }
+    return -1;
+}
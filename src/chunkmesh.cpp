@@ -0,0 +1,1150 @@
+#include <cmath>
+#include <algorithm>
+#include <utility>
+
+#include "chunkmesh.hpp"
+#include "profiler.hpp"
+
+ChunkSnapshot::ChunkSnapshot(WorldBlockMatrix const &world, LightEngine const *light, int chunk_x, int chunk_y, int chunk_z):
+    chunk_x(chunk_x),
+    chunk_y(chunk_y),
+    chunk_z(chunk_z)
+{
+    WorldPoint size = world.Size();
+    int size_x = size.x, size_y = size.y, size_z = size.z;
+
+    int origin_x = chunk_x * CHUNK_SIZE - 1;
+    int origin_y = chunk_y * CHUNK_SIZE - 1;
+    int origin_z = chunk_z * CHUNK_SIZE - 1;
+
+    // Blocos fora do mundo são ar, para que as faces da borda apareçam.
+    for (int x = 0; x < SIZE; ++x)
+    {
+        for (int y = 0; y < SIZE; ++y)
+        {
+            for (int z = 0; z < SIZE; ++z)
+            {
+                int wx = origin_x + x;
+                int wy = origin_y + y;
+                int wz = origin_z + z;
+
+                bool inside = wx >= 0 && wy >= 0 && wz >= 0
+                    && wx < size_x && wy < size_y && wz < size_z;
+                this->blocks[x][y][z] = inside ? world[WorldPoint(wx, wy, wz)] : BLOCK_AIR;
+                this->light[x][y][z] = light != NULL ? light->Light(wx, wy, wz) : (LIGHT_MAX << 4);
+            }
+        }
+    }
+}
+
+void BuildChunkMesh(ChunkSnapshot const &snapshot, std::vector<ChunkVertex> &vertices, bool skirts)
+{
+    vertices.clear();
+    int origin[3] = { snapshot.chunk_x * CHUNK_SIZE, snapshot.chunk_y * CHUNK_SIZE, snapshot.chunk_z * CHUNK_SIZE };
+
+    for (int x = 0; x < CHUNK_SIZE; ++x)
+    {
+        for (int y = 0; y < CHUNK_SIZE; ++y)
+        {
+            for (int z = 0; z < CHUNK_SIZE; ++z)
+            {
+                if (snapshot.At(x, y, z) == BLOCK_AIR)
+                    continue;
+
+                int block[3] = { x, y, z };
+
+                for (int axis = 0; axis < 3; ++axis)
+                {
+                    for (int sign = -1; sign <= 1; sign += 2)
+                    {
+                        int neighbor[3] = { x, y, z };
+                        neighbor[axis] += sign;
+                        bool outside = neighbor[axis] < 0 || neighbor[axis] >= CHUNK_SIZE;
+                        if (snapshot.At(neighbor[0], neighbor[1], neighbor[2]) != BLOCK_AIR && !(skirts && outside))
+                            continue;
+
+                        unsigned char light = snapshot.LightAt(neighbor[0], neighbor[1], neighbor[2]);
+
+                        // Os eixos u e v formam, com o eixo da normal, uma
+                        // base de mão direita; os cantos (0,0) (1,0) (1,1)
+                        // (0,1) ficam em sentido anti-horário vistos de fora
+                        // pelo lado positivo, e são invertidos no negativo.
+                        int u_axis = (axis + 1) % 3;
+                        int v_axis = (axis + 2) % 3;
+                        static const int quad_u[4] = { 0, 1, 1, 0 };
+                        static const int quad_v[4] = { 0, 0, 1, 1 };
+
+                        ChunkVertex quad[4];
+                        for (int i = 0; i < 4; ++i)
+                        {
+                            int corner_index = sign > 0 ? i : 3 - i;
+                            int offset[3];
+                            offset[axis] = sign > 0 ? 1 : 0;
+                            offset[u_axis] = quad_u[corner_index];
+                            offset[v_axis] = quad_v[corner_index];
+
+                            ChunkVertex &vertex = quad[i];
+                            vertex.position[0] = origin[0] + block[0] + offset[0];
+                            vertex.position[1] = origin[1] + block[1] + offset[1];
+                            vertex.position[2] = origin[2] + block[2] + offset[2];
+                            vertex.padding = 0;
+
+                            // Blocos que tocam o canto na camada de ar em
+                            // frente à face: os dois lados e a diagonal. Com
+                            // os dois lados sólidos o canto fica escondido.
+                            int side_u[3] = { neighbor[0], neighbor[1], neighbor[2] };
+                            int side_v[3] = { neighbor[0], neighbor[1], neighbor[2] };
+                            side_u[u_axis] += offset[u_axis] ? 1 : -1;
+                            side_v[v_axis] += offset[v_axis] ? 1 : -1;
+                            int diagonal[3] = { side_u[0], side_u[1], side_u[2] };
+                            diagonal[v_axis] = side_v[v_axis];
+
+                            int solid_u = snapshot.At(side_u[0], side_u[1], side_u[2]) != BLOCK_AIR;
+                            int solid_v = snapshot.At(side_v[0], side_v[1], side_v[2]) != BLOCK_AIR;
+                            int solid_diagonal = snapshot.At(diagonal[0], diagonal[1], diagonal[2]) != BLOCK_AIR;
+                            vertex.occlusion = (solid_u && solid_v) ? 0 : 3 - (solid_u + solid_v + solid_diagonal);
+
+                            vertex.normal[0] = axis == 0 ? sign : 0;
+                            vertex.normal[1] = axis == 1 ? sign : 0;
+                            vertex.normal[2] = axis == 2 ? sign : 0;
+                            vertex.normal[3] = 0;
+
+                            // Mesmo mapeamento de textura usado para o
+                            // modelo do bloco em "shader_fragment.glsl".
+                            if (axis == 0)
+                            {
+                                vertex.texcoords[0] = offset[2];
+                                vertex.texcoords[1] = offset[1];
+                            }
+                            else if (axis == 1)
+                            {
+                                vertex.texcoords[0] = offset[2];
+                                vertex.texcoords[1] = offset[0];
+                            }
+                            else
+                            {
+                                vertex.texcoords[0] = offset[0];
+                                vertex.texcoords[1] = offset[1];
+                            }
+
+                            vertex.light[0] = LightSky(light);
+                            vertex.light[1] = LightBlock(light);
+                        }
+
+                        // O buffer de índices divide cada face pela diagonal
+                        // entre o primeiro e o terceiro vértice. Começamos
+                        // pelo segundo quando a outra diagonal liga os cantos
+                        // mais claros, para que a oclusão seja interpolada
+                        // igualmente nos dois sentidos.
+                        int first = quad[1].occlusion + quad[3].occlusion > quad[0].occlusion + quad[2].occlusion ? 1 : 0;
+                        for (int i = 0; i < 4; ++i)
+                            vertices.push_back(quad[(first + i) % 4]);
+                    }
+                }
+            }
+        }
+    }
+}
+
+int ChunkLodForDistance(float distance)
+{
+    int lod = 0;
+    float limit = CHUNK_LOD_DISTANCE;
+    while (lod + 1 < CHUNK_LOD_LEVELS && distance >= limit)
+    {
+        lod++;
+        limit *= 2.0f;
+    }
+    return lod;
+}
+
+// Tipo mais comum entre os blocos sólidos contados, ou ar se menos da metade
+// dos blocos é sólida.
+static Block MajorityBlock(unsigned const counts[256], int total)
+{
+    int solid = total - counts[BLOCK_AIR];
+    if (2 * solid < total)
+        return BLOCK_AIR;
+
+    int best = BLOCK_AIR + 1;
+    for (int block = best + 1; block < 256; ++block)
+        if (counts[block] > counts[best])
+            best = block;
+    return (Block)best;
+}
+
+void DownsampleChunkSnapshot(ChunkSnapshot &snapshot, int lod)
+{
+    const int scale = 1 << lod;
+    const int cells = CHUNK_SIZE / scale;
+    unsigned counts[256];
+
+    // Células do chunk. Os blocos são lidos antes de a célula ser escrita, e
+    // as células não se sobrepõem.
+    for (int cell_x = 0; cell_x < cells; ++cell_x)
+    {
+        for (int cell_y = 0; cell_y < cells; ++cell_y)
+        {
+            for (int cell_z = 0; cell_z < cells; ++cell_z)
+            {
+                std::fill(counts, counts + 256, 0u);
+                for (int x = cell_x * scale; x < (cell_x + 1) * scale; ++x)
+                    for (int y = cell_y * scale; y < (cell_y + 1) * scale; ++y)
+                        for (int z = cell_z * scale; z < (cell_z + 1) * scale; ++z)
+                            counts[snapshot.At(x, y, z)]++;
+
+                unsigned char block = MajorityBlock(counts, scale * scale * scale);
+                for (int x = cell_x * scale; x < (cell_x + 1) * scale; ++x)
+                    for (int y = cell_y * scale; y < (cell_y + 1) * scale; ++y)
+                        for (int z = cell_z * scale; z < (cell_z + 1) * scale; ++z)
+                            snapshot.blocks[x + 1][y + 1][z + 1] = block;
+            }
+        }
+    }
+}
+
+// Célula de um snapshot reduzido, dentro do chunk.
+static bool LodCellSolid(ChunkSnapshot const &snapshot, int scale, int const cell[3])
+{
+    return snapshot.At(cell[0] * scale, cell[1] * scale, cell[2] * scale) != BLOCK_AIR;
+}
+
+// Face do lado sign do eixo axis da célula sólida cell.
+static void AddLodFace(ChunkSnapshot const &snapshot, int scale, int const cell[3], int axis, int sign,
+                       std::vector<ChunkVertex> &vertices)
+{
+    int u_axis = (axis + 1) % 3;
+    int v_axis = (axis + 2) % 3;
+    int origin[3] = { cell[0] * scale, cell[1] * scale, cell[2] * scale };
+    int chunk_origin[3] = { snapshot.chunk_x * CHUNK_SIZE, snapshot.chunk_y * CHUNK_SIZE, snapshot.chunk_z * CHUNK_SIZE };
+
+    // A face de uma célula cobre vários blocos de ar; usamos a maior luz da
+    // camada em frente a ela.
+    unsigned char sky = 0, block_light = 0;
+    int front[3];
+    front[axis] = sign > 0 ? origin[axis] + scale : origin[axis] - 1;
+    for (int u = origin[u_axis]; u < origin[u_axis] + scale; ++u)
+    {
+        for (int v = origin[v_axis]; v < origin[v_axis] + scale; ++v)
+        {
+            front[u_axis] = u;
+            front[v_axis] = v;
+            unsigned char light = snapshot.LightAt(front[0], front[1], front[2]);
+            sky = std::max(sky, LightSky(light));
+            block_light = std::max(block_light, LightBlock(light));
+        }
+    }
+
+    // Mesma ordem dos cantos de BuildChunkMesh().
+    static const int quad_u[4] = { 0, 1, 1, 0 };
+    static const int quad_v[4] = { 0, 0, 1, 1 };
+    for (int i = 0; i < 4; ++i)
+    {
+        int corner_index = sign > 0 ? i : 3 - i;
+        int offset[3];
+        offset[axis] = sign > 0 ? scale : 0;
+        offset[u_axis] = quad_u[corner_index] * scale;
+        offset[v_axis] = quad_v[corner_index] * scale;
+
+        ChunkVertex vertex;
+        vertex.position[0] = chunk_origin[0] + origin[0] + offset[0];
+        vertex.position[1] = chunk_origin[1] + origin[1] + offset[1];
+        vertex.position[2] = chunk_origin[2] + origin[2] + offset[2];
+        vertex.occlusion = 3;
+        vertex.padding = 0;
+
+        vertex.normal[0] = axis == 0 ? sign : 0;
+        vertex.normal[1] = axis == 1 ? sign : 0;
+        vertex.normal[2] = axis == 2 ? sign : 0;
+        vertex.normal[3] = 0;
+
+        // A textura se repete a cada bloco.
+        if (axis == 0)
+        {
+            vertex.texcoords[0] = offset[2];
+            vertex.texcoords[1] = offset[1];
+        }
+        else if (axis == 1)
+        {
+            vertex.texcoords[0] = offset[2];
+            vertex.texcoords[1] = offset[0];
+        }
+        else
+        {
+            vertex.texcoords[0] = offset[0];
+            vertex.texcoords[1] = offset[1];
+        }
+
+        vertex.light[0] = sky;
+        vertex.light[1] = block_light;
+        vertices.push_back(vertex);
+    }
+}
+
+void BuildChunkLodMesh(ChunkSnapshot const &snapshot, int lod, std::vector<ChunkVertex> &vertices)
+{
+    vertices.clear();
+
+    const int scale = 1 << lod;
+    const int cells = CHUNK_SIZE / scale;
+    for (int x = 0; x < cells; ++x)
+    {
+        for (int y = 0; y < cells; ++y)
+        {
+            for (int z = 0; z < cells; ++z)
+            {
+                int cell[3] = { x, y, z };
+                if (!LodCellSolid(snapshot, scale, cell))
+                    continue;
+
+                for (int axis = 0; axis < 3; ++axis)
+                {
+                    for (int sign = -1; sign <= 1; sign += 2)
+                    {
+                        // Na borda, a saia não depende do vizinho.
+                        int neighbor[3] = { x, y, z };
+                        neighbor[axis] += sign;
+                        bool outside = neighbor[axis] < 0 || neighbor[axis] >= cells;
+                        if (outside || !LodCellSolid(snapshot, scale, neighbor))
+                            AddLodFace(snapshot, scale, cell, axis, sign, vertices);
+                    }
+                }
+            }
+        }
+    }
+}
+
+unsigned ChunkOccluderFaces(ChunkSnapshot const &snapshot)
+{
+    unsigned faces = 0;
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        int u_axis = (axis + 1) % 3;
+        int v_axis = (axis + 2) % 3;
+        for (int side = 0; side < 2; ++side)
+        {
+            bool solid = true;
+            for (int u = 0; u < CHUNK_SIZE && solid; ++u)
+            {
+                for (int v = 0; v < CHUNK_SIZE && solid; ++v)
+                {
+                    int block[3];
+                    block[axis] = side ? CHUNK_SIZE - 1 : 0;
+                    block[u_axis] = u;
+                    block[v_axis] = v;
+                    solid = snapshot.At(block[0], block[1], block[2]) != BLOCK_AIR;
+                }
+            }
+
+            if (solid)
+                faces |= 1u << (2 * axis + side);
+        }
+    }
+    return faces;
+}
+
+unsigned ChunkFacePairBit(int face_a, int face_b)
+{
+    if (face_a > face_b)
+        std::swap(face_a, face_b);
+
+    // Os pares (0, 1) ... (0, 5) ocupam os bits 0 a 4, (1, 2) ... (1, 5) os
+    // bits 5 a 8, e assim por diante.
+    return 1u << (face_a * 5 - face_a * (face_a - 1) / 2 + face_b - face_a - 1);
+}
+
+unsigned ChunkFaceConnections(ChunkSnapshot const &snapshot)
+{
+    bool visited[CHUNK_SIZE][CHUNK_SIZE][CHUNK_SIZE] = {};
+    std::vector<WorldPoint> stack;
+    unsigned connections = 0;
+
+    for (int x = 0; x < CHUNK_SIZE; ++x)
+    {
+        for (int y = 0; y < CHUNK_SIZE; ++y)
+        {
+            for (int z = 0; z < CHUNK_SIZE; ++z)
+            {
+                if (visited[x][y][z] || snapshot.At(x, y, z) != BLOCK_AIR)
+                    continue;
+
+                // Preenche a região de ar e anota as faces que ela toca.
+                unsigned faces = 0;
+                visited[x][y][z] = true;
+                stack.push_back(WorldPoint(x, y, z));
+                while (!stack.empty())
+                {
+                    WorldPoint cell = stack.back();
+                    stack.pop_back();
+
+                    int position[3] = { (int)cell.x, (int)cell.y, (int)cell.z };
+                    for (int axis = 0; axis < 3; ++axis)
+                    {
+                        for (int side = 0; side < 2; ++side)
+                        {
+                            int neighbor[3] = { position[0], position[1], position[2] };
+                            neighbor[axis] += side ? 1 : -1;
+                            if (neighbor[axis] < 0 || neighbor[axis] >= CHUNK_SIZE)
+                            {
+                                faces |= 1u << (2 * axis + side);
+                                continue;
+                            }
+
+                            bool &neighbor_visited = visited[neighbor[0]][neighbor[1]][neighbor[2]];
+                            if (neighbor_visited || snapshot.At(neighbor[0], neighbor[1], neighbor[2]) != BLOCK_AIR)
+                                continue;
+
+                            neighbor_visited = true;
+                            stack.push_back(WorldPoint(neighbor[0], neighbor[1], neighbor[2]));
+                        }
+                    }
+                }
+
+                for (int face_a = 0; face_a < 6; ++face_a)
+                    for (int face_b = face_a + 1; face_b < 6; ++face_b)
+                        if ((faces & (1u << face_a)) && (faces & (1u << face_b)))
+                            connections |= ChunkFacePairBit(face_a, face_b);
+            }
+        }
+    }
+
+    return connections;
+}
+
+ChunkRenderer::ChunkRenderer():
+    chunks_x(0),
+    chunks_y(0),
+    chunks_z(0),
+    index_buffer_id(0),
+    index_capacity(0),
+    jobs_in_flight(0),
+    discarded_meshes(0),
+    lod_enabled(true)
+{
+    this->culling_stats.meshes = 0;
+    this->culling_stats.outside_frustum = 0;
+    this->culling_stats.occluded = 0;
+    this->culling_stats.occluder_faces = 0;
+    this->culling_stats.cpu_ms = 0.0f;
+}
+
+ChunkRenderer::~ChunkRenderer()
+{
+    // As tarefas em andamento escrevem em this->ready.
+    g_JobSystem.Wait(this->jobs);
+
+    for (size_t i = 0; i < this->chunks.size(); ++i)
+        g_GpuMemory.Free(this->chunks[i].vertices);
+    for (size_t arena = 0; arena < this->arena_draws.size(); ++arena)
+    {
+        glDeleteVertexArrays(1, &this->arena_draws[arena].vertex_array_object_id);
+        glDeleteVertexArrays(1, &this->arena_draws[arena].depth_vertex_array_object_id);
+    }
+    glDeleteBuffers(1, &this->index_buffer_id);
+}
+
+int ChunkRenderer::ChunkIndex(int chunk_x, int chunk_y, int chunk_z) const
+{
+    return (chunk_x * this->chunks_y + chunk_y) * this->chunks_z + chunk_z;
+}
+
+void ChunkRenderer::Init(WorldBlockMatrix const &world)
+{
+    glGenBuffers(1, &this->index_buffer_id);
+
+    WorldPoint size = world.SizeInChunks();
+    this->chunks_x = size.x;
+    this->chunks_y = size.y;
+    this->chunks_z = size.z;
+
+    Chunk empty;
+    empty.version = 0;
+    empty.dirty = false;
+    empty.has_mesh = false;
+    empty.vertices = GPU_INVALID_ALLOCATION;
+    empty.num_indices = 0;
+    empty.occluder_faces = 0;
+    empty.face_connections = CHUNK_ALL_FACES_CONNECTED;
+    empty.visible = true;
+    empty.lod = 0;
+    empty.skirts = false;
+    this->chunks.assign(this->chunks_x * this->chunks_y * this->chunks_z, empty);
+    this->reachable.assign(this->chunks.size(), true);
+
+    for (int x = 0; x < this->chunks_x; ++x)
+        for (int y = 0; y < this->chunks_y; ++y)
+            for (int z = 0; z < this->chunks_z; ++z)
+                if (world.IsChunkLoaded(x, y, z))
+                    this->MarkChunkDirty(x, y, z);
+}
+
+void ChunkRenderer::MarkBlockDirty(WorldPoint point)
+{
+    int chunk_x = point.x / CHUNK_SIZE;
+    int chunk_y = point.y / CHUNK_SIZE;
+    int chunk_z = point.z / CHUNK_SIZE;
+    this->MarkChunkDirty(chunk_x, chunk_y, chunk_z);
+
+    // Um bloco na borda do chunk também muda as faces do chunk vizinho.
+    int local[3] = { (int)(point.x % CHUNK_SIZE), (int)(point.y % CHUNK_SIZE), (int)(point.z % CHUNK_SIZE) };
+    int chunk[3] = { chunk_x, chunk_y, chunk_z };
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        int neighbor[3] = { chunk[0], chunk[1], chunk[2] };
+        if (local[axis] == 0)
+            neighbor[axis]--;
+        else if (local[axis] == CHUNK_SIZE - 1)
+            neighbor[axis]++;
+        else
+            continue;
+
+        this->MarkChunkDirty(neighbor[0], neighbor[1], neighbor[2]);
+    }
+}
+
+void ChunkRenderer::MarkChunkDirty(int chunk_x, int chunk_y, int chunk_z)
+{
+    if (chunk_x < 0 || chunk_y < 0 || chunk_z < 0
+        || chunk_x >= this->chunks_x || chunk_y >= this->chunks_y || chunk_z >= this->chunks_z)
+        return;
+
+    Chunk &chunk = this->chunks[ChunkIndex(chunk_x, chunk_y, chunk_z)];
+    chunk.version++;
+    chunk.dirty = true;
+
+    // Até a nova malha chegar, o chunk não oculta nada: um bloco quebrado
+    // pode ter aberto uma passagem.
+    chunk.occluder_faces = 0;
+    chunk.face_connections = CHUNK_ALL_FACES_CONNECTED;
+}
+
+void ChunkRenderer::OnChunkLoaded(int chunk_x, int chunk_y, int chunk_z)
+{
+    this->MarkChunkDirty(chunk_x, chunk_y, chunk_z);
+    this->MarkChunkDirty(chunk_x - 1, chunk_y, chunk_z);
+    this->MarkChunkDirty(chunk_x + 1, chunk_y, chunk_z);
+    this->MarkChunkDirty(chunk_x, chunk_y - 1, chunk_z);
+    this->MarkChunkDirty(chunk_x, chunk_y + 1, chunk_z);
+    this->MarkChunkDirty(chunk_x, chunk_y, chunk_z - 1);
+    this->MarkChunkDirty(chunk_x, chunk_y, chunk_z + 1);
+}
+
+void ChunkRenderer::OnChunkUnloaded(int chunk_x, int chunk_y, int chunk_z)
+{
+    Chunk &chunk = this->chunks[ChunkIndex(chunk_x, chunk_y, chunk_z)];
+
+    // Malhas em construção para este chunk serão descartadas.
+    chunk.version++;
+    chunk.dirty = false;
+
+    this->FreeMesh(chunk);
+    chunk.has_mesh = false;
+    chunk.occluder_faces = 0;
+    chunk.face_connections = CHUNK_ALL_FACES_CONNECTED;
+}
+
+void ChunkRenderer::SetLodEnabled(bool enabled)
+{
+    this->lod_enabled = enabled;
+}
+
+int ChunkRenderer::SelectLod(int current_lod, float distance) const
+{
+    if (!this->lod_enabled)
+        return 0;
+
+    int lod = ChunkLodForDistance(distance);
+    if (lod > current_lod)
+        lod = std::max(current_lod, ChunkLodForDistance(distance - CHUNK_LOD_HYSTERESIS));
+    else if (lod < current_lod)
+        lod = std::min(current_lod, ChunkLodForDistance(distance + CHUNK_LOD_HYSTERESIS));
+    return lod;
+}
+
+bool ChunkRenderer::NeedsSkirts(int chunk_x, int chunk_y, int chunk_z) const
+{
+    if (this->chunks[ChunkIndex(chunk_x, chunk_y, chunk_z)].lod > 0)
+        return true;
+
+    int chunk[3] = { chunk_x, chunk_y, chunk_z };
+    int limits[3] = { this->chunks_x, this->chunks_y, this->chunks_z };
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        for (int sign = -1; sign <= 1; sign += 2)
+        {
+            int neighbor[3] = { chunk[0], chunk[1], chunk[2] };
+            neighbor[axis] += sign;
+            if (neighbor[axis] < 0 || neighbor[axis] >= limits[axis])
+                continue;
+            if (this->chunks[ChunkIndex(neighbor[0], neighbor[1], neighbor[2])].lod > 0)
+                return true;
+        }
+    }
+    return false;
+}
+
+void ChunkRenderer::Update(WorldBlockMatrix const &world, LightEngine const *light, glm::vec4 camera_position)
+{
+    // Chunks carregados e a distância do centro de cada um à câmera.
+    std::vector<std::pair<float, int> > loaded;
+    for (int x = 0; x < this->chunks_x; ++x)
+    {
+        for (int y = 0; y < this->chunks_y; ++y)
+        {
+            for (int z = 0; z < this->chunks_z; ++z)
+            {
+                int index = ChunkIndex(x, y, z);
+                Chunk &chunk = this->chunks[index];
+
+                // Sem malha e sem pedido de malha, o chunk não está carregado.
+                if (!chunk.dirty && !chunk.has_mesh)
+                    continue;
+
+                glm::vec4 center((x + 0.5f) * CHUNK_SIZE - 0.5f, (y + 0.5f) * CHUNK_SIZE - 0.5f, (z + 0.5f) * CHUNK_SIZE - 0.5f, 1.0f);
+                glm::vec4 d = center - camera_position;
+                float distance_squared = d.x * d.x + d.y * d.y + d.z * d.z;
+
+                // Os blocos não mudaram, mas a malha do novo nível tem outras
+                // faces ocultas e outros caminhos de ar; os da malha atual
+                // valem até a nova chegar.
+                int lod = this->SelectLod(chunk.lod, sqrtf(distance_squared));
+                if (lod != chunk.lod)
+                {
+                    chunk.lod = lod;
+                    chunk.version++;
+                    chunk.dirty = true;
+                }
+
+                loaded.push_back(std::make_pair(distance_squared, index));
+            }
+        }
+    }
+
+    // Chunks marcados, ordenados pela distância do centro à câmera. As saias
+    // dependem dos níveis dos vizinhos, já escolhidos acima.
+    std::vector<std::pair<float, int> > dirty;
+    for (size_t i = 0; i < loaded.size(); ++i)
+    {
+        int index = loaded[i].second;
+        Chunk &chunk = this->chunks[index];
+
+        int x = index / (this->chunks_y * this->chunks_z);
+        int y = (index / this->chunks_z) % this->chunks_y;
+        int z = index % this->chunks_z;
+
+        bool skirts = this->NeedsSkirts(x, y, z);
+        if (skirts != chunk.skirts)
+        {
+            chunk.skirts = skirts;
+            chunk.version++;
+            chunk.dirty = true;
+        }
+
+        if (!chunk.dirty)
+            continue;
+
+        // Vizinhos de chunks carregados podem ainda não estar
+        // carregados; não há o que desenhar.
+        if (!world.IsChunkLoaded(x, y, z))
+        {
+            chunk.dirty = false;
+            continue;
+        }
+
+        dirty.push_back(loaded[i]);
+    }
+
+    std::sort(dirty.begin(), dirty.end());
+
+    for (size_t i = 0; i < dirty.size() && this->jobs_in_flight < CHUNK_MAX_JOBS_IN_FLIGHT; ++i)
+    {
+        int index = dirty[i].second;
+        Chunk &chunk = this->chunks[index];
+
+        int chunk_x = index / (this->chunks_y * this->chunks_z);
+        int chunk_y = (index / this->chunks_z) % this->chunks_y;
+        int chunk_z = index % this->chunks_z;
+
+        // A cópia é feita aqui, na thread dona do mundo; a trabalhadora só a
+        // lê, e edições posteriores geram uma nova versão.
+        std::shared_ptr<const ChunkSnapshot> snapshot = std::make_shared<ChunkSnapshot>(world, light, chunk_x, chunk_y, chunk_z);
+        unsigned version = chunk.version;
+        int lod = chunk.lod;
+        bool skirts = chunk.skirts;
+
+        g_JobSystem.Submit([this, snapshot, index, version, lod, skirts]() {
+            ProfileScope cpu_scope("chunk mesh");
+
+            MeshResult result;
+            result.chunk = index;
+            result.version = version;
+            if (lod == 0)
+            {
+                BuildChunkMesh(*snapshot, result.vertices, skirts);
+                result.occluder_faces = ChunkOccluderFaces(*snapshot);
+                result.face_connections = ChunkFaceConnections(*snapshot);
+            }
+            else
+            {
+                // As faces ocultas e os caminhos de ar devem ser os da malha
+                // desenhada, isto é, os da grade reduzida.
+                ChunkSnapshot reduced(*snapshot);
+                DownsampleChunkSnapshot(reduced, lod);
+                BuildChunkLodMesh(reduced, lod, result.vertices);
+                result.occluder_faces = ChunkOccluderFaces(reduced);
+                result.face_connections = ChunkFaceConnections(reduced);
+            }
+
+            std::lock_guard<std::mutex> lock(this->ready_mutex);
+            this->ready.push_back(std::move(result));
+        }, &this->jobs);
+
+        chunk.dirty = false;
+        this->jobs_in_flight++;
+    }
+}
+
+void ChunkRenderer::Upload(size_t budget_bytes)
+{
+    {
+        std::lock_guard<std::mutex> lock(this->ready_mutex);
+        for (size_t i = 0; i < this->ready.size(); ++i)
+            this->pending_uploads.push_back(std::move(this->ready[i]));
+        this->jobs_in_flight -= this->ready.size();
+        this->ready.clear();
+    }
+
+    size_t uploaded_bytes = 0;
+    size_t next = 0;
+    for (; next < this->pending_uploads.size(); ++next)
+    {
+        MeshResult &result = this->pending_uploads[next];
+        Chunk &chunk = this->chunks[result.chunk];
+
+        // O chunk mudou depois que a cópia foi feita: a malha já está velha.
+        if (result.version != chunk.version)
+        {
+            this->discarded_meshes++;
+            continue;
+        }
+
+        size_t bytes = result.vertices.size() * sizeof(ChunkVertex);
+        if (uploaded_bytes > 0 && uploaded_bytes + bytes > budget_bytes)
+            break;
+
+        this->UploadMesh(chunk, result.vertices);
+        chunk.occluder_faces = result.occluder_faces;
+        chunk.face_connections = result.face_connections;
+        uploaded_bytes += bytes;
+    }
+
+    this->pending_uploads.erase(this->pending_uploads.begin(), this->pending_uploads.begin() + next);
+}
+
+void ChunkRenderer::EnsureIndexCapacity(size_t num_quads)
+{
+    if (num_quads <= this->index_capacity)
+        return;
+
+    // Todas as malhas usam o mesmo buffer de índices: cada face é um
+    // quadrado de 4 vértices consecutivos, desenhado como 2 triângulos.
+    size_t capacity = std::max(num_quads, 2 * this->index_capacity);
+    std::vector<GLuint> indices;
+    indices.reserve(6 * capacity);
+    for (size_t quad = 0; quad < capacity; ++quad)
+    {
+        GLuint first = 4 * quad;
+        indices.push_back(first + 0);
+        indices.push_back(first + 1);
+        indices.push_back(first + 2);
+        indices.push_back(first + 2);
+        indices.push_back(first + 3);
+        indices.push_back(first + 0);
+    }
+
+    // O nome do buffer não muda, então os VAOs que já o referenciam
+    // continuam válidos.
+    glBindVertexArray(0);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, this->index_buffer_id);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(GLuint), indices.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+    this->index_capacity = capacity;
+}
+
+void ChunkRenderer::FreeMesh(Chunk &chunk)
+{
+    g_GpuMemory.Free(chunk.vertices);
+    chunk.vertices = GPU_INVALID_ALLOCATION;
+    chunk.num_indices = 0;
+}
+
+void ChunkRenderer::UploadMesh(Chunk &chunk, std::vector<ChunkVertex> const &vertices)
+{
+    this->EnsureIndexCapacity(vertices.size() / 4);
+    chunk.has_mesh = true;
+
+    // A malha nova vai para um intervalo novo: a antiga pode ainda estar
+    // sendo lida pelos quadros em andamento, e g_GpuMemory só reaproveita o
+    // intervalo dela depois que a GPU terminar. O início é múltiplo do
+    // tamanho do vértice, para servir de vértice base.
+    this->FreeMesh(chunk);
+    if (vertices.empty())
+        return;
+
+    size_t bytes = vertices.size() * sizeof(ChunkVertex);
+    chunk.vertices = g_GpuMemory.Allocate(bytes, sizeof(ChunkVertex), true);
+    g_GpuMemory.Upload(chunk.vertices, 0, bytes, vertices.data());
+    chunk.num_indices = vertices.size() / 4 * 6;
+}
+
+void ChunkRenderer::Cull(glm::mat4 const &view_projection, glm::vec4 camera_position)
+{
+    double start_us = g_Profiler.NowMicroseconds();
+
+    this->culler.Begin(view_projection);
+
+    // Oclusores: as faces sólidas dos chunks mais próximos da câmera que
+    // estão dentro do frustum. Chunks inteiramente sólidos não têm malha,
+    // mas são os melhores oclusores.
+    this->occluder_chunks.clear();
+    for (int x = 0; x < this->chunks_x; ++x)
+    {
+        for (int y = 0; y < this->chunks_y; ++y)
+        {
+            for (int z = 0; z < this->chunks_z; ++z)
+            {
+                int index = ChunkIndex(x, y, z);
+                if (this->chunks[index].occluder_faces == 0)
+                    continue;
+
+                glm::vec3 box_min(x * CHUNK_SIZE - 0.5f, y * CHUNK_SIZE - 0.5f, z * CHUNK_SIZE - 0.5f);
+                glm::vec3 box_max = box_min + glm::vec3(CHUNK_SIZE);
+                if (!this->culler.IsInFrustum(box_min, box_max))
+                    continue;
+
+                glm::vec3 center = box_min + glm::vec3(CHUNK_SIZE / 2.0f);
+                glm::vec3 d = center - glm::vec3(camera_position);
+                this->occluder_chunks.push_back(std::make_pair(d.x * d.x + d.y * d.y + d.z * d.z, index));
+            }
+        }
+    }
+
+    if (this->occluder_chunks.size() > CHUNK_MAX_OCCLUDER_CHUNKS)
+    {
+        std::nth_element(this->occluder_chunks.begin(), this->occluder_chunks.begin() + CHUNK_MAX_OCCLUDER_CHUNKS, this->occluder_chunks.end());
+        this->occluder_chunks.resize(CHUNK_MAX_OCCLUDER_CHUNKS);
+    }
+
+    size_t occluder_faces = 0;
+    for (size_t i = 0; i < this->occluder_chunks.size(); ++i)
+    {
+        int index = this->occluder_chunks[i].second;
+        int chunk[3] = { index / (this->chunks_y * this->chunks_z), (index / this->chunks_z) % this->chunks_y, index % this->chunks_z };
+        unsigned faces = this->chunks[index].occluder_faces;
+
+        for (int axis = 0; axis < 3; ++axis)
+        {
+            int u_axis = (axis + 1) % 3;
+            int v_axis = (axis + 2) % 3;
+            for (int side = 0; side < 2; ++side)
+            {
+                if (!(faces & (1u << (2 * axis + side))))
+                    continue;
+
+                static const int quad_u[4] = { 0, 1, 1, 0 };
+                static const int quad_v[4] = { 0, 0, 1, 1 };
+                glm::vec3 corners[4];
+                for (int corner = 0; corner < 4; ++corner)
+                {
+                    corners[corner][axis] = (chunk[axis] + side) * CHUNK_SIZE - 0.5f;
+                    corners[corner][u_axis] = (chunk[u_axis] + quad_u[corner]) * CHUNK_SIZE - 0.5f;
+                    corners[corner][v_axis] = (chunk[v_axis] + quad_v[corner]) * CHUNK_SIZE - 0.5f;
+                }
+                this->culler.AddOccluderQuad(corners);
+                occluder_faces++;
+            }
+        }
+    }
+
+    this->culler.BuildPyramid();
+    this->FindReachableChunks(camera_position);
+
+    ChunkCullingStats stats;
+    stats.meshes = 0;
+    stats.outside_frustum = 0;
+    stats.unreachable = 0;
+    stats.occluded = 0;
+    stats.occluder_faces = occluder_faces;
+
+    for (int x = 0; x < this->chunks_x; ++x)
+    {
+        for (int y = 0; y < this->chunks_y; ++y)
+        {
+            for (int z = 0; z < this->chunks_z; ++z)
+            {
+                Chunk &chunk = this->chunks[ChunkIndex(x, y, z)];
+                if (chunk.num_indices == 0)
+                    continue;
+
+                glm::vec3 box_min(x * CHUNK_SIZE - 0.5f, y * CHUNK_SIZE - 0.5f, z * CHUNK_SIZE - 0.5f);
+                glm::vec3 box_max = box_min + glm::vec3(CHUNK_SIZE);
+
+                stats.meshes++;
+                chunk.visible = false;
+                if (!this->culler.IsInFrustum(box_min, box_max))
+                    stats.outside_frustum++;
+                else if (!this->reachable[ChunkIndex(x, y, z)])
+                    stats.unreachable++;
+                else if (this->culler.IsOccluded(box_min, box_max))
+                    stats.occluded++;
+                else
+                    chunk.visible = true;
+            }
+        }
+    }
+
+    stats.cpu_ms = (g_Profiler.NowMicroseconds() - start_us) / 1000.0;
+    this->culling_stats = stats;
+}
+
+void ChunkRenderer::FindReachableChunks(glm::vec4 camera_position)
+{
+    int start[3];
+    for (int axis = 0; axis < 3; ++axis)
+        start[axis] = (int)floorf((camera_position[axis] + 0.5f) / CHUNK_SIZE);
+
+    // Fora do mundo não há por onde começar; nenhum chunk é descartado.
+    if (start[0] < 0 || start[1] < 0 || start[2] < 0
+        || start[0] >= this->chunks_x || start[1] >= this->chunks_y || start[2] >= this->chunks_z)
+    {
+        std::fill(this->reachable.begin(), this->reachable.end(), true);
+        return;
+    }
+
+    std::fill(this->reachable.begin(), this->reachable.end(), false);
+
+    // Busca em largura a partir do chunk da câmera. Um chunk só é
+    // atravessado entre duas faces ligadas por ar, a busca nunca volta no
+    // sentido oposto a um sentido em que já andou (assim ela só se afasta da
+    // câmera), e chunks fora do frustum não são visitados.
+    int start_index = ChunkIndex(start[0], start[1], start[2]);
+    CaveStep first = { start_index, -1, 0 };
+    this->cave_steps.clear();
+    this->cave_steps.push_back(first);
+    this->reachable[start_index] = true;
+
+    for (size_t next = 0; next < this->cave_steps.size(); ++next)
+    {
+        CaveStep step = this->cave_steps[next];
+        int chunk[3] = { step.chunk / (this->chunks_y * this->chunks_z), (step.chunk / this->chunks_z) % this->chunks_y, step.chunk % this->chunks_z };
+        unsigned connections = this->chunks[step.chunk].face_connections;
+
+        for (int face = 0; face < 6; ++face)
+        {
+            int axis = face / 2;
+            int opposite = face ^ 1;
+            if (step.directions & (1u << opposite))
+                continue;
+            if (step.entry_face >= 0 && (step.entry_face == face || !(connections & ChunkFacePairBit(step.entry_face, face))))
+                continue;
+
+            int neighbor[3] = { chunk[0], chunk[1], chunk[2] };
+            neighbor[axis] += (face & 1) ? 1 : -1;
+            if (neighbor[0] < 0 || neighbor[1] < 0 || neighbor[2] < 0
+                || neighbor[0] >= this->chunks_x || neighbor[1] >= this->chunks_y || neighbor[2] >= this->chunks_z)
+                continue;
+
+            int index = ChunkIndex(neighbor[0], neighbor[1], neighbor[2]);
+            if (this->reachable[index])
+                continue;
+
+            glm::vec3 box_min(neighbor[0] * CHUNK_SIZE - 0.5f, neighbor[1] * CHUNK_SIZE - 0.5f, neighbor[2] * CHUNK_SIZE - 0.5f);
+            if (!this->culler.IsInFrustum(box_min, box_min + glm::vec3(CHUNK_SIZE)))
+                continue;
+
+            this->reachable[index] = true;
+            CaveStep neighbor_step = { index, opposite, step.directions | (1u << face) };
+            this->cave_steps.push_back(neighbor_step);
+        }
+    }
+}
+
+void ChunkRenderer::AddDraw(Chunk const &chunk)
+{
+    size_t arena = g_GpuMemory.Arena(chunk.vertices);
+    while (this->arena_draws.size() <= arena)
+    {
+        ArenaDraws draws;
+        GLuint buffer_id = g_GpuMemory.ArenaBuffer(this->arena_draws.size());
+        glGenVertexArrays(1, &draws.vertex_array_object_id);
+        glGenVertexArrays(1, &draws.depth_vertex_array_object_id);
+
+        glBindBuffer(GL_ARRAY_BUFFER, buffer_id);
+        glBindVertexArray(draws.vertex_array_object_id);
+
+        // Mesmas localizações usadas por "shader_vertex.glsl". Os inteiros
+        // são convertidos para float sem normalização.
+        glVertexAttribPointer(0, 3, GL_UNSIGNED_SHORT, GL_FALSE, sizeof(ChunkVertex), (void *)offsetof(ChunkVertex, position));
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(1, 4, GL_BYTE, GL_FALSE, sizeof(ChunkVertex), (void *)offsetof(ChunkVertex, normal));
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(2, 2, GL_UNSIGNED_BYTE, GL_FALSE, sizeof(ChunkVertex), (void *)offsetof(ChunkVertex, texcoords));
+        glEnableVertexAttribArray(2);
+        glVertexAttribPointer(3, 2, GL_UNSIGNED_BYTE, GL_FALSE, sizeof(ChunkVertex), (void *)offsetof(ChunkVertex, light));
+        glEnableVertexAttribArray(3);
+        glVertexAttribPointer(4, 1, GL_UNSIGNED_BYTE, GL_FALSE, sizeof(ChunkVertex), (void *)offsetof(ChunkVertex, occlusion));
+        glEnableVertexAttribArray(4);
+
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, this->index_buffer_id);
+
+        // O passe de profundidade lê somente a posição.
+        glBindVertexArray(draws.depth_vertex_array_object_id);
+        glVertexAttribPointer(0, 3, GL_UNSIGNED_SHORT, GL_FALSE, sizeof(ChunkVertex), (void *)offsetof(ChunkVertex, position));
+        glEnableVertexAttribArray(0);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, this->index_buffer_id);
+        glBindVertexArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+        this->arena_draws.push_back(draws);
+    }
+
+    // O intervalo da malha é lido a cada quadro: a compactação de
+    // g_GpuMemory pode tê-lo movido.
+    ArenaDraws &draws = this->arena_draws[arena];
+    draws.draw_counts.push_back(chunk.num_indices);
+    draws.draw_base_vertices.push_back(g_GpuMemory.Offset(chunk.vertices) / sizeof(ChunkVertex));
+}
+
+void ChunkRenderer::SubmitDraws(bool depth_only)
+{
+    for (size_t i = 0; i < this->arena_draws.size(); ++i)
+    {
+        ArenaDraws &draws = this->arena_draws[i];
+        if (draws.draw_counts.empty())
+            continue;
+
+        if (this->draw_offsets.size() < draws.draw_counts.size())
+            this->draw_offsets.resize(draws.draw_counts.size(), NULL);
+
+        size_t num_indices = 0;
+        for (size_t draw = 0; draw < draws.draw_counts.size(); ++draw)
+            num_indices += draws.draw_counts[draw];
+
+        glBindVertexArray(depth_only ? draws.depth_vertex_array_object_id : draws.vertex_array_object_id);
+        glMultiDrawElementsBaseVertex(GL_TRIANGLES, draws.draw_counts.data(), GL_UNSIGNED_INT, this->draw_offsets.data(),
+                                      draws.draw_counts.size(), draws.draw_base_vertices.data());
+        g_Profiler.CountDrawCall(num_indices / 3);
+
+        draws.draw_counts.clear();
+        draws.draw_base_vertices.clear();
+    }
+
+    glBindVertexArray(0);
+}
+
+void ChunkRenderer::Draw(GLint model_uniform)
+{
+    // Os vértices estão nos cantos dos blocos, e os blocos são centrados nas
+    // coordenadas inteiras do mundo.
+    GLfloat model[16] = {
+        1.0f, 0.0f, 0.0f, 0.0f,
+        0.0f, 1.0f, 0.0f, 0.0f,
+        0.0f, 0.0f, 1.0f, 0.0f,
+        -0.5f, -0.5f, -0.5f, 1.0f
+    };
+    glUniformMatrix4fv(model_uniform, 1, GL_FALSE, model);
+
+    // As listas de desenho são refeitas a partir do resultado do último
+    // Cull().
+    for (size_t i = 0; i < this->chunks.size(); ++i)
+    {
+        Chunk const &chunk = this->chunks[i];
+        if (chunk.num_indices == 0 || !chunk.visible)
+            continue;
+
+        this->AddDraw(chunk);
+    }
+
+    this->SubmitDraws(false);
+}
+
+void ChunkRenderer::DrawDepth(GLint model_uniform, glm::mat4 const &light_matrix)
+{
+    GLfloat model[16] = {
+        1.0f, 0.0f, 0.0f, 0.0f,
+        0.0f, 1.0f, 0.0f, 0.0f,
+        0.0f, 0.0f, 1.0f, 0.0f,
+        -0.5f, -0.5f, -0.5f, 1.0f
+    };
+    glUniformMatrix4fv(model_uniform, 1, GL_FALSE, model);
+
+    for (int x = 0; x < this->chunks_x; ++x)
+    {
+        for (int y = 0; y < this->chunks_y; ++y)
+        {
+            for (int z = 0; z < this->chunks_z; ++z)
+            {
+                Chunk const &chunk = this->chunks[ChunkIndex(x, y, z)];
+                if (chunk.num_indices == 0)
+                    continue;
+
+                float origin[3] = { x * CHUNK_SIZE - 0.5f, y * CHUNK_SIZE - 0.5f, z * CHUNK_SIZE - 0.5f };
+
+                // Caixa do chunk no espaço de recorte da luz (ortográfica,
+                // então w = 1). Os chunks mais próximos da luz que o plano
+                // próximo continuam projetando sombra.
+                float clip_min[3] = { 1e30f, 1e30f, 1e30f };
+                float clip_max[3] = { -1e30f, -1e30f, -1e30f };
+                for (int corner = 0; corner < 8; ++corner)
+                {
+                    glm::vec4 point(origin[0] + ((corner & 1) ? CHUNK_SIZE : 0),
+                                    origin[1] + ((corner & 2) ? CHUNK_SIZE : 0),
+                                    origin[2] + ((corner & 4) ? CHUNK_SIZE : 0), 1.0f);
+                    glm::vec4 clip = light_matrix * point;
+                    for (int axis = 0; axis < 3; ++axis)
+                    {
+                        clip_min[axis] = std::min(clip_min[axis], clip[axis]);
+                        clip_max[axis] = std::max(clip_max[axis], clip[axis]);
+                    }
+                }
+                if (clip_min[0] > 1.0f || clip_max[0] < -1.0f
+                    || clip_min[1] > 1.0f || clip_max[1] < -1.0f
+                    || clip_min[2] > 1.0f)
+                    continue;
+
+                this->AddDraw(chunk);
+            }
+        }
+    }
+
+    this->SubmitDraws(true);
+}
+
+size_t ChunkRenderer::DirtyChunks() const
+{
+    size_t count = 0;
+    for (size_t i = 0; i < this->chunks.size(); ++i)
+        if (this->chunks[i].dirty)
+            count++;
+    return count;
+}
+
+size_t ChunkRenderer::JobsInFlight() const
+{
+    return this->jobs_in_flight;
+}
+
+size_t ChunkRenderer::ReadyMeshes() const
+{
+    return this->pending_uploads.size();
+}
+
+size_t ChunkRenderer::DiscardedMeshes() const
+{
+    return this->discarded_meshes;
+}
+
+ChunkCullingStats const &ChunkRenderer::CullingStats() const
+{
+    return this->culling_stats;
+}
@@ -60,17 +60,6 @@ bool FacingNonAirBlock(CollisionFace &output, Camera const &camera, WorldBlockMa
     return block_selected;
 }
 
-bool IsPointInWorld(glm::vec3 point){
-    return (point.x > -0.5
-             && point.y > -0.5
-             && point.z > -0.5
-             && point.x < WORLD_SIZE_X -0.5
-             && point.y < WORLD_SIZE_Y -0.5
-             && point.z < WORLD_SIZE_Z -0.5
-              );
-
-}
-
 bool coordenadaCruza(glm::vec3 a,float tA, glm::vec3 b, float tB, int axis){
     if((a[axis] > b[axis])&&(a[axis] - tA < b[axis] + tB)){
         return true;
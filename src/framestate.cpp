@@ -0,0 +1,111 @@
+#include <chrono>
+#include <utility>
+
+#include "framestate.hpp"
+
+BlockEdit::BlockEdit(WorldPoint position, Block block):
+    position(position),
+    block(block)
+{
+}
+
+FrameSnapshot::FrameSnapshot():
+    frame_number(0),
+    cow_position(0.0f, 0.0f, 0.0f, 1.0f),
+    stones_in_inventory(0),
+    show_info_text(true),
+    framebuffer_width(0),
+    framebuffer_height(0),
+    window_width(0),
+    window_height(0),
+    input_us(-1.0)
+{
+}
+
+static double FrameExchange_ElapsedMs(std::chrono::steady_clock::time_point start)
+{
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count();
+}
+
+FrameExchange::FrameExchange():
+    write_index(0),
+    ready_index(1),
+    read_index(2),
+    ready_pending(false),
+    closed(false),
+    producer_wait_ms(0.0),
+    consumer_wait_ms(0.0)
+{
+}
+
+FrameSnapshot &FrameExchange::WriteSlot()
+{
+    // Somente a thread de simulação usa write_index fora de Publish().
+    return this->slots[this->write_index];
+}
+
+void FrameExchange::Publish()
+{
+    std::unique_lock<std::mutex> lock(this->mutex);
+
+    std::chrono::steady_clock::time_point wait_start = std::chrono::steady_clock::now();
+    while (this->ready_pending)
+        this->ready_changed.wait(lock);
+    this->producer_wait_ms += FrameExchange_ElapsedMs(wait_start);
+
+    std::swap(this->write_index, this->ready_index);
+    this->ready_pending = true;
+
+    // A cópia devolvida para escrita já foi desenhada; suas edições não
+    // valem para o próximo quadro.
+    this->slots[this->write_index].block_edits.clear();
+    this->slots[this->write_index].chunk_loads.clear();
+    this->slots[this->write_index].chunk_unloads.clear();
+    this->slots[this->write_index].input_us = -1.0;
+
+    lock.unlock();
+    this->ready_changed.notify_all();
+}
+
+bool FrameExchange::Acquire(FrameSnapshot const *&snapshot)
+{
+    std::unique_lock<std::mutex> lock(this->mutex);
+
+    std::chrono::steady_clock::time_point wait_start = std::chrono::steady_clock::now();
+    while (!this->ready_pending && !this->closed)
+        this->ready_changed.wait(lock);
+    this->consumer_wait_ms += FrameExchange_ElapsedMs(wait_start);
+
+    if (!this->ready_pending)
+        return false;
+
+    std::swap(this->read_index, this->ready_index);
+    this->ready_pending = false;
+    snapshot = &this->slots[this->read_index];
+
+    lock.unlock();
+    this->ready_changed.notify_all();
+    return true;
+}
+
+void FrameExchange::Close()
+{
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        this->closed = true;
+    }
+    this->ready_changed.notify_all();
+}
+
+double FrameExchange::ProducerWaitMs() const
+{
+    std::lock_guard<std::mutex> lock(this->mutex);
+    return this->producer_wait_ms;
+}
+
+double FrameExchange::ConsumerWaitMs() const
+{
+    std::lock_guard<std::mutex> lock(this->mutex);
+    return this->consumer_wait_ms;
+}
@@ -1,5 +1,6 @@
 #include <glad/glad.h>
 #include <string>
+#include <cstdio>
 #include "gpu.hpp"
 
 // Esta função cria um programa de GPU, o qual contém obrigatoriamente um
@@ -52,3 +53,37 @@ GLuint CreateGpuProgram(GLuint vertex_shader_id, GLuint fragment_shader_id)
     // Retornamos o ID gerado acima
     return program_id;
 }
+
+GLuint CreateGpuShaderFromSource(GLenum shader_type, const GLchar *source)
+{
+    GLuint shader_id = glCreateShader(shader_type);
+
+    glShaderSource(shader_id, 1, &source, NULL);
+    glCompileShader(shader_id);
+
+    GLint compiled_ok = GL_FALSE;
+    glGetShaderiv(shader_id, GL_COMPILE_STATUS, &compiled_ok);
+
+    if ( compiled_ok == GL_FALSE )
+    {
+        GLint log_length = 0;
+        glGetShaderiv(shader_id, GL_INFO_LOG_LENGTH, &log_length);
+
+        GLchar* log = new GLchar[log_length + 1];
+        log[0] = '\0';
+        glGetShaderInfoLog(shader_id, log_length, &log_length, log);
+
+        std::string output;
+
+        output += "ERROR: OpenGL compilation of embedded shader failed.\n";
+        output += "== Start of compilation log\n";
+        output += log;
+        output += "== End of compilation log\n";
+
+        delete [] log;
+
+        fprintf(stderr, "%s", output.c_str());
+    }
+
+    return shader_id;
+}
@@ -0,0 +1,248 @@
+#include <cassert>
+#include <algorithm>
+#include <utility>
+
+#include "gpumemory.hpp"
+#include "streambuffer.hpp"
+
+GpuMemory g_GpuMemory;
+
+GpuMemory::GpuMemory():
+    pending_free_bytes(0),
+    moved_bytes(0),
+    frame_number(0)
+{
+}
+
+size_t GpuMemory::AddArena(size_t bytes)
+{
+    MemoryArena arena;
+    arena.allocator = RangeAllocator(bytes);
+    glGenBuffers(1, &arena.buffer_id);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, arena.buffer_id);
+    glBufferData(GL_COPY_WRITE_BUFFER, bytes, NULL, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+    this->arenas.push_back(arena);
+    return this->arenas.size() - 1;
+}
+
+GpuAllocation GpuMemory::Allocate(size_t bytes, size_t alignment, bool movable)
+{
+    if (bytes == 0)
+        return GPU_INVALID_ALLOCATION;
+
+    Allocation allocation;
+    allocation.arena = this->arenas.size();
+    allocation.offset = RangeAllocator::INVALID;
+    allocation.bytes = bytes;
+    allocation.alignment = alignment;
+    allocation.movable = movable;
+    allocation.live = true;
+
+    for (size_t arena = 0; arena < this->arenas.size() && allocation.offset == RangeAllocator::INVALID; ++arena)
+    {
+        allocation.offset = this->arenas[arena].allocator.Allocate(bytes, alignment);
+        allocation.arena = arena;
+    }
+
+    if (allocation.offset == RangeAllocator::INVALID)
+    {
+        allocation.arena = this->AddArena(std::max((size_t)GPU_ARENA_BYTES, bytes));
+        allocation.offset = this->arenas[allocation.arena].allocator.Allocate(bytes, alignment);
+    }
+
+    if (!this->unused_handles.empty())
+    {
+        GpuAllocation handle = this->unused_handles.back();
+        this->unused_handles.pop_back();
+        this->allocations[handle] = allocation;
+        return handle;
+    }
+
+    this->allocations.push_back(allocation);
+    return this->allocations.size() - 1;
+}
+
+void GpuMemory::Free(GpuAllocation handle)
+{
+    if (handle == GPU_INVALID_ALLOCATION)
+        return;
+
+    Allocation &allocation = this->allocations[handle];
+    assert(allocation.live);
+    allocation.live = false;
+
+    // O intervalo volta à arena em EndFrame(), depois da cerca deste quadro.
+    Range range = { allocation.arena, allocation.offset, allocation.bytes };
+    this->frame_frees.push_back(range);
+    this->pending_free_bytes += allocation.bytes;
+    this->unused_handles.push_back(handle);
+}
+
+void GpuMemory::Upload(GpuAllocation handle, size_t offset, size_t bytes, void const *data)
+{
+    Allocation const &allocation = this->allocations[handle];
+    assert(offset + bytes <= allocation.bytes);
+
+    // Os dados passam pelo anel de g_StreamBuffer e são copiados pela GPU.
+    // Se não couberem nele, glBufferSubData.
+    if (g_StreamBuffer.CopyToBuffer(this->arenas[allocation.arena].buffer_id, allocation.offset + offset, data, bytes))
+        return;
+
+    glBindBuffer(GL_COPY_WRITE_BUFFER, this->arenas[allocation.arena].buffer_id);
+    glBufferSubData(GL_COPY_WRITE_BUFFER, allocation.offset + offset, bytes, data);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+size_t GpuMemory::Arena(GpuAllocation handle) const
+{
+    return this->allocations[handle].arena;
+}
+
+size_t GpuMemory::Offset(GpuAllocation handle) const
+{
+    return this->allocations[handle].offset;
+}
+
+size_t GpuMemory::NumArenas() const
+{
+    return this->arenas.size();
+}
+
+GLuint GpuMemory::ArenaBuffer(size_t arena) const
+{
+    return this->arenas[arena].buffer_id;
+}
+
+void GpuMemory::EndFrame()
+{
+    this->frame_number++;
+
+    if (this->frame_number % GPU_COMPACTION_INTERVAL_FRAMES == 0)
+    {
+        size_t most_fragmented = this->arenas.size();
+        float worst = GPU_COMPACTION_MIN_FRAGMENTATION;
+        for (size_t arena = 0; arena < this->arenas.size(); ++arena)
+        {
+            float fragmentation = this->Fragmentation(arena);
+            if (fragmentation >= worst)
+            {
+                worst = fragmentation;
+                most_fragmented = arena;
+            }
+        }
+
+        if (most_fragmented < this->arenas.size())
+            this->Compact(most_fragmented, GPU_COMPACTION_BUDGET_BYTES);
+    }
+
+    // A cerca vem depois de todos os comandos do quadro, inclusive das
+    // cópias da compactação, que leem os intervalos antigos.
+    if (!this->frame_frees.empty())
+    {
+        this->fenced_frees.push_back(FencedFrees());
+        this->fenced_frees.back().fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        this->fenced_frees.back().ranges.swap(this->frame_frees);
+    }
+
+    // As cercas são sinalizadas em ordem. Com tempo de espera zero, a CPU
+    // somente consulta o estado de cada uma.
+    while (!this->fenced_frees.empty())
+    {
+        FencedFrees &frees = this->fenced_frees.front();
+        GLenum status = glClientWaitSync(frees.fence, 0, 0);
+        if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+            break;
+
+        for (size_t i = 0; i < frees.ranges.size(); ++i)
+        {
+            Range const &range = frees.ranges[i];
+            this->arenas[range.arena].allocator.Free(range.offset, range.bytes);
+            this->pending_free_bytes -= range.bytes;
+        }
+        glDeleteSync(frees.fence);
+        this->fenced_frees.pop_front();
+    }
+}
+
+void GpuMemory::Compact(size_t arena, size_t budget_bytes)
+{
+    // Alocações móveis da arena, da mais distante do início para a mais
+    // próxima. Cada uma vai para o primeiro intervalo livre que couber, se
+    // ele estiver antes dela.
+    std::vector<std::pair<size_t, GpuAllocation> > candidates;
+    for (size_t handle = 0; handle < this->allocations.size(); ++handle)
+    {
+        Allocation const &allocation = this->allocations[handle];
+        if (allocation.live && allocation.movable && allocation.arena == arena)
+            candidates.push_back(std::make_pair(allocation.offset, handle));
+    }
+    std::sort(candidates.rbegin(), candidates.rend());
+
+    MemoryArena &memory = this->arenas[arena];
+    glBindBuffer(GL_COPY_READ_BUFFER, memory.buffer_id);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, memory.buffer_id);
+
+    size_t moved = 0;
+    for (size_t i = 0; i < candidates.size(); ++i)
+    {
+        Allocation &allocation = this->allocations[candidates[i].second];
+        if (moved > 0 && moved + allocation.bytes > budget_bytes)
+            break;
+
+        size_t offset = memory.allocator.Allocate(allocation.bytes, allocation.alignment);
+        if (offset == RangeAllocator::INVALID)
+            continue;
+        if (offset > allocation.offset)
+        {
+            // O intervalo nunca foi usado: pode voltar à arena na hora.
+            memory.allocator.Free(offset, allocation.bytes);
+            continue;
+        }
+
+        // Os dois intervalos estão no mesmo buffer, mas não se sobrepõem.
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, allocation.offset, offset, allocation.bytes);
+
+        Range old_range = { arena, allocation.offset, allocation.bytes };
+        this->frame_frees.push_back(old_range);
+        this->pending_free_bytes += allocation.bytes;
+        allocation.offset = offset;
+        moved += allocation.bytes;
+    }
+
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    this->moved_bytes += moved;
+}
+
+float GpuMemory::Fragmentation(size_t arena) const
+{
+    RangeAllocator const &allocator = this->arenas[arena].allocator;
+    size_t free_bytes = allocator.Capacity() - allocator.UsedSize();
+    if (free_bytes == 0)
+        return 0.0f;
+    return 1.0f - (float)allocator.LargestFreeRange() / free_bytes;
+}
+
+GpuMemoryStats GpuMemory::Stats() const
+{
+    GpuMemoryStats stats;
+    stats.arenas = this->arenas.size();
+    stats.capacity_bytes = 0;
+    stats.used_bytes = 0;
+    stats.largest_free_bytes = 0;
+    stats.free_ranges = 0;
+    for (size_t arena = 0; arena < this->arenas.size(); ++arena)
+    {
+        RangeAllocator const &allocator = this->arenas[arena].allocator;
+        stats.capacity_bytes += allocator.Capacity();
+        stats.used_bytes += allocator.UsedSize();
+        stats.largest_free_bytes = std::max(stats.largest_free_bytes, allocator.LargestFreeRange());
+        stats.free_ranges += allocator.NumFreeRanges();
+    }
+    stats.free_bytes = stats.capacity_bytes - stats.used_bytes;
+    stats.pending_free_bytes = this->pending_free_bytes;
+    stats.moved_bytes = this->moved_bytes;
+    return stats;
+}
@@ -0,0 +1,201 @@
+#include <cstdio>
+#include <cstdint>
+#include <iostream>
+#include <algorithm>
+
+#include "headless.hpp"
+#include "utils.h"
+
+OffscreenTarget::OffscreenTarget():
+    framebuffer_id(0),
+    color_renderbuffer_id(0),
+    depth_renderbuffer_id(0),
+    width(0),
+    height(0)
+{
+}
+
+bool OffscreenTarget::Create(int width, int height)
+{
+    this->width = width;
+    this->height = height;
+
+    glGenFramebuffers(1, &this->framebuffer_id);
+    glBindFramebuffer(GL_FRAMEBUFFER, this->framebuffer_id);
+
+    glGenRenderbuffers(1, &this->color_renderbuffer_id);
+    glBindRenderbuffer(GL_RENDERBUFFER, this->color_renderbuffer_id);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, this->color_renderbuffer_id);
+
+    glGenRenderbuffers(1, &this->depth_renderbuffer_id);
+    glBindRenderbuffer(GL_RENDERBUFFER, this->depth_renderbuffer_id);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, this->depth_renderbuffer_id);
+
+    GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+    glCheckError();
+
+    if (status != GL_FRAMEBUFFER_COMPLETE)
+    {
+        std::cerr << "ERROR: Offscreen framebuffer is incomplete (status 0x" << std::hex << status << std::dec << ")." << std::endl;
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        return false;
+    }
+
+    return true;
+}
+
+void OffscreenTarget::Bind() const
+{
+    glBindFramebuffer(GL_FRAMEBUFFER, this->framebuffer_id);
+}
+
+int OffscreenTarget::Width() const
+{
+    return this->width;
+}
+
+int OffscreenTarget::Height() const
+{
+    return this->height;
+}
+
+bool OffscreenTarget::SaveToPng(const char *filename)
+{
+    size_t row_size = 3 * this->width;
+    this->pixels.resize(row_size * this->height * 2);
+
+    unsigned char *read = this->pixels.data();
+    unsigned char *flipped = read + row_size * this->height;
+
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, this->framebuffer_id);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(0, 0, this->width, this->height, GL_RGB, GL_UNSIGNED_BYTE, read);
+
+    // O OpenGL devolve as linhas de baixo para cima.
+    for (int y = 0; y < this->height; ++y)
+    {
+        const unsigned char *src = read + row_size * (this->height - 1 - y);
+        std::copy(src, src + row_size, flipped + row_size * y);
+    }
+
+    return WritePng(filename, this->width, this->height, flipped);
+}
+
+static uint32_t Png_Crc(uint32_t crc, const unsigned char *data, size_t length)
+{
+    static uint32_t table[256];
+    static bool table_ready = false;
+    if (!table_ready)
+    {
+        for (uint32_t n = 0; n < 256; ++n)
+        {
+            uint32_t c = n;
+            for (int k = 0; k < 8; ++k)
+                c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            table[n] = c;
+        }
+        table_ready = true;
+    }
+
+    crc = ~crc;
+    for (size_t i = 0; i < length; ++i)
+        crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    return ~crc;
+}
+
+static void Png_PutU32(std::vector<unsigned char> &out, uint32_t value)
+{
+    out.push_back((value >> 24) & 0xFF);
+    out.push_back((value >> 16) & 0xFF);
+    out.push_back((value >> 8) & 0xFF);
+    out.push_back(value & 0xFF);
+}
+
+static void Png_WriteChunk(FILE *file, const char *type, std::vector<unsigned char> const &data)
+{
+    std::vector<unsigned char> header;
+    Png_PutU32(header, data.size());
+    header.insert(header.end(), type, type + 4);
+
+    uint32_t crc = Png_Crc(0, (const unsigned char *)type, 4);
+    crc = Png_Crc(crc, data.data(), data.size());
+
+    std::vector<unsigned char> footer;
+    Png_PutU32(footer, crc);
+
+    fwrite(header.data(), 1, header.size(), file);
+    fwrite(data.data(), 1, data.size(), file);
+    fwrite(footer.data(), 1, footer.size(), file);
+}
+
+bool WritePng(const char *filename, int width, int height, const unsigned char *rgb)
+{
+    FILE *file = fopen(filename, "wb");
+    if (file == NULL)
+    {
+        std::cerr << "ERROR: Cannot open \"" << filename << "\" for writing." << std::endl;
+        return false;
+    }
+
+    static const unsigned char signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+    fwrite(signature, 1, 8, file);
+
+    std::vector<unsigned char> ihdr;
+    Png_PutU32(ihdr, width);
+    Png_PutU32(ihdr, height);
+    ihdr.push_back(8); // Bits por canal
+    ihdr.push_back(2); // Tipo de cor: RGB
+    ihdr.push_back(0); // Compressão
+    ihdr.push_back(0); // Filtro
+    ihdr.push_back(0); // Sem entrelaçamento
+    Png_WriteChunk(file, "IHDR", ihdr);
+
+    // Dados da imagem: cada linha é precedida pelo tipo de filtro (0 = nenhum).
+    size_t row_size = 3 * width;
+    std::vector<unsigned char> raw;
+    raw.reserve((row_size + 1) * height);
+    for (int y = 0; y < height; ++y)
+    {
+        raw.push_back(0);
+        raw.insert(raw.end(), rgb + row_size * y, rgb + row_size * (y + 1));
+    }
+
+    // Fluxo zlib com blocos deflate sem compressão, de até 65535 bytes.
+    std::vector<unsigned char> idat;
+    idat.reserve(raw.size() + raw.size() / 65535 * 5 + 16);
+    idat.push_back(0x78);
+    idat.push_back(0x01);
+
+    size_t offset = 0;
+    do
+    {
+        size_t block_size = std::min<size_t>(65535, raw.size() - offset);
+        bool last = offset + block_size == raw.size();
+        idat.push_back(last ? 1 : 0);
+        idat.push_back(block_size & 0xFF);
+        idat.push_back((block_size >> 8) & 0xFF);
+        idat.push_back(~block_size & 0xFF);
+        idat.push_back((~block_size >> 8) & 0xFF);
+        idat.insert(idat.end(), raw.begin() + offset, raw.begin() + offset + block_size);
+        offset += block_size;
+    } while (offset < raw.size());
+
+    // Checksum Adler-32 do fluxo zlib
+    uint32_t a = 1, b = 0;
+    for (size_t i = 0; i < raw.size(); ++i)
+    {
+        a = (a + raw[i]) % 65521;
+        b = (b + a) % 65521;
+    }
+    Png_PutU32(idat, (b << 16) | a);
+
+    Png_WriteChunk(file, "IDAT", idat);
+    Png_WriteChunk(file, "IEND", std::vector<unsigned char>());
+
+    bool ok = ferror(file) == 0;
+    fclose(file);
+    return ok;
+}
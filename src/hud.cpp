@@ -0,0 +1,182 @@
+#include <algorithm>
+#include "hud.hpp"
+#include "textrendering.hpp"
+#include "profiler.hpp"
+#include "streambuffer.hpp"
+#include "utils.h"
+
+// Cada vértice de texto é (x, y, s, t).
+#define HUD_FLOATS_PER_VERTEX 4
+
+// Folga reservada para cada rótulo, em caracteres, para que pequenas variações
+// no tamanho do texto (ex: "9.99 fps" -> "10.00 fps") não obriguem a
+// reorganizar o buffer inteiro.
+#define HUD_LABEL_SLACK_CHARS 8
+
+Hud::Hud():
+    vertex_array_object_id(0),
+    vertex_buffer_id(0),
+    vertex_buffer_capacity(0),
+    layout_version(0),
+    needs_repack(true)
+{
+}
+
+void Hud::Init()
+{
+    glGenVertexArrays(1, &this->vertex_array_object_id);
+    glGenBuffers(1, &this->vertex_buffer_id);
+
+    glBindVertexArray(this->vertex_array_object_id);
+    glBindBuffer(GL_ARRAY_BUFFER, this->vertex_buffer_id);
+    glVertexAttribPointer(0, HUD_FLOATS_PER_VERTEX, GL_FLOAT, GL_FALSE, 0, 0);
+    glEnableVertexAttribArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindVertexArray(0);
+    glCheckError();
+}
+
+Hud::LabelId Hud::AddLabel(HudLabel::Anchor anchor, float column, float line, float scale)
+{
+    HudLabel label;
+    label.anchor = anchor;
+    label.column = column;
+    label.line = line;
+    label.scale = scale;
+    label.visible = true;
+    label.first_vertex = 0;
+    label.num_vertices = 0;
+    label.vertex_capacity = 0;
+    label.dirty = true;
+
+    this->labels.push_back(label);
+    this->needs_repack = true;
+
+    return this->labels.size() - 1;
+}
+
+void Hud::SetText(LabelId label_id, const std::string &text)
+{
+    HudLabel &label = this->labels[label_id];
+    if (label.text == text)
+        return;
+
+    label.text = text;
+    label.dirty = true;
+
+    // Seis vértices por caractere
+    if (text.size() * 6 > label.vertex_capacity)
+        this->needs_repack = true;
+}
+
+void Hud::SetVisible(LabelId label_id, bool visible)
+{
+    this->labels[label_id].visible = visible;
+}
+
+void Hud::LayoutLabel(HudLabel &label)
+{
+    TextLayoutContext const &layout = TextRendering_LayoutContext();
+
+    float x;
+    if (label.anchor == HudLabel::ANCHOR_TOP_RIGHT)
+        x = 1.0f - (label.text.size() + label.column) * layout.char_width * label.scale;
+    else
+        x = -1.0f + label.column * layout.char_width * label.scale;
+    float y = 1.0f - label.line * layout.line_height * label.scale;
+
+    // Montamos o texto em um vetor temporário e copiamos para a faixa do
+    // rótulo dentro da cópia em CPU do buffer.
+    static std::vector<float> scratch;
+    scratch.clear();
+    label.num_vertices = TextRendering_LayoutString(scratch, label.text, x, y, label.scale);
+
+    std::copy(scratch.begin(), scratch.end(), this->vertices.begin() + label.first_vertex * HUD_FLOATS_PER_VERTEX);
+    label.dirty = false;
+}
+
+void Hud::Repack()
+{
+    size_t total_vertices = 0;
+    for (size_t i = 0; i < this->labels.size(); ++i)
+    {
+        HudLabel &label = this->labels[i];
+        label.first_vertex = total_vertices;
+        label.vertex_capacity = (label.text.size() + HUD_LABEL_SLACK_CHARS) * 6;
+        label.dirty = true;
+        total_vertices += label.vertex_capacity;
+    }
+
+    this->vertices.assign(total_vertices * HUD_FLOATS_PER_VERTEX, 0.0f);
+
+    for (size_t i = 0; i < this->labels.size(); ++i)
+        this->LayoutLabel(this->labels[i]);
+
+    glBindBuffer(GL_ARRAY_BUFFER, this->vertex_buffer_id);
+    glBufferData(GL_ARRAY_BUFFER, this->vertices.size() * sizeof(float), this->vertices.data(), GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    this->vertex_buffer_capacity = total_vertices;
+    this->needs_repack = false;
+}
+
+void Hud::Draw()
+{
+    // Redimensionar a janela muda a posição de todos os rótulos.
+    unsigned current_layout_version = TextRendering_LayoutContext().version;
+    if (current_layout_version != this->layout_version)
+    {
+        this->layout_version = current_layout_version;
+        for (size_t i = 0; i < this->labels.size(); ++i)
+            this->labels[i].dirty = true;
+    }
+
+    if (this->needs_repack)
+    {
+        this->Repack();
+    }
+    else
+    {
+        // Somente as faixas dos rótulos alterados são reenviadas à GPU, pelo
+        // anel de g_StreamBuffer: a GPU copia a faixa quando terminar de
+        // desenhar o quadro anterior, sem que a CPU espere.
+        glBindBuffer(GL_ARRAY_BUFFER, this->vertex_buffer_id);
+        for (size_t i = 0; i < this->labels.size(); ++i)
+        {
+            HudLabel &label = this->labels[i];
+            if (!label.dirty)
+                continue;
+
+            this->LayoutLabel(label);
+
+            size_t offset = label.first_vertex * HUD_FLOATS_PER_VERTEX;
+            size_t count = label.num_vertices * HUD_FLOATS_PER_VERTEX;
+            if (!g_StreamBuffer.CopyToBuffer(this->vertex_buffer_id, offset * sizeof(float), this->vertices.data() + offset, count * sizeof(float)))
+                glBufferSubData(GL_ARRAY_BUFFER, offset * sizeof(float), count * sizeof(float), this->vertices.data() + offset);
+        }
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    this->draw_firsts.clear();
+    this->draw_counts.clear();
+    for (size_t i = 0; i < this->labels.size(); ++i)
+    {
+        HudLabel const &label = this->labels[i];
+        if (!label.visible || label.num_vertices == 0)
+            continue;
+        this->draw_firsts.push_back(label.first_vertex);
+        this->draw_counts.push_back(label.num_vertices);
+    }
+
+    if (this->draw_firsts.empty())
+        return;
+
+    // Todos os rótulos visíveis são desenhados com uma única chamada.
+    TextRendering_BeginDraw();
+    glBindVertexArray(this->vertex_array_object_id);
+    glMultiDrawArrays(GL_TRIANGLES, this->draw_firsts.data(), this->draw_counts.data(), this->draw_firsts.size());
+    for (size_t i = 0; i < this->draw_counts.size(); ++i)
+        g_Profiler.CountDrawCall(this->draw_counts[i] / 3);
+    glBindVertexArray(0);
+    TextRendering_EndDraw();
+}
@@ -0,0 +1,247 @@
+#include <cstring>
+#include <chrono>
+#include <iostream>
+
+#include "inputlog.hpp"
+
+#define INPUTLOG_MAGIC "FCGI"
+#define INPUTLOG_VERSION 1
+
+// Número de campos inteiros e reais gravados para cada tipo de evento.
+static void InputLog_FieldCounts(InputEventType type, size_t &num_ints, size_t &num_doubles)
+{
+    switch (type)
+    {
+    case INPUT_EVENT_FRAME:        num_ints = 0; num_doubles = 0; break;
+    case INPUT_EVENT_KEY:          num_ints = 4; num_doubles = 0; break;
+    case INPUT_EVENT_MOUSE_BUTTON: num_ints = 3; num_doubles = 0; break;
+    case INPUT_EVENT_CURSOR_POS:   num_ints = 2; num_doubles = 2; break;
+    case INPUT_EVENT_SCROLL:       num_ints = 0; num_doubles = 2; break;
+    default:                       num_ints = 0; num_doubles = 0; break;
+    }
+}
+
+static double InputLog_Now()
+{
+    std::chrono::duration<double> now = std::chrono::steady_clock::now().time_since_epoch();
+    return now.count();
+}
+
+InputRecorder::InputRecorder():
+    file(NULL),
+    current_frame(0),
+    start_time(0.0)
+{
+}
+
+InputRecorder::~InputRecorder()
+{
+    this->Close();
+}
+
+bool InputRecorder::Open(const char *filename)
+{
+    this->Close();
+
+    this->file = fopen(filename, "wb");
+    if (this->file == NULL)
+    {
+        std::cerr << "ERROR: Cannot open input log \"" << filename << "\" for writing." << std::endl;
+        return false;
+    }
+
+    uint32_t version = INPUTLOG_VERSION;
+    fwrite(INPUTLOG_MAGIC, 1, 4, this->file);
+    fwrite(&version, sizeof(version), 1, this->file);
+
+    this->current_frame = 0;
+    this->start_time = InputLog_Now();
+    return true;
+}
+
+void InputRecorder::Close()
+{
+    if (this->file != NULL)
+    {
+        fclose(this->file);
+        this->file = NULL;
+    }
+}
+
+bool InputRecorder::IsOpen() const
+{
+    return this->file != NULL;
+}
+
+void InputRecorder::Write(InputEvent const &event)
+{
+    if (this->file == NULL)
+        return;
+
+    size_t num_ints, num_doubles;
+    InputLog_FieldCounts(event.type, num_ints, num_doubles);
+
+    uint8_t type = event.type;
+    fwrite(&type, sizeof(type), 1, this->file);
+    fwrite(&event.frame, sizeof(event.frame), 1, this->file);
+    fwrite(&event.time, sizeof(event.time), 1, this->file);
+    fwrite(event.ints, sizeof(int32_t), num_ints, this->file);
+    if (num_doubles > 0)
+    {
+        fwrite(&event.x, sizeof(double), 1, this->file);
+        fwrite(&event.y, sizeof(double), 1, this->file);
+    }
+}
+
+void InputRecorder::RecordFrame(uint32_t frame, double frame_seconds)
+{
+    this->current_frame = frame;
+
+    InputEvent event;
+    event.type = INPUT_EVENT_FRAME;
+    event.frame = frame;
+    event.time = frame_seconds;
+    this->Write(event);
+}
+
+void InputRecorder::RecordKey(int key, int scancode, int action, int mods)
+{
+    InputEvent event;
+    event.type = INPUT_EVENT_KEY;
+    event.frame = this->current_frame;
+    event.time = InputLog_Now() - this->start_time;
+    event.ints[0] = key;
+    event.ints[1] = scancode;
+    event.ints[2] = action;
+    event.ints[3] = mods;
+    this->Write(event);
+}
+
+void InputRecorder::RecordMouseButton(int button, int action, int mods)
+{
+    InputEvent event;
+    event.type = INPUT_EVENT_MOUSE_BUTTON;
+    event.frame = this->current_frame;
+    event.time = InputLog_Now() - this->start_time;
+    event.ints[0] = button;
+    event.ints[1] = action;
+    event.ints[2] = mods;
+    this->Write(event);
+}
+
+void InputRecorder::RecordCursorPos(double xpos, double ypos, int window_center_x, int window_center_y)
+{
+    InputEvent event;
+    event.type = INPUT_EVENT_CURSOR_POS;
+    event.frame = this->current_frame;
+    event.time = InputLog_Now() - this->start_time;
+    event.ints[0] = window_center_x;
+    event.ints[1] = window_center_y;
+    event.x = xpos;
+    event.y = ypos;
+    this->Write(event);
+}
+
+void InputRecorder::RecordScroll(double xoffset, double yoffset)
+{
+    InputEvent event;
+    event.type = INPUT_EVENT_SCROLL;
+    event.frame = this->current_frame;
+    event.time = InputLog_Now() - this->start_time;
+    event.x = xoffset;
+    event.y = yoffset;
+    this->Write(event);
+}
+
+InputReplayer::InputReplayer():
+    next_event(0)
+{
+}
+
+bool InputReplayer::Open(const char *filename)
+{
+    FILE *file = fopen(filename, "rb");
+    if (file == NULL)
+    {
+        std::cerr << "ERROR: Cannot open input log \"" << filename << "\"." << std::endl;
+        return false;
+    }
+
+    char magic[4];
+    uint32_t version = 0;
+    if (fread(magic, 1, 4, file) != 4
+        || memcmp(magic, INPUTLOG_MAGIC, 4) != 0
+        || fread(&version, sizeof(version), 1, file) != 1
+        || version != INPUTLOG_VERSION)
+    {
+        std::cerr << "ERROR: \"" << filename << "\" is not a valid input log." << std::endl;
+        fclose(file);
+        return false;
+    }
+
+    this->events.clear();
+    this->frame_seconds.clear();
+    this->next_event = 0;
+
+    uint8_t type;
+    while (fread(&type, sizeof(type), 1, file) == 1)
+    {
+        InputEvent event;
+        event.type = (InputEventType)type;
+
+        size_t num_ints, num_doubles;
+        InputLog_FieldCounts(event.type, num_ints, num_doubles);
+
+        bool ok = fread(&event.frame, sizeof(event.frame), 1, file) == 1
+            && fread(&event.time, sizeof(event.time), 1, file) == 1
+            && fread(event.ints, sizeof(int32_t), num_ints, file) == num_ints;
+        if (ok && num_doubles > 0)
+        {
+            ok = fread(&event.x, sizeof(double), 1, file) == 1
+                && fread(&event.y, sizeof(double), 1, file) == 1;
+        }
+
+        // Um registro truncado (ex: o programa terminou durante a gravação)
+        // encerra o log.
+        if (!ok)
+            break;
+
+        if (event.type == INPUT_EVENT_FRAME)
+        {
+            if (event.frame >= this->frame_seconds.size())
+                this->frame_seconds.resize(event.frame + 1, 0.0);
+            this->frame_seconds[event.frame] = event.time;
+        }
+        else
+        {
+            this->events.push_back(event);
+        }
+    }
+
+    fclose(file);
+
+    std::cout << "Log de entrada \"" << filename << "\": " << this->frame_seconds.size()
+              << " quadros, " << this->events.size() << " eventos" << std::endl;
+    return true;
+}
+
+uint32_t InputReplayer::NumFrames() const
+{
+    return this->frame_seconds.size();
+}
+
+double InputReplayer::FrameSeconds(uint32_t frame) const
+{
+    if (frame >= this->frame_seconds.size())
+        return 0.0;
+    return this->frame_seconds[frame];
+}
+
+bool InputReplayer::NextEvent(uint32_t frame, InputEvent &event)
+{
+    if (this->next_event >= this->events.size() || this->events[this->next_event].frame > frame)
+        return false;
+
+    event = this->events[this->next_event++];
+    return true;
+}
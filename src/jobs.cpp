@@ -0,0 +1,360 @@
+#include <algorithm>
+#include <chrono>
+
+#include "jobs.hpp"
+
+JobSystem g_JobSystem;
+
+// Índice da trabalhadora que executa a thread atual, ou -1 fora do conjunto.
+static thread_local int t_JobWorkerIndex = -1;
+static thread_local JobSystem *t_JobSystem = NULL;
+
+static uint64_t JobSystem_NowMicroseconds()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+TaskGroup::TaskGroup():
+    pending(0)
+{
+}
+
+bool TaskGroup::IsDone() const
+{
+    std::lock_guard<std::mutex> lock(this->mutex);
+    return this->pending == 0;
+}
+
+JobSystem::Worker::Worker():
+    tasks_run(0),
+    steals(0),
+    idle_us(0),
+    idle_start(0)
+{
+}
+
+JobSystem::JobSystem():
+    running(false),
+    queued_tasks(0),
+    next_queue(0)
+{
+}
+
+JobSystem::~JobSystem()
+{
+    this->Stop();
+}
+
+void JobSystem::Start(size_t num_workers)
+{
+    this->Stop();
+
+    if (num_workers == 0)
+    {
+        size_t cores = std::thread::hardware_concurrency();
+        num_workers = cores > 1 ? cores - 1 : 1;
+    }
+
+    this->running = true;
+
+    // Todas as filas precisam existir antes que alguma trabalhadora tente
+    // roubar tarefas.
+    for (size_t i = 0; i < num_workers; ++i)
+        this->workers.push_back(new Worker());
+    for (size_t i = 0; i < num_workers; ++i)
+        this->workers[i]->thread = std::thread(&JobSystem::WorkerLoop, this, i);
+}
+
+void JobSystem::Stop()
+{
+    if (this->workers.empty())
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock(this->sleep_mutex);
+        this->running = false;
+    }
+    this->work_available.notify_all();
+
+    for (size_t i = 0; i < this->workers.size(); ++i)
+    {
+        this->workers[i]->thread.join();
+        delete this->workers[i];
+    }
+    this->workers.clear();
+}
+
+size_t JobSystem::NumWorkers() const
+{
+    return this->workers.size();
+}
+
+void JobSystem::Submit(std::function<void()> const &task, TaskGroup *group)
+{
+    if (group != NULL)
+    {
+        std::lock_guard<std::mutex> lock(group->mutex);
+        group->pending++;
+    }
+
+    Task new_task;
+    new_task.function = task;
+    new_task.group = group;
+    this->Push(new_task);
+}
+
+void JobSystem::ContinueWith(TaskGroup &group, std::function<void()> const &task, TaskGroup *continuation_group)
+{
+    // O grupo da continuação já conta a tarefa agora, para que quem o espera
+    // não termine antes da continuação ser submetida.
+    if (continuation_group != NULL)
+    {
+        std::lock_guard<std::mutex> lock(continuation_group->mutex);
+        continuation_group->pending++;
+    }
+
+    Task new_task;
+    new_task.function = task;
+    new_task.group = continuation_group;
+
+    {
+        std::lock_guard<std::mutex> lock(group.mutex);
+        if (group.pending > 0)
+        {
+            TaskGroup::Continuation continuation;
+            continuation.function = task;
+            continuation.group = continuation_group;
+            group.continuations.push_back(continuation);
+            return;
+        }
+    }
+
+    this->Push(new_task);
+}
+
+void JobSystem::Wait(TaskGroup &group)
+{
+    while (!group.IsDone())
+    {
+        Task task;
+        if (this->FindTask(task))
+        {
+            this->Run(task);
+            continue;
+        }
+
+        // Sem tarefas para ajudar: dormimos até o grupo terminar, acordando
+        // periodicamente para verificar se surgiram novas tarefas.
+        std::unique_lock<std::mutex> lock(group.mutex);
+        if (group.pending == 0)
+            return;
+        group.done.wait_for(lock, std::chrono::microseconds(200));
+        if (group.pending == 0)
+            return;
+    }
+}
+
+void JobSystem::ParallelFor(size_t begin, size_t end, size_t grain, std::function<void(size_t, size_t)> const &body)
+{
+    if (end <= begin)
+        return;
+
+    size_t count = end - begin;
+    if (grain == 0)
+        grain = std::max<size_t>(1, count / (4 * (this->NumWorkers() + 1)));
+
+    TaskGroup group;
+    for (size_t first = begin; first < end; first += grain)
+    {
+        size_t last = std::min(end, first + grain);
+        this->Submit([&body, first, last]() { body(first, last); }, &group);
+    }
+
+    this->Wait(group);
+}
+
+JobWorkerStats JobSystem::WorkerStats(size_t worker) const
+{
+    JobWorkerStats stats;
+    stats.tasks_run = this->workers[worker]->tasks_run;
+    stats.steals = this->workers[worker]->steals;
+
+    // Uma espera em andamento ainda não foi somada a idle_us.
+    uint64_t idle_us = this->workers[worker]->idle_us;
+    uint64_t idle_start = this->workers[worker]->idle_start;
+    if (idle_start != 0)
+        idle_us += JobSystem_NowMicroseconds() - idle_start;
+    stats.idle_ms = idle_us / 1000.0;
+    return stats;
+}
+
+void JobSystem::ResetStats()
+{
+    for (size_t i = 0; i < this->workers.size(); ++i)
+    {
+        this->workers[i]->tasks_run = 0;
+        this->workers[i]->steals = 0;
+
+        // Uma espera em andamento passa a contar a partir de agora.
+        uint64_t idle_start = this->workers[i]->idle_start;
+        if (idle_start != 0)
+            this->workers[i]->idle_start.compare_exchange_strong(idle_start, JobSystem_NowMicroseconds());
+        this->workers[i]->idle_us = 0;
+    }
+}
+
+void JobSystem::WorkerLoop(size_t index)
+{
+    t_JobWorkerIndex = index;
+    t_JobSystem = this;
+
+    Worker &worker = *this->workers[index];
+
+    while (true)
+    {
+        Task task;
+        if (this->FindTask(task))
+        {
+            this->Run(task);
+            worker.tasks_run++;
+            continue;
+        }
+
+        worker.idle_start = JobSystem_NowMicroseconds();
+        {
+            std::unique_lock<std::mutex> lock(this->sleep_mutex);
+            while (this->running && this->queued_tasks == 0)
+                this->work_available.wait(lock);
+        }
+        uint64_t idle_start = worker.idle_start.exchange(0);
+        worker.idle_us += JobSystem_NowMicroseconds() - idle_start;
+
+        if (!this->running && this->queued_tasks == 0)
+            break;
+    }
+
+    t_JobWorkerIndex = -1;
+    t_JobSystem = NULL;
+}
+
+void JobSystem::Push(Task const &task)
+{
+    // Sem trabalhadoras (Start() não foi chamado) a tarefa executa aqui.
+    if (this->workers.empty())
+    {
+        Task inline_task = task;
+        this->Run(inline_task);
+        return;
+    }
+
+    // Uma trabalhadora coloca as tarefas que cria na sua própria fila.
+    size_t index;
+    if (t_JobSystem == this && t_JobWorkerIndex >= 0)
+        index = t_JobWorkerIndex;
+    else
+        index = this->next_queue++ % this->workers.size();
+
+    {
+        std::lock_guard<std::mutex> lock(this->workers[index]->mutex);
+        this->workers[index]->tasks.push_back(task);
+    }
+    this->queued_tasks++;
+
+    // O mutex garante que uma trabalhadora prestes a dormir veja a tarefa
+    // ou receba a notificação.
+    {
+        std::lock_guard<std::mutex> lock(this->sleep_mutex);
+    }
+    this->work_available.notify_one();
+}
+
+bool JobSystem::PopLocal(size_t index, Task &task)
+{
+    Worker &worker = *this->workers[index];
+    std::lock_guard<std::mutex> lock(worker.mutex);
+    if (worker.tasks.empty())
+        return false;
+
+    task = worker.tasks.back();
+    worker.tasks.pop_back();
+    this->queued_tasks--;
+    return true;
+}
+
+bool JobSystem::Steal(size_t thief, Task &task)
+{
+    size_t num_workers = this->workers.size();
+    for (size_t i = 1; i <= num_workers; ++i)
+    {
+        size_t victim = (thief + i) % num_workers;
+        if (victim == thief && t_JobSystem == this)
+            continue;
+
+        Worker &worker = *this->workers[victim];
+        std::lock_guard<std::mutex> lock(worker.mutex);
+        if (worker.tasks.empty())
+            continue;
+
+        task = worker.tasks.front();
+        worker.tasks.pop_front();
+        this->queued_tasks--;
+        return true;
+    }
+    return false;
+}
+
+bool JobSystem::FindTask(Task &task)
+{
+    if (this->workers.empty() || this->queued_tasks == 0)
+        return false;
+
+    if (t_JobSystem == this && t_JobWorkerIndex >= 0)
+    {
+        size_t index = t_JobWorkerIndex;
+        if (this->PopLocal(index, task))
+            return true;
+        if (this->Steal(index, task))
+        {
+            this->workers[index]->steals++;
+            return true;
+        }
+        return false;
+    }
+
+    // Threads de fora do conjunto só executam tarefas enquanto esperam um
+    // grupo; elas não contam como roubo.
+    return this->Steal(this->next_queue % this->workers.size(), task);
+}
+
+void JobSystem::Run(Task &task)
+{
+    task.function();
+    this->FinishTask(task.group);
+}
+
+void JobSystem::FinishTask(TaskGroup *group)
+{
+    if (group == NULL)
+        return;
+
+    std::vector<TaskGroup::Continuation> continuations;
+    {
+        std::lock_guard<std::mutex> lock(group->mutex);
+        group->pending--;
+        if (group->pending == 0)
+        {
+            continuations.swap(group->continuations);
+            group->done.notify_all();
+        }
+    }
+
+    // Depois de liberar o mutex o grupo pode já ter sido destruído por quem
+    // o esperava; só usamos a cópia local das continuações.
+    for (size_t i = 0; i < continuations.size(); ++i)
+    {
+        Task task;
+        task.function = continuations[i].function;
+        task.group = continuations[i].group;
+        this->Push(task);
+    }
+}
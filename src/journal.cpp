@@ -0,0 +1,221 @@
+#include <cstring>
+#include <iostream>
+
+#include "journal.hpp"
+#include "region.hpp"
+
+#define JOURNAL_MAGIC "FCGJ"
+#define JOURNAL_VERSION 1
+#define JOURNAL_HEADER_SIZE 8
+#define JOURNAL_ENTRY_SIZE 22
+
+bool ReadJournalFile(std::string const &path, std::vector<JournalEntry> &entries)
+{
+    FILE *file = fopen(path.c_str(), "rb");
+    if (file == NULL)
+        return false;
+
+    char magic[4];
+    uint32_t version = 0;
+    if (fread(magic, 1, 4, file) != 4
+        || memcmp(magic, JOURNAL_MAGIC, 4) != 0
+        || fread(&version, sizeof(version), 1, file) != 1
+        || version != JOURNAL_VERSION)
+    {
+        std::cerr << "ERROR: \"" << path << "\" is not a valid journal." << std::endl;
+        fclose(file);
+        return false;
+    }
+
+    for (;;)
+    {
+        JournalEntry entry;
+        uint8_t blocks[2];
+        bool ok = fread(&entry.x, sizeof(entry.x), 1, file) == 1
+            && fread(&entry.y, sizeof(entry.y), 1, file) == 1
+            && fread(&entry.z, sizeof(entry.z), 1, file) == 1
+            && fread(blocks, 1, 2, file) == 2
+            && fread(&entry.tick, sizeof(entry.tick), 1, file) == 1;
+        if (!ok)
+            break;
+
+        entry.old_block = (Block)blocks[0];
+        entry.new_block = (Block)blocks[1];
+        entries.push_back(entry);
+    }
+
+    fclose(file);
+    return true;
+}
+
+EditJournal::EditJournal():
+    file(NULL),
+    num_entries(0),
+    compacting(false)
+{
+}
+
+EditJournal::~EditJournal()
+{
+    this->Close();
+}
+
+std::string EditJournal::LogPath() const
+{
+    return this->directory + "/journal.log";
+}
+
+std::string EditJournal::OldPath() const
+{
+    return this->directory + "/journal.old";
+}
+
+bool EditJournal::Open(const char *directory, std::vector<JournalEntry> &recovered)
+{
+    this->Close();
+    this->directory = directory;
+
+    // Uma compactação interrompida deixa "journal.old", com as entradas
+    // mais antigas.
+    recovered.clear();
+    ReadJournalFile(this->OldPath(), recovered);
+    ReadJournalFile(this->LogPath(), recovered);
+
+    // As entradas recuperadas são regravadas em um único diário, sem a
+    // possível entrada incompleta no final. O diário novo substitui o atual
+    // sem apagá-lo antes: em qualquer ponto de uma interrupção, as entradas
+    // estão em "journal.log" ou em "journal.old".
+    std::string temporary_path = this->LogPath() + ".tmp";
+    if (!this->StartLog(temporary_path, recovered))
+        return false;
+
+    fclose(this->file);
+    this->file = NULL;
+    if (!Region_ReplaceFile(temporary_path, this->LogPath()))
+    {
+        std::cerr << "ERROR: Cannot replace \"" << this->LogPath() << "\"." << std::endl;
+        return false;
+    }
+    remove(this->OldPath().c_str());
+
+    this->file = fopen(this->LogPath().c_str(), "ab");
+    if (this->file == NULL)
+    {
+        std::cerr << "ERROR: Cannot open \"" << this->LogPath() << "\" for writing." << std::endl;
+        return false;
+    }
+
+    this->num_entries = recovered.size();
+    if (!recovered.empty())
+        std::cout << "Diário \"" << this->LogPath() << "\": " << recovered.size() << " alterações recuperadas" << std::endl;
+    return true;
+}
+
+void EditJournal::Close()
+{
+    if (this->file != NULL)
+    {
+        fclose(this->file);
+        this->file = NULL;
+    }
+}
+
+bool EditJournal::IsOpen() const
+{
+    return this->file != NULL;
+}
+
+bool EditJournal::StartLog(std::string const &path, std::vector<JournalEntry> const &entries)
+{
+    this->file = fopen(path.c_str(), "wb");
+    if (this->file == NULL)
+    {
+        std::cerr << "ERROR: Cannot open \"" << path << "\" for writing." << std::endl;
+        return false;
+    }
+
+    uint32_t version = JOURNAL_VERSION;
+    fwrite(JOURNAL_MAGIC, 1, 4, this->file);
+    fwrite(&version, sizeof(version), 1, this->file);
+
+    for (size_t i = 0; i < entries.size(); ++i)
+        this->Write(entries[i]);
+    fflush(this->file);
+
+    this->num_entries = entries.size();
+    return true;
+}
+
+void EditJournal::Write(JournalEntry const &entry)
+{
+    uint8_t blocks[2] = { entry.old_block, entry.new_block };
+    fwrite(&entry.x, sizeof(entry.x), 1, this->file);
+    fwrite(&entry.y, sizeof(entry.y), 1, this->file);
+    fwrite(&entry.z, sizeof(entry.z), 1, this->file);
+    fwrite(blocks, 1, 2, this->file);
+    fwrite(&entry.tick, sizeof(entry.tick), 1, this->file);
+}
+
+void EditJournal::Append(WorldPoint position, Block old_block, Block new_block, uint64_t tick)
+{
+    if (this->file == NULL)
+        return;
+
+    JournalEntry entry;
+    entry.x = position.x;
+    entry.y = position.y;
+    entry.z = position.z;
+    entry.old_block = old_block;
+    entry.new_block = new_block;
+    entry.tick = tick;
+    this->Write(entry);
+
+    // A entrada chega ao sistema operacional antes de a alteração aparecer
+    // na tela.
+    fflush(this->file);
+    this->num_entries++;
+}
+
+void EditJournal::BeginCompaction(std::vector<JournalEntry> const &carry_over)
+{
+    if (this->file == NULL || this->compacting)
+        return;
+
+    fclose(this->file);
+    this->file = NULL;
+
+    remove(this->OldPath().c_str());
+    if (rename(this->LogPath().c_str(), this->OldPath().c_str()) != 0)
+    {
+        std::cerr << "ERROR: Cannot rename \"" << this->LogPath() << "\"." << std::endl;
+        this->file = fopen(this->LogPath().c_str(), "ab");
+        return;
+    }
+
+    if (this->StartLog(this->LogPath(), carry_over))
+        this->compacting = true;
+}
+
+void EditJournal::EndCompaction()
+{
+    if (!this->compacting)
+        return;
+
+    remove(this->OldPath().c_str());
+    this->compacting = false;
+}
+
+bool EditJournal::IsCompacting() const
+{
+    return this->compacting;
+}
+
+size_t EditJournal::NumEntries() const
+{
+    return this->num_entries;
+}
+
+size_t EditJournal::Bytes() const
+{
+    return JOURNAL_HEADER_SIZE + this->num_entries * JOURNAL_ENTRY_SIZE;
+}
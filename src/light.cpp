@@ -0,0 +1,478 @@
+#include <algorithm>
+#include <cstring>
+
+#include "light.hpp"
+#include "profiler.hpp"
+
+// Vizinhos de uma célula. A luz do céu desce na vertical sem perder nível.
+static const int LIGHT_DIRECTIONS[6][3] = {
+    { 1, 0, 0 }, { -1, 0, 0 },
+    { 0, 1, 0 }, { 0, -1, 0 },
+    { 0, 0, 1 }, { 0, 0, -1 }
+};
+#define LIGHT_DIRECTION_DOWN 3
+
+unsigned char BlockLightEmission(Block block)
+{
+    switch (block)
+    {
+    case BLOCK_LAMP: return 14;
+    default:         return 0;
+    }
+}
+
+LightEngine::LightEngine():
+    world(NULL),
+    size_x(0), size_y(0), size_z(0),
+    chunks_x(0), chunks_y(0), chunks_z(0)
+{
+}
+
+void LightEngine::Init(WorldBlockMatrix const &world)
+{
+    this->world = &world;
+
+    WorldPoint size = world.Size();
+    this->size_x = size.x;
+    this->size_y = size.y;
+    this->size_z = size.z;
+
+    WorldPoint chunks = world.SizeInChunks();
+    this->chunks_x = chunks.x;
+    this->chunks_y = chunks.y;
+    this->chunks_z = chunks.z;
+
+    this->chunks.clear();
+    this->chunks.resize(this->chunks_x * this->chunks_y * this->chunks_z);
+    this->column_pending.assign(this->chunks_x * this->chunks_z, false);
+    this->chunk_changed.assign(this->chunks.size(), false);
+
+    for (int x = 0; x < this->chunks_x; ++x)
+        for (int y = 0; y < this->chunks_y; ++y)
+            for (int z = 0; z < this->chunks_z; ++z)
+                if (world.IsChunkLoaded(x, y, z))
+                    this->ChunkLoaded(x, y, z);
+
+    this->Update();
+}
+
+unsigned char const *LightEngine::LightCell(int x, int y, int z) const
+{
+    if (x < 0 || y < 0 || z < 0 || x >= this->size_x || y >= this->size_y || z >= this->size_z)
+        return NULL;
+
+    size_t index = ((x / CHUNK_SIZE) * this->chunks_y + y / CHUNK_SIZE) * this->chunks_z + z / CHUNK_SIZE;
+    ChunkLight const *chunk = this->chunks[index].get();
+    if (chunk == NULL)
+        return NULL;
+    return &chunk->light[x % CHUNK_SIZE][y % CHUNK_SIZE][z % CHUNK_SIZE];
+}
+
+unsigned char *LightEngine::LightCell(int x, int y, int z)
+{
+    return const_cast<unsigned char *>(static_cast<LightEngine const *>(this)->LightCell(x, y, z));
+}
+
+unsigned char LightEngine::Light(int x, int y, int z) const
+{
+    unsigned char const *cell = this->LightCell(x, y, z);
+    return cell != NULL ? *cell : 0;
+}
+
+bool LightEngine::IsTransparent(int x, int y, int z) const
+{
+    return (*this->world)[WorldPoint(x, y, z)] == BLOCK_AIR;
+}
+
+void LightEngine::SetLight(int x, int y, int z, unsigned char *cell, unsigned char light)
+{
+    *cell = light;
+    this->MarkChanged(x, y, z);
+}
+
+void LightEngine::MarkChanged(int x, int y, int z)
+{
+    int chunk[3] = { x / CHUNK_SIZE, y / CHUNK_SIZE, z / CHUNK_SIZE };
+    this->MarkChunkChanged(chunk[0], chunk[1], chunk[2]);
+
+    // A luz de uma célula na borda ilumina faces de blocos do chunk vizinho.
+    int local[3] = { x % CHUNK_SIZE, y % CHUNK_SIZE, z % CHUNK_SIZE };
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        int neighbor[3] = { chunk[0], chunk[1], chunk[2] };
+        if (local[axis] == 0)
+            neighbor[axis]--;
+        else if (local[axis] == CHUNK_SIZE - 1)
+            neighbor[axis]++;
+        else
+            continue;
+
+        this->MarkChunkChanged(neighbor[0], neighbor[1], neighbor[2]);
+    }
+}
+
+void LightEngine::MarkChunkChanged(int chunk_x, int chunk_y, int chunk_z)
+{
+    if (chunk_x < 0 || chunk_y < 0 || chunk_z < 0
+        || chunk_x >= this->chunks_x || chunk_y >= this->chunks_y || chunk_z >= this->chunks_z)
+        return;
+
+    size_t index = (chunk_x * this->chunks_y + chunk_y) * this->chunks_z + chunk_z;
+    if (this->chunk_changed[index])
+        return;
+
+    this->chunk_changed[index] = true;
+    this->changed_chunks.push_back(WorldPoint(chunk_x, chunk_y, chunk_z));
+}
+
+void LightEngine::TakeChangedChunks(std::vector<WorldPoint> &chunks)
+{
+    chunks.swap(this->changed_chunks);
+    this->changed_chunks.clear();
+    for (size_t i = 0; i < chunks.size(); ++i)
+        this->chunk_changed[(chunks[i].x * this->chunks_y + chunks[i].y) * this->chunks_z + chunks[i].z] = false;
+}
+
+void LightEngine::SeedSources(int x, int y, int z)
+{
+    unsigned char *cell = this->LightCell(x, y, z);
+    if (cell == NULL)
+        return;
+
+    unsigned char sky = LightSky(*cell);
+    unsigned char block = LightBlock(*cell);
+
+    unsigned char emission = BlockLightEmission((*this->world)[WorldPoint(x, y, z)]);
+    if (emission > block)
+        block = emission;
+
+    // O topo do mundo é aberto para o céu.
+    if (y == this->size_y - 1 && this->IsTransparent(x, y, z))
+        sky = LIGHT_MAX;
+
+    unsigned char light = (sky << 4) | block;
+    if (light == *cell)
+        return;
+
+    this->SetLight(x, y, z, cell, light);
+    Cell seed = { x, y, z };
+    this->add_queue.push_back(seed);
+}
+
+void LightEngine::BlockChanged(WorldPoint point)
+{
+    int x = point.x, y = point.y, z = point.z;
+    unsigned char *cell = this->LightCell(x, y, z);
+    if (cell == NULL)
+        return;
+
+    // A luz que passava pela célula é apagada, junto da que dependia dela.
+    unsigned char old_light = *cell;
+    if (LightSky(old_light) > 0)
+    {
+        Removal removal = { x, y, z, LightSky(old_light) };
+        this->sky_removal_queue.push_back(removal);
+    }
+    if (LightBlock(old_light) > 0)
+    {
+        Removal removal = { x, y, z, LightBlock(old_light) };
+        this->block_removal_queue.push_back(removal);
+    }
+    this->SetLight(x, y, z, cell, 0);
+
+    this->SeedSources(x, y, z);
+
+    // Um bloco de ar novo é iluminado pelos vizinhos.
+    if (this->IsTransparent(x, y, z))
+    {
+        for (int d = 0; d < 6; ++d)
+        {
+            Cell neighbor = { x + LIGHT_DIRECTIONS[d][0], y + LIGHT_DIRECTIONS[d][1], z + LIGHT_DIRECTIONS[d][2] };
+            this->add_queue.push_back(neighbor);
+        }
+    }
+}
+
+void LightEngine::ChunkLoaded(size_t chunk_x, size_t chunk_y, size_t chunk_z)
+{
+    std::unique_ptr<ChunkLight> &chunk = this->chunks[(chunk_x * this->chunks_y + chunk_y) * this->chunks_z + chunk_z];
+    if (!chunk)
+    {
+        chunk.reset(new ChunkLight);
+        memset(chunk->light, 0, sizeof(chunk->light));
+    }
+
+    size_t column = chunk_x * this->chunks_z + chunk_z;
+    if (!this->column_pending[column])
+    {
+        this->column_pending[column] = true;
+        this->pending_columns.push_back(column);
+    }
+}
+
+void LightEngine::ChunkReplaced(size_t chunk_x, size_t chunk_y, size_t chunk_z, WorldChunk const &previous)
+{
+    if (!this->chunks[(chunk_x * this->chunks_y + chunk_y) * this->chunks_z + chunk_z])
+    {
+        this->ChunkLoaded(chunk_x, chunk_y, chunk_z);
+        return;
+    }
+
+    WorldChunk const &current = this->world->Chunk(chunk_x, chunk_y, chunk_z);
+    for (int x = 0; x < CHUNK_SIZE; ++x)
+        for (int y = 0; y < CHUNK_SIZE; ++y)
+            for (int z = 0; z < CHUNK_SIZE; ++z)
+                if (current.blocks[x][y][z] != previous.blocks[x][y][z])
+                    this->BlockChanged(WorldPoint(chunk_x * CHUNK_SIZE + x, chunk_y * CHUNK_SIZE + y, chunk_z * CHUNK_SIZE + z));
+}
+
+void LightEngine::ChunkUnloaded(size_t chunk_x, size_t chunk_y, size_t chunk_z)
+{
+    std::unique_ptr<ChunkLight> &chunk = this->chunks[(chunk_x * this->chunks_y + chunk_y) * this->chunks_z + chunk_z];
+    if (!chunk)
+        return;
+
+    // A luz que saiu do chunk pelas faces é apagada dos vizinhos, como se as
+    // células da borda tivessem ficado escuras. As células do chunk deixam
+    // de existir, então a remoção só alcança os vizinhos.
+    int position[3] = { (int)chunk_x, (int)chunk_y, (int)chunk_z };
+    int origin[3] = { position[0] * CHUNK_SIZE, position[1] * CHUNK_SIZE, position[2] * CHUNK_SIZE };
+    for (int x = 0; x < CHUNK_SIZE; ++x)
+    {
+        for (int y = 0; y < CHUNK_SIZE; ++y)
+        {
+            for (int z = 0; z < CHUNK_SIZE; ++z)
+            {
+                if (x > 0 && x < CHUNK_SIZE - 1 && y > 0 && y < CHUNK_SIZE - 1 && z > 0 && z < CHUNK_SIZE - 1)
+                    continue;
+
+                unsigned char light = chunk->light[x][y][z];
+                if (LightSky(light) > 0)
+                {
+                    Removal removal = { origin[0] + x, origin[1] + y, origin[2] + z, LightSky(light) };
+                    this->sky_removal_queue.push_back(removal);
+                }
+                if (LightBlock(light) > 0)
+                {
+                    Removal removal = { origin[0] + x, origin[1] + y, origin[2] + z, LightBlock(light) };
+                    this->block_removal_queue.push_back(removal);
+                }
+            }
+        }
+    }
+    chunk.reset();
+
+    // As faces dos vizinhos voltadas para o chunk eram iluminadas pelas
+    // células dele, que agora têm luz 0.
+    for (int d = 0; d < 6; ++d)
+        this->MarkChunkChanged(position[0] + LIGHT_DIRECTIONS[d][0], position[1] + LIGHT_DIRECTIONS[d][1], position[2] + LIGHT_DIRECTIONS[d][2]);
+}
+
+void LightEngine::LightColumn(size_t column)
+{
+    int chunk_x = column / this->chunks_z;
+    int chunk_z = column % this->chunks_z;
+    int origin_x = chunk_x * CHUNK_SIZE;
+    int origin_z = chunk_z * CHUNK_SIZE;
+
+    // Luz direta do céu: o ar acima do bloco mais alto de cada coluna de
+    // blocos. Guardamos a altura desse bloco (-1 se só há ar).
+    int top[CHUNK_SIZE][CHUNK_SIZE];
+    for (int lx = 0; lx < CHUNK_SIZE; ++lx)
+    {
+        for (int lz = 0; lz < CHUNK_SIZE; ++lz)
+        {
+            int x = origin_x + lx, z = origin_z + lz;
+            int y = this->size_y - 1;
+            for (; y >= 0; --y)
+            {
+                unsigned char *cell = this->LightCell(x, y, z);
+                if (cell == NULL || !this->IsTransparent(x, y, z))
+                    break;
+                this->SetLight(x, y, z, cell, (LIGHT_MAX << 4) | LightBlock(*cell));
+            }
+            top[lx][lz] = y;
+        }
+    }
+
+    // Somente as células de céu direto ao lado de células mais baixas
+    // espalham a luz para os lados.
+    for (int lx = 0; lx < CHUNK_SIZE; ++lx)
+    {
+        for (int lz = 0; lz < CHUNK_SIZE; ++lz)
+        {
+            int limit = this->size_y - 1;
+            if (lx > 0 && lx < CHUNK_SIZE - 1 && lz > 0 && lz < CHUNK_SIZE - 1)
+                limit = std::max(std::max(top[lx - 1][lz], top[lx + 1][lz]), std::max(top[lx][lz - 1], top[lx][lz + 1]));
+
+            for (int y = top[lx][lz] + 1; y <= limit; ++y)
+            {
+                Cell seed = { origin_x + lx, y, origin_z + lz };
+                this->add_queue.push_back(seed);
+            }
+        }
+    }
+
+    // Blocos emissores.
+    for (int chunk_y = 0; chunk_y < this->chunks_y; ++chunk_y)
+    {
+        if (!this->world->IsChunkLoaded(chunk_x, chunk_y, chunk_z))
+            continue;
+
+        WorldChunk const &chunk = this->world->Chunk(chunk_x, chunk_y, chunk_z);
+        for (int lx = 0; lx < CHUNK_SIZE; ++lx)
+            for (int ly = 0; ly < CHUNK_SIZE; ++ly)
+                for (int lz = 0; lz < CHUNK_SIZE; ++lz)
+                    if (BlockLightEmission(chunk.blocks[lx][ly][lz]) > 0)
+                        this->SeedSources(origin_x + lx, chunk_y * CHUNK_SIZE + ly, origin_z + lz);
+    }
+
+    // Luz que entra pelas colunas vizinhas.
+    for (int y = 0; y < this->size_y; ++y)
+    {
+        for (int i = 0; i < CHUNK_SIZE; ++i)
+        {
+            Cell neighbors[4] = {
+                { origin_x - 1, y, origin_z + i },
+                { origin_x + CHUNK_SIZE, y, origin_z + i },
+                { origin_x + i, y, origin_z - 1 },
+                { origin_x + i, y, origin_z + CHUNK_SIZE }
+            };
+            for (int n = 0; n < 4; ++n)
+            {
+                unsigned char *cell = this->LightCell(neighbors[n].x, neighbors[n].y, neighbors[n].z);
+                if (cell != NULL && *cell != 0)
+                    this->add_queue.push_back(neighbors[n]);
+            }
+        }
+    }
+}
+
+void LightEngine::PropagateRemovals(std::vector<Removal> &queue, bool sky)
+{
+    for (size_t i = 0; i < queue.size(); ++i)
+    {
+        Removal removal = queue[i];
+
+        for (int d = 0; d < 6; ++d)
+        {
+            int x = removal.x + LIGHT_DIRECTIONS[d][0];
+            int y = removal.y + LIGHT_DIRECTIONS[d][1];
+            int z = removal.z + LIGHT_DIRECTIONS[d][2];
+            unsigned char *cell = this->LightCell(x, y, z);
+            if (cell == NULL)
+                continue;
+
+            unsigned char level = sky ? LightSky(*cell) : LightBlock(*cell);
+            if (level == 0)
+                continue;
+
+            // A luz do vizinho veio desta célula: é apagada também. Uma luz
+            // maior ou igual vem de outro caminho, e ilumina de novo a
+            // região apagada.
+            bool dependent = level < removal.level
+                || (sky && d == LIGHT_DIRECTION_DOWN && removal.level == LIGHT_MAX && level == LIGHT_MAX);
+            if (dependent)
+            {
+                this->SetLight(x, y, z, cell, sky ? LightBlock(*cell) : (*cell & 0xF0));
+                Removal next = { x, y, z, level };
+                queue.push_back(next);
+                this->SeedSources(x, y, z);
+            }
+            else
+            {
+                Cell source = { x, y, z };
+                this->add_queue.push_back(source);
+            }
+        }
+    }
+    queue.clear();
+}
+
+void LightEngine::PropagateAdds()
+{
+    for (size_t i = 0; i < this->add_queue.size(); ++i)
+    {
+        Cell c = this->add_queue[i];
+        unsigned char *cell = this->LightCell(c.x, c.y, c.z);
+        if (cell == NULL)
+            continue;
+
+        unsigned char sky = LightSky(*cell);
+        unsigned char block = LightBlock(*cell);
+        if (sky <= 1 && block <= 1)
+            continue;
+
+        for (int d = 0; d < 6; ++d)
+        {
+            int x = c.x + LIGHT_DIRECTIONS[d][0];
+            int y = c.y + LIGHT_DIRECTIONS[d][1];
+            int z = c.z + LIGHT_DIRECTIONS[d][2];
+            unsigned char *neighbor = this->LightCell(x, y, z);
+            if (neighbor == NULL || !this->IsTransparent(x, y, z))
+                continue;
+
+            unsigned char neighbor_sky = (d == LIGHT_DIRECTION_DOWN && sky == LIGHT_MAX) ? LIGHT_MAX : (sky > 0 ? sky - 1 : 0);
+            unsigned char neighbor_block = block > 0 ? block - 1 : 0;
+            neighbor_sky = std::max(neighbor_sky, LightSky(*neighbor));
+            neighbor_block = std::max(neighbor_block, LightBlock(*neighbor));
+
+            unsigned char light = (neighbor_sky << 4) | neighbor_block;
+            if (light == *neighbor)
+                continue;
+
+            this->SetLight(x, y, z, neighbor, light);
+            Cell next = { x, y, z };
+            this->add_queue.push_back(next);
+        }
+    }
+    this->add_queue.clear();
+}
+
+void LightEngine::Update()
+{
+    if (this->pending_columns.empty() && this->add_queue.empty()
+        && this->sky_removal_queue.empty() && this->block_removal_queue.empty())
+        return;
+
+    ProfileScope cpu_scope("light update");
+
+    // A luz apagada é propagada antes da nova, que ilumina de novo as
+    // regiões apagadas.
+    this->PropagateRemovals(this->sky_removal_queue, true);
+    this->PropagateRemovals(this->block_removal_queue, false);
+
+    for (size_t i = 0; i < this->pending_columns.size(); ++i)
+    {
+        this->column_pending[this->pending_columns[i]] = false;
+        this->LightColumn(this->pending_columns[i]);
+    }
+    this->pending_columns.clear();
+
+    this->PropagateAdds();
+}
+
+void LightEngine::RecomputeAll()
+{
+    this->add_queue.clear();
+    this->sky_removal_queue.clear();
+    this->block_removal_queue.clear();
+
+    for (int x = 0; x < this->chunks_x; ++x)
+    {
+        for (int y = 0; y < this->chunks_y; ++y)
+        {
+            for (int z = 0; z < this->chunks_z; ++z)
+            {
+                std::unique_ptr<ChunkLight> &chunk = this->chunks[(x * this->chunks_y + y) * this->chunks_z + z];
+                if (!chunk)
+                    continue;
+
+                memset(chunk->light, 0, sizeof(chunk->light));
+                this->ChunkLoaded(x, y, z);
+            }
+        }
+    }
+
+    this->Update();
+}
@@ -4,6 +4,8 @@
 #include <fstream>
 #include <sstream>
 #include <map>
+#include <algorithm>
+#include <thread>
 
 #include <glad/glad.h>  // Criação de contexto OpenGL 3.3
 #include <GLFW/glfw3.h> // Criação de janelas do sistema operacional
@@ -21,13 +23,38 @@
 #include "stb_image.h"
 #include "blocks.hpp"
 #include "collisions.hpp"
+#include "textrendering.hpp"
+#include "hud.hpp"
+#include "profiler.hpp"
+#include "benchmark.hpp"
+#include "inputlog.hpp"
+#include "headless.hpp"
+#include "simulation.hpp"
+#include "framestate.hpp"
+#include "jobs.hpp"
+#include "terrain.hpp"
+#include "streaming.hpp"
+#include "region.hpp"
+#include "journal.hpp"
+#include "chunkmesh.hpp"
+#include "light.hpp"
+#include "shadowmap.hpp"
+#include "gpumemory.hpp"
+#include "streambuffer.hpp"
 
 #define OBJ_BLOCK 0
 #define OBJ_COW 1
 #define OBJ_EYE 2
+#define OBJ_CHUNK 3
 
 #define INVENTORY_MAX 64
 
+// Número máximo de trabalhadoras mostradas no HUD.
+#define HUD_MAX_JOB_WORKERS 8
+
+// Intervalo entre os salvamentos automáticos do mundo, em segundos.
+#define WORLD_AUTOSAVE_SECONDS 30.0
+
 void FramebufferSizeCallback(GLFWwindow *window, int width, int height);
 void ErrorCallback(int error, const char *description);
 void KeyCallback(GLFWwindow *window, int key, int scancode, int action, int mode);
@@ -35,27 +62,74 @@ void MouseButtonCallback(GLFWwindow *window, int button, int action, int mods);
 void CursorPosCallback(GLFWwindow *window, double xpos, double ypos);
 void ScrollCallback(GLFWwindow *window, double xoffset, double yoffset);
 
-// Declaração de funções auxiliares para renderizar texto dentro da janela
-// OpenGL. Estas funções estão definidas no arquivo "textrendering.cpp".
-void TextRendering_Init();
-float TextRendering_LineHeight(GLFWwindow *window);
-float TextRendering_CharWidth(GLFWwindow *window);
-void TextRendering_PrintString(GLFWwindow *window, const std::string &str, float x, float y, float scale = 1.0f);
-void TextRendering_PrintMatrix(GLFWwindow *window, glm::mat4 M, float x, float y, float scale = 1.0f);
-void TextRendering_PrintVector(GLFWwindow *window, glm::vec4 v, float x, float y, float scale = 1.0f);
-void TextRendering_PrintMatrixVectorProduct(GLFWwindow *window, glm::mat4 M, glm::vec4 v, float x, float y, float scale = 1.0f);
-void TextRendering_PrintMatrixVectorProductMoreDigits(GLFWwindow *window, glm::mat4 M, glm::vec4 v, float x, float y, float scale = 1.0f);
-void TextRendering_PrintMatrixVectorProductDivW(GLFWwindow *window, glm::mat4 M, glm::vec4 v, float x, float y, float scale = 1.0f);
-
-void TextRendering_ShowFramesPerSecond(GLFWwindow *window);
-void TextRendering_ShowCameraPosition(GLFWwindow *window);
-void TextRendering_ShowInventory(GLFWwindow *window);
+// Versões dos callbacks acima que gravam os eventos antes de tratá-los.
+void RecordingKeyCallback(GLFWwindow *window, int key, int scancode, int action, int mode);
+void RecordingMouseButtonCallback(GLFWwindow *window, int button, int action, int mods);
+void RecordingCursorPosCallback(GLFWwindow *window, double xpos, double ypos);
+void RecordingScrollCallback(GLFWwindow *window, double xoffset, double yoffset);
+
+void RotateCameraFromCursor(double dx, double dy);
+void ReplayInputEvent(GLFWwindow *window, InputEvent const &event);
+
+// Opções passadas pela linha de comando.
+struct CommandLineOptions
+{
+    const char *trace_filename;     // --trace <arquivo>: grava um trace no formato do Chrome
+    const char *benchmark_filename; // --benchmark <roteiro>: executa o roteiro e imprime estatísticas
+    const char *record_filename;    // --record <arquivo>: grava os eventos de entrada
+    const char *replay_filename;    // --replay <arquivo>: reproduz eventos gravados e imprime estatísticas
+    bool        headless;           // --headless: renderiza em um framebuffer fora da tela
+    const char *dump_frames_dir;    // --dump-frames <dir>: salva os quadros como PNG
+    int         dump_every;         // --dump-every <N>: salva um a cada N quadros
+    double      tick_rate;          // --tick-rate <Hz>: passos de simulação por segundo
+    int         jobs;               // --jobs <N>: trabalhadoras do JobSystem (0 = automático)
+    bool        jobs_benchmark;     // --jobs-benchmark: mede a escalabilidade do JobSystem e termina
+    uint32_t    seed;               // --seed <n>: semente do gerador de terreno
+    int         world_size[3];      // --world-size <x> <y> <z>: dimensões do mundo (0 = padrão)
+    bool        terrain_benchmark;  // --terrain-benchmark: mede a geração de terreno e termina
+    int         stream_radius;      // --stream-radius <chunks>: raio carregado em volta da câmera
+    int         stream_budget_mb;   // --stream-budget <MiB>: memória dos chunks carregados
+    const char *world_dir;          // --world-dir <dir>: salva as alterações do mundo nesse diretório
+    const char *region_benchmark_dir; // --region-benchmark <dir>: mede a gravação e a leitura de regiões e termina
+    const char *journal_benchmark_dir; // --journal-benchmark <dir>: mede a gravação do diário de alterações e termina
+    bool        snapshot_benchmark; // --snapshot-benchmark: mede a cópia e a restauração do mundo e termina
+    bool        light_benchmark;    // --light-benchmark: mede a iluminação completa e incremental e termina
+    bool        lod_benchmark;      // --lod-benchmark: mede as malhas com e sem níveis de detalhe e termina
+    bool        no_lod;             // --no-lod: todas as malhas dos chunks são feitas de blocos
+    float       view_distance;      // --view-distance <blocos>: distância do plano distante (0 = padrão da câmera)
+};
+
+bool ParseCommandLine(int argc, char const *argv[], CommandLineOptions &options);
+
+// Estado da thread de renderização. Ela é a única thread que usa o contexto
+// OpenGL, e desenha os quadros publicados pela thread principal.
+struct RenderThreadContext
+{
+    GLFWwindow               *window;
+    CommandLineOptions const *options;
+    FrameExchange            *exchange;
+    WorldBlockMatrix          world; // Cópia do mundo, atualizada pelas edições de cada quadro
+    BenchmarkStats           *stats; // NULL fora do benchmark e da reprodução
+};
+
+void RenderThread(RenderThreadContext *context);
+
+void SetupHud();
+void UpdateHudFramesPerSecond();
+void UpdateHudCameraPosition(glm::vec4 position);
+void UpdateHudInventory(unsigned stones);
+void UpdateHudJobStats(float ellapsed_seconds);
+void UpdateHudChunks(ChunkRenderer const &chunk_renderer);
+void UpdateHudStreaming(StreamingStats const &stats);
+void UpdateHudCulling(ChunkCullingStats const &stats);
+void UpdateHudGpuMemory(GpuMemoryStats const &stats);
+void UpdateHudStreamBuffer(StreamBuffer const &stream_buffer);
 
 void LoadShader(const char *filename, GLuint shader_id);
 GLuint LoadShader_Vertex(const char *filename);   // Carrega um vertex shader
 GLuint LoadShader_Fragment(const char *filename); // Carrega um fragment shader
-GLFWwindow *CreateGLFWWindow(void);
-void SetupInputCallbacks(GLFWwindow *window);
+GLFWwindow *CreateGLFWWindow(bool visible);
+void SetupInputCallbacks(GLFWwindow *window, bool recording);
 void PrintGlInfo();
 void SetupFramebufferSize(GLFWwindow *window);
 
@@ -65,6 +139,11 @@ GLuint LoadTextureImage(char const *path, char const *name, GLuint program_id);
 
 glm::vec3 CowPosition(double time);
 
+void BreakBlock(glm::vec3 position);
+void PlaceBlock(glm::vec3 position);
+
+void NoteInputEvent();
+
 // Variável que controla se o texto informativo será mostrado na tela.
 bool g_ShowInfoText = true;
 
@@ -74,8 +153,210 @@ WorldBlockMatrix g_WorldBlockMatrix;
 
 unsigned char g_StonesInInventory = 0;
 
+// Bloco colocado com o botão direito: pedra ou lâmpada (tecla L).
+Block g_PlacedBlock = BLOCK_STONE;
+
+InputRecorder g_InputRecorder;
+
+// Diário das alterações de blocos do mundo salvo (--world-dir), e o passo da
+// simulação gravado em cada alteração.
+EditJournal g_EditJournal;
+uint64_t g_SimulationTick = 0;
+
+// Teclas de movimento mantidas pressionadas, lidas a cada passo da simulação.
+InputState g_InputState;
+
+// Estado do jogo salvo com F5 e restaurado com F9 (ex: para testes). O
+// mundo é uma cópia que compartilha os chunks (veja WorldBlockMatrix), de
+// forma que salvar e restaurar não copiam os blocos.
+struct SaveState
+{
+    bool             valid;
+    WorldBlockMatrix world;
+    Camera           camera;
+    Simulation       simulation; // Tempo de jogo, que também move a vaca
+    unsigned char    stones_in_inventory;
+
+    SaveState(): valid(false), world(0, 0, 0) {}
+};
+
+// Pedidos feitos pelos callbacks, atendidos no próximo quadro.
+bool g_SaveStateRequested = false;
+bool g_RestoreStateRequested = false;
+
+// Estado produzido pelos callbacks (na thread principal) e enviado à thread
+// de renderização no próximo quadro.
+std::vector<BlockEdit> g_PendingBlockEdits;
+double g_PendingInputUs = -1.0;
+int g_FramebufferWidth = 800;
+int g_FramebufferHeight = 600;
+int g_WindowWidth = 800;
+int g_WindowHeight = 600;
+
+// HUD com as informações de depuração. Os rótulos só são montados novamente
+// quando seus textos mudam.
+Hud g_Hud;
+Hud::LabelId g_HudFpsLabel;
+Hud::LabelId g_HudCameraPositionLabel;
+Hud::LabelId g_HudInventoryTitleLabel;
+Hud::LabelId g_HudInventoryStonesLabel;
+Hud::LabelId g_HudFrameTimeLabel;
+Hud::LabelId g_HudInputLatencyLabel;
+Hud::LabelId g_HudChunksLabel;
+Hud::LabelId g_HudStreamingLabel;
+Hud::LabelId g_HudCullingLabel;
+Hud::LabelId g_HudGpuMemoryLabel;
+Hud::LabelId g_HudStreamBufferLabel;
+Hud::LabelId g_HudJobsLabel;
+Hud::LabelId g_HudJobWorkerLabels[HUD_MAX_JOB_WORKERS];
+
 int main(int argc, char const *argv[])
 {
+    CommandLineOptions options;
+    if (!ParseCommandLine(argc, argv, options))
+    {
+        std::exit(EXIT_FAILURE);
+    }
+
+    if (options.jobs_benchmark)
+    {
+        size_t max_workers = options.jobs > 0 ? options.jobs : std::max(1u, std::thread::hardware_concurrency());
+        RunJobScalingBenchmark(std::cout, max_workers);
+        return 0;
+    }
+
+    g_Profiler.EnableTrace(options.trace_filename != NULL);
+
+    g_JobSystem.Start(options.jobs);
+
+    if (options.terrain_benchmark)
+    {
+        RunTerrainBenchmark(std::cout,
+                            options.world_size[0] > 0 ? options.world_size[0] : TERRAIN_BENCHMARK_SIZE_X,
+                            options.world_size[1] > 0 ? options.world_size[1] : TERRAIN_BENCHMARK_SIZE_Y,
+                            options.world_size[2] > 0 ? options.world_size[2] : TERRAIN_BENCHMARK_SIZE_Z,
+                            options.seed);
+        g_JobSystem.Stop();
+        return 0;
+    }
+
+    if (options.region_benchmark_dir != NULL)
+    {
+        RunRegionBenchmark(std::cout, options.region_benchmark_dir, options.seed);
+        g_JobSystem.Stop();
+        return 0;
+    }
+
+    if (options.journal_benchmark_dir != NULL)
+    {
+        RunJournalBenchmark(std::cout, options.journal_benchmark_dir, options.seed);
+        g_JobSystem.Stop();
+        return 0;
+    }
+
+    if (options.snapshot_benchmark)
+    {
+        RunSnapshotBenchmark(std::cout, options.seed);
+        g_JobSystem.Stop();
+        return 0;
+    }
+
+    if (options.light_benchmark)
+    {
+        RunLightBenchmark(std::cout, options.seed);
+        g_JobSystem.Stop();
+        return 0;
+    }
+
+    if (options.lod_benchmark)
+    {
+        RunLodBenchmark(std::cout, options.seed);
+        g_JobSystem.Stop();
+        return 0;
+    }
+
+    // Um mundo salvo é aberto com a mesma semente e as mesmas dimensões com
+    // que foi criado.
+    if (options.world_dir != NULL)
+    {
+        uint32_t saved_seed = options.seed;
+        WorldPoint saved_size(0, 0, 0);
+        if (ReadWorldInfo(options.world_dir, saved_seed, saved_size))
+        {
+            options.seed = saved_seed;
+            options.world_size[0] = saved_size.x;
+            options.world_size[1] = saved_size.y;
+            options.world_size[2] = saved_size.z;
+        }
+    }
+
+    // O mundo começa vazio; o ChunkStreamer gera (ou relê) as colunas em
+    // volta da câmera e descarrega as distantes. As colunas em volta do
+    // centro do mundo são carregadas antes de a janela ser criada, e a
+    // câmera começa sobre o terreno.
+    TerrainGenerator terrain_generator(options.seed);
+    ChunkStreamer chunk_streamer(terrain_generator);
+    {
+        ProfileScope scope("terrain");
+
+        g_WorldBlockMatrix = WorldBlockMatrix(options.world_size[0] > 0 ? options.world_size[0] : TERRAIN_DEFAULT_SIZE_X,
+                                              options.world_size[1] > 0 ? options.world_size[1] : TERRAIN_DEFAULT_SIZE_Y,
+                                              options.world_size[2] > 0 ? options.world_size[2] : TERRAIN_DEFAULT_SIZE_Z,
+                                              false);
+        if (!chunk_streamer.Init(g_WorldBlockMatrix, options.stream_radius, (size_t)options.stream_budget_mb * 1024 * 1024, options.world_dir)
+            || (options.world_dir != NULL && !WriteWorldInfo(options.world_dir, options.seed, g_WorldBlockMatrix.Size())))
+        {
+            std::exit(EXIT_FAILURE);
+        }
+
+        // Alterações que não chegaram aos arquivos de região na execução
+        // anterior são aplicadas quando as suas colunas são carregadas.
+        if (options.world_dir != NULL)
+        {
+            std::vector<JournalEntry> recovered;
+            if (!g_EditJournal.Open(options.world_dir, recovered))
+                std::exit(EXIT_FAILURE);
+            chunk_streamer.AddRecoveredEdits(recovered);
+        }
+
+        // A cópia do mundo da thread de renderização é feita depois, e já
+        // inclui estes chunks.
+        WorldPoint size = g_WorldBlockMatrix.Size();
+        glm::vec4 spawn(size.x / 2.0f, 0.0f, size.z / 2.0f, 1.0f);
+        std::vector<ChunkLoad> loads;
+        std::vector<WorldPoint> unloads;
+        chunk_streamer.LoadAroundNow(spawn, loads, unloads);
+
+        spawn.y = g_WorldBlockMatrix.TopSolidY(size.x / 2, size.z / 2) + 2.0f;
+        g_Camera.SetCenterPoint(spawn);
+        if (options.view_distance > 0.0f)
+            g_Camera.SetViewDistance(options.view_distance);
+    }
+
+    // No modo de benchmark a câmera e as edições de blocos vêm do roteiro, e
+    // o tempo de jogo avança um passo fixo por quadro.
+    bool benchmark_mode = options.benchmark_filename != NULL;
+    BenchmarkScript benchmark_script;
+    BenchmarkStats benchmark_stats;
+    if (benchmark_mode && !benchmark_script.Load(options.benchmark_filename))
+    {
+        std::exit(EXIT_FAILURE);
+    }
+
+    // Na reprodução os eventos de entrada e o tempo de jogo de cada quadro
+    // vêm do log gravado com --record.
+    bool replay_mode = options.replay_filename != NULL;
+    InputReplayer input_replayer;
+    if (replay_mode && !input_replayer.Open(options.replay_filename))
+    {
+        std::exit(EXIT_FAILURE);
+    }
+
+    if (options.record_filename != NULL && !g_InputRecorder.Open(options.record_filename))
+    {
+        std::exit(EXIT_FAILURE);
+    }
+
     int success = glfwInit();
     if (!success)
     {
@@ -86,7 +367,7 @@ int main(int argc, char const *argv[])
     // Definimos o callback para impressão de erros da GLFW no terminal
     glfwSetErrorCallback(ErrorCallback);
 
-    GLFWwindow *window = CreateGLFWWindow();
+    GLFWwindow *window = CreateGLFWWindow(!options.headless);
     if (!window)
     {
         glfwTerminate();
@@ -94,21 +375,288 @@ int main(int argc, char const *argv[])
         std::exit(EXIT_FAILURE);
     }
 
-    SetupInputCallbacks(window);
+    // No benchmark e na reprodução a entrada do usuário é ignorada, para que
+    // execuções diferentes sejam comparáveis.
+    if (!benchmark_mode && !replay_mode)
+        SetupInputCallbacks(window, g_InputRecorder.IsOpen());
+
+    SetupFramebufferSize(window);
+
+    CorrectCursorPos(window);
+
+    // A thread principal trata os eventos e executa a simulação; a thread de
+    // renderização é a única que usa o contexto OpenGL. Enquanto o quadro N
+    // é desenhado, o quadro N+1 já está sendo simulado.
+    FrameExchange frame_exchange;
+
+    RenderThreadContext render_context;
+    render_context.window = window;
+    render_context.options = &options;
+    render_context.exchange = &frame_exchange;
+    render_context.world = g_WorldBlockMatrix;
+    render_context.stats = (benchmark_mode || replay_mode) ? &benchmark_stats : NULL;
+
+    std::thread render_thread(RenderThread, &render_context);
+
+    Simulation simulation(options.tick_rate);
+    SaveState save_state;
+
+    double last_frame_start = glfwGetTime();
+    double last_autosave = last_frame_start;
+
+    // Tudo que foi salvo no início da compactação do diário: o diário antigo
+    // só é apagado depois que isso chega aos arquivos.
+    uint64_t compaction_mark = 0;
+
+    size_t frame_number = 0;
+    size_t benchmark_next_edit = 0;
+
+    while (!glfwWindowShouldClose(window))
+    {
+        ProfileScope frame_scope("simulation frame");
+
+        // Duração do quadro anterior, que a simulação vai consumir em passos
+        // de tamanho fixo.
+        double frame_start = glfwGetTime();
+        double frame_seconds = frame_start - last_frame_start;
+        last_frame_start = frame_start;
+
+        if (replay_mode)
+        {
+            frame_seconds = input_replayer.FrameSeconds(frame_number);
+        }
+
+        if (benchmark_mode)
+        {
+            frame_seconds = benchmark_script.timestep;
+
+            benchmark_script.ApplyCamera(frame_number, g_Camera);
+
+            std::vector<BenchmarkEdit> const &edits = benchmark_script.edits;
+            while (benchmark_next_edit < edits.size() && edits[benchmark_next_edit].frame <= frame_number)
+            {
+                BenchmarkEdit const &edit = edits[benchmark_next_edit++];
+                if (edit.kind == BenchmarkEdit::EDIT_BREAK)
+                    BreakBlock(edit.position);
+                else
+                    PlaceBlock(edit.position);
+            }
+        }
+
+        if (g_InputRecorder.IsOpen())
+        {
+            g_InputRecorder.RecordFrame(frame_number, frame_seconds);
+        }
+
+        {
+            ProfileScope cpu_scope("simulation");
+            simulation.Advance(frame_seconds, g_InputState, g_Camera);
+            g_SimulationTick = simulation.TotalTicks();
+        }
+
+        FrameSnapshot &frame = frame_exchange.WriteSlot();
+
+        // As alterações do quadro entram nas colunas a salvar antes de uma
+        // possível compactação, que apaga as suas entradas do diário.
+        for (size_t i = 0; i < g_PendingBlockEdits.size(); ++i)
+            chunk_streamer.MarkModified(g_PendingBlockEdits[i].position);
+
+        if (g_SaveStateRequested)
+        {
+            ProfileScope cpu_scope("save state");
+            save_state.valid = true;
+            save_state.world = g_WorldBlockMatrix;
+            save_state.camera = g_Camera;
+            save_state.simulation = simulation;
+            save_state.stones_in_inventory = g_StonesInInventory;
+            g_SaveStateRequested = false;
+        }
+
+        if (g_RestoreStateRequested && save_state.valid)
+        {
+            ProfileScope cpu_scope("restore state");
+
+            // Entradas do diário posteriores à restauração não podem ficar
+            // para depois da gravação dos blocos restaurados.
+            if (g_EditJournal.IsCompacting())
+            {
+                chunk_streamer.FlushSaves();
+                if (chunk_streamer.SavesWritten(compaction_mark))
+                    g_EditJournal.EndCompaction();
+            }
+
+            chunk_streamer.Restore(save_state.world, frame.chunk_loads);
+            g_Camera = save_state.camera;
+            g_Camera.OnScreenResize(g_FramebufferWidth, g_FramebufferHeight);
+            simulation = save_state.simulation;
+            g_SimulationTick = simulation.TotalTicks();
+            g_StonesInInventory = save_state.stones_in_inventory;
+
+            // As entradas do diário anteriores à restauração são
+            // substituídas pelos blocos restaurados.
+            g_EditJournal.BeginCompaction(chunk_streamer.UnappliedEdits());
+            chunk_streamer.SaveModified();
+            compaction_mark = chunk_streamer.SaveMark();
+            last_autosave = frame_start;
+        }
+        g_RestoreStateRequested = false;
+
+        // As colunas alteradas são salvas de tempos em tempos, ou quando o
+        // diário cresce; os arquivos são gravados em segundo plano. O diário
+        // antigo é apagado depois que as regiões foram gravadas; enquanto uma
+        // gravação falhar, ele continua lá.
+        if (g_EditJournal.IsCompacting())
+        {
+            if (chunk_streamer.SavesWritten(compaction_mark))
+                g_EditJournal.EndCompaction();
+        }
+        else if (g_EditJournal.NumEntries() >= JOURNAL_COMPACT_ENTRIES
+                 || frame_start - last_autosave >= WORLD_AUTOSAVE_SECONDS)
+        {
+            ProfileScope cpu_scope("autosave");
+            if (g_EditJournal.NumEntries() > 0)
+                g_EditJournal.BeginCompaction(chunk_streamer.UnappliedEdits());
+            chunk_streamer.SaveModified();
+            compaction_mark = chunk_streamer.SaveMark();
+            last_autosave = frame_start;
+        }
+
+        {
+            ProfileScope cpu_scope("chunk streaming");
+            chunk_streamer.Update(g_Camera.CenterPoint(), frame.chunk_loads, frame.chunk_unloads);
+            frame.streaming = chunk_streamer.Stats();
+        }
+
+        // Montamos o quadro que será desenhado pela thread de renderização.
+        {
+            ProfileScope cpu_scope("build frame");
+
+            frame.frame_number = frame_number;
+
+            // A câmera usada para desenhar fica entre os dois últimos passos da
+            // simulação, para que o movimento seja suave com qualquer taxa de
+            // quadros.
+            frame.camera = g_Camera;
+            frame.camera.SetCenterPoint(simulation.InterpolatedCameraPosition());
+
+            double cow_speed = 0.1f;
+
+            glm::vec3 cow_xz = CowPosition(simulation.InterpolatedTime() * cow_speed);
+            // A vaca anda sobre o terreno, na coluna de blocos em que está.
+            WorldPoint world_size = g_WorldBlockMatrix.Size();
+            size_t cow_column_x = std::min<size_t>(std::max(0.0f, roundf(cow_xz.x)), world_size.x - 1);
+            size_t cow_column_z = std::min<size_t>(std::max(0.0f, roundf(cow_xz.y)), world_size.z - 1);
+            int cow_ground = g_WorldBlockMatrix.TopSolidY(cow_column_x, cow_column_z);
+            frame.cow_position = glm::vec4(cow_xz.x, cow_ground + 1.5f, cow_xz.y, 1.0f);
+
+            frame.stones_in_inventory = g_StonesInInventory;
+            frame.show_info_text = g_ShowInfoText;
+
+            frame.framebuffer_width = g_FramebufferWidth;
+            frame.framebuffer_height = g_FramebufferHeight;
+            frame.window_width = g_WindowWidth;
+            frame.window_height = g_WindowHeight;
+
+            frame.block_edits.swap(g_PendingBlockEdits);
+
+            frame.input_us = g_PendingInputUs;
+            g_PendingInputUs = -1.0;
+        }
+
+        {
+            ProfileScope cpu_scope("wait for render");
+            frame_exchange.Publish();
+        }
+
+        // Verificamos com o sistema operacional se houve alguma interação do
+        // usuário (teclado, mouse, ...). Caso positivo, as funções de callback
+        // definidas anteriormente usando glfwSet*Callback() serão chamadas
+        // pela biblioteca GLFW.
+        {
+            ProfileScope cpu_scope("poll events");
+            glfwPollEvents();
+
+            // Na reprodução, os eventos gravados durante este quadro são
+            // entregues no mesmo ponto em que a GLFW os entregaria.
+            InputEvent event;
+            while (replay_mode && input_replayer.NextEvent(frame_number, event))
+                ReplayInputEvent(window, event);
+        }
+
+        frame_number++;
+        if (benchmark_mode && frame_number >= benchmark_script.num_frames)
+            break;
+        if (replay_mode && frame_number >= input_replayer.NumFrames())
+            break;
+    }
+
+    // A thread de renderização desenha os quadros já publicados e termina.
+    frame_exchange.Close();
+    render_thread.join();
+
+    if (benchmark_mode || replay_mode)
+    {
+        benchmark_stats.PrintCsv(std::cout);
+    }
+
+    g_InputRecorder.Close();
+
+    // As cargas em andamento escrevem na lista de chunks prontos do
+    // ChunkStreamer; ela deve estar definida antes de as edições serem
+    // marcadas como modificadas e de o diário ser compactado.
+    chunk_streamer.WaitForLoads();
+    g_JobSystem.Stop();
+
+    for (size_t i = 0; i < g_PendingBlockEdits.size(); ++i)
+        chunk_streamer.MarkModified(g_PendingBlockEdits[i].position);
+    g_EditJournal.BeginCompaction(chunk_streamer.UnappliedEdits());
+    chunk_streamer.SaveModified();
+    compaction_mark = chunk_streamer.SaveMark();
+    chunk_streamer.FlushSaves();
+    if (chunk_streamer.SavesWritten(compaction_mark))
+        g_EditJournal.EndCompaction();
+    else
+        std::cerr << "ERROR: Some regions were not written; the journal was kept for the next run." << std::endl;
+    g_EditJournal.Close();
+
+    if (options.trace_filename != NULL)
+    {
+        g_Profiler.WriteChromeTrace(options.trace_filename);
+    }
+
+    // Finalizamos o uso dos recursos do sistema operacional
+    glfwTerminate();
+    return 0;
+}
+
+// Laço da thread de renderização: cria todos os recursos OpenGL e desenha
+// cada quadro publicado pela thread principal.
+void RenderThread(RenderThreadContext *context)
+{
+    GLFWwindow *window = context->window;
+    CommandLineOptions const &options = *context->options;
 
     // Indicamos que as chamadas OpenGL deverão renderizar nesta janela
     glfwMakeContextCurrent(window);
 
+    // No benchmark e na reprodução não esperamos pela sincronia vertical.
+    if (options.benchmark_filename != NULL || options.replay_filename != NULL)
+        glfwSwapInterval(0);
+
     // Carregamento de todas funções definidas por OpenGL 3.3, utilizando a
     // biblioteca GLAD.
     gladLoadGLLoader((GLADloadproc)glfwGetProcAddress);
 
-    SetupFramebufferSize(window);
+    // No modo sem janela todo o quadro é renderizado em um framebuffer fora
+    // da tela, com o mesmo tamanho da janela.
+    OffscreenTarget offscreen_target;
+    if (options.headless && !offscreen_target.Create(800, 600))
+    {
+        std::exit(EXIT_FAILURE);
+    }
 
     PrintGlInfo();
 
-    CorrectCursorPos(window);
-
     // Carregamos os shaders de vértices e de fragmentos que serão utilizados
     // para renderização. Veja slides 176-196 do documento Aula_03_Rendering_Pipeline_Grafico.pdf.
     //
@@ -152,77 +700,185 @@ int main(int argc, char const *argv[])
     GLint selected_texture_uniform = glGetUniformLocation(program_id, "selected_texture");
     GLint bbox_min_uniform = glGetUniformLocation(program_id, "bbox_min");
     GLint bbox_max_uniform = glGetUniformLocation(program_id, "bbox_max");
+    GLint sun_direction_uniform = glGetUniformLocation(program_id, "sun_direction");
 
     // Habilitamos o Z-buffer. Veja slides 104-116 do documento Aula_09_Projecoes.pdf.2
     glEnable(GL_DEPTH_TEST);
 
+    // Anel por onde passam os vértices do texto e as malhas enviadas à GPU.
+    g_StreamBuffer.Init();
+
     VirtualScene virtual_scene;
 
     TextRendering_Init();
+    SetupHud();
+    g_Profiler.Init();
+
+    // As malhas do mundo são construídas pelas trabalhadoras do JobSystem e
+    // enviadas à GPU aos poucos, a cada quadro.
+    ChunkRenderer chunk_renderer;
+    chunk_renderer.SetLodEnabled(!context->options->no_lod);
+    chunk_renderer.Init(context->world);
+
+    // A luz da cópia do mundo é atualizada a cada edição e gravada nas malhas.
+    LightEngine light_engine;
+    light_engine.Init(context->world);
+    std::vector<WorldPoint> lit_chunks;
+
+    // Sombras do sol, desenhadas a partir das mesmas malhas dos chunks.
+    CascadedShadowMap shadow_map;
+    if (!shadow_map.Init())
+    {
+        std::exit(EXIT_FAILURE);
+    }
 
-    double cow_time_start = glfwGetTime();
+    // Tamanhos aplicados ao viewport e ao layout do texto.
+    int viewport_width = 0;
+    int viewport_height = 0;
+    int text_window_width = 0;
+    int text_window_height = 0;
 
-    while (!glfwWindowShouldClose(window))
+    FrameSnapshot const *frame;
+    while (context->exchange->Acquire(frame))
     {
-        // Aqui executamos as operações de renderização
+        g_Profiler.BeginFrame();
+
+        if (options.headless)
+            offscreen_target.Bind();
+
+        if (frame->framebuffer_width != viewport_width || frame->framebuffer_height != viewport_height)
+        {
+            // Indicamos que queremos renderizar em toda região do framebuffer. A
+            // função "glViewport" define o mapeamento das "normalized device
+            // coordinates" (NDC) para "pixel coordinates".  Essa é a operação de
+            // "Screen Mapping" ou "Viewport Mapping" vista em aula ({+ViewportMapping2+}).
+            viewport_width = frame->framebuffer_width;
+            viewport_height = frame->framebuffer_height;
+            glViewport(0, 0, viewport_width, viewport_height);
+        }
+
+        if (frame->window_width != text_window_width || frame->window_height != text_window_height)
+        {
+            text_window_width = frame->window_width;
+            text_window_height = frame->window_height;
+            TextRendering_OnWindowResize(text_window_width, text_window_height);
+        }
+
+        {
+            ProfileScope cpu_scope("apply block edits");
+            for (size_t i = 0; i < frame->block_edits.size(); ++i)
+            {
+                context->world[frame->block_edits[i].position] = frame->block_edits[i].block;
+                chunk_renderer.MarkBlockDirty(frame->block_edits[i].position);
+                light_engine.BlockChanged(frame->block_edits[i].position);
+            }
+        }
+
+        {
+            ProfileScope cpu_scope("apply chunk streaming");
+            for (size_t i = 0; i < frame->chunk_loads.size(); ++i)
+            {
+                ChunkLoad const &load = frame->chunk_loads[i];
+
+                // Um chunk que já estava carregado (ex: restauração de um estado
+                // salvo) só ilumina de novo os blocos que mudaram.
+                std::shared_ptr<const WorldChunk> previous = context->world.SharedChunk(load.chunk_x, load.chunk_y, load.chunk_z);
+                context->world.LoadChunk(load.chunk_x, load.chunk_y, load.chunk_z, *load.data);
+                chunk_renderer.OnChunkLoaded(load.chunk_x, load.chunk_y, load.chunk_z);
+                if (previous)
+                    light_engine.ChunkReplaced(load.chunk_x, load.chunk_y, load.chunk_z, *previous);
+                else
+                    light_engine.ChunkLoaded(load.chunk_x, load.chunk_y, load.chunk_z);
+            }
+            for (size_t i = 0; i < frame->chunk_unloads.size(); ++i)
+            {
+                WorldPoint const &chunk = frame->chunk_unloads[i];
+                context->world.UnloadChunk(chunk.x, chunk.y, chunk.z);
+                chunk_renderer.OnChunkUnloaded(chunk.x, chunk.y, chunk.z);
+                light_engine.ChunkUnloaded(chunk.x, chunk.y, chunk.z);
+            }
+        }
 
-        // Definimos a cor do "fundo" do framebuffer como branco.  Tal cor é
-        // definida como coeficientes RGBA: Red, Green, Blue, Alpha; isto é:
-        // Vermelho, Verde, Azul, Alpha (valor de transparência).
-        // Conversaremos sobre sistemas de cores nas aulas de Modelos de Iluminação.
-        //
-        //           R     G     B     A
-        glClearColor(1.0f, 1.0f, 1.0f, 1.0f);
+        {
+            ProfileScope cpu_scope("lighting");
+            light_engine.Update();
+            light_engine.TakeChangedChunks(lit_chunks);
+            for (size_t i = 0; i < lit_chunks.size(); ++i)
+                chunk_renderer.MarkChunkDirty(lit_chunks[i].x, lit_chunks[i].y, lit_chunks[i].z);
+        }
 
-        // "Pintamos" todos os pixels do framebuffer com a cor definida acima,
-        // e também resetamos todos os pixels do Z-buffer (depth buffer).
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        {
+            ProfileScope cpu_scope("chunk meshing");
+            chunk_renderer.Update(context->world, &light_engine, frame->camera.CenterPoint());
+            chunk_renderer.Upload(CHUNK_UPLOAD_BUDGET_BYTES);
+        }
 
-        // Pedimos para a GPU utilizar o programa de GPU criado acima (contendo
-        // os shaders de vértice e fragmentos).
-        glUseProgram(program_id);
+        // Aqui executamos as operações de renderização
 
         glm::mat4 model = Matrix_Identity();
-        glm::mat4 view = g_Camera.ViewMatrix();
-        glm::mat4 projection = g_Camera.ProjectionMatrix();
+        glm::mat4 view = frame->camera.ViewMatrix();
+        glm::mat4 projection = frame->camera.ProjectionMatrix();
+        glm::vec4 sun_direction = SHADOW_SUN_DIRECTION;
 
-        glUniformMatrix4fv(view_uniform, 1, GL_FALSE, glm::value_ptr(view));
-        glUniformMatrix4fv(projection_uniform, 1, GL_FALSE, glm::value_ptr(projection));
+        {
+            ProfileScope cpu_scope("shadow pass");
+            GpuProfileScope gpu_scope("shadow pass");
+            shadow_map.Fit(view, projection, sun_direction);
+            shadow_map.Render(chunk_renderer);
+        }
 
-        // Renderiza os blocos do chao
-        glUniform1i(object_id_uniform, OBJ_BLOCK);
+        {
+            ProfileScope cpu_scope("occlusion culling");
+            chunk_renderer.Cull(projection * view, frame->camera.CenterPoint());
+        }
 
-        for (size_t x = 0; x < WORLD_SIZE_X; x++)
         {
-            for (size_t y = 0; y < WORLD_SIZE_Y; y++)
-            {
-                for (size_t z = 0; z < WORLD_SIZE_Z; z++)
-                {
-                    if (g_WorldBlockMatrix[WorldPoint(x, y, z)] == BLOCK_STONE)
-                    {
-                        glUniform1i(selected_texture_uniform, stone_texture_id);
-                        model = Matrix_Translate(x, y, z);
-                        glUniformMatrix4fv(model_uniform, 1, GL_FALSE, glm::value_ptr(model));
-                        virtual_scene["block"].Draw(bbox_min_uniform, bbox_max_uniform);
-                    }
-                }
-            }
+            ProfileScope cpu_scope("world render");
+            GpuProfileScope gpu_scope("world render");
+
+            // Definimos a cor do "fundo" do framebuffer como branco.  Tal cor é
+            // definida como coeficientes RGBA: Red, Green, Blue, Alpha; isto é:
+            // Vermelho, Verde, Azul, Alpha (valor de transparência).
+            // Conversaremos sobre sistemas de cores nas aulas de Modelos de Iluminação.
+            //
+            //           R     G     B     A
+            glClearColor(1.0f, 1.0f, 1.0f, 1.0f);
+
+            // "Pintamos" todos os pixels do framebuffer com a cor definida acima,
+            // e também resetamos todos os pixels do Z-buffer (depth buffer).
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+            // Pedimos para a GPU utilizar o programa de GPU criado acima (contendo
+            // os shaders de vértice e fragmentos).
+            glUseProgram(program_id);
+
+            glUniformMatrix4fv(view_uniform, 1, GL_FALSE, glm::value_ptr(view));
+            glUniformMatrix4fv(projection_uniform, 1, GL_FALSE, glm::value_ptr(projection));
+            glUniform4fv(sun_direction_uniform, 1, glm::value_ptr(sun_direction));
+            shadow_map.Bind(program_id);
+
+            // Renderiza os blocos do chao, uma malha por chunk
+            glUniform1i(object_id_uniform, OBJ_CHUNK);
+            glUniform1i(selected_texture_uniform, stone_texture_id);
+            chunk_renderer.Draw(model_uniform);
         }
 
-        double cow_time_curr = glfwGetTime();
-        double cow_speed = 0.1f;
+        {
+            ProfileScope cpu_scope("cow render");
+            GpuProfileScope gpu_scope("cow render");
 
-        glm::vec3 cow_xz = CowPosition((cow_time_curr - cow_time_start) * cow_speed);
-        glm::vec4 cow_pos = glm::vec4(cow_xz.x, WORLD_SIZE_Y / 2.0f + 0.5f, cow_xz.y, 1.0f);
+            // Desenhar vaca
+            glUniform1i(object_id_uniform, OBJ_COW);
+            glUniform1i(selected_texture_uniform, cow_texture_id);
 
-        // Desenhar vaca
-        glUniform1i(object_id_uniform, OBJ_COW);
-        glUniform1i(selected_texture_uniform, cow_texture_id);
+            model = Matrix_Translate(frame->cow_position.x, frame->cow_position.y, frame->cow_position.z);
 
-        model = Matrix_Translate(cow_pos.x, cow_pos.y, cow_pos.z);
+            glUniformMatrix4fv(model_uniform, 1, GL_FALSE, glm::value_ptr(model));
 
-        glUniformMatrix4fv(model_uniform, 1, GL_FALSE, glm::value_ptr(model));
-        virtual_scene["cow"].Draw(bbox_min_uniform, bbox_max_uniform);
+            // Vacas distantes são desenhadas com menos triângulos.
+            SceneObject const &cow = virtual_scene["cow"];
+            cow.Draw(bbox_min_uniform, bbox_max_uniform, cow.SelectLod(model, view, projection, viewport_height));
+        }
 
         /*
         glUniform1i(object_id_uniform, OBJ_EYE);
@@ -232,9 +888,33 @@ int main(int argc, char const *argv[])
         virtual_scene["eye"].Draw(bbox_min_uniform, bbox_max_uniform);
         */
 
-        TextRendering_ShowFramesPerSecond(window);
-        TextRendering_ShowCameraPosition(window);
-        TextRendering_ShowInventory(window);
+        {
+            ProfileScope cpu_scope("hud");
+            GpuProfileScope gpu_scope("hud");
+
+            UpdateHudFramesPerSecond();
+            UpdateHudCameraPosition(frame->camera.CenterPoint());
+            UpdateHudInventory(frame->stones_in_inventory);
+            UpdateHudChunks(chunk_renderer);
+            UpdateHudStreaming(frame->streaming);
+            UpdateHudCulling(chunk_renderer.CullingStats());
+            UpdateHudGpuMemory(g_GpuMemory.Stats());
+            UpdateHudStreamBuffer(g_StreamBuffer);
+
+            if (frame->show_info_text)
+            {
+                g_Hud.Draw();
+                g_Profiler.DrawGraph();
+            }
+        }
+
+        if (options.dump_frames_dir != NULL && frame->frame_number % options.dump_every == 0)
+        {
+            ProfileScope cpu_scope("dump frame");
+            char filename[512];
+            snprintf(filename, sizeof(filename), "%s/frame_%05u.png", options.dump_frames_dir, (unsigned)frame->frame_number);
+            offscreen_target.SaveToPng(filename);
+        }
 
         // O framebuffer onde OpenGL executa as operações de renderização não
         // é o mesmo que está sendo mostrado para o usuário, caso contrário
@@ -242,18 +922,242 @@ int main(int argc, char const *argv[])
         // chamada abaixo faz a troca dos buffers, mostrando para o usuário
         // tudo que foi renderizado pelas funções acima.
         // Veja o link: https://en.wikipedia.org/w/index.php?title=Multiple_buffering&oldid=793452829#Double_buffering_in_computer_graphics
-        glfwSwapBuffers(window);
+        {
+            ProfileScope cpu_scope("swap");
+            // Sem janela visível não há troca de buffers; esperamos a GPU
+            // terminar o quadro para que o tempo medido inclua a renderização.
+            if (options.headless)
+                glFinish();
+            else
+                glfwSwapBuffers(window);
+        }
 
-        // Verificamos com o sistema operacional se houve alguma interação do
-        // usuário (teclado, mouse, ...). Caso positivo, as funções de callback
-        // definidas anteriormente usando glfwSet*Callback() serão chamadas
-        // pela biblioteca GLFW.
-        glfwPollEvents();
+        // Intervalos de g_GpuMemory liberados neste quadro ficam esperando a
+        // GPU; os dos quadros já terminados voltam às arenas.
+        g_GpuMemory.EndFrame();
+        g_StreamBuffer.EndFrame();
+
+        // Latência de entrada: do callback que recebeu o evento até a troca
+        // de buffers do primeiro quadro que o reflete.
+        if (frame->input_us >= 0.0)
+        {
+            double presented_us = g_Profiler.NowMicroseconds();
+            g_Profiler.RecordInputLatency(frame->input_us, presented_us);
+            if (context->stats != NULL)
+                context->stats->AddInputLatency((presented_us - frame->input_us) / 1000.0);
+        }
+
+        g_Profiler.EndFrame();
+
+        if (context->stats != NULL)
+        {
+            context->stats->AddFrame(g_Profiler.LastFrameMs(), g_Profiler.LastFrameDrawCalls(), g_Profiler.LastFrameTriangles());
+        }
     }
 
-    // Finalizamos o uso dos recursos do sistema operacional
-    glfwTerminate();
-    return 0;
+    glfwMakeContextCurrent(NULL);
+}
+
+bool ParseCommandLine(int argc, char const *argv[], CommandLineOptions &options)
+{
+    options.trace_filename = NULL;
+    options.benchmark_filename = NULL;
+    options.record_filename = NULL;
+    options.replay_filename = NULL;
+    options.headless = false;
+    options.dump_frames_dir = NULL;
+    options.dump_every = 1;
+    options.tick_rate = SIMULATION_DEFAULT_TICK_RATE;
+    options.jobs = 0;
+    options.jobs_benchmark = false;
+    options.seed = TERRAIN_DEFAULT_SEED;
+    options.world_size[0] = options.world_size[1] = options.world_size[2] = 0;
+    options.terrain_benchmark = false;
+    options.stream_radius = STREAMING_DEFAULT_RADIUS;
+    options.stream_budget_mb = STREAMING_DEFAULT_BUDGET_MB;
+    options.world_dir = NULL;
+    options.region_benchmark_dir = NULL;
+    options.journal_benchmark_dir = NULL;
+    options.snapshot_benchmark = false;
+    options.light_benchmark = false;
+    options.lod_benchmark = false;
+    options.no_lod = false;
+    options.view_distance = 0.0f;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+
+        if (arg == "--trace" && i + 1 < argc)
+        {
+            options.trace_filename = argv[++i];
+        }
+        else if (arg == "--benchmark" && i + 1 < argc)
+        {
+            options.benchmark_filename = argv[++i];
+        }
+        else if (arg == "--record" && i + 1 < argc)
+        {
+            options.record_filename = argv[++i];
+        }
+        else if (arg == "--replay" && i + 1 < argc)
+        {
+            options.replay_filename = argv[++i];
+        }
+        else if (arg == "--headless")
+        {
+            options.headless = true;
+        }
+        else if (arg == "--dump-frames" && i + 1 < argc)
+        {
+            options.dump_frames_dir = argv[++i];
+        }
+        else if (arg == "--dump-every" && i + 1 < argc)
+        {
+            options.dump_every = atoi(argv[++i]);
+        }
+        else if (arg == "--tick-rate" && i + 1 < argc)
+        {
+            options.tick_rate = atof(argv[++i]);
+        }
+        else if (arg == "--jobs" && i + 1 < argc)
+        {
+            options.jobs = atoi(argv[++i]);
+        }
+        else if (arg == "--jobs-benchmark")
+        {
+            options.jobs_benchmark = true;
+        }
+        else if (arg == "--seed" && i + 1 < argc)
+        {
+            options.seed = strtoul(argv[++i], NULL, 10);
+        }
+        else if (arg == "--world-size" && i + 3 < argc)
+        {
+            options.world_size[0] = atoi(argv[++i]);
+            options.world_size[1] = atoi(argv[++i]);
+            options.world_size[2] = atoi(argv[++i]);
+        }
+        else if (arg == "--terrain-benchmark")
+        {
+            options.terrain_benchmark = true;
+        }
+        else if (arg == "--stream-radius" && i + 1 < argc)
+        {
+            options.stream_radius = atoi(argv[++i]);
+        }
+        else if (arg == "--stream-budget" && i + 1 < argc)
+        {
+            options.stream_budget_mb = atoi(argv[++i]);
+        }
+        else if (arg == "--world-dir" && i + 1 < argc)
+        {
+            options.world_dir = argv[++i];
+        }
+        else if (arg == "--region-benchmark" && i + 1 < argc)
+        {
+            options.region_benchmark_dir = argv[++i];
+        }
+        else if (arg == "--journal-benchmark" && i + 1 < argc)
+        {
+            options.journal_benchmark_dir = argv[++i];
+        }
+        else if (arg == "--snapshot-benchmark")
+        {
+            options.snapshot_benchmark = true;
+        }
+        else if (arg == "--light-benchmark")
+        {
+            options.light_benchmark = true;
+        }
+        else if (arg == "--lod-benchmark")
+        {
+            options.lod_benchmark = true;
+        }
+        else if (arg == "--no-lod")
+        {
+            options.no_lod = true;
+        }
+        else if (arg == "--view-distance" && i + 1 < argc)
+        {
+            options.view_distance = atof(argv[++i]);
+        }
+        else
+        {
+            std::cerr << "ERROR: Unknown or incomplete option \"" << arg << "\"." << std::endl;
+            std::cerr << "Usage: " << argv[0] << " [--trace <file.json>] [--benchmark <script> | --replay <log>] [--record <log>]"
+                      << " [--headless [--dump-frames <dir>] [--dump-every <N>]] [--tick-rate <Hz>]"
+                      << " [--jobs <N>] [--jobs-benchmark] [--seed <n>] [--world-size <x> <y> <z>] [--terrain-benchmark]"
+                      << " [--stream-radius <chunks>] [--stream-budget <MiB>] [--world-dir <dir>] [--region-benchmark <dir>]"
+                      << " [--journal-benchmark <dir>] [--snapshot-benchmark] [--light-benchmark] [--lod-benchmark]"
+                      << " [--no-lod] [--view-distance <blocks>]" << std::endl;
+            return false;
+        }
+    }
+
+    if (options.benchmark_filename != NULL && options.replay_filename != NULL)
+    {
+        std::cerr << "ERROR: --benchmark and --replay cannot be used together." << std::endl;
+        return false;
+    }
+
+    // Sem janela não há como o usuário encerrar o programa; o roteiro ou o
+    // log determinam quando parar.
+    if (options.headless && options.benchmark_filename == NULL && options.replay_filename == NULL)
+    {
+        std::cerr << "ERROR: --headless requires --benchmark or --replay." << std::endl;
+        return false;
+    }
+
+    if (options.dump_frames_dir != NULL && !options.headless)
+    {
+        std::cerr << "ERROR: --dump-frames requires --headless." << std::endl;
+        return false;
+    }
+
+    if (options.tick_rate <= 0.0)
+    {
+        std::cerr << "ERROR: --tick-rate must be positive." << std::endl;
+        return false;
+    }
+
+    if (options.dump_every < 1)
+    {
+        std::cerr << "ERROR: --dump-every must be at least 1." << std::endl;
+        return false;
+    }
+
+    if (options.jobs < 0)
+    {
+        std::cerr << "ERROR: --jobs cannot be negative." << std::endl;
+        return false;
+    }
+
+    if (options.stream_radius < 1)
+    {
+        std::cerr << "ERROR: --stream-radius must be at least 1." << std::endl;
+        return false;
+    }
+
+    if (options.stream_budget_mb < 1)
+    {
+        std::cerr << "ERROR: --stream-budget must be at least 1." << std::endl;
+        return false;
+    }
+
+    if (options.view_distance < 0.0f)
+    {
+        std::cerr << "ERROR: --view-distance cannot be negative." << std::endl;
+        return false;
+    }
+
+    if (options.world_size[0] < 0 || options.world_size[1] < 0 || options.world_size[2] < 0)
+    {
+        std::cerr << "ERROR: --world-size cannot be negative." << std::endl;
+        return false;
+    }
+
+    return true;
 }
 
 // Definimos o callback para impressão de erros da GLFW no terminal
@@ -265,6 +1169,8 @@ void ErrorCallback(int error, const char *description)
 // Função callback chamada sempre que o usuário aperta algum dos botões do mouse
 void MouseButtonCallback(GLFWwindow *window, int button, int action, int mods)
 {
+    NoteInputEvent();
+
     if (button == GLFW_MOUSE_BUTTON_LEFT && action == GLFW_RELEASE)
     {
         // Quando o usuário soltar o botão esquerdo do mouse, atualizamos a
@@ -277,11 +1183,7 @@ void MouseButtonCallback(GLFWwindow *window, int button, int action, int mods)
             PrintVector(point);
             std::cout << output.axis << std::endl;
             std::cout << output.sign << std::endl;
-            g_WorldBlockMatrix[WorldPoint(output.block_position)] = BLOCK_AIR;
-            if (g_StonesInInventory < INVENTORY_MAX)
-            {
-                g_StonesInInventory++;
-            }
+            BreakBlock(output.block_position);
         }
     }
 
@@ -297,12 +1199,40 @@ void MouseButtonCallback(GLFWwindow *window, int button, int action, int mods)
             PrintVector(point);
             glm::vec3 position = output.block_position;
             position[output.axis] -= output.sign;
-            g_WorldBlockMatrix[WorldPoint(position)] = BLOCK_STONE;
-            g_StonesInInventory--;
+            PlaceBlock(position);
         }
     }
 }
 
+// Remove o bloco na posição dada, guardando a pedra no inventário.
+void BreakBlock(glm::vec3 position)
+{
+    if (!g_WorldBlockMatrix.IsPointInWorld(position))
+        return;
+
+    Block old_block = g_WorldBlockMatrix[WorldPoint(position)];
+    g_WorldBlockMatrix[WorldPoint(position)] = BLOCK_AIR;
+    g_EditJournal.Append(WorldPoint(position), old_block, BLOCK_AIR, g_SimulationTick);
+    g_PendingBlockEdits.push_back(BlockEdit(WorldPoint(position), BLOCK_AIR));
+    if (g_StonesInInventory < INVENTORY_MAX)
+    {
+        g_StonesInInventory++;
+    }
+}
+
+// Coloca uma pedra do inventário na posição dada, como o bloco escolhido.
+void PlaceBlock(glm::vec3 position)
+{
+    if (!g_WorldBlockMatrix.IsPointInWorld(position))
+        return;
+
+    Block old_block = g_WorldBlockMatrix[WorldPoint(position)];
+    g_WorldBlockMatrix[WorldPoint(position)] = g_PlacedBlock;
+    g_EditJournal.Append(WorldPoint(position), old_block, g_PlacedBlock, g_SimulationTick);
+    g_PendingBlockEdits.push_back(BlockEdit(WorldPoint(position), g_PlacedBlock));
+    g_StonesInInventory--;
+}
+
 // Função callback chamada sempre que o usuário movimentar o cursor do mouse em
 // cima da janela OpenGL.
 void CursorPosCallback(GLFWwindow *window, double xpos, double ypos)
@@ -313,8 +1243,14 @@ void CursorPosCallback(GLFWwindow *window, double xpos, double ypos)
     CorrectCursorPos(window, &window_center_x, &window_center_y);
 
     // Deslocamento do cursor do mouse em x e y de coordenadas de tela!
-    float dx = xpos - window_center_x;
-    float dy = ypos - window_center_y;
+    RotateCameraFromCursor(xpos - window_center_x, ypos - window_center_y);
+}
+
+void RotateCameraFromCursor(double dx, double dy)
+{
+    // CorrectCursorPos() também gera eventos, sem deslocamento.
+    if (dx != 0.0 || dy != 0.0)
+        NoteInputEvent();
 
     g_Camera.RotateViewTheta(dx);
     g_Camera.RotateViewPhi(dy);
@@ -343,6 +1279,7 @@ void CorrectCursorPos(GLFWwindow *window, int *out_window_center_x, int *out_win
 // Função callback chamada sempre que o usuário movimenta a "rodinha" do mouse.
 void ScrollCallback(GLFWwindow *window, double xoffset, double yoffset)
 {
+    NoteInputEvent();
     g_Camera.Zoom(yoffset);
 }
 
@@ -358,6 +1295,8 @@ void KeyCallback(GLFWwindow *window, int key, int scancode, int action, int mod)
             std::exit(100 + i);
     // ===============
 
+    NoteInputEvent();
+
     // Se o usuário pressionar a tecla ESC, fechamos a janela.
     if (key == GLFW_KEY_ESCAPE && action == GLFW_PRESS)
         glfwSetWindowShouldClose(window, GL_TRUE);
@@ -371,31 +1310,35 @@ void KeyCallback(GLFWwindow *window, int key, int scancode, int action, int mod)
     //   Se apertar tecla shift+Z então g_AngleZ -= delta;
 
     /******* Movimento da Câmera Para Frente/Trás/Lados *******/
-    if (action == GLFW_PRESS || action == GLFW_REPEAT)
+    // Aqui só registramos quais teclas estão pressionadas; o movimento é
+    // aplicado a cada passo da simulação, independente da repetição do teclado.
+    if (action == GLFW_PRESS || action == GLFW_RELEASE)
     {
+        bool pressed = action == GLFW_PRESS;
+
         if (key == GLFW_KEY_W)
         {
-            g_Camera.MoveForewards();
+            g_InputState.move_forward = pressed;
         }
         else if (key == GLFW_KEY_S)
         {
-            g_Camera.MoveBackwards();
+            g_InputState.move_backward = pressed;
         }
         else if (key == GLFW_KEY_A)
         {
-            g_Camera.MoveLeftwards();
+            g_InputState.move_left = pressed;
         }
         else if (key == GLFW_KEY_D)
         {
-            g_Camera.MoveRightwards();
+            g_InputState.move_right = pressed;
         }
         else if (key == GLFW_KEY_SPACE)
         {
-            g_Camera.MoveUpwards();
+            g_InputState.move_up = pressed;
         }
         else if (key == GLFW_KEY_F)
         {
-            g_Camera.MoveDownwards();
+            g_InputState.move_down = pressed;
         }
     }
 
@@ -411,6 +1354,23 @@ void KeyCallback(GLFWwindow *window, int key, int scancode, int action, int mod)
         g_Camera.SetProjectionType(Camera::ORTHOGRAPHIC_PROJ);
     }
 
+    // F5 salva o estado do jogo, e F9 volta a ele.
+    if (key == GLFW_KEY_F5 && action == GLFW_PRESS)
+    {
+        g_SaveStateRequested = true;
+    }
+
+    if (key == GLFW_KEY_F9 && action == GLFW_PRESS)
+    {
+        g_RestoreStateRequested = true;
+    }
+
+    // Se o usuário apertar a tecla L, alternamos o bloco colocado entre pedra e lâmpada.
+    if (key == GLFW_KEY_L && action == GLFW_PRESS)
+    {
+        g_PlacedBlock = g_PlacedBlock == BLOCK_LAMP ? BLOCK_STONE : BLOCK_LAMP;
+    }
+
     // Se o usuário apertar a tecla H, fazemos um "toggle" do texto informativo mostrado na tela.
     if (key == GLFW_KEY_H && action == GLFW_PRESS)
     {
@@ -423,11 +1383,11 @@ void KeyCallback(GLFWwindow *window, int key, int scancode, int action, int mod)
 // "framebuffer" (região de memória onde são armazenados os pixels da imagem).
 void FramebufferSizeCallback(GLFWwindow *window, int width, int height)
 {
-    // Indicamos que queremos renderizar em toda região do framebuffer. A
-    // função "glViewport" define o mapeamento das "normalized device
-    // coordinates" (NDC) para "pixel coordinates".  Essa é a operação de
-    // "Screen Mapping" ou "Viewport Mapping" vista em aula ({+ViewportMapping2+}).
-    glViewport(0, 0, width, height);
+    // Esta função executa na thread principal, que não tem o contexto
+    // OpenGL. O viewport é atualizado pela thread de renderização a partir do
+    // tamanho enviado em cada quadro.
+    g_FramebufferWidth = width;
+    g_FramebufferHeight = height;
 
     // Atualizamos também a razão que define a proporção da janela (largura /
     // altura), a qual será utilizada na definição das matrizes de projeção,
@@ -437,6 +1397,19 @@ void FramebufferSizeCallback(GLFWwindow *window, int width, int height)
     // O cast para float é necessário pois números inteiros são arredondados ao
     // serem divididos!
     g_Camera.OnScreenResize(width, height);
+
+    // O layout do texto usa o tamanho da janela (que pode diferir do tamanho
+    // do framebuffer em telas de alta densidade). Consultamos o sistema de
+    // janelas somente aqui, e não a cada caractere impresso.
+    glfwGetWindowSize(window, &g_WindowWidth, &g_WindowHeight);
+}
+
+// Guarda o instante do primeiro evento de entrada recebido desde o último
+// quadro montado, para medir a latência até a sua apresentação.
+void NoteInputEvent()
+{
+    if (g_PendingInputUs < 0.0)
+        g_PendingInputUs = g_Profiler.NowMicroseconds();
 }
 
 // Carrega um Vertex Shader de um arquivo. Veja definição de LoadShader() abaixo.
@@ -540,7 +1513,7 @@ void LoadShader(const char *filename, GLuint shader_id)
     delete[] log;
 }
 
-GLFWwindow *CreateGLFWWindow(void)
+GLFWwindow *CreateGLFWWindow(bool visible)
 {
     // Pedimos para utilizar OpenGL versão 3.3 (ou superior)
     glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
@@ -554,6 +1527,10 @@ GLFWwindow *CreateGLFWWindow(void)
     // funções modernas de OpenGL.
     glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
 
+    // No modo sem janela (--headless) a janela existe apenas para fornecer o
+    // contexto OpenGL, e nunca é mostrada.
+    glfwWindowHint(GLFW_VISIBLE, visible ? GLFW_TRUE : GLFW_FALSE);
+
     // Criamos uma janela do sistema operacional, com 800 colunas e 600 linhas
     // de pixels, e com título "INF01047 ...".
     GLFWwindow *window;
@@ -563,8 +1540,17 @@ GLFWwindow *CreateGLFWWindow(void)
     return window;
 }
 
-void SetupInputCallbacks(GLFWwindow *window)
+void SetupInputCallbacks(GLFWwindow *window, bool recording)
 {
+    if (recording)
+    {
+        glfwSetKeyCallback(window, RecordingKeyCallback);
+        glfwSetMouseButtonCallback(window, RecordingMouseButtonCallback);
+        glfwSetCursorPosCallback(window, RecordingCursorPosCallback);
+        glfwSetScrollCallback(window, RecordingScrollCallback);
+        return;
+    }
+
     // Definimos a função de callback que será chamada sempre que o usuário
     // pressionar alguma tecla do teclado ...
     glfwSetKeyCallback(window, KeyCallback);
@@ -576,6 +1562,56 @@ void SetupInputCallbacks(GLFWwindow *window)
     glfwSetScrollCallback(window, ScrollCallback);
 }
 
+void RecordingKeyCallback(GLFWwindow *window, int key, int scancode, int action, int mode)
+{
+    g_InputRecorder.RecordKey(key, scancode, action, mode);
+    KeyCallback(window, key, scancode, action, mode);
+}
+
+void RecordingMouseButtonCallback(GLFWwindow *window, int button, int action, int mods)
+{
+    g_InputRecorder.RecordMouseButton(button, action, mods);
+    MouseButtonCallback(window, button, action, mods);
+}
+
+void RecordingCursorPosCallback(GLFWwindow *window, double xpos, double ypos)
+{
+    // Guardamos também o centro da janela, para que a reprodução calcule o
+    // mesmo deslocamento mesmo com uma janela de outro tamanho.
+    int window_width, window_height;
+    glfwGetWindowSize(window, &window_width, &window_height);
+    g_InputRecorder.RecordCursorPos(xpos, ypos, window_width / 2, window_height / 2);
+    CursorPosCallback(window, xpos, ypos);
+}
+
+void RecordingScrollCallback(GLFWwindow *window, double xoffset, double yoffset)
+{
+    g_InputRecorder.RecordScroll(xoffset, yoffset);
+    ScrollCallback(window, xoffset, yoffset);
+}
+
+// Entrega um evento gravado ao mesmo tratamento dado pelos callbacks.
+void ReplayInputEvent(GLFWwindow *window, InputEvent const &event)
+{
+    switch (event.type)
+    {
+    case INPUT_EVENT_KEY:
+        KeyCallback(window, event.ints[0], event.ints[1], event.ints[2], event.ints[3]);
+        break;
+    case INPUT_EVENT_MOUSE_BUTTON:
+        MouseButtonCallback(window, event.ints[0], event.ints[1], event.ints[2]);
+        break;
+    case INPUT_EVENT_CURSOR_POS:
+        RotateCameraFromCursor(event.x - event.ints[0], event.y - event.ints[1]);
+        break;
+    case INPUT_EVENT_SCROLL:
+        ScrollCallback(window, event.x, event.y);
+        break;
+    default:
+        break;
+    }
+}
+
 void PrintGlInfo()
 {
     // Imprimimos no terminal informações sobre a GPU do sistema
@@ -664,19 +1700,40 @@ GLuint LoadTextureImage(char const *path, char const *name, GLuint program_id)
     return textureunit;
 }
 
-// Escrevemos na tela o número de quadros renderizados por segundo (frames per
-// second).
-void TextRendering_ShowFramesPerSecond(GLFWwindow *window)
+void SetupHud()
 {
-    if (!g_ShowInfoText)
-        return;
+    g_Hud.Init();
+
+    g_HudFpsLabel = g_Hud.AddLabel(HudLabel::ANCHOR_TOP_RIGHT, 1.0f, 1.0f);
+    g_HudCameraPositionLabel = g_Hud.AddLabel(HudLabel::ANCHOR_TOP_RIGHT, 1.0f, 1.25f * 2);
+    g_HudInventoryTitleLabel = g_Hud.AddLabel(HudLabel::ANCHOR_TOP_RIGHT, 1.0f, 1.25f * 4);
+    g_HudInventoryStonesLabel = g_Hud.AddLabel(HudLabel::ANCHOR_TOP_RIGHT, 1.0f, 1.25f * 5);
+
+    g_HudFrameTimeLabel = g_Hud.AddLabel(HudLabel::ANCHOR_TOP_RIGHT, 1.0f, 1.25f * 7);
+    g_HudInputLatencyLabel = g_Hud.AddLabel(HudLabel::ANCHOR_TOP_RIGHT, 1.0f, 1.25f * 8);
+
+    g_HudChunksLabel = g_Hud.AddLabel(HudLabel::ANCHOR_TOP_RIGHT, 1.0f, 1.25f * 9);
+    g_HudStreamingLabel = g_Hud.AddLabel(HudLabel::ANCHOR_TOP_RIGHT, 1.0f, 1.25f * 10);
+    g_HudCullingLabel = g_Hud.AddLabel(HudLabel::ANCHOR_TOP_RIGHT, 1.0f, 1.25f * 11);
+    g_HudGpuMemoryLabel = g_Hud.AddLabel(HudLabel::ANCHOR_TOP_RIGHT, 1.0f, 1.25f * 12);
+    g_HudStreamBufferLabel = g_Hud.AddLabel(HudLabel::ANCHOR_TOP_RIGHT, 1.0f, 1.25f * 13);
 
+    g_HudJobsLabel = g_Hud.AddLabel(HudLabel::ANCHOR_TOP_RIGHT, 1.0f, 1.25f * 14);
+    for (size_t i = 0; i < HUD_MAX_JOB_WORKERS; ++i)
+        g_HudJobWorkerLabels[i] = g_Hud.AddLabel(HudLabel::ANCHOR_TOP_RIGHT, 1.0f, 1.25f * (15 + i));
+
+    g_Hud.SetText(g_HudFpsLabel, "?? fps");
+    g_Hud.SetText(g_HudInventoryTitleLabel, "INVENTORY");
+}
+
+// Atualizamos o número de quadros renderizados por segundo (frames per
+// second). O texto só muda uma vez por segundo.
+void UpdateHudFramesPerSecond()
+{
     // Variáveis estáticas (static) mantém seus valores entre chamadas
     // subsequentes da função!
     static float old_seconds = (float)glfwGetTime();
     static int ellapsed_frames = 0;
-    static char buffer[20] = "?? fps";
-    static int numchars = 7;
 
     ellapsed_frames += 1;
 
@@ -688,54 +1745,219 @@ void TextRendering_ShowFramesPerSecond(GLFWwindow *window)
 
     if (ellapsed_seconds > 1.0f)
     {
-        numchars = snprintf(buffer, 20, "%.2f fps", ellapsed_frames / ellapsed_seconds);
+        char buffer[40];
+        snprintf(buffer, 40, "%.2f fps", ellapsed_frames / ellapsed_seconds);
+        g_Hud.SetText(g_HudFpsLabel, buffer);
+
+        char frame_time_buffer[64];
+        snprintf(frame_time_buffer, 64, "CPU %.2f ms  GPU %.2f ms  SHADOWS %.2f ms", g_Profiler.AverageCpuFrameMs(),
+                 g_Profiler.AverageGpuFrameMs(), g_Profiler.AverageGpuScopeMs("shadow pass"));
+        g_Hud.SetText(g_HudFrameTimeLabel, frame_time_buffer);
+
+        snprintf(buffer, 40, "INPUT LATENCY %.2f ms", g_Profiler.AverageInputLatencyMs());
+        g_Hud.SetText(g_HudInputLatencyLabel, buffer);
+
+        UpdateHudJobStats(ellapsed_seconds);
 
         old_seconds = seconds;
         ellapsed_frames = 0;
     }
+}
+
+void UpdateHudCameraPosition(glm::vec4 position)
+{
+    // Só formatamos o texto se a câmera se moveu.
+    static bool first_update = true;
+    static glm::vec4 last_position;
+
+    if (!first_update && position == last_position)
+        return;
+
+    first_update = false;
+    last_position = position;
 
-    float lineheight = TextRendering_LineHeight(window);
-    float charwidth = TextRendering_CharWidth(window);
+    char buffer[17 * 3] = {0};
+    snprintf(buffer, 17 * 3, "X=%.2f  Y=%.2f  Z=%.2f", position.x, position.y, position.z);
+    g_Hud.SetText(g_HudCameraPositionLabel, buffer);
+}
 
-    TextRendering_PrintString(window, buffer, 1.0f - (numchars + 1) * charwidth, 1.0f - lineheight, 1.0f);
+void UpdateHudInventory(unsigned stones)
+{
+    // Só formatamos o texto se o inventário mudou.
+    static int last_stones = -1;
+    if (last_stones == (int)stones)
+        return;
+
+    last_stones = stones;
+
+    char buffer[20];
+    snprintf(buffer, 20, "STONES: %u", stones);
+    g_Hud.SetText(g_HudInventoryStonesLabel, buffer);
 }
 
-void TextRendering_ShowCameraPosition(GLFWwindow *window)
+// Estado da construção das malhas: chunks esperando uma trabalhadora, em
+// construção, esperando o envio à GPU, e malhas descartadas por estarem
+// velhas.
+void UpdateHudChunks(ChunkRenderer const &chunk_renderer)
 {
-    if (!g_ShowInfoText)
+    // Só formatamos o texto se algum dos contadores mudou.
+    static size_t last_counts[4] = { (size_t)-1, 0, 0, 0 };
+    size_t counts[4] = {
+        chunk_renderer.DirtyChunks(),
+        chunk_renderer.JobsInFlight(),
+        chunk_renderer.ReadyMeshes(),
+        chunk_renderer.DiscardedMeshes()
+    };
+    if (std::equal(counts, counts + 4, last_counts))
         return;
+    std::copy(counts, counts + 4, last_counts);
 
-    float lineheight = TextRendering_LineHeight(window);
-    float charwidth = TextRendering_CharWidth(window);
+    char buffer[64];
+    snprintf(buffer, 64, "CHUNKS: %u dirty %u meshing %u ready %u stale",
+             (unsigned)counts[0], (unsigned)counts[1], (unsigned)counts[2], (unsigned)counts[3]);
+    g_Hud.SetText(g_HudChunksLabel, buffer);
+}
 
-    char buffer[17 * 3] = {0};
+// Chunks carregados e a memória que ocupam, chunks descarregados guardados
+// compactados, e colunas sendo carregadas.
+void UpdateHudStreaming(StreamingStats const &stats)
+{
+    // Só formatamos o texto se algum dos contadores mudou.
+    static size_t last_counts[4] = { (size_t)-1, 0, 0, 0 };
+    size_t counts[4] = {
+        stats.resident_chunks,
+        stats.stored_chunks,
+        stats.stored_bytes,
+        stats.loads_in_flight
+    };
+    if (std::equal(counts, counts + 4, last_counts))
+        return;
+    std::copy(counts, counts + 4, last_counts);
+
+    char buffer[64];
+    snprintf(buffer, 64, "WORLD: %u chunks %.1f MiB, %u saved %.1f MiB, %u loading",
+             (unsigned)stats.resident_chunks, stats.resident_bytes / (1024.0 * 1024.0),
+             (unsigned)stats.stored_chunks, stats.stored_bytes / (1024.0 * 1024.0),
+             (unsigned)stats.loads_in_flight);
+    g_Hud.SetText(g_HudStreamingLabel, buffer);
+}
+
+// Chunks com malha descartados antes do desenho, em porcentagem: fora do
+// frustum e, dos que restam, sem caminho de ar até a câmera ou ocultos por
+// faces sólidas. O tempo de CPU da
+// seleção é a média dos quadros desde a última atualização, feita uma vez
+// por segundo.
+void UpdateHudCulling(ChunkCullingStats const &stats)
+{
+    static float old_seconds = (float)glfwGetTime();
+    static double accum_ms = 0.0;
+    static int frames = 0;
+
+    accum_ms += stats.cpu_ms;
+    frames += 1;
+
+    float seconds = (float)glfwGetTime();
+    if (seconds - old_seconds <= 1.0f)
+        return;
+
+    size_t in_frustum = stats.meshes - stats.outside_frustum;
+    char buffer[80];
+    snprintf(buffer, 80, "CULLING: %.0f%% outside %.0f%% caves %.0f%% occluded, %u occluders, %.2f ms",
+             stats.meshes > 0 ? 100.0 * stats.outside_frustum / stats.meshes : 0.0,
+             in_frustum > 0 ? 100.0 * stats.unreachable / in_frustum : 0.0,
+             in_frustum > 0 ? 100.0 * stats.occluded / in_frustum : 0.0,
+             (unsigned)stats.occluder_faces, accum_ms / frames);
+    g_Hud.SetText(g_HudCullingLabel, buffer);
+
+    old_seconds = seconds;
+    accum_ms = 0.0;
+    frames = 0;
+}
+
+// Ocupação das arenas de g_GpuMemory e fração do espaço livre fora do maior
+// intervalo livre, intervalos esperando a GPU e bytes já movidos pela
+// compactação.
+void UpdateHudGpuMemory(GpuMemoryStats const &stats)
+{
+    static float old_seconds = (float)glfwGetTime();
+
+    float seconds = (float)glfwGetTime();
+    if (seconds - old_seconds <= 1.0f)
+        return;
 
-    size_t numchars = snprintf(
-        buffer,
-        17 * 3,
-        "X=%.2f  Y=%.2f  Z=%.2f",
-        g_Camera.CenterPoint().x,
-        g_Camera.CenterPoint().y,
-        g_Camera.CenterPoint().z);
+    const double mib = 1024.0 * 1024.0;
+    char buffer[96];
+    snprintf(buffer, 96, "GPU MEMORY: %.1f/%.0f MiB in %u arenas, %.0f%% fragmented, %.1f MiB pending, %.1f MiB moved",
+             stats.used_bytes / mib, stats.capacity_bytes / mib, (unsigned)stats.arenas,
+             stats.free_bytes > 0 ? 100.0 * (1.0 - (double)stats.largest_free_bytes / stats.free_bytes) : 0.0,
+             stats.pending_free_bytes / mib, stats.moved_bytes / mib);
+    g_Hud.SetText(g_HudGpuMemoryLabel, buffer);
 
-    TextRendering_PrintString(window, buffer, 1.0f - (numchars + 1) * charwidth, 1.0 - lineheight * 1.25 * 2, 1.0f);
+    old_seconds = seconds;
 }
 
-void TextRendering_ShowInventory(GLFWwindow *window)
+// Bytes escritos por quadro no anel de g_StreamBuffer e vezes em que a CPU
+// esperou a GPU liberar espaço nele, desde a última atualização.
+void UpdateHudStreamBuffer(StreamBuffer const &stream_buffer)
 {
-    if (!g_ShowInfoText)
+    static float old_seconds = (float)glfwGetTime();
+    static size_t accum_bytes = 0;
+    static size_t accum_stalls = 0;
+    static int frames = 0;
+
+    StreamBufferStats const &stats = stream_buffer.LastFrameStats();
+    accum_bytes += stats.bytes;
+    accum_stalls += stats.stalls;
+    frames += 1;
+
+    float seconds = (float)glfwGetTime();
+    if (seconds - old_seconds <= 1.0f)
         return;
 
-    float lineheight = TextRendering_LineHeight(window);
-    float charwidth = TextRendering_CharWidth(window);
+    char buffer[80];
+    snprintf(buffer, 80, "UPLOADS: %.0f KiB/frame, %u stalls (%u total)",
+             accum_bytes / 1024.0 / frames, (unsigned)accum_stalls, (unsigned)stream_buffer.TotalStalls());
+    g_Hud.SetText(g_HudStreamBufferLabel, buffer);
 
-    char buffer[20] = "INVENTORY";
-    size_t numchars = strlen(buffer);
+    old_seconds = seconds;
+    accum_bytes = 0;
+    accum_stalls = 0;
+    frames = 0;
+}
+
+// Tarefas e roubos por segundo e fração do tempo ociosa de cada
+// trabalhadora, desde a última atualização.
+void UpdateHudJobStats(float ellapsed_seconds)
+{
+    static std::vector<JobWorkerStats> last_stats;
 
-    TextRendering_PrintString(window, buffer, 1.0f - (numchars + 1) * charwidth, 1.0 - lineheight * 1.25 * 4, 1.0f);
+    size_t num_workers = g_JobSystem.NumWorkers();
+    last_stats.resize(num_workers, JobWorkerStats());
 
-    numchars = snprintf(buffer, 20, "STONES: %u", g_StonesInInventory);
-    TextRendering_PrintString(window, buffer, 1.0f - (numchars + 1) * charwidth, 1.0 - lineheight * 1.25 * 5, 1.0f);
+    char buffer[64];
+    snprintf(buffer, 64, "JOBS: %u workers", (unsigned)num_workers);
+    g_Hud.SetText(g_HudJobsLabel, buffer);
+
+    for (size_t i = 0; i < HUD_MAX_JOB_WORKERS; ++i)
+    {
+        if (i >= num_workers)
+        {
+            g_Hud.SetVisible(g_HudJobWorkerLabels[i], false);
+            continue;
+        }
+
+        JobWorkerStats stats = g_JobSystem.WorkerStats(i);
+        float idle = (stats.idle_ms - last_stats[i].idle_ms) / (10.0f * ellapsed_seconds);
+        snprintf(buffer, 64, "W%u %6.0f tasks/s %5.0f steals/s %3.0f%% idle",
+                 (unsigned)i,
+                 (stats.tasks_run - last_stats[i].tasks_run) / ellapsed_seconds,
+                 (stats.steals - last_stats[i].steals) / ellapsed_seconds,
+                 idle);
+        g_Hud.SetText(g_HudJobWorkerLabels[i], buffer);
+        g_Hud.SetVisible(g_HudJobWorkerLabels[i], true);
+
+        last_stats[i] = stats;
+    }
 }
 
 glm::vec3 CowPosition(double time)
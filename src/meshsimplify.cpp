@@ -0,0 +1,389 @@
+#include <cmath>
+#include <queue>
+#include <algorithm>
+
+#include <glm/geometric.hpp>
+
+#include "meshsimplify.hpp"
+
+// Peso dos planos das bordas abertas, relativo ao quadrado do comprimento
+// da aresta.
+#define SIMPLIFY_BOUNDARY_WEIGHT 10.0
+
+// Forma quádrica simétrica 4x4, guardada pelo triângulo superior: o erro
+// de um ponto p é [p 1] Q [p 1]^T. weight é a soma dos pesos dos planos.
+struct Quadric
+{
+    double a00, a01, a02, a03;
+    double      a11, a12, a13;
+    double           a22, a23;
+    double                a33;
+    double weight;
+
+    Quadric():
+        a00(0.0), a01(0.0), a02(0.0), a03(0.0),
+        a11(0.0), a12(0.0), a13(0.0),
+        a22(0.0), a23(0.0),
+        a33(0.0),
+        weight(0.0)
+    {
+    }
+
+    // Soma o quadrado da distância ao plano n . p + d = 0, com n unitário.
+    void AddPlane(glm::dvec3 n, double d, double weight)
+    {
+        this->a00 += weight * n.x * n.x;
+        this->a01 += weight * n.x * n.y;
+        this->a02 += weight * n.x * n.z;
+        this->a03 += weight * n.x * d;
+        this->a11 += weight * n.y * n.y;
+        this->a12 += weight * n.y * n.z;
+        this->a13 += weight * n.y * d;
+        this->a22 += weight * n.z * n.z;
+        this->a23 += weight * n.z * d;
+        this->a33 += weight * d * d;
+        this->weight += weight;
+    }
+
+    void Add(Quadric const &other)
+    {
+        this->a00 += other.a00; this->a01 += other.a01; this->a02 += other.a02; this->a03 += other.a03;
+        this->a11 += other.a11; this->a12 += other.a12; this->a13 += other.a13;
+        this->a22 += other.a22; this->a23 += other.a23;
+        this->a33 += other.a33;
+        this->weight += other.weight;
+    }
+
+    // Média ponderada dos quadrados das distâncias aos planos.
+    double Error(glm::dvec3 p) const
+    {
+        if (this->weight <= 0.0)
+            return 0.0;
+        return (p.x * (this->a00 * p.x + 2.0 * (this->a01 * p.y + this->a02 * p.z + this->a03))
+             + p.y * (this->a11 * p.y + 2.0 * (this->a12 * p.z + this->a13))
+             + p.z * (this->a22 * p.z + 2.0 * this->a23)
+             + this->a33) / this->weight;
+    }
+};
+
+// Contração do vértice from até o vértice to. As versões dos dois vértices
+// no momento do cálculo identificam candidatas desatualizadas.
+struct Collapse
+{
+    double   cost;
+    GLuint   from, to;
+    unsigned from_version, to_version;
+
+    bool operator<(Collapse const &other) const
+    {
+        // std::priority_queue devolve o maior; queremos o menor custo.
+        return this->cost > other.cost;
+    }
+};
+
+class MeshSimplifier
+{
+public:
+    MeshSimplifier(std::vector<glm::vec3> const &positions, std::vector<GLuint> const &indices);
+
+    void Run(size_t target_triangles, double max_error);
+    void Result(std::vector<GLuint> &simplified) const;
+
+private:
+    std::vector<glm::dvec3>            positions;
+    std::vector<GLuint>                triangles; // 3 índices por triângulo
+    std::vector<bool>                  triangle_removed;
+    std::vector<std::vector<GLuint> >  vertex_triangles; // Pode conter triângulos removidos
+    std::vector<Quadric>               quadrics;
+    std::vector<bool>                  locked;
+    std::vector<bool>                  vertex_removed;
+    std::vector<unsigned>              versions;
+    std::priority_queue<Collapse>      queue;
+    std::vector<GLuint>                neighbors;
+    std::vector<GLuint>                other_neighbors;
+    size_t                             live_triangles;
+
+    glm::dvec3 TriangleNormal(GLuint triangle) const;
+    void PushEdge(GLuint a, GLuint b);
+    void Neighbors(GLuint vertex, std::vector<GLuint> &result) const;
+    bool CanCollapse(GLuint from, GLuint to);
+    void ApplyCollapse(GLuint from, GLuint to);
+};
+
+MeshSimplifier::MeshSimplifier(std::vector<glm::vec3> const &positions, std::vector<GLuint> const &indices):
+    triangles(indices),
+    triangle_removed(indices.size() / 3, false),
+    vertex_triangles(positions.size()),
+    quadrics(positions.size()),
+    locked(positions.size(), false),
+    vertex_removed(positions.size(), false),
+    versions(positions.size(), 0),
+    live_triangles(indices.size() / 3)
+{
+    this->positions.reserve(positions.size());
+    for (size_t i = 0; i < positions.size(); ++i)
+        this->positions.push_back(glm::dvec3(positions[i]));
+
+    // Planos dos triângulos, ponderados pela área.
+    size_t num_triangles = indices.size() / 3;
+    for (GLuint triangle = 0; triangle < num_triangles; ++triangle)
+    {
+        glm::dvec3 n = this->TriangleNormal(triangle);
+        double length = glm::length(n);
+        if (length > 0.0)
+        {
+            n /= length;
+            double d = -glm::dot(n, this->positions[indices[3 * triangle]]);
+            for (int corner = 0; corner < 3; ++corner)
+                this->quadrics[indices[3 * triangle + corner]].AddPlane(n, d, 0.5 * length);
+        }
+
+        for (int corner = 0; corner < 3; ++corner)
+            this->vertex_triangles[indices[3 * triangle + corner]].push_back(triangle);
+    }
+
+    // Vértices na mesma posição de outro vértice ficam parados.
+    std::vector<GLuint> order(positions.size());
+    for (GLuint i = 0; i < order.size(); ++i)
+        order[i] = i;
+    std::sort(order.begin(), order.end(), [&positions](GLuint a, GLuint b) {
+        glm::vec3 const &pa = positions[a];
+        glm::vec3 const &pb = positions[b];
+        return pa.x != pb.x ? pa.x < pb.x : (pa.y != pb.y ? pa.y < pb.y : pa.z < pb.z);
+    });
+    for (size_t i = 1; i < order.size(); ++i)
+    {
+        if (positions[order[i]] == positions[order[i - 1]])
+        {
+            this->locked[order[i]] = true;
+            this->locked[order[i - 1]] = true;
+        }
+    }
+
+    // Arestas, com o triângulo de cada uma. As que aparecem uma só vez são
+    // bordas abertas.
+    struct Edge
+    {
+        GLuint a, b, triangle;
+        bool operator<(Edge const &other) const
+        {
+            return this->a != other.a ? this->a < other.a : this->b < other.b;
+        }
+    };
+    std::vector<Edge> edges;
+    edges.reserve(indices.size());
+    for (GLuint triangle = 0; triangle < num_triangles; ++triangle)
+    {
+        for (int corner = 0; corner < 3; ++corner)
+        {
+            GLuint a = indices[3 * triangle + corner];
+            GLuint b = indices[3 * triangle + (corner + 1) % 3];
+            Edge edge = { std::min(a, b), std::max(a, b), triangle };
+            edges.push_back(edge);
+        }
+    }
+    std::sort(edges.begin(), edges.end());
+
+    for (size_t i = 0; i < edges.size(); )
+    {
+        size_t end = i + 1;
+        while (end < edges.size() && edges[end].a == edges[i].a && edges[end].b == edges[i].b)
+            end++;
+
+        Edge const &edge = edges[i];
+        if (end - i == 1)
+        {
+            // Plano que contém a aresta e é perpendicular ao triângulo.
+            glm::dvec3 pa = this->positions[edge.a];
+            glm::dvec3 direction = this->positions[edge.b] - pa;
+            glm::dvec3 n = glm::cross(direction, this->TriangleNormal(edge.triangle));
+            double length = glm::length(n);
+            if (length > 0.0)
+            {
+                n /= length;
+                double d = -glm::dot(n, pa);
+                double weight = SIMPLIFY_BOUNDARY_WEIGHT * glm::dot(direction, direction);
+                this->quadrics[edge.a].AddPlane(n, d, weight);
+                this->quadrics[edge.b].AddPlane(n, d, weight);
+            }
+        }
+
+        if (edge.a != edge.b)
+            this->PushEdge(edge.a, edge.b);
+        i = end;
+    }
+}
+
+glm::dvec3 MeshSimplifier::TriangleNormal(GLuint triangle) const
+{
+    glm::dvec3 const &a = this->positions[this->triangles[3 * triangle + 0]];
+    glm::dvec3 const &b = this->positions[this->triangles[3 * triangle + 1]];
+    glm::dvec3 const &c = this->positions[this->triangles[3 * triangle + 2]];
+    return glm::cross(b - a, c - a);
+}
+
+void MeshSimplifier::PushEdge(GLuint a, GLuint b)
+{
+    // As duas direções são candidatas: se a mais barata inverter algum
+    // triângulo, a outra ainda pode ser usada.
+    Quadric sum = this->quadrics[a];
+    sum.Add(this->quadrics[b]);
+
+    if (!this->locked[a])
+    {
+        Collapse collapse = { sum.Error(this->positions[b]), a, b, this->versions[a], this->versions[b] };
+        this->queue.push(collapse);
+    }
+    if (!this->locked[b])
+    {
+        Collapse collapse = { sum.Error(this->positions[a]), b, a, this->versions[b], this->versions[a] };
+        this->queue.push(collapse);
+    }
+}
+
+void MeshSimplifier::Neighbors(GLuint vertex, std::vector<GLuint> &result) const
+{
+    result.clear();
+    std::vector<GLuint> const &around = this->vertex_triangles[vertex];
+    for (size_t i = 0; i < around.size(); ++i)
+    {
+        if (this->triangle_removed[around[i]])
+            continue;
+        for (int corner = 0; corner < 3; ++corner)
+        {
+            GLuint other = this->triangles[3 * around[i] + corner];
+            if (other != vertex)
+                result.push_back(other);
+        }
+    }
+    std::sort(result.begin(), result.end());
+    result.erase(std::unique(result.begin(), result.end()), result.end());
+}
+
+bool MeshSimplifier::CanCollapse(GLuint from, GLuint to)
+{
+    // Uma aresta interna é compartilhada por 2 triângulos, e os extremos têm
+    // 2 vizinhos em comum. Com mais vizinhos em comum a contração dobraria a
+    // malha sobre si mesma.
+    this->Neighbors(from, this->neighbors);
+    this->Neighbors(to, this->other_neighbors);
+    size_t common = 0;
+    for (size_t i = 0, j = 0; i < this->neighbors.size() && j < this->other_neighbors.size(); )
+    {
+        if (this->neighbors[i] < this->other_neighbors[j])
+            i++;
+        else if (this->neighbors[i] > this->other_neighbors[j])
+            j++;
+        else
+        {
+            common++;
+            i++;
+            j++;
+        }
+    }
+    if (common > 2)
+        return false;
+
+    // Nenhum triângulo que continua existindo pode inverter.
+    std::vector<GLuint> const &around = this->vertex_triangles[from];
+    for (size_t i = 0; i < around.size(); ++i)
+    {
+        GLuint triangle = around[i];
+        if (this->triangle_removed[triangle])
+            continue;
+
+        GLuint const *corners = &this->triangles[3 * triangle];
+        if (corners[0] == to || corners[1] == to || corners[2] == to)
+            continue;
+
+        glm::dvec3 moved[3];
+        for (int corner = 0; corner < 3; ++corner)
+            moved[corner] = this->positions[corners[corner] == from ? to : corners[corner]];
+
+        glm::dvec3 before = this->TriangleNormal(triangle);
+        glm::dvec3 after = glm::cross(moved[1] - moved[0], moved[2] - moved[0]);
+        if (glm::dot(before, after) <= 0.0)
+            return false;
+    }
+
+    return true;
+}
+
+void MeshSimplifier::ApplyCollapse(GLuint from, GLuint to)
+{
+    std::vector<GLuint> &around = this->vertex_triangles[from];
+    for (size_t i = 0; i < around.size(); ++i)
+    {
+        GLuint triangle = around[i];
+        if (this->triangle_removed[triangle])
+            continue;
+
+        GLuint *corners = &this->triangles[3 * triangle];
+        if (corners[0] == to || corners[1] == to || corners[2] == to)
+        {
+            this->triangle_removed[triangle] = true;
+            this->live_triangles--;
+            continue;
+        }
+
+        for (int corner = 0; corner < 3; ++corner)
+            if (corners[corner] == from)
+                corners[corner] = to;
+        this->vertex_triangles[to].push_back(triangle);
+    }
+    around.clear();
+
+    this->vertex_removed[from] = true;
+    this->quadrics[to].Add(this->quadrics[from]);
+    this->versions[to]++;
+
+    // Os custos das arestas de to mudaram.
+    this->Neighbors(to, this->neighbors);
+    for (size_t i = 0; i < this->neighbors.size(); ++i)
+        this->PushEdge(to, this->neighbors[i]);
+}
+
+void MeshSimplifier::Run(size_t target_triangles, double max_error)
+{
+    double max_cost = max_error * max_error;
+    while (this->live_triangles > target_triangles && !this->queue.empty())
+    {
+        // As candidatas seguintes custam ainda mais.
+        Collapse collapse = this->queue.top();
+        if (collapse.cost > max_cost)
+            break;
+        this->queue.pop();
+
+        if (this->vertex_removed[collapse.from] || this->vertex_removed[collapse.to]
+            || this->versions[collapse.from] != collapse.from_version
+            || this->versions[collapse.to] != collapse.to_version)
+            continue;
+
+        if (!this->CanCollapse(collapse.from, collapse.to))
+            continue;
+
+        this->ApplyCollapse(collapse.from, collapse.to);
+    }
+}
+
+void MeshSimplifier::Result(std::vector<GLuint> &simplified) const
+{
+    simplified.clear();
+    simplified.reserve(3 * this->live_triangles);
+    for (size_t triangle = 0; triangle < this->triangle_removed.size(); ++triangle)
+    {
+        if (this->triangle_removed[triangle])
+            continue;
+        simplified.push_back(this->triangles[3 * triangle + 0]);
+        simplified.push_back(this->triangles[3 * triangle + 1]);
+        simplified.push_back(this->triangles[3 * triangle + 2]);
+    }
+}
+
+void SimplifyMesh(std::vector<glm::vec3> const &positions, std::vector<GLuint> const &indices,
+                  size_t target_triangles, float max_error, std::vector<GLuint> &simplified)
+{
+    MeshSimplifier simplifier(positions, indices);
+    simplifier.Run(target_triangles, max_error);
+    simplifier.Result(simplified);
+}
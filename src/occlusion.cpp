@@ -0,0 +1,266 @@
+#include <cmath>
+#include <algorithm>
+
+#include "occlusion.hpp"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+// Uma caixa só é considerada oculta se estiver atrás dos oclusores por mais
+// que esta diferença de profundidade (NDC). Evita que as faces sólidas de um
+// chunk ocultem o próprio chunk por erros de arredondamento.
+#define OCCLUSION_DEPTH_EPSILON 1e-6f
+
+// Pontos com w menor que isto estão atrás da câmera (ou sobre ela).
+#define OCCLUSION_MIN_W 1e-5f
+
+OcclusionCuller::OcclusionCuller():
+    view_projection(1.0f),
+    occluder_triangles(0)
+{
+    int width = OCCLUSION_WIDTH;
+    int height = OCCLUSION_HEIGHT;
+    while (true)
+    {
+        this->levels.push_back(std::vector<float>(width * height, 1.0f));
+        this->level_widths.push_back(width);
+        this->level_heights.push_back(height);
+        if (width == 1 || height == 1)
+            break;
+        width /= 2;
+        height /= 2;
+    }
+}
+
+void OcclusionCuller::Begin(glm::mat4 const &view_projection)
+{
+    this->view_projection = view_projection;
+    this->occluder_triangles = 0;
+    std::fill(this->levels[0].begin(), this->levels[0].end(), 1.0f);
+}
+
+void OcclusionCuller::AddOccluderQuad(glm::vec3 const corners[4])
+{
+    ScreenVertex screen[4];
+    for (int i = 0; i < 4; ++i)
+    {
+        glm::vec4 clip = this->view_projection * glm::vec4(corners[i], 1.0f);
+
+        // Recortar o quadrilátero no plano próximo não vale a pena: os
+        // oclusores que o cruzam são descartados, o que só deixa o teste
+        // mais conservador.
+        if (clip.w < OCCLUSION_MIN_W || clip.z < -clip.w)
+            return;
+
+        screen[i].x = (clip.x / clip.w * 0.5f + 0.5f) * OCCLUSION_WIDTH;
+        screen[i].y = (clip.y / clip.w * 0.5f + 0.5f) * OCCLUSION_HEIGHT;
+        screen[i].z = clip.z / clip.w;
+    }
+
+    this->RasterizeTriangle(screen[0], screen[1], screen[2]);
+    this->RasterizeTriangle(screen[0], screen[2], screen[3]);
+}
+
+void OcclusionCuller::RasterizeTriangle(ScreenVertex const &v0, ScreenVertex v1, ScreenVertex v2)
+{
+    // Os triângulos são desenhados dos dois lados: uma camada sólida de
+    // blocos oculta o que está atrás dela em qualquer sentido.
+    float area = (v1.x - v0.x) * (v2.y - v0.y) - (v1.y - v0.y) * (v2.x - v0.x);
+    if (fabsf(area) < 1e-6f)
+        return;
+    if (area < 0.0f)
+    {
+        std::swap(v1, v2);
+        area = -area;
+    }
+
+    float min_x = std::min(v0.x, std::min(v1.x, v2.x));
+    float max_x = std::max(v0.x, std::max(v1.x, v2.x));
+    float min_y = std::min(v0.y, std::min(v1.y, v2.y));
+    float max_y = std::max(v0.y, std::max(v1.y, v2.y));
+
+    // Pixels cujo centro pode estar dentro do triângulo. A coluna inicial é
+    // alinhada a 4 pixels.
+    int start_x = std::max(0, (int)floorf(min_x)) & ~3;
+    int end_x = std::min(OCCLUSION_WIDTH - 1, (int)ceilf(max_x));
+    int start_y = std::max(0, (int)floorf(min_y));
+    int end_y = std::min(OCCLUSION_HEIGHT - 1, (int)ceilf(max_y));
+    if (start_x > end_x || start_y > end_y)
+        return;
+
+    this->occluder_triangles++;
+
+    // Funções de aresta e = a*x + b*y + c, positivas dentro do triângulo.
+    ScreenVertex const *vertices[3] = { &v0, &v1, &v2 };
+    float edge_a[3], edge_b[3], edge_c[3];
+    for (int i = 0; i < 3; ++i)
+    {
+        ScreenVertex const &from = *vertices[i];
+        ScreenVertex const &to = *vertices[(i + 1) % 3];
+        edge_a[i] = from.y - to.y;
+        edge_b[i] = to.x - from.x;
+        edge_c[i] = -(edge_a[i] * from.x + edge_b[i] * from.y);
+    }
+
+    // Plano da profundidade: z = z0 + dz_dx * (x - x0) + dz_dy * (y - y0).
+    float dz_dx = ((v1.z - v0.z) * (v2.y - v0.y) - (v2.z - v0.z) * (v1.y - v0.y)) / area;
+    float dz_dy = ((v2.z - v0.z) * (v1.x - v0.x) - (v1.z - v0.z) * (v2.x - v0.x)) / area;
+    float z_c = v0.z - dz_dx * v0.x - dz_dy * v0.y;
+
+    std::vector<float> &depth = this->levels[0];
+
+#ifdef __SSE2__
+    const __m128 offsets = _mm_set_ps(3.5f, 2.5f, 1.5f, 0.5f);
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 a0 = _mm_set1_ps(edge_a[0]), a1 = _mm_set1_ps(edge_a[1]), a2 = _mm_set1_ps(edge_a[2]);
+    const __m128 z_a = _mm_set1_ps(dz_dx);
+
+    for (int y = start_y; y <= end_y; ++y)
+    {
+        float center_y = y + 0.5f;
+        __m128 row0 = _mm_set1_ps(edge_b[0] * center_y + edge_c[0]);
+        __m128 row1 = _mm_set1_ps(edge_b[1] * center_y + edge_c[1]);
+        __m128 row2 = _mm_set1_ps(edge_b[2] * center_y + edge_c[2]);
+        __m128 row_z = _mm_set1_ps(dz_dy * center_y + z_c);
+        float *line = &depth[y * OCCLUSION_WIDTH];
+
+        for (int x = start_x; x <= end_x; x += 4)
+        {
+            __m128 center_x = _mm_add_ps(_mm_set1_ps((float)x), offsets);
+            __m128 e0 = _mm_add_ps(_mm_mul_ps(a0, center_x), row0);
+            __m128 e1 = _mm_add_ps(_mm_mul_ps(a1, center_x), row1);
+            __m128 e2 = _mm_add_ps(_mm_mul_ps(a2, center_x), row2);
+            __m128 inside = _mm_and_ps(_mm_cmpge_ps(e0, zero), _mm_and_ps(_mm_cmpge_ps(e1, zero), _mm_cmpge_ps(e2, zero)));
+            if (_mm_movemask_ps(inside) == 0)
+                continue;
+
+            __m128 z = _mm_add_ps(_mm_mul_ps(z_a, center_x), row_z);
+            __m128 current = _mm_loadu_ps(line + x);
+            __m128 nearest = _mm_min_ps(current, z);
+            _mm_storeu_ps(line + x, _mm_or_ps(_mm_and_ps(inside, nearest), _mm_andnot_ps(inside, current)));
+        }
+    }
+#else
+    for (int y = start_y; y <= end_y; ++y)
+    {
+        float center_y = y + 0.5f;
+        float *line = &depth[y * OCCLUSION_WIDTH];
+        for (int x = start_x; x <= end_x; ++x)
+        {
+            float center_x = x + 0.5f;
+            if (edge_a[0] * center_x + edge_b[0] * center_y + edge_c[0] < 0.0f
+                || edge_a[1] * center_x + edge_b[1] * center_y + edge_c[1] < 0.0f
+                || edge_a[2] * center_x + edge_b[2] * center_y + edge_c[2] < 0.0f)
+                continue;
+
+            float z = dz_dx * center_x + dz_dy * center_y + z_c;
+            line[x] = std::min(line[x], z);
+        }
+    }
+#endif
+}
+
+void OcclusionCuller::BuildPyramid()
+{
+    for (size_t level = 1; level < this->levels.size(); ++level)
+    {
+        std::vector<float> const &below = this->levels[level - 1];
+        std::vector<float> &above = this->levels[level];
+        int below_width = this->level_widths[level - 1];
+        int width = this->level_widths[level];
+        int height = this->level_heights[level];
+
+        for (int y = 0; y < height; ++y)
+        {
+            float const *row0 = &below[(2 * y) * below_width];
+            float const *row1 = row0 + below_width;
+            for (int x = 0; x < width; ++x)
+            {
+                float top = std::max(row0[2 * x], row0[2 * x + 1]);
+                float bottom = std::max(row1[2 * x], row1[2 * x + 1]);
+                above[y * width + x] = std::max(top, bottom);
+            }
+        }
+    }
+}
+
+bool OcclusionCuller::IsInFrustum(glm::vec3 const &box_min, glm::vec3 const &box_max) const
+{
+    // A caixa está fora se todos os cantos estão fora do mesmo plano.
+    int outside[6] = { 0, 0, 0, 0, 0, 0 };
+    for (int corner = 0; corner < 8; ++corner)
+    {
+        glm::vec4 point((corner & 1) ? box_max.x : box_min.x,
+                        (corner & 2) ? box_max.y : box_min.y,
+                        (corner & 4) ? box_max.z : box_min.z, 1.0f);
+        glm::vec4 clip = this->view_projection * point;
+        outside[0] += clip.x < -clip.w;
+        outside[1] += clip.x > clip.w;
+        outside[2] += clip.y < -clip.w;
+        outside[3] += clip.y > clip.w;
+        outside[4] += clip.z < -clip.w;
+        outside[5] += clip.z > clip.w;
+    }
+
+    for (int plane = 0; plane < 6; ++plane)
+        if (outside[plane] == 8)
+            return false;
+    return true;
+}
+
+bool OcclusionCuller::IsOccluded(glm::vec3 const &box_min, glm::vec3 const &box_max) const
+{
+    float min_x = 1e30f, max_x = -1e30f;
+    float min_y = 1e30f, max_y = -1e30f;
+    float min_z = 1e30f;
+    for (int corner = 0; corner < 8; ++corner)
+    {
+        glm::vec4 point((corner & 1) ? box_max.x : box_min.x,
+                        (corner & 2) ? box_max.y : box_min.y,
+                        (corner & 4) ? box_max.z : box_min.z, 1.0f);
+        glm::vec4 clip = this->view_projection * point;
+
+        // A caixa cruza o plano próximo: está, em parte, na frente de
+        // qualquer oclusor.
+        if (clip.w < OCCLUSION_MIN_W || clip.z < -clip.w)
+            return false;
+
+        float x = (clip.x / clip.w * 0.5f + 0.5f) * OCCLUSION_WIDTH;
+        float y = (clip.y / clip.w * 0.5f + 0.5f) * OCCLUSION_HEIGHT;
+        min_x = std::min(min_x, x);
+        max_x = std::max(max_x, x);
+        min_y = std::min(min_y, y);
+        max_y = std::max(max_y, y);
+        min_z = std::min(min_z, clip.z / clip.w);
+    }
+
+    // Os oclusores cobrem pixels inteiros a partir do centro; aumentamos a
+    // área da caixa em um pixel para que as bordas dos oclusores não a
+    // escondam por engano.
+    int x0 = std::max(0, (int)floorf(min_x) - 1);
+    int x1 = std::min(OCCLUSION_WIDTH - 1, (int)floorf(max_x) + 1);
+    int y0 = std::max(0, (int)floorf(min_y) - 1);
+    int y1 = std::min(OCCLUSION_HEIGHT - 1, (int)floorf(max_y) + 1);
+    if (x0 > x1 || y0 > y1)
+        return false;
+
+    // Nível em que a área ocupa no máximo 2x2 texels.
+    size_t level = 0;
+    while (level + 1 < this->levels.size() && ((x1 >> level) - (x0 >> level) > 1 || (y1 >> level) - (y0 >> level) > 1))
+        level++;
+
+    std::vector<float> const &depth = this->levels[level];
+    int width = this->level_widths[level];
+    for (int y = y0 >> level; y <= (y1 >> level); ++y)
+        for (int x = x0 >> level; x <= (x1 >> level); ++x)
+            if (depth[y * width + x] + OCCLUSION_DEPTH_EPSILON >= min_z)
+                return false;
+
+    return true;
+}
+
+size_t OcclusionCuller::OccluderTriangles() const
+{
+    return this->occluder_triangles;
+}
@@ -0,0 +1,429 @@
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <algorithm>
+#include <thread>
+#include <atomic>
+
+#include "profiler.hpp"
+#include "gpu.hpp"
+#include "streambuffer.hpp"
+#include "utils.h"
+
+Profiler g_Profiler;
+
+// Identificador da thread usado nos eventos do trace da GPU.
+#define PROFILER_GPU_THREAD 1000
+
+// Escala vertical do gráfico: a altura total corresponde a este tempo.
+#define PROFILER_GRAPH_MAX_MS 33.3f
+
+const GLchar* const graphvertexshader_source = ""
+"#version 330\n"
+"layout (location = 0) in vec2 position;\n"
+"void main()\n"
+"{\n"
+    "gl_Position = vec4(position, 0, 1);\n"
+"}\n"
+"\0";
+
+const GLchar* const graphfragmentshader_source = ""
+"#version 330\n"
+"uniform vec4 color;\n"
+"out vec4 fragColor;\n"
+"void main()\n"
+"{\n"
+    "fragColor = color;\n"
+"}\n"
+"\0";
+
+// Cada thread recebe um número pequeno e estável para o arquivo de trace.
+static int Profiler_CurrentThread()
+{
+    static std::atomic<int> next_thread(0);
+    static thread_local int thread = next_thread++;
+    return thread;
+}
+
+Profiler::Profiler():
+    epoch(std::chrono::steady_clock::now()),
+    trace_enabled(false),
+    frame_number(0),
+    gpu_scope_open(false),
+    gpu_initialized(false),
+    frame_start_us(0.0),
+    history_head(0),
+    frame_draw_calls(0),
+    frame_triangles(0),
+    last_frame_draw_calls(0),
+    last_frame_triangles(0),
+    average_window_start_us(0.0),
+    average_cpu_accum_ms(0.0),
+    average_gpu_accum_ms(0.0),
+    average_cpu_frames(0),
+    average_gpu_frames(0),
+    average_latency_accum_ms(0.0),
+    average_latency_events(0),
+    average_cpu_ms(0.0f),
+    average_gpu_ms(0.0f),
+    average_latency_ms(0.0f),
+    graph_program_id(0),
+    graph_color_uniform(-1),
+    graph_vertex_array_object_id(0)
+{
+    for (size_t i = 0; i < PROFILER_HISTORY_FRAMES; ++i)
+    {
+        this->cpu_frame_ms[i] = 0.0f;
+        this->gpu_frame_ms[i] = 0.0f;
+    }
+    for (size_t i = 0; i < PROFILER_GPU_FRAMES_IN_FLIGHT; ++i)
+    {
+        this->gpu_frames[i].num_scopes = 0;
+        this->gpu_frames[i].history_index = 0;
+        this->gpu_frames[i].pending = false;
+    }
+}
+
+void Profiler::Init()
+{
+    for (size_t i = 0; i < PROFILER_GPU_FRAMES_IN_FLIGHT; ++i)
+    {
+        for (size_t j = 0; j < PROFILER_MAX_GPU_SCOPES; ++j)
+            glGenQueries(1, &this->gpu_frames[i].scopes[j].query_id);
+    }
+
+    GLuint vertex_shader_id = CreateGpuShaderFromSource(GL_VERTEX_SHADER, graphvertexshader_source);
+    GLuint fragment_shader_id = CreateGpuShaderFromSource(GL_FRAGMENT_SHADER, graphfragmentshader_source);
+    this->graph_program_id = CreateGpuProgram(vertex_shader_id, fragment_shader_id);
+    this->graph_color_uniform = glGetUniformLocation(this->graph_program_id, "color");
+
+    // Os vértices do gráfico são escritos a cada quadro no anel de
+    // g_StreamBuffer.
+    glGenVertexArrays(1, &this->graph_vertex_array_object_id);
+    glBindVertexArray(this->graph_vertex_array_object_id);
+    glBindBuffer(GL_ARRAY_BUFFER, g_StreamBuffer.Buffer());
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 0, 0);
+    glEnableVertexAttribArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindVertexArray(0);
+    glCheckError();
+
+    this->gpu_initialized = true;
+}
+
+void Profiler::EnableTrace(bool enabled)
+{
+    std::lock_guard<std::mutex> lock(this->trace_mutex);
+    this->trace_enabled = enabled;
+    if (enabled)
+        this->trace_events.reserve(1 << 16);
+}
+
+double Profiler::NowMicroseconds() const
+{
+    std::chrono::duration<double, std::micro> elapsed = std::chrono::steady_clock::now() - this->epoch;
+    return elapsed.count();
+}
+
+void Profiler::PushTraceEvent(const char *name, double start_us, double duration_us, int thread)
+{
+    std::lock_guard<std::mutex> lock(this->trace_mutex);
+    if (!this->trace_enabled || this->trace_events.size() >= PROFILER_MAX_TRACE_EVENTS)
+        return;
+
+    ProfilerTraceEvent event;
+    event.name = name;
+    event.start_us = start_us;
+    event.duration_us = duration_us;
+    event.thread = thread;
+    this->trace_events.push_back(event);
+}
+
+void Profiler::RecordCpuScope(const char *name, double start_us, double end_us)
+{
+    this->PushTraceEvent(name, start_us, end_us - start_us, Profiler_CurrentThread());
+}
+
+void Profiler::BeginFrame()
+{
+    this->frame_start_us = this->NowMicroseconds();
+
+    GpuFrame &frame = this->gpu_frames[this->frame_number % PROFILER_GPU_FRAMES_IN_FLIGHT];
+    if (frame.pending)
+        this->CollectGpuFrame(frame);
+
+    frame.num_scopes = 0;
+    frame.history_index = this->history_head;
+    frame.pending = false;
+}
+
+void Profiler::EndFrame()
+{
+    double now_us = this->NowMicroseconds();
+    float frame_ms = (now_us - this->frame_start_us) / 1000.0;
+
+    this->PushTraceEvent("frame", this->frame_start_us, now_us - this->frame_start_us, Profiler_CurrentThread());
+
+    GpuFrame &frame = this->gpu_frames[this->frame_number % PROFILER_GPU_FRAMES_IN_FLIGHT];
+    frame.pending = frame.num_scopes > 0;
+
+    this->last_frame_draw_calls = this->frame_draw_calls;
+    this->last_frame_triangles = this->frame_triangles;
+    this->frame_draw_calls = 0;
+    this->frame_triangles = 0;
+
+    this->cpu_frame_ms[this->history_head] = frame_ms;
+    this->gpu_frame_ms[this->history_head] = 0.0f;
+    this->history_head = (this->history_head + 1) % PROFILER_HISTORY_FRAMES;
+    this->frame_number++;
+
+    this->average_cpu_accum_ms += frame_ms;
+    this->average_cpu_frames++;
+    if (now_us - this->average_window_start_us > 1000000.0)
+    {
+        if (this->average_cpu_frames > 0)
+            this->average_cpu_ms = this->average_cpu_accum_ms / this->average_cpu_frames;
+        if (this->average_gpu_frames > 0)
+            this->average_gpu_ms = this->average_gpu_accum_ms / this->average_gpu_frames;
+        this->average_latency_ms = this->average_latency_events > 0 ? this->average_latency_accum_ms / this->average_latency_events : 0.0;
+        for (size_t i = 0; i < this->gpu_scope_averages.size(); ++i)
+        {
+            GpuScopeAverage &scope_average = this->gpu_scope_averages[i];
+            scope_average.average_ms = scope_average.frames > 0 ? scope_average.accum_ms / scope_average.frames : 0.0;
+            scope_average.accum_ms = 0.0;
+            scope_average.frames = 0;
+        }
+
+        this->average_window_start_us = now_us;
+        this->average_cpu_accum_ms = 0.0;
+        this->average_gpu_accum_ms = 0.0;
+        this->average_latency_accum_ms = 0.0;
+        this->average_latency_events = 0;
+        this->average_cpu_frames = 0;
+        this->average_gpu_frames = 0;
+    }
+}
+
+void Profiler::CollectGpuFrame(GpuFrame &frame)
+{
+    frame.pending = false;
+
+    // Se o último resultado ainda não está disponível, descartamos o quadro
+    // em vez de bloquear a CPU esperando a GPU.
+    GLint available = 0;
+    glGetQueryObjectiv(frame.scopes[frame.num_scopes - 1].query_id, GL_QUERY_RESULT_AVAILABLE, &available);
+    if (!available)
+        return;
+
+    double total_ms = 0.0;
+    for (size_t i = 0; i < frame.num_scopes; ++i)
+    {
+        GLuint64 elapsed_ns = 0;
+        glGetQueryObjectui64v(frame.scopes[i].query_id, GL_QUERY_RESULT, &elapsed_ns);
+        total_ms += elapsed_ns / 1000000.0;
+
+        // A GPU não expõe o instante de início de cada escopo com
+        // GL_TIME_ELAPSED; usamos o instante em que a CPU o submeteu.
+        this->PushTraceEvent(frame.scopes[i].name, frame.scopes[i].cpu_start_us, elapsed_ns / 1000.0, PROFILER_GPU_THREAD);
+
+        size_t average = 0;
+        while (average < this->gpu_scope_averages.size() && strcmp(this->gpu_scope_averages[average].name, frame.scopes[i].name) != 0)
+            average++;
+        if (average == this->gpu_scope_averages.size())
+        {
+            GpuScopeAverage scope_average = { frame.scopes[i].name, 0.0, 0, 0.0f };
+            this->gpu_scope_averages.push_back(scope_average);
+        }
+        this->gpu_scope_averages[average].accum_ms += elapsed_ns / 1000000.0;
+        this->gpu_scope_averages[average].frames++;
+    }
+
+    this->gpu_frame_ms[frame.history_index] = total_ms;
+    this->average_gpu_accum_ms += total_ms;
+    this->average_gpu_frames++;
+}
+
+void Profiler::BeginGpuScope(const char *name)
+{
+    GpuFrame &frame = this->gpu_frames[this->frame_number % PROFILER_GPU_FRAMES_IN_FLIGHT];
+    if (!this->gpu_initialized || this->gpu_scope_open || frame.num_scopes >= PROFILER_MAX_GPU_SCOPES)
+        return;
+
+    GpuScope &scope = frame.scopes[frame.num_scopes];
+    scope.name = name;
+    scope.cpu_start_us = this->NowMicroseconds();
+    glBeginQuery(GL_TIME_ELAPSED, scope.query_id);
+    this->gpu_scope_open = true;
+}
+
+void Profiler::EndGpuScope()
+{
+    if (!this->gpu_scope_open)
+        return;
+
+    glEndQuery(GL_TIME_ELAPSED);
+    this->gpu_frames[this->frame_number % PROFILER_GPU_FRAMES_IN_FLIGHT].num_scopes++;
+    this->gpu_scope_open = false;
+}
+
+void Profiler::CountDrawCall(size_t num_triangles)
+{
+    this->frame_draw_calls++;
+    this->frame_triangles += num_triangles;
+}
+
+float Profiler::LastFrameMs() const
+{
+    size_t last = (this->history_head + PROFILER_HISTORY_FRAMES - 1) % PROFILER_HISTORY_FRAMES;
+    return this->cpu_frame_ms[last];
+}
+
+size_t Profiler::LastFrameDrawCalls() const
+{
+    return this->last_frame_draw_calls;
+}
+
+size_t Profiler::LastFrameTriangles() const
+{
+    return this->last_frame_triangles;
+}
+
+float Profiler::AverageCpuFrameMs() const
+{
+    return this->average_cpu_ms;
+}
+
+float Profiler::AverageGpuFrameMs() const
+{
+    return this->average_gpu_ms;
+}
+
+void Profiler::RecordInputLatency(double input_us, double presented_us)
+{
+    this->PushTraceEvent("input latency", input_us, presented_us - input_us, Profiler_CurrentThread());
+
+    this->average_latency_accum_ms += (presented_us - input_us) / 1000.0;
+    this->average_latency_events++;
+}
+
+float Profiler::AverageInputLatencyMs() const
+{
+    return this->average_latency_ms;
+}
+
+float Profiler::AverageGpuScopeMs(const char *name) const
+{
+    for (size_t i = 0; i < this->gpu_scope_averages.size(); ++i)
+        if (strcmp(this->gpu_scope_averages[i].name, name) == 0)
+            return this->gpu_scope_averages[i].average_ms;
+    return 0.0f;
+}
+
+void Profiler::DrawGraph()
+{
+    if (!this->gpu_initialized)
+        return;
+
+    // O gráfico ocupa o canto inferior esquerdo da tela, em coordenadas NDC.
+    const float left = -0.98f;
+    const float bottom = -0.98f;
+    const float width = 0.8f;
+    const float height = 0.4f;
+
+    this->graph_vertices.clear();
+
+    // Linha de referência de 16.6 ms (60 fps)
+    float reference_y = bottom + height * (16.6f / PROFILER_GRAPH_MAX_MS);
+    this->graph_vertices.push_back(left);
+    this->graph_vertices.push_back(reference_y);
+    this->graph_vertices.push_back(left + width);
+    this->graph_vertices.push_back(reference_y);
+
+    const float *series[2] = { this->cpu_frame_ms, this->gpu_frame_ms };
+    for (size_t s = 0; s < 2; ++s)
+    {
+        for (size_t i = 0; i < PROFILER_HISTORY_FRAMES; ++i)
+        {
+            // Do quadro mais antigo para o mais recente
+            size_t index = (this->history_head + i) % PROFILER_HISTORY_FRAMES;
+            float value = std::min(series[s][index], PROFILER_GRAPH_MAX_MS);
+            this->graph_vertices.push_back(left + width * i / (PROFILER_HISTORY_FRAMES - 1));
+            this->graph_vertices.push_back(bottom + height * value / PROFILER_GRAPH_MAX_MS);
+        }
+    }
+
+    const size_t vertex_bytes = 2 * sizeof(float);
+    size_t offset = g_StreamBuffer.Write(this->graph_vertices.data(), this->graph_vertices.size() * sizeof(float), vertex_bytes);
+    if (offset == StreamBuffer::INVALID)
+        return;
+    GLint first = offset / vertex_bytes;
+
+    glDepthFunc(GL_ALWAYS);
+    glUseProgram(this->graph_program_id);
+    glBindVertexArray(this->graph_vertex_array_object_id);
+
+    glUniform4f(this->graph_color_uniform, 0.5f, 0.5f, 0.5f, 1.0f);
+    glDrawArrays(GL_LINES, first, 2);
+    glUniform4f(this->graph_color_uniform, 0.9f, 0.1f, 0.1f, 1.0f);
+    glDrawArrays(GL_LINE_STRIP, first + 2, PROFILER_HISTORY_FRAMES);
+    glUniform4f(this->graph_color_uniform, 0.1f, 0.1f, 0.9f, 1.0f);
+    glDrawArrays(GL_LINE_STRIP, first + 2 + PROFILER_HISTORY_FRAMES, PROFILER_HISTORY_FRAMES);
+
+    glBindVertexArray(0);
+    glUseProgram(0);
+    glDepthFunc(GL_LESS);
+}
+
+bool Profiler::WriteChromeTrace(const char *filename) const
+{
+    FILE *file = fopen(filename, "w");
+    if (file == NULL)
+    {
+        fprintf(stderr, "ERROR: Cannot open trace file \"%s\".\n", filename);
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(this->trace_mutex);
+
+    fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    fprintf(file, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"GPU\"}}", PROFILER_GPU_THREAD);
+
+    for (size_t i = 0; i < this->trace_events.size(); ++i)
+    {
+        ProfilerTraceEvent const &event = this->trace_events[i];
+        fprintf(
+            file,
+            ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+            event.name,
+            event.thread,
+            event.start_us,
+            event.duration_us);
+    }
+
+    fprintf(file, "\n]}\n");
+    fclose(file);
+
+    std::cout << "Trace com " << this->trace_events.size() << " eventos escrito em \"" << filename << "\"" << std::endl;
+    return true;
+}
+
+ProfileScope::ProfileScope(const char *name):
+    name(name),
+    start_us(g_Profiler.NowMicroseconds())
+{
+}
+
+ProfileScope::~ProfileScope()
+{
+    g_Profiler.RecordCpuScope(this->name, this->start_us, g_Profiler.NowMicroseconds());
+}
+
+GpuProfileScope::GpuProfileScope(const char *name)
+{
+    g_Profiler.BeginGpuScope(name);
+}
+
+GpuProfileScope::~GpuProfileScope()
+{
+    g_Profiler.EndGpuScope();
+}
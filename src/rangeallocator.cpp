@@ -0,0 +1,89 @@
+#include <cassert>
+#include <algorithm>
+
+#include "rangeallocator.hpp"
+
+RangeAllocator::RangeAllocator(size_t capacity):
+    capacity(capacity),
+    used(0)
+{
+    if (capacity > 0)
+        this->free_ranges[0] = capacity;
+}
+
+size_t RangeAllocator::Allocate(size_t size, size_t alignment)
+{
+    if (size == 0 || alignment == 0)
+        return RangeAllocator::INVALID;
+
+    for (std::map<size_t, size_t>::iterator range = this->free_ranges.begin(); range != this->free_ranges.end(); ++range)
+    {
+        size_t start = range->first;
+        size_t end = range->first + range->second;
+        size_t offset = (start + alignment - 1) / alignment * alignment;
+        if (offset + size > end)
+            continue;
+
+        // O que sobra antes e depois do intervalo continua livre.
+        this->free_ranges.erase(range);
+        if (offset > start)
+            this->free_ranges[start] = offset - start;
+        if (end > offset + size)
+            this->free_ranges[offset + size] = end - (offset + size);
+
+        this->used += size;
+        return offset;
+    }
+
+    return RangeAllocator::INVALID;
+}
+
+void RangeAllocator::Free(size_t offset, size_t size)
+{
+    assert(offset + size <= this->capacity && size <= this->used);
+    this->used -= size;
+
+    // Junta com o intervalo livre seguinte e com o anterior, se encostarem.
+    std::map<size_t, size_t>::iterator next = this->free_ranges.lower_bound(offset);
+    if (next != this->free_ranges.end() && offset + size == next->first)
+    {
+        size += next->second;
+        next = this->free_ranges.erase(next);
+    }
+
+    if (next != this->free_ranges.begin())
+    {
+        std::map<size_t, size_t>::iterator previous = next;
+        --previous;
+        if (previous->first + previous->second == offset)
+        {
+            previous->second += size;
+            return;
+        }
+    }
+
+    this->free_ranges[offset] = size;
+}
+
+size_t RangeAllocator::Capacity() const
+{
+    return this->capacity;
+}
+
+size_t RangeAllocator::UsedSize() const
+{
+    return this->used;
+}
+
+size_t RangeAllocator::LargestFreeRange() const
+{
+    size_t largest = 0;
+    for (std::map<size_t, size_t>::const_iterator range = this->free_ranges.begin(); range != this->free_ranges.end(); ++range)
+        largest = std::max(largest, range->second);
+    return largest;
+}
+
+size_t RangeAllocator::NumFreeRanges() const
+{
+    return this->free_ranges.size();
+}
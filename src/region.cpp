@@ -0,0 +1,648 @@
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#include <direct.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "region.hpp"
+#include "profiler.hpp"
+
+#define REGION_MAGIC "FCGR"
+#define REGION_VERSION 1
+#define REGION_HEADER_SIZE 16
+
+void EncodeChunkRle(WorldChunk const &chunk, std::vector<unsigned char> &encoded)
+{
+    Block const *blocks = &chunk.blocks[0][0][0];
+    size_t num_blocks = CHUNK_SIZE * CHUNK_SIZE * CHUNK_SIZE;
+
+    encoded.clear();
+    for (size_t i = 0; i < num_blocks;)
+    {
+        size_t run = 1;
+        while (run < 255 && i + run < num_blocks && blocks[i + run] == blocks[i])
+            run++;
+
+        encoded.push_back(run);
+        encoded.push_back(blocks[i]);
+        i += run;
+    }
+}
+
+bool DecodeChunkRle(unsigned char const *data, size_t size, WorldChunk &chunk)
+{
+    Block *blocks = &chunk.blocks[0][0][0];
+    size_t num_blocks = CHUNK_SIZE * CHUNK_SIZE * CHUNK_SIZE;
+
+    size_t count = 0;
+    for (size_t i = 0; i + 1 < size; i += 2)
+    {
+        size_t run = data[i];
+        if (run == 0 || count + run > num_blocks)
+            return false;
+
+        std::fill(blocks + count, blocks + count + run, (Block)data[i + 1]);
+        count += run;
+    }
+    return count == num_blocks && size % 2 == 0;
+}
+
+MappedFile::MappedFile():
+    data(NULL),
+    size(0)
+#ifdef _WIN32
+    , file_handle(INVALID_HANDLE_VALUE),
+    mapping_handle(NULL)
+#endif
+{
+}
+
+MappedFile::~MappedFile()
+{
+    this->Close();
+}
+
+#ifdef _WIN32
+
+bool MappedFile::Open(std::string const &path)
+{
+    this->Close();
+
+    this->file_handle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (this->file_handle == INVALID_HANDLE_VALUE)
+        return false;
+
+    LARGE_INTEGER file_size;
+    if (!GetFileSizeEx(this->file_handle, &file_size) || file_size.QuadPart == 0)
+    {
+        this->Close();
+        return false;
+    }
+
+    this->mapping_handle = CreateFileMappingA(this->file_handle, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (this->mapping_handle == NULL)
+    {
+        this->Close();
+        return false;
+    }
+
+    this->data = (unsigned char const *)MapViewOfFile(this->mapping_handle, FILE_MAP_READ, 0, 0, 0);
+    if (this->data == NULL)
+    {
+        this->Close();
+        return false;
+    }
+
+    this->size = file_size.QuadPart;
+    return true;
+}
+
+void MappedFile::Close()
+{
+    if (this->data != NULL)
+        UnmapViewOfFile(this->data);
+    if (this->mapping_handle != NULL)
+        CloseHandle(this->mapping_handle);
+    if (this->file_handle != INVALID_HANDLE_VALUE)
+        CloseHandle(this->file_handle);
+
+    this->data = NULL;
+    this->size = 0;
+    this->mapping_handle = NULL;
+    this->file_handle = INVALID_HANDLE_VALUE;
+}
+
+#else
+
+bool MappedFile::Open(std::string const &path)
+{
+    this->Close();
+
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size == 0)
+    {
+        close(fd);
+        return false;
+    }
+
+    // O mapeamento continua válido depois de fechar o descritor.
+    void *mapping = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED)
+        return false;
+
+    this->data = (unsigned char const *)mapping;
+    this->size = info.st_size;
+    return true;
+}
+
+void MappedFile::Close()
+{
+    if (this->data != NULL)
+        munmap((void *)this->data, this->size);
+
+    this->data = NULL;
+    this->size = 0;
+}
+
+#endif
+
+unsigned char const *MappedFile::Data() const
+{
+    return this->data;
+}
+
+size_t MappedFile::Size() const
+{
+    return this->size;
+}
+
+static uint32_t Region_ReadU32(unsigned char const *data)
+{
+    uint32_t value;
+    memcpy(&value, data, sizeof(value));
+    return value;
+}
+
+bool RegionFile::Open(std::string const &path, size_t chunks_y)
+{
+    this->chunks_y = chunks_y;
+    if (!this->file.Open(path))
+        return false;
+
+    size_t table_entries = REGION_SIZE * chunks_y * REGION_SIZE;
+    unsigned char const *data = this->file.Data();
+    if (this->file.Size() < REGION_HEADER_SIZE + 8 * table_entries
+        || memcmp(data, REGION_MAGIC, 4) != 0
+        || Region_ReadU32(data + 4) != REGION_VERSION
+        || Region_ReadU32(data + 8) != chunks_y)
+    {
+        std::cerr << "ERROR: \"" << path << "\" is not a valid region file." << std::endl;
+        this->file.Close();
+        return false;
+    }
+
+    return true;
+}
+
+void RegionFile::Close()
+{
+    this->file.Close();
+}
+
+bool RegionFile::ChunkData(size_t local_x, size_t chunk_y, size_t local_z, unsigned char const *&data, size_t &size) const
+{
+    size_t entry = (local_x * this->chunks_y + chunk_y) * REGION_SIZE + local_z;
+    unsigned char const *table = this->file.Data() + REGION_HEADER_SIZE;
+
+    uint32_t offset = Region_ReadU32(table + 8 * entry);
+    uint32_t length = Region_ReadU32(table + 8 * entry + 4);
+    if (length == 0 || (size_t)offset + length > this->file.Size())
+        return false;
+
+    data = this->file.Data() + offset;
+    size = length;
+    return true;
+}
+
+bool Region_ReplaceFile(std::string const &from, std::string const &to)
+{
+#ifdef _WIN32
+    return MoveFileExA(from.c_str(), to.c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+    return rename(from.c_str(), to.c_str()) == 0;
+#endif
+}
+
+static bool Region_MakeDirectory(std::string const &path)
+{
+#ifdef _WIN32
+    return _mkdir(path.c_str()) == 0 || errno == EEXIST;
+#else
+    return mkdir(path.c_str(), 0755) == 0 || errno == EEXIST;
+#endif
+}
+
+bool WriteRegionFile(std::string const &path, size_t chunks_y, std::vector<std::vector<unsigned char> > const &chunks)
+{
+    std::string temporary_path = path + ".tmp";
+    FILE *file = fopen(temporary_path.c_str(), "wb");
+    if (file == NULL)
+    {
+        std::cerr << "ERROR: Cannot open \"" << temporary_path << "\" for writing." << std::endl;
+        return false;
+    }
+
+    uint32_t header[3] = { REGION_VERSION, (uint32_t)chunks_y, 0 };
+    fwrite(REGION_MAGIC, 1, 4, file);
+    fwrite(header, sizeof(uint32_t), 3, file);
+
+    std::vector<uint32_t> table(2 * chunks.size(), 0);
+    uint32_t offset = REGION_HEADER_SIZE + table.size() * sizeof(uint32_t);
+    for (size_t i = 0; i < chunks.size(); ++i)
+    {
+        table[2 * i] = chunks[i].empty() ? 0 : offset;
+        table[2 * i + 1] = chunks[i].size();
+        offset += chunks[i].size();
+    }
+    fwrite(table.data(), sizeof(uint32_t), table.size(), file);
+
+    for (size_t i = 0; i < chunks.size(); ++i)
+        fwrite(chunks[i].data(), 1, chunks[i].size(), file);
+
+    bool ok = ferror(file) == 0;
+    ok = fclose(file) == 0 && ok;
+    if (!ok || !Region_ReplaceFile(temporary_path, path))
+    {
+        std::cerr << "ERROR: Cannot write region file \"" << path << "\"." << std::endl;
+        remove(temporary_path.c_str());
+        return false;
+    }
+    return true;
+}
+
+RegionStore::RegionStore():
+    persistent(false),
+    chunks_x(0),
+    chunks_y(0),
+    chunks_z(0),
+    pending_bytes(0),
+    generation(0),
+    writing(false),
+    stopping(false),
+    regions_written(0),
+    failed_writes(0)
+{
+}
+
+RegionStore::~RegionStore()
+{
+    if (!this->writer.joinable())
+        return;
+
+    // As regiões agendadas são gravadas antes de a thread terminar.
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        this->stopping = true;
+    }
+    this->changed.notify_all();
+    this->writer.join();
+}
+
+bool RegionStore::Open(const char *directory, WorldPoint size_in_chunks)
+{
+    this->chunks_x = size_in_chunks.x;
+    this->chunks_y = size_in_chunks.y;
+    this->chunks_z = size_in_chunks.z;
+
+    if (directory == NULL)
+        return true;
+
+    if (!Region_MakeDirectory(directory))
+    {
+        std::cerr << "ERROR: Cannot create directory \"" << directory << "\"." << std::endl;
+        return false;
+    }
+
+    this->directory = directory;
+    this->persistent = true;
+    this->writer = std::thread(&RegionStore::WriterThread, this);
+    return true;
+}
+
+size_t RegionStore::ChunkKey(size_t chunk_x, size_t chunk_y, size_t chunk_z) const
+{
+    return (chunk_x * this->chunks_y + chunk_y) * this->chunks_z + chunk_z;
+}
+
+size_t RegionStore::RegionKey(size_t chunk_x, size_t chunk_z) const
+{
+    size_t regions_z = (this->chunks_z + REGION_SIZE - 1) / REGION_SIZE;
+    return (chunk_x / REGION_SIZE) * regions_z + chunk_z / REGION_SIZE;
+}
+
+std::string RegionStore::RegionPath(size_t region_x, size_t region_z) const
+{
+    char name[64];
+    snprintf(name, sizeof(name), "/r.%u.%u.fcgr", (unsigned)region_x, (unsigned)region_z);
+    return this->directory + name;
+}
+
+void RegionStore::Save(size_t chunk_x, size_t chunk_y, size_t chunk_z, WorldChunk const &chunk)
+{
+    std::vector<unsigned char> encoded;
+    EncodeChunkRle(chunk, encoded);
+
+    size_t region = this->RegionKey(chunk_x, chunk_z);
+
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        PendingChunk &stored = this->pending[this->ChunkKey(chunk_x, chunk_y, chunk_z)];
+        this->pending_bytes -= stored.data.size();
+        this->pending_bytes += encoded.size();
+        stored.data.swap(encoded);
+        stored.generation = ++this->generation;
+
+        if (this->persistent)
+            this->dirty_regions.insert(region);
+    }
+    this->changed.notify_all();
+}
+
+bool RegionStore::Load(size_t chunk_x, size_t chunk_y, size_t chunk_z, WorldChunk &chunk) const
+{
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        std::unordered_map<size_t, PendingChunk>::const_iterator it = this->pending.find(this->ChunkKey(chunk_x, chunk_y, chunk_z));
+        if (it != this->pending.end())
+            return DecodeChunkRle(it->second.data.data(), it->second.data.size(), chunk);
+    }
+
+    if (!this->persistent)
+        return false;
+
+    // Um chunk só sai de "pending" depois que o arquivo com ele substituiu o
+    // anterior, e o arquivo substituído já saiu de open_files.
+    std::shared_ptr<RegionFile> region;
+    {
+        std::lock_guard<std::mutex> lock(this->file_mutex);
+
+        size_t key = this->RegionKey(chunk_x, chunk_z);
+        std::unordered_map<size_t, std::shared_ptr<RegionFile> >::iterator it = this->open_files.find(key);
+        if (it == this->open_files.end())
+        {
+            if (this->open_files.size() >= REGION_MAX_OPEN_FILES)
+            {
+                for (it = this->open_files.begin(); it != this->open_files.end(); )
+                {
+                    if (it->second.use_count() <= 1)
+                        it = this->open_files.erase(it);
+                    else
+                        ++it;
+                }
+            }
+
+            std::shared_ptr<RegionFile> file = std::make_shared<RegionFile>();
+            if (!file->Open(this->RegionPath(chunk_x / REGION_SIZE, chunk_z / REGION_SIZE), this->chunks_y))
+                file.reset();
+            it = this->open_files.insert(std::make_pair(key, file)).first;
+        }
+        region = it->second;
+    }
+
+    if (!region)
+        return false;
+
+    unsigned char const *data;
+    size_t size;
+    bool ok = region->ChunkData(chunk_x % REGION_SIZE, chunk_y, chunk_z % REGION_SIZE, data, size)
+        && DecodeChunkRle(data, size, chunk);
+
+    // A referência é solta com file_mutex, para que WriteRegion() não perca
+    // o aviso entre consultar as referências e esperar.
+    {
+        std::lock_guard<std::mutex> lock(this->file_mutex);
+        region.reset();
+    }
+    this->file_released.notify_all();
+    return ok;
+}
+
+void RegionStore::Flush()
+{
+    std::unique_lock<std::mutex> lock(this->mutex);
+    size_t failed_writes = this->failed_writes;
+    while ((!this->dirty_regions.empty() || this->writing) && this->failed_writes == failed_writes)
+        this->changed.wait(lock);
+}
+
+bool RegionStore::IsIdle() const
+{
+    std::lock_guard<std::mutex> lock(this->mutex);
+    return this->dirty_regions.empty() && !this->writing;
+}
+
+uint64_t RegionStore::SaveGeneration() const
+{
+    std::lock_guard<std::mutex> lock(this->mutex);
+    return this->generation;
+}
+
+bool RegionStore::IsWritten(uint64_t generation) const
+{
+    if (!this->persistent)
+        return true;
+
+    // Um chunk só sai de "pending" depois de gravado; salvo de novo, a
+    // geração aumenta, e os dados novos incluem os antigos.
+    std::lock_guard<std::mutex> lock(this->mutex);
+    std::unordered_map<size_t, PendingChunk>::const_iterator it;
+    for (it = this->pending.begin(); it != this->pending.end(); ++it)
+        if (it->second.generation <= generation)
+            return false;
+    return true;
+}
+
+size_t RegionStore::PendingChunks() const
+{
+    std::lock_guard<std::mutex> lock(this->mutex);
+    return this->pending.size();
+}
+
+size_t RegionStore::PendingBytes() const
+{
+    std::lock_guard<std::mutex> lock(this->mutex);
+    return this->pending_bytes;
+}
+
+size_t RegionStore::RegionsWritten() const
+{
+    std::lock_guard<std::mutex> lock(this->mutex);
+    return this->regions_written;
+}
+
+void RegionStore::WriterThread()
+{
+    std::unique_lock<std::mutex> lock(this->mutex);
+    for (;;)
+    {
+        while (this->dirty_regions.empty() && !this->stopping)
+            this->changed.wait(lock);
+
+        if (this->dirty_regions.empty())
+            break;
+
+        size_t region = *this->dirty_regions.begin();
+        this->dirty_regions.erase(this->dirty_regions.begin());
+        this->writing = true;
+
+        lock.unlock();
+        bool ok = this->WriteRegion(region);
+        lock.lock();
+
+        this->writing = false;
+        if (ok)
+        {
+            this->regions_written++;
+            this->changed.notify_all();
+            continue;
+        }
+
+        // Os chunks da região continuam pendentes. Ao terminar, a região
+        // não é gravada de novo: as alterações continuam no diário.
+        this->failed_writes++;
+        this->changed.notify_all();
+        if (this->stopping)
+            continue;
+
+        this->dirty_regions.insert(region);
+        std::chrono::steady_clock::time_point retry = std::chrono::steady_clock::now() + std::chrono::milliseconds(REGION_RETRY_MS);
+        while (!this->stopping && this->changed.wait_until(lock, retry) != std::cv_status::timeout)
+            ;
+    }
+}
+
+bool RegionStore::WriteRegion(size_t region)
+{
+    ProfileScope cpu_scope("region write");
+
+    size_t regions_z = (this->chunks_z + REGION_SIZE - 1) / REGION_SIZE;
+    size_t first_x = (region / regions_z) * REGION_SIZE;
+    size_t first_z = (region % regions_z) * REGION_SIZE;
+
+    std::vector<std::vector<unsigned char> > chunks(REGION_SIZE * this->chunks_y * REGION_SIZE);
+    std::vector<std::pair<size_t, uint64_t> > written; // Chave e geração dos chunks gravados
+
+    // Chunks salvos desde a última gravação...
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        for (size_t x = 0; x < REGION_SIZE && first_x + x < this->chunks_x; ++x)
+        {
+            for (size_t y = 0; y < this->chunks_y; ++y)
+            {
+                for (size_t z = 0; z < REGION_SIZE && first_z + z < this->chunks_z; ++z)
+                {
+                    size_t key = this->ChunkKey(first_x + x, y, first_z + z);
+                    std::unordered_map<size_t, PendingChunk>::const_iterator it = this->pending.find(key);
+                    if (it == this->pending.end())
+                        continue;
+
+                    chunks[(x * this->chunks_y + y) * REGION_SIZE + z] = it->second.data;
+                    written.push_back(std::make_pair(key, it->second.generation));
+                }
+            }
+        }
+    }
+
+    std::string path = this->RegionPath(first_x / REGION_SIZE, first_z / REGION_SIZE);
+    bool ok;
+    {
+        std::unique_lock<std::mutex> lock(this->file_mutex);
+
+        // O arquivo aberto por Load() é reaproveitado e sai de open_files;
+        // as leituras seguintes esperam a gravação e abrem o arquivo novo.
+        std::shared_ptr<RegionFile> previous;
+        std::unordered_map<size_t, std::shared_ptr<RegionFile> >::iterator it = this->open_files.find(region);
+        if (it != this->open_files.end())
+        {
+            previous = it->second;
+            this->open_files.erase(it);
+        }
+        else
+        {
+            previous = std::make_shared<RegionFile>();
+            if (!previous->Open(path, this->chunks_y))
+                previous.reset();
+        }
+
+        // ... e os demais, do arquivo atual.
+        if (previous)
+        {
+            for (size_t x = 0; x < REGION_SIZE; ++x)
+            {
+                for (size_t y = 0; y < this->chunks_y; ++y)
+                {
+                    for (size_t z = 0; z < REGION_SIZE; ++z)
+                    {
+                        std::vector<unsigned char> &chunk = chunks[(x * this->chunks_y + y) * REGION_SIZE + z];
+                        unsigned char const *data;
+                        size_t size;
+                        if (chunk.empty() && previous->ChunkData(x, y, z, data, size))
+                            chunk.assign(data, data + size);
+                    }
+                }
+            }
+
+            // No Windows um arquivo mapeado não pode ser substituído.
+            while (previous.use_count() > 1)
+                this->file_released.wait(lock);
+            previous.reset();
+        }
+
+        ok = WriteRegionFile(path, this->chunks_y, chunks);
+    }
+
+    // Chunks salvos de novo durante a gravação continuam pendentes.
+    if (ok)
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        for (size_t i = 0; i < written.size(); ++i)
+        {
+            std::unordered_map<size_t, PendingChunk>::iterator it = this->pending.find(written[i].first);
+            if (it != this->pending.end() && it->second.generation == written[i].second)
+            {
+                this->pending_bytes -= it->second.data.size();
+                this->pending.erase(it);
+            }
+        }
+    }
+    return ok;
+}
+
+bool ReadWorldInfo(const char *directory, uint32_t &seed, WorldPoint &size)
+{
+    std::ifstream file((std::string(directory) + "/world.txt").c_str());
+    if (!file)
+        return false;
+
+    std::string key;
+    while (file >> key)
+    {
+        if (key == "seed")
+            file >> seed;
+        else if (key == "size")
+            file >> size.x >> size.y >> size.z;
+    }
+    return true;
+}
+
+bool WriteWorldInfo(const char *directory, uint32_t seed, WorldPoint size)
+{
+    std::ofstream file((std::string(directory) + "/world.txt").c_str());
+    if (!file)
+    {
+        std::cerr << "ERROR: Cannot write \"" << directory << "/world.txt\"." << std::endl;
+        return false;
+    }
+
+    file << "seed " << seed << std::endl;
+    file << "size " << size.x << " " << size.y << " " << size.z << std::endl;
+    return true;
+}
@@ -1,10 +1,39 @@
 #include <glm/gtc/type_ptr.hpp>
 #include <iostream>
+#include <map>
+#include <tuple>
 #include "scene.hpp"
 #include "matrices.hpp"
+#include "meshsimplify.hpp"
 #include "tiny_obj_loader.h"
+#include "profiler.hpp"
 
-void SceneObject::Draw(GLint bbox_min_uniform, GLint bbox_max_uniform) const
+size_t SceneObject::SelectLod(glm::mat4 const &model, glm::mat4 const &view, glm::mat4 const &projection, int viewport_height) const
+{
+    // Raio no sistema do mundo: a matriz model pode ter escala.
+    glm::vec3 center = (this->bbox_min + this->bbox_max) * 0.5f;
+    float scale = std::max(glm::length(glm::vec3(model[0])), std::max(glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2]))));
+    float radius = 0.5f * glm::length(this->bbox_max - this->bbox_min) * scale;
+
+    // Na projeção perspectiva, w é a distância até a câmera; na ortográfica,
+    // é 1. Em ambas, projection[1][1] leva a altura para o NDC, que tem 2
+    // unidades de altura.
+    glm::vec4 clip = projection * view * model * glm::vec4(center, 1.0f);
+    if (clip.w <= radius * 1e-3f)
+        return 0;
+    float pixels = radius * projection[1][1] / clip.w * viewport_height;
+
+    size_t lod = 0;
+    float threshold = SCENE_LOD_FULL_DETAIL_PIXELS;
+    while (lod + 1 < this->num_lods && pixels < threshold)
+    {
+        lod++;
+        threshold *= 0.5f;
+    }
+    return lod;
+}
+
+void SceneObject::Draw(GLint bbox_min_uniform, GLint bbox_max_uniform, size_t lod) const
 {
     // "Ligamos" o VAO. Informamos que queremos utilizar os atributos de
     // vértices apontados pelo VAO criado pela função BuildTrianglesAndAddToVirtualScene(). Veja
@@ -25,10 +54,11 @@ void SceneObject::Draw(GLint bbox_min_uniform, GLint bbox_max_uniform) const
     // http://docs.gl/gl3/glDrawElements.
     glDrawElements(
         this->rendering_mode,
-        this->num_indices,
+        this->lod_num_indices[lod],
         GL_UNSIGNED_INT,
-        (void*)(this->first_index * sizeof(GLuint))
+        (void*)(this->lod_first_index[lod] * sizeof(GLuint))
     );
+    g_Profiler.CountDrawCall(this->lod_num_indices[lod] / 3);
 
     // "Desligamos" o VAO, evitando assim que operações posteriores venham a
     // alterar o mesmo. Isso evita bugs.
@@ -113,6 +143,21 @@ void ObjModel::ComputeNormals()
 }
 
 
+// Copia os coeficientes para um intervalo novo de g_GpuMemory e liga o
+// atributo location do VAO atual a ele.
+static GpuAllocation UploadAttribute(std::vector<float> const &coefficients, GLuint location, GLint number_of_dimensions)
+{
+    size_t bytes = coefficients.size() * sizeof(float);
+    GpuAllocation allocation = g_GpuMemory.Allocate(bytes, sizeof(float), false);
+    g_GpuMemory.Upload(allocation, 0, bytes, coefficients.data());
+
+    glBindBuffer(GL_ARRAY_BUFFER, g_GpuMemory.ArenaBuffer(g_GpuMemory.Arena(allocation)));
+    glVertexAttribPointer(location, number_of_dimensions, GL_FLOAT, GL_FALSE, 0, (void *)g_GpuMemory.Offset(allocation));
+    glEnableVertexAttribArray(location);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    return allocation;
+}
+
 void ObjModel::BuildTriangles(VirtualScene &target_virtual_scene) const
 {
     GLuint vertex_array_object_id;
@@ -123,6 +168,7 @@ void ObjModel::BuildTriangles(VirtualScene &target_virtual_scene) const
     std::vector<float>  model_coefficients;
     std::vector<float>  normal_coefficients;
     std::vector<float>  texture_coefficients;
+    std::vector<SceneObject> objects;
 
     for (size_t shape = 0; shape < this->shapes.size(); ++shape) {
         size_t first_index = indices.size();
@@ -134,13 +180,29 @@ void ObjModel::BuildTriangles(VirtualScene &target_virtual_scene) const
         glm::vec3 bbox_min = glm::vec3(maxval,maxval,maxval);
         glm::vec3 bbox_max = glm::vec3(minval,minval,minval);
 
+        // Os cantos dos triângulos com a mesma posição, normal e coordenada
+        // de textura compartilham o vértice, para que a simplificação saiba
+        // quais triângulos são vizinhos. Os índices de shape_indices são
+        // relativos ao primeiro vértice do objeto.
+        GLuint base_vertex = model_coefficients.size() / 4;
+        std::map<std::tuple<int, int, int>, GLuint> shape_vertices;
+        std::vector<glm::vec3> shape_positions;
+        std::vector<GLuint>    shape_indices;
+
         for (size_t triangle = 0; triangle < num_triangles; ++triangle) {
             assert(this->shapes[shape].mesh.num_face_vertices[triangle] == 3);
 
             for (size_t vertex = 0; vertex < 3; ++vertex) {
                 tinyobj::index_t idx = this->shapes[shape].mesh.indices[3*triangle + vertex];
 
-                indices.push_back(first_index + 3*triangle + vertex);
+                std::tuple<int, int, int> key(idx.vertex_index, idx.normal_index, idx.texcoord_index);
+                auto found = shape_vertices.find(key);
+                if (found != shape_vertices.end()) {
+                    shape_indices.push_back(found->second);
+                    continue;
+                }
+                shape_vertices[key] = shape_positions.size();
+                shape_indices.push_back(shape_positions.size());
 
                 const float vx = this->attrib.vertices[3*idx.vertex_index + 0];
                 const float vy = this->attrib.vertices[3*idx.vertex_index + 1];
@@ -150,6 +212,7 @@ void ObjModel::BuildTriangles(VirtualScene &target_virtual_scene) const
                 model_coefficients.push_back( vy ); // Y
                 model_coefficients.push_back( vz ); // Z
                 model_coefficients.push_back( 1.0f ); // W
+                shape_positions.push_back(glm::vec3(vx, vy, vz));
 
                 bbox_min.x = std::min(bbox_min.x, vx);
                 bbox_min.y = std::min(bbox_min.y, vy);
@@ -182,71 +245,85 @@ void ObjModel::BuildTriangles(VirtualScene &target_virtual_scene) const
             }
         }
 
-        size_t last_index = indices.size() - 1;
-
+        // Níveis de detalhe: cada um é a simplificação do anterior, e os
+        // índices de todos vão para o mesmo buffer. O erro de cada nível é
+        // limitado a um pixel no maior diâmetro em que o nível é usado (veja
+        // SelectLod()).
+        float diameter = glm::length(bbox_max - bbox_min);
         SceneObject theobject;
+        theobject.num_lods = 0;
+        std::vector<GLuint> simplified;
+        for (size_t lod = 0; lod < SCENE_LOD_LEVELS; ++lod) {
+            if (lod > 0) {
+                size_t target = (size_t)(shape_indices.size() / 3 * SCENE_LOD_TRIANGLE_RATIO);
+                float max_error = diameter * (1 << (lod - 1)) / SCENE_LOD_FULL_DETAIL_PIXELS;
+                SimplifyMesh(shape_positions, shape_indices, target, max_error, simplified);
+
+                // Um nível com quase todos os triângulos do anterior não
+                // compensa.
+                if (4 * simplified.size() > 3 * shape_indices.size())
+                    break;
+                shape_indices.swap(simplified);
+            }
+
+            theobject.lod_first_index[lod] = indices.size();
+            theobject.lod_num_indices[lod] = shape_indices.size();
+            for (size_t i = 0; i < shape_indices.size(); ++i)
+                indices.push_back(base_vertex + shape_indices[i]);
+            theobject.num_lods++;
+        }
+
+        std::cout << "Objeto \"" << this->shapes[shape].name << "\": " << num_triangles << " triângulos";
+        for (size_t lod = 1; lod < theobject.num_lods; ++lod)
+            std::cout << ", nível " << lod << " com " << theobject.lod_num_indices[lod] / 3;
+        std::cout << std::endl;
+
         theobject.name           = this->shapes[shape].name;
         theobject.first_index    = first_index; // Primeiro índice
-        theobject.num_indices    = last_index - first_index + 1; // Número de indices
+        theobject.num_indices    = theobject.lod_num_indices[0]; // Número de indices
         theobject.rendering_mode = GL_TRIANGLES;       // Índices correspondem ao tipo de rasterização GL_TRIANGLES.
         theobject.vertex_array_object_id = vertex_array_object_id;
 
         theobject.bbox_min = bbox_min;
         theobject.bbox_max = bbox_max;
 
-        target_virtual_scene.insert(theobject);
-    }
-
-    GLuint VBO_model_coefficients_id;
-    glGenBuffers(1, &VBO_model_coefficients_id);
-    glBindBuffer(GL_ARRAY_BUFFER, VBO_model_coefficients_id);
-    glBufferData(GL_ARRAY_BUFFER, model_coefficients.size() * sizeof(float), NULL, GL_STATIC_DRAW);
-    glBufferSubData(GL_ARRAY_BUFFER, 0, model_coefficients.size() * sizeof(float), model_coefficients.data());
-    GLuint location = 0; // "(location = 0)" em "shader_vertex.glsl"
-    GLint  number_of_dimensions = 4; // vec4 em "shader_vertex.glsl"
-    glVertexAttribPointer(location, number_of_dimensions, GL_FLOAT, GL_FALSE, 0, 0);
-    glEnableVertexAttribArray(location);
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
-
-    if (!normal_coefficients.empty()) {
-        GLuint VBO_normal_coefficients_id;
-        glGenBuffers(1, &VBO_normal_coefficients_id);
-        glBindBuffer(GL_ARRAY_BUFFER, VBO_normal_coefficients_id);
-        glBufferData(GL_ARRAY_BUFFER, normal_coefficients.size() * sizeof(float), NULL, GL_STATIC_DRAW);
-        glBufferSubData(GL_ARRAY_BUFFER, 0, normal_coefficients.size() * sizeof(float), normal_coefficients.data());
-        location = 1; // "(location = 1)" em "shader_vertex.glsl"
-        number_of_dimensions = 4; // vec4 em "shader_vertex.glsl"
-        glVertexAttribPointer(location, number_of_dimensions, GL_FLOAT, GL_FALSE, 0, 0);
-        glEnableVertexAttribArray(location);
-        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        objects.push_back(theobject);
     }
 
-    if (!texture_coefficients.empty()) {
-        GLuint VBO_texture_coefficients_id;
-        glGenBuffers(1, &VBO_texture_coefficients_id);
-        glBindBuffer(GL_ARRAY_BUFFER, VBO_texture_coefficients_id);
-        glBufferData(GL_ARRAY_BUFFER, texture_coefficients.size() * sizeof(float), NULL, GL_STATIC_DRAW);
-        glBufferSubData(GL_ARRAY_BUFFER, 0, texture_coefficients.size() * sizeof(float), texture_coefficients.data());
-        location = 2; // "(location = 1)" em "shader_vertex.glsl"
-        number_of_dimensions = 2; // vec2 em "shader_vertex.glsl"
-        glVertexAttribPointer(location, number_of_dimensions, GL_FLOAT, GL_FALSE, 0, 0);
-        glEnableVertexAttribArray(location);
-        glBindBuffer(GL_ARRAY_BUFFER, 0);
-    }
+    // Os atributos e os índices ficam em intervalos de g_GpuMemory, em vez
+    // de um buffer por atributo. Os intervalos não são movidos pela
+    // compactação, porque o VAO guarda o início de cada um.
+    std::vector<GpuAllocation> allocations;
+    allocations.push_back(UploadAttribute(model_coefficients, 0, 4)); // "(location = 0)", vec4 em "shader_vertex.glsl"
+    if (!normal_coefficients.empty())
+        allocations.push_back(UploadAttribute(normal_coefficients, 1, 4)); // "(location = 1)", vec4 em "shader_vertex.glsl"
+    if (!texture_coefficients.empty())
+        allocations.push_back(UploadAttribute(texture_coefficients, 2, 2)); // "(location = 2)", vec2 em "shader_vertex.glsl"
 
-    GLuint indices_id;
-    glGenBuffers(1, &indices_id);
+    GpuAllocation indices_allocation = g_GpuMemory.Allocate(indices.size() * sizeof(GLuint), sizeof(GLuint), false);
+    g_GpuMemory.Upload(indices_allocation, 0, indices.size() * sizeof(GLuint), indices.data());
+    allocations.push_back(indices_allocation);
 
     // "Ligamos" o buffer. Note que o tipo agora é GL_ELEMENT_ARRAY_BUFFER.
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indices_id);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(GLuint), NULL, GL_STATIC_DRAW);
-    glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, 0, indices.size() * sizeof(GLuint), indices.data());
+    // A ligação fica guardada no VAO, que ainda está ligado.
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, g_GpuMemory.ArenaBuffer(g_GpuMemory.Arena(indices_allocation)));
     // glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0); // XXX Errado!
     //
 
     // "Desligamos" o VAO, evitando assim que operações posteriores venham a
     // alterar o mesmo. Isso evita bugs.
     glBindVertexArray(0);
+
+    // Os índices dos objetos passam a contar do início da arena.
+    size_t arena_first_index = g_GpuMemory.Offset(indices_allocation) / sizeof(GLuint);
+    for (size_t i = 0; i < objects.size(); ++i)
+    {
+        objects[i].first_index += arena_first_index;
+        for (size_t lod = 0; lod < objects[i].num_lods; ++lod)
+            objects[i].lod_first_index[lod] += arena_first_index;
+        target_virtual_scene.insert(objects[i]);
+    }
+    target_virtual_scene.insert_buffers(vertex_array_object_id, allocations);
 }
 
 void ObjModel::NewIntoVirtualScene(
@@ -268,6 +345,14 @@ VirtualScene::VirtualScene()
     ObjModel::NewIntoVirtualScene(*this, "../../data/eye.obj");
 }
 
+VirtualScene::~VirtualScene()
+{
+    for (size_t i = 0; i < this->allocations.size(); ++i)
+        g_GpuMemory.Free(this->allocations[i]);
+    for (size_t i = 0; i < this->vertex_array_object_ids.size(); ++i)
+        glDeleteVertexArrays(1, &this->vertex_array_object_ids[i]);
+}
+
 
 void VirtualScene::insert(SceneObject new_scene_object)
 {
@@ -282,6 +367,12 @@ void VirtualScene::insert(SceneObject new_scene_object)
     this->objects[new_scene_object.name]  = new_scene_object;
 }
 
+void VirtualScene::insert_buffers(GLuint vertex_array_object_id, std::vector<GpuAllocation> const &allocations)
+{
+    this->vertex_array_object_ids.push_back(vertex_array_object_id);
+    this->allocations.insert(this->allocations.end(), allocations.begin(), allocations.end());
+}
+
 SceneObject const &VirtualScene::operator [] (char const *name) const
 {
     auto find_iter = this->objects.find(name);
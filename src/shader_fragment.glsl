@@ -13,6 +13,14 @@ in vec4 position_model;
 // Coordenadas de textura obtidas do arquivo OBJ (se existirem!)
 in vec2 texcoords;
 
+// Luz do céu (x) e dos blocos emissores (y) em frente à face, em [0, 1].
+// Somente as malhas dos chunks têm estes valores.
+in vec2 light;
+
+// Oclusão ambiente calculada nos cantos de cada face, em [0, 1] (1 = sem
+// oclusão). Somente as malhas dos chunks têm este valor.
+in float occlusion;
+
 // Matrizes computadas no código C++ e enviadas para a GPU
 uniform mat4 model;
 uniform mat4 view;
@@ -22,6 +30,7 @@ uniform mat4 projection;
 #define OBJ_BLOCK 0
 #define OBJ_COW 1
 #define OBJ_EYE 2
+#define OBJ_CHUNK 3
 uniform int object_id;
 
 // Parâmetros da axis-aligned bounding box (AABB) do modelo
@@ -31,14 +40,41 @@ uniform vec4 bbox_max;
 // Variáveis para acesso das imagens de textura
 uniform sampler2D selected_texture;
 
+// Sentido do ponto para o sol e as cascatas do mapa de sombras, calculados
+// em "shadowmap.cpp". SHADOW_CASCADES deve ser o mesmo de "shadowmap.hpp".
+#define SHADOW_CASCADES 3
+uniform vec4 sun_direction;
+uniform sampler2DArrayShadow shadow_map;
+uniform mat4 shadow_matrices[SHADOW_CASCADES];
+uniform float shadow_splits[SHADOW_CASCADES];
+uniform float shadow_texel_sizes[SHADOW_CASCADES];
+
 // O valor de saída ("out") de um Fragment Shader é a cor final do fragmento.
 out vec4 color;
 
 // Constantes
 #define M_PI   3.14159265358979323846
 #define M_PI_2 1.57079632679489661923
-float pi = 3.1415f;
-float abertura = pi/6.0f;
+
+// Fração da luz do sol que chega ao ponto p, de normal n: 0 na sombra e 1
+// fora dela. A cascata é escolhida pela distância à câmera; pontos além da
+// última cascata não recebem sombra.
+float SunVisibility(vec4 p, vec4 n)
+{
+    float depth = -(view * p).z;
+    for (int i = 0; i < SHADOW_CASCADES; ++i)
+    {
+        if (depth <= shadow_splits[i])
+        {
+            // Deslocamos o ponto ao longo da normal em um texel e meio, para
+            // que a superfície não faça sombra sobre si mesma.
+            vec4 q = shadow_matrices[i] * (p + n * 1.5 * shadow_texel_sizes[i]);
+            vec3 coords = q.xyz * 0.5 + 0.5;
+            return texture(shadow_map, vec4(coords.xy, float(i), coords.z));
+        }
+    }
+    return 1.0;
+}
 
 void main()
 {
@@ -58,8 +94,9 @@ void main()
     // normais de cada vértice.
     vec4 n = normalize(normal);
 
-    // Vetor que define o sentido da fonte de luz em relação ao ponto atual.
-    vec4 l = normalize(vec4(1.0,1.0,0.0,0.0));
+    // Vetor que define o sentido da fonte de luz (o sol) em relação ao ponto
+    // atual.
+    vec4 l = normalize(sun_direction);
 
     // Vetor que define o sentido da câmera em relação ao ponto atual.
     vec4 v = normalize(camera_position - p);
@@ -70,10 +107,6 @@ void main()
 
     vec3 Kd;
 
-    vec4 sentidoLuz = normalize(vec4(0.0,1.0,0.0,0.0));
-    float beta = dot(p-l,sentidoLuz);
-    float alpha = cos(abertura);
-
     vec3 Ka;
     vec3 Ks;
     float q;
@@ -102,6 +135,25 @@ void main()
         color.rgb = Kd * (lambert + 0.01);
 
     }
+    else if (object_id == OBJ_CHUNK) {
+        // Malha de um chunk: as coordenadas de textura de cada face vêm dos
+        // vértices, com o mesmo mapeamento usado para o bloco acima. Nas
+        // malhas de menor detalhe as faces têm vários blocos de lado, e a
+        // textura se repete a cada bloco.
+        U = (floor(fract(texcoords.x) * 16.0f) - 0.5) / 16.0f;
+        V = (floor(fract(texcoords.y) * 16.0f) - 0.5) / 16.0f;
+        Kd = texture(selected_texture, vec2(U,V)).rgb;
+        float lambert = max(0,dot(n,l)) * SunVisibility(p, n);
+
+        // Cada nível de luz a menos escurece a face em 20%. A luz do sol só
+        // chega onde há luz do céu; a luz dos blocos é amarelada.
+        float sky_light = light.x > 0.0 ? pow(0.8, 15.0 * (1.0 - light.x)) : 0.0;
+        float block_light = light.y > 0.0 ? pow(0.8, 15.0 * (1.0 - light.y)) : 0.0;
+        vec3 lamp_color = vec3(1.0, 0.85, 0.6);
+        // Os cantos mais ocluídos recebem até 50% menos luz.
+        float ambient_occlusion = 0.5 + 0.5 * occlusion;
+        color.rgb = Kd * ambient_occlusion * (sky_light * (lambert + 0.2) + block_light * lamp_color + 0.01);
+    }
     else if (object_id == OBJ_COW){
         Kd = vec3(1.0,1.0,0.0);
         Ks = vec3(0.8,0.8,0.8);
@@ -132,11 +184,10 @@ void main()
 
         vec3 phong_specular_term  = Ks*I*pow(max(0,dot(v,normalize(r))),q);
 
-
-        if(beta<alpha){
-            lambert_diffuse_term = vec3(0.0,0.0,0.0);
-            phong_specular_term = vec3(0.0,0.0,0.0);
-        }
+        // O sol não ilumina os pontos na sombra dos blocos.
+        float sun_visibility = SunVisibility(p, n);
+        lambert_diffuse_term *= sun_visibility;
+        phong_specular_term *= sun_visibility;
         color.rgb = lambert_diffuse_term + ambient_term + phong_specular_term;
     }
     else if (object_id == OBJ_EYE){
@@ -169,11 +220,10 @@ void main()
 
         vec3 phong_specular_term  = Ks*I*pow(max(0,dot(v,normalize(r))),q);
 
-
-        if(beta<alpha){
-            lambert_diffuse_term = vec3(0.0,0.0,0.0);
-            phong_specular_term = vec3(0.0,0.0,0.0);
-        }
+        // O sol não ilumina os pontos na sombra dos blocos.
+        float sun_visibility = SunVisibility(p, n);
+        lambert_diffuse_term *= sun_visibility;
+        phong_specular_term *= sun_visibility;
         color.rgb = Kd;
     }
 
@@ -5,6 +5,10 @@
 layout (location = 0) in vec4 model_coefficients;
 layout (location = 1) in vec4 normal_coefficients;
 layout (location = 2) in vec2 texture_coefficients;
+// Luz do cu e dos blocos, de 0 a 15 (somente nas malhas dos chunks)
+layout (location = 3) in vec2 light_coefficients;
+// Ocluso ambiente do vrtice, de 0 a 3 (somente nas malhas dos chunks)
+layout (location = 4) in float occlusion_coefficient;
 
 // Matrizes computadas no cdigo C++ e enviadas para a GPU
 uniform mat4 model;
@@ -19,6 +23,8 @@ out vec4 position_world;
 out vec4 position_model;
 out vec4 normal;
 out vec2 texcoords;
+out vec2 light;
+out float occlusion;
 
 void main()
 {
@@ -63,5 +69,9 @@ void main()
 
     // Coordenadas de textura obtidas do arquivo OBJ (se existirem!)
     texcoords = texture_coefficients;
+
+    // Luz calculada pelo LightEngine, normalizada para [0, 1]
+    light = light_coefficients / 15.0;
+    occlusion = occlusion_coefficient / 3.0;
 }
 
@@ -0,0 +1,220 @@
+#include <cmath>
+#include <iostream>
+#include <algorithm>
+
+#include <glm/matrix.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+#include "shadowmap.hpp"
+#include "matrices.hpp"
+#include "gpu.hpp"
+#include "utils.h"
+
+// O passe de profundidade não escreve cor: o fragment shader é vazio.
+const GLchar* const shadowvertexshader_source = ""
+"#version 330\n"
+"layout (location = 0) in vec4 model_coefficients;\n"
+"uniform mat4 model;\n"
+"uniform mat4 light_matrix;\n"
+"void main()\n"
+"{\n"
+    "gl_Position = light_matrix * model * model_coefficients;\n"
+"}\n"
+"\0";
+
+const GLchar* const shadowfragmentshader_source = ""
+"#version 330\n"
+"void main()\n"
+"{\n"
+"}\n"
+"\0";
+
+CascadedShadowMap::CascadedShadowMap():
+    texture_id(0),
+    framebuffer_id(0),
+    program_id(0),
+    model_uniform(-1),
+    light_matrix_uniform(-1)
+{
+    for (int i = 0; i < SHADOW_CASCADES; ++i)
+    {
+        this->light_matrices[i] = Matrix_Identity();
+        this->split_distances[i] = 0.0f;
+        this->texel_sizes[i] = 0.0f;
+    }
+}
+
+CascadedShadowMap::~CascadedShadowMap()
+{
+    if (this->framebuffer_id != 0)
+        glDeleteFramebuffers(1, &this->framebuffer_id);
+    if (this->texture_id != 0)
+        glDeleteTextures(1, &this->texture_id);
+    if (this->program_id != 0)
+        glDeleteProgram(this->program_id);
+}
+
+bool CascadedShadowMap::Init()
+{
+    // Uma camada de profundidade por cascata. A comparação com a
+    // profundidade do fragmento é feita pelo hardware, que também filtra o
+    // resultado dos 4 texels vizinhos (GL_LINEAR). Fora do mapa não há
+    // sombra.
+    glGenTextures(1, &this->texture_id);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, this->texture_id);
+    glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_DEPTH_COMPONENT32F, SHADOW_MAP_SIZE, SHADOW_MAP_SIZE, SHADOW_CASCADES,
+                 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
+    GLfloat border[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+    glTexParameterfv(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_BORDER_COLOR, border);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+    glGenFramebuffers(1, &this->framebuffer_id);
+    glBindFramebuffer(GL_FRAMEBUFFER, this->framebuffer_id);
+    glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, this->texture_id, 0, 0);
+    glDrawBuffer(GL_NONE);
+    glReadBuffer(GL_NONE);
+    GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glCheckError();
+
+    if (status != GL_FRAMEBUFFER_COMPLETE)
+    {
+        std::cerr << "ERROR: Shadow map framebuffer is incomplete (status 0x" << std::hex << status << std::dec << ")." << std::endl;
+        return false;
+    }
+
+    GLuint vertex_shader_id = CreateGpuShaderFromSource(GL_VERTEX_SHADER, shadowvertexshader_source);
+    GLuint fragment_shader_id = CreateGpuShaderFromSource(GL_FRAGMENT_SHADER, shadowfragmentshader_source);
+    this->program_id = CreateGpuProgram(vertex_shader_id, fragment_shader_id);
+    this->model_uniform = glGetUniformLocation(this->program_id, "model");
+    this->light_matrix_uniform = glGetUniformLocation(this->program_id, "light_matrix");
+
+    return true;
+}
+
+void CascadedShadowMap::Fit(glm::mat4 const &view, glm::mat4 const &projection, glm::vec4 sun_direction)
+{
+    // Cantos do frustum no sistema de coordenadas da câmera, nos planos
+    // próximo e distante. Funciona para as projeções perspectiva e
+    // ortográfica.
+    glm::mat4 inverse_projection = glm::inverse(projection);
+    glm::mat4 inverse_view = glm::inverse(view);
+    glm::vec4 near_corners[4];
+    glm::vec4 far_corners[4];
+    for (int i = 0; i < 4; ++i)
+    {
+        float x = (i & 1) ? 1.0f : -1.0f;
+        float y = (i & 2) ? 1.0f : -1.0f;
+        near_corners[i] = inverse_projection * glm::vec4(x, y, -1.0f, 1.0f);
+        near_corners[i] /= near_corners[i].w;
+        far_corners[i] = inverse_projection * glm::vec4(x, y, 1.0f, 1.0f);
+        far_corners[i] /= far_corners[i].w;
+    }
+    float near_distance = -near_corners[0].z;
+    float far_distance = -far_corners[0].z;
+
+    glm::vec4 up = fabs(sun_direction.y) > 0.99f ? glm::vec4(1.0f, 0.0f, 0.0f, 0.0f) : glm::vec4(0.0f, 1.0f, 0.0f, 0.0f);
+    glm::mat4 light_view = Matrix_Camera_View(glm::vec4(0.0f, 0.0f, 0.0f, 1.0f), -sun_direction, up);
+
+    float slice_start = near_distance;
+    for (int cascade = 0; cascade < SHADOW_CASCADES; ++cascade)
+    {
+        // Divisões mais próximas da câmera são menores, como as logarítmicas,
+        // para que a resolução das sombras próximas seja maior.
+        float fraction = (cascade + 1.0f) / SHADOW_CASCADES;
+        float logarithmic = near_distance * powf(far_distance / near_distance, fraction);
+        float uniform = near_distance + (far_distance - near_distance) * fraction;
+        float slice_end = SHADOW_SPLIT_LAMBDA * logarithmic + (1.0f - SHADOW_SPLIT_LAMBDA) * uniform;
+
+        // Cantos da fatia no sistema global. As arestas do frustum vão dos
+        // cantos próximos aos distantes, linearmente na profundidade.
+        glm::vec4 corners[8];
+        glm::vec4 center(0.0f, 0.0f, 0.0f, 0.0f);
+        for (int i = 0; i < 8; ++i)
+        {
+            float distance = (i < 4) ? slice_start : slice_end;
+            float t = (distance - near_distance) / (far_distance - near_distance);
+            glm::vec4 corner = near_corners[i % 4] + (far_corners[i % 4] - near_corners[i % 4]) * t;
+            corners[i] = inverse_view * corner;
+            center += corners[i] / 8.0f;
+        }
+
+        // O raio só depende da forma da fatia; o arredondamento para cima
+        // evita que erros de ponto flutuante mudem o tamanho do texel.
+        float radius = 0.0f;
+        for (int i = 0; i < 8; ++i)
+            radius = std::max(radius, (float)glm::length(glm::vec3(corners[i] - center)));
+        radius = ceilf(radius * 16.0f) / 16.0f;
+
+        float texel_size = 2.0f * radius / SHADOW_MAP_SIZE;
+        glm::vec4 light_center = light_view * center;
+        light_center.x = floorf(light_center.x / texel_size) * texel_size;
+        light_center.y = floorf(light_center.y / texel_size) * texel_size;
+
+        glm::mat4 light_projection = Matrix_Orthographic(
+            light_center.x - radius, light_center.x + radius,
+            light_center.y - radius, light_center.y + radius,
+            light_center.z + radius, light_center.z - radius);
+
+        this->light_matrices[cascade] = light_projection * light_view;
+        this->split_distances[cascade] = slice_end;
+        this->texel_sizes[cascade] = texel_size;
+
+        slice_start = slice_end;
+    }
+}
+
+void CascadedShadowMap::Render(ChunkRenderer &chunk_renderer)
+{
+    GLint previous_framebuffer = 0;
+    GLint previous_program = 0;
+    GLint previous_viewport[4];
+    glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &previous_framebuffer);
+    glGetIntegerv(GL_CURRENT_PROGRAM, &previous_program);
+    glGetIntegerv(GL_VIEWPORT, previous_viewport);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, this->framebuffer_id);
+    glViewport(0, 0, SHADOW_MAP_SIZE, SHADOW_MAP_SIZE);
+    glUseProgram(this->program_id);
+
+    // Blocos entre o sol e o plano próximo de uma cascata são presos ao
+    // plano próximo em vez de recortados, e continuam projetando sombra.
+    // O deslocamento de profundidade evita que as faces iluminadas façam
+    // sombra sobre si mesmas.
+    glEnable(GL_DEPTH_CLAMP);
+    glEnable(GL_POLYGON_OFFSET_FILL);
+    glPolygonOffset(2.0f, 4.0f);
+
+    for (int cascade = 0; cascade < SHADOW_CASCADES; ++cascade)
+    {
+        glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, this->texture_id, 0, cascade);
+        glClear(GL_DEPTH_BUFFER_BIT);
+
+        glUniformMatrix4fv(this->light_matrix_uniform, 1, GL_FALSE, glm::value_ptr(this->light_matrices[cascade]));
+        chunk_renderer.DrawDepth(this->model_uniform, this->light_matrices[cascade]);
+    }
+
+    glDisable(GL_POLYGON_OFFSET_FILL);
+    glDisable(GL_DEPTH_CLAMP);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, previous_framebuffer);
+    glViewport(previous_viewport[0], previous_viewport[1], previous_viewport[2], previous_viewport[3]);
+    glUseProgram(previous_program);
+}
+
+void CascadedShadowMap::Bind(GLuint program_id) const
+{
+    glActiveTexture(GL_TEXTURE0 + SHADOW_TEXTURE_UNIT);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, this->texture_id);
+
+    glUniform1i(glGetUniformLocation(program_id, "shadow_map"), SHADOW_TEXTURE_UNIT);
+    glUniformMatrix4fv(glGetUniformLocation(program_id, "shadow_matrices"), SHADOW_CASCADES, GL_FALSE, glm::value_ptr(this->light_matrices[0]));
+    glUniform1fv(glGetUniformLocation(program_id, "shadow_splits"), SHADOW_CASCADES, this->split_distances);
+    glUniform1fv(glGetUniformLocation(program_id, "shadow_texel_sizes"), SHADOW_CASCADES, this->texel_sizes);
+}
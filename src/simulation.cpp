@@ -0,0 +1,112 @@
+#include "simulation.hpp"
+
+InputState::InputState():
+    move_forward(false),
+    move_backward(false),
+    move_left(false),
+    move_right(false),
+    move_up(false),
+    move_down(false)
+{
+}
+
+Simulation::Simulation(double tick_rate):
+    tick_duration(1.0 / tick_rate),
+    accumulator(0.0),
+    time(0.0),
+    total_ticks(0),
+    previous_camera_position(0.0f, 0.0f, 0.0f, 1.0f),
+    current_camera_position(0.0f, 0.0f, 0.0f, 1.0f)
+{
+}
+
+void Simulation::SetTickRate(double tick_rate)
+{
+    this->tick_duration = 1.0 / tick_rate;
+}
+
+double Simulation::TickRate() const
+{
+    return 1.0 / this->tick_duration;
+}
+
+double Simulation::TickDuration() const
+{
+    return this->tick_duration;
+}
+
+size_t Simulation::Advance(double frame_seconds, InputState const &input, Camera &camera)
+{
+    if (frame_seconds > SIMULATION_MAX_FRAME_SECONDS)
+        frame_seconds = SIMULATION_MAX_FRAME_SECONDS;
+    if (frame_seconds < 0.0)
+        frame_seconds = 0.0;
+
+    // Se a câmera foi movida fora da simulação (ex: pelo roteiro de
+    // benchmark), não interpolamos a partir da posição antiga.
+    if (camera.CenterPoint() != this->current_camera_position)
+    {
+        this->previous_camera_position = camera.CenterPoint();
+        this->current_camera_position = camera.CenterPoint();
+    }
+
+    this->accumulator += frame_seconds;
+
+    size_t ticks = 0;
+    while (this->accumulator >= this->tick_duration)
+    {
+        this->previous_camera_position = this->current_camera_position;
+        this->Tick(input, camera);
+        this->current_camera_position = camera.CenterPoint();
+
+        this->accumulator -= this->tick_duration;
+        ticks++;
+    }
+
+    return ticks;
+}
+
+void Simulation::Tick(InputState const &input, Camera &camera)
+{
+    float dt = this->tick_duration;
+
+    if (input.move_forward)
+        camera.MoveForewards(dt);
+    if (input.move_backward)
+        camera.MoveBackwards(dt);
+    if (input.move_left)
+        camera.MoveLeftwards(dt);
+    if (input.move_right)
+        camera.MoveRightwards(dt);
+    if (input.move_up)
+        camera.MoveUpwards(dt);
+    if (input.move_down)
+        camera.MoveDownwards(dt);
+
+    this->time += this->tick_duration;
+    this->total_ticks++;
+}
+
+double Simulation::InterpolationAlpha() const
+{
+    return this->accumulator / this->tick_duration;
+}
+
+double Simulation::InterpolatedTime() const
+{
+    // O estado atual corresponde a "time"; o quadro é mostrado com o atraso
+    // de até um passo, interpolando entre o passo anterior e o atual.
+    double time = this->time - this->tick_duration + this->accumulator;
+    return time > 0.0 ? time : 0.0;
+}
+
+glm::vec4 Simulation::InterpolatedCameraPosition() const
+{
+    float alpha = this->InterpolationAlpha();
+    return this->previous_camera_position + alpha * (this->current_camera_position - this->previous_camera_position);
+}
+
+size_t Simulation::TotalTicks() const
+{
+    return this->total_ticks;
+}
@@ -0,0 +1,172 @@
+#include <cstring>
+
+#include "streambuffer.hpp"
+
+StreamBuffer g_StreamBuffer;
+
+// Tempo máximo de cada espera pela cerca, em nanossegundos. A espera é
+// repetida até a cerca ser sinalizada.
+#define STREAM_WAIT_TIMEOUT_NS 1000000000ull
+
+StreamBuffer::StreamBuffer():
+    buffer_id(0),
+    capacity(0),
+    head(0),
+    used(0),
+    frame_bytes(0),
+    total_stalls(0)
+{
+    this->frame_stats.bytes = 0;
+    this->frame_stats.writes = 0;
+    this->frame_stats.stalls = 0;
+    this->last_frame_stats = this->frame_stats;
+}
+
+void StreamBuffer::Init(size_t capacity)
+{
+    this->capacity = capacity;
+    glGenBuffers(1, &this->buffer_id);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, this->buffer_id);
+    glBufferData(GL_COPY_WRITE_BUFFER, capacity, NULL, GL_STREAM_DRAW);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+GLuint StreamBuffer::Buffer() const
+{
+    return this->buffer_id;
+}
+
+size_t StreamBuffer::Write(void const *data, size_t bytes, size_t alignment)
+{
+    if (bytes == 0 || bytes > this->capacity)
+        return StreamBuffer::INVALID;
+
+    // Os bytes livres vão de head até o início do quadro mais antigo em
+    // uso. Os quadros cujas cercas já foram sinalizadas são liberados sem
+    // esperar; só esperamos se ainda faltar espaço.
+    size_t offset;
+    size_t needed;
+    for (;;)
+    {
+        // Com o anel vazio, a escrita começa no início. Sem isso, uma escrita
+        // maior que o espaço entre head e o fim precisaria dos bytes pulados
+        // além dos seus, mais que a capacidade, e nunca caberia.
+        if (this->used == 0)
+            this->head = 0;
+
+        // O intervalo não pode passar do fim do buffer: se não couber até lá,
+        // o resto do buffer é pulado e a escrita começa no início.
+        offset = (this->head + alignment - 1) / alignment * alignment;
+        if (offset + bytes > this->capacity)
+            offset = 0;
+        needed = (offset >= this->head ? offset - this->head : this->capacity - this->head) + bytes;
+
+        if (this->capacity - this->used >= needed)
+            break;
+        if (!this->frames.empty() && this->RetireOldestFrame(false))
+            continue;
+
+        // O quadro atual sozinho encheu o anel: cercamos o que já foi
+        // escrito para poder esperar por isso.
+        if (this->frames.empty())
+            this->FenceCurrentFrame();
+
+        this->frame_stats.stalls++;
+        this->total_stalls++;
+        this->RetireOldestFrame(true);
+    }
+
+    glBindBuffer(GL_COPY_WRITE_BUFFER, this->buffer_id);
+    void *destination = glMapBufferRange(GL_COPY_WRITE_BUFFER, offset, bytes,
+                                         GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+    if (destination != NULL)
+    {
+        memcpy(destination, data, bytes);
+        glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+    }
+    else
+    {
+        glBufferSubData(GL_COPY_WRITE_BUFFER, offset, bytes, data);
+    }
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+    this->head = offset + bytes;
+    this->used += needed;
+    this->frame_bytes += needed;
+    this->frame_stats.bytes += bytes;
+    this->frame_stats.writes++;
+    return offset;
+}
+
+bool StreamBuffer::CopyToBuffer(GLuint buffer_id, size_t offset, void const *data, size_t bytes)
+{
+    size_t source = this->Write(data, bytes, 1);
+    if (source == StreamBuffer::INVALID)
+        return false;
+
+    glBindBuffer(GL_COPY_READ_BUFFER, this->buffer_id);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, buffer_id);
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, source, offset, bytes);
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    return true;
+}
+
+void StreamBuffer::EndFrame()
+{
+    if (this->frame_bytes > 0)
+        this->FenceCurrentFrame();
+
+    // Libera os quadros já terminados, para que as estatísticas do próximo
+    // quadro não contem esperas que não aconteceram.
+    while (!this->frames.empty() && this->RetireOldestFrame(false))
+        ;
+
+    this->last_frame_stats = this->frame_stats;
+    this->frame_stats.bytes = 0;
+    this->frame_stats.writes = 0;
+    this->frame_stats.stalls = 0;
+}
+
+void StreamBuffer::FenceCurrentFrame()
+{
+    FrameRegion region;
+    region.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    region.bytes = this->frame_bytes;
+    this->frames.push_back(region);
+    this->frame_bytes = 0;
+}
+
+bool StreamBuffer::RetireOldestFrame(bool wait)
+{
+    FrameRegion &region = this->frames.front();
+    if (wait)
+    {
+        // GL_SYNC_FLUSH_COMMANDS_BIT garante que a cerca chegue à GPU.
+        GLenum status;
+        do
+            status = glClientWaitSync(region.fence, GL_SYNC_FLUSH_COMMANDS_BIT, STREAM_WAIT_TIMEOUT_NS);
+        while (status == GL_TIMEOUT_EXPIRED);
+    }
+    else
+    {
+        GLenum status = glClientWaitSync(region.fence, 0, 0);
+        if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+            return false;
+    }
+
+    glDeleteSync(region.fence);
+    this->used -= region.bytes;
+    this->frames.pop_front();
+    return true;
+}
+
+StreamBufferStats const &StreamBuffer::LastFrameStats() const
+{
+    return this->last_frame_stats;
+}
+
+size_t StreamBuffer::TotalStalls() const
+{
+    return this->total_stalls;
+}
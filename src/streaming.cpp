@@ -0,0 +1,374 @@
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+#include "streaming.hpp"
+#include "profiler.hpp"
+
+StreamingStats::StreamingStats():
+    resident_chunks(0),
+    resident_bytes(0),
+    stored_chunks(0),
+    stored_bytes(0),
+    loads_in_flight(0)
+{
+}
+
+ChunkStreamer::ChunkStreamer(TerrainGenerator const &generator):
+    generator(generator),
+    world(NULL),
+    chunks_x(0),
+    chunks_y(0),
+    chunks_z(0),
+    radius(STREAMING_DEFAULT_RADIUS),
+    budget_bytes(STREAMING_DEFAULT_BUDGET_MB * 1024 * 1024),
+    loads_in_flight(0),
+    missing_columns(0)
+{
+}
+
+ChunkStreamer::~ChunkStreamer()
+{
+    this->WaitForLoads();
+}
+
+void ChunkStreamer::WaitForLoads()
+{
+    // As tarefas em andamento escrevem em this->ready.
+    g_JobSystem.Wait(this->jobs);
+}
+
+bool ChunkStreamer::Init(WorldBlockMatrix &world, int radius_chunks, size_t budget_bytes, const char *save_directory)
+{
+    this->world = &world;
+    this->radius = radius_chunks;
+    this->budget_bytes = budget_bytes;
+
+    WorldPoint size = world.SizeInChunks();
+    this->chunks_x = size.x;
+    this->chunks_y = size.y;
+    this->chunks_z = size.z;
+
+    size_t num_columns = this->chunks_x * this->chunks_z;
+    this->states.assign(num_columns, COLUMN_UNLOADED);
+    this->modified.assign(num_columns, false);
+    this->lru.clear();
+    this->lru_positions.assign(num_columns, this->lru.end());
+
+    // Colunas que já estão no mundo passam a ser gerenciadas como as demais.
+    for (size_t column = 0; column < num_columns; ++column)
+    {
+        if (world.IsChunkLoaded(column / this->chunks_z, 0, column % this->chunks_z))
+        {
+            this->states[column] = COLUMN_RESIDENT;
+            this->lru_positions[column] = this->lru.insert(this->lru.end(), column);
+        }
+    }
+
+    return this->store.Open(save_directory, size);
+}
+
+void ChunkStreamer::MarkModified(WorldPoint block)
+{
+    this->modified[(block.x / CHUNK_SIZE) * this->chunks_z + block.z / CHUNK_SIZE] = true;
+}
+
+void ChunkStreamer::SaveColumn(size_t column)
+{
+    size_t chunk_x = column / this->chunks_z;
+    size_t chunk_z = column % this->chunks_z;
+
+    // Acesso const: salvar não copia os chunks compartilhados.
+    WorldBlockMatrix const &world = *this->world;
+    for (size_t chunk_y = 0; chunk_y < this->chunks_y; ++chunk_y)
+        this->store.Save(chunk_x, chunk_y, chunk_z, world.Chunk(chunk_x, chunk_y, chunk_z));
+    this->modified[column] = false;
+}
+
+void ChunkStreamer::SaveModified()
+{
+    ProfileScope cpu_scope("save modified chunks");
+
+    for (size_t column = 0; column < this->states.size(); ++column)
+    {
+        if (this->states[column] == COLUMN_RESIDENT && this->modified[column])
+            this->SaveColumn(column);
+    }
+}
+
+void ChunkStreamer::FlushSaves()
+{
+    this->store.Flush();
+}
+
+uint64_t ChunkStreamer::SaveMark() const
+{
+    return this->store.SaveGeneration();
+}
+
+bool ChunkStreamer::SavesWritten(uint64_t mark) const
+{
+    return this->store.IsWritten(mark);
+}
+
+void ChunkStreamer::AddRecoveredEdits(std::vector<JournalEntry> const &entries)
+{
+    for (size_t i = 0; i < entries.size(); ++i)
+    {
+        JournalEntry const &entry = entries[i];
+        if (entry.x >= this->chunks_x * CHUNK_SIZE || entry.y >= this->chunks_y * CHUNK_SIZE || entry.z >= this->chunks_z * CHUNK_SIZE)
+            continue;
+
+        size_t column = (entry.x / CHUNK_SIZE) * this->chunks_z + entry.z / CHUNK_SIZE;
+        this->recovered_edits[column].push_back(entry);
+    }
+}
+
+std::vector<JournalEntry> ChunkStreamer::UnappliedEdits() const
+{
+    std::vector<JournalEntry> entries;
+    std::unordered_map<size_t, std::vector<JournalEntry> >::const_iterator it;
+    for (it = this->recovered_edits.begin(); it != this->recovered_edits.end(); ++it)
+        entries.insert(entries.end(), it->second.begin(), it->second.end());
+    return entries;
+}
+
+void ChunkStreamer::LoadColumn(size_t column, std::vector<WorldChunk> &chunks) const
+{
+    size_t chunk_x = column / this->chunks_z;
+    size_t chunk_z = column % this->chunks_z;
+
+    chunks.resize(this->chunks_y);
+
+    // As colunas são sempre salvas inteiras.
+    if (this->store.Load(chunk_x, 0, chunk_z, chunks[0]))
+    {
+        for (size_t chunk_y = 1; chunk_y < this->chunks_y; ++chunk_y)
+            this->store.Load(chunk_x, chunk_y, chunk_z, chunks[chunk_y]);
+        return;
+    }
+
+    std::vector<WorldChunk *> pointers(this->chunks_y);
+    for (size_t chunk_y = 0; chunk_y < this->chunks_y; ++chunk_y)
+        pointers[chunk_y] = &chunks[chunk_y];
+    this->generator.GenerateColumn(chunk_x, chunk_z, pointers.data(), this->chunks_y);
+}
+
+void ChunkStreamer::Install(ColumnLoad const &load, std::vector<ChunkLoad> &loads)
+{
+    size_t chunk_x = load.column / this->chunks_z;
+    size_t chunk_z = load.column % this->chunks_z;
+
+    // Alterações que não chegaram aos arquivos de região antes de o programa
+    // terminar, na ordem em que foram feitas.
+    std::unordered_map<size_t, std::vector<JournalEntry> >::iterator recovered = this->recovered_edits.find(load.column);
+    if (recovered != this->recovered_edits.end())
+    {
+        std::vector<JournalEntry> const &entries = recovered->second;
+        for (size_t i = 0; i < entries.size(); ++i)
+        {
+            WorldChunk &chunk = (*load.chunks)[entries[i].y / CHUNK_SIZE];
+            chunk.blocks[entries[i].x % CHUNK_SIZE][entries[i].y % CHUNK_SIZE][entries[i].z % CHUNK_SIZE] = entries[i].new_block;
+        }
+        this->recovered_edits.erase(recovered);
+        this->modified[load.column] = true;
+    }
+
+    for (size_t chunk_y = 0; chunk_y < this->chunks_y; ++chunk_y)
+    {
+        WorldChunk const &data = (*load.chunks)[chunk_y];
+        this->world->LoadChunk(chunk_x, chunk_y, chunk_z, data);
+
+        // Os outros mundos compartilham os blocos carregados, sem cópia,
+        // até os copiarem para os seus próprios chunks.
+        ChunkLoad chunk_load;
+        chunk_load.chunk_x = chunk_x;
+        chunk_load.chunk_y = chunk_y;
+        chunk_load.chunk_z = chunk_z;
+        chunk_load.data = std::shared_ptr<const WorldChunk>(load.chunks, &data);
+        loads.push_back(chunk_load);
+    }
+
+    this->states[load.column] = COLUMN_RESIDENT;
+    this->lru_positions[load.column] = this->lru.insert(this->lru.begin(), load.column);
+}
+
+void ChunkStreamer::Evict(size_t column, std::vector<WorldPoint> &unloads)
+{
+    size_t chunk_x = column / this->chunks_z;
+    size_t chunk_z = column % this->chunks_z;
+
+    if (this->modified[column])
+        this->SaveColumn(column);
+
+    for (size_t chunk_y = 0; chunk_y < this->chunks_y; ++chunk_y)
+    {
+        this->world->UnloadChunk(chunk_x, chunk_y, chunk_z);
+        unloads.push_back(WorldPoint(chunk_x, chunk_y, chunk_z));
+    }
+
+    this->states[column] = COLUMN_UNLOADED;
+    this->lru.erase(this->lru_positions[column]);
+    this->lru_positions[column] = this->lru.end();
+}
+
+void ChunkStreamer::Restore(WorldBlockMatrix const &snapshot, std::vector<ChunkLoad> &loads)
+{
+    ProfileScope cpu_scope("restore chunks");
+
+    // Colunas que terminam de carregar depois da restauração teriam os
+    // blocos de antes dela.
+    this->WaitForLoads();
+    {
+        std::lock_guard<std::mutex> lock(this->ready_mutex);
+        for (size_t i = 0; i < this->ready.size(); ++i)
+            this->states[this->ready[i].column] = COLUMN_UNLOADED;
+        this->loads_in_flight -= this->ready.size();
+        this->ready.clear();
+    }
+
+    for (size_t column = 0; column < this->states.size(); ++column)
+    {
+        size_t chunk_x = column / this->chunks_z;
+        size_t chunk_z = column % this->chunks_z;
+
+        // Colunas que não estavam carregadas na cópia ficam como estão.
+        if (!snapshot.IsChunkLoaded(chunk_x, 0, chunk_z))
+            continue;
+
+        if (this->states[column] == COLUMN_RESIDENT)
+        {
+            // Somente os chunks alterados desde a cópia são trocados.
+            for (size_t chunk_y = 0; chunk_y < this->chunks_y; ++chunk_y)
+            {
+                if (!this->world->ShareChunk(snapshot, chunk_x, chunk_y, chunk_z))
+                    continue;
+
+                ChunkLoad chunk_load;
+                chunk_load.chunk_x = chunk_x;
+                chunk_load.chunk_y = chunk_y;
+                chunk_load.chunk_z = chunk_z;
+                chunk_load.data = snapshot.SharedChunk(chunk_x, chunk_y, chunk_z);
+                loads.push_back(chunk_load);
+                this->modified[column] = true;
+            }
+        }
+        else
+        {
+            // Colunas descarregadas depois da cópia: os blocos da cópia são
+            // salvos, e lidos quando a coluna for carregada de novo.
+            for (size_t chunk_y = 0; chunk_y < this->chunks_y; ++chunk_y)
+                this->store.Save(chunk_x, chunk_y, chunk_z, snapshot.Chunk(chunk_x, chunk_y, chunk_z));
+        }
+    }
+}
+
+void ChunkStreamer::Touch(size_t column)
+{
+    this->lru.splice(this->lru.begin(), this->lru, this->lru_positions[column]);
+}
+
+void ChunkStreamer::Update(glm::vec4 camera_position, std::vector<ChunkLoad> &loads, std::vector<WorldPoint> &unloads)
+{
+    // Colunas carregadas pelas trabalhadoras desde o último quadro.
+    std::vector<ColumnLoad> finished;
+    {
+        std::lock_guard<std::mutex> lock(this->ready_mutex);
+        finished.swap(this->ready);
+    }
+    for (size_t i = 0; i < finished.size(); ++i)
+        this->Install(finished[i], loads);
+    this->loads_in_flight -= finished.size();
+
+    // Os blocos são centrados nas coordenadas inteiras.
+    int camera_x = (int)floorf((camera_position.x + 0.5f) / CHUNK_SIZE);
+    int camera_z = (int)floorf((camera_position.z + 0.5f) / CHUNK_SIZE);
+    int radius_squared = this->radius * this->radius;
+
+    // Colunas dentro do raio: as carregadas passam para o início da lista
+    // LRU, e as que faltam são pedidas, da mais próxima à mais distante.
+    std::vector<std::pair<int, size_t> > missing;
+    for (int dx = -this->radius; dx <= this->radius; ++dx)
+    {
+        for (int dz = -this->radius; dz <= this->radius; ++dz)
+        {
+            int chunk_x = camera_x + dx;
+            int chunk_z = camera_z + dz;
+            if (chunk_x < 0 || chunk_z < 0 || chunk_x >= (int)this->chunks_x || chunk_z >= (int)this->chunks_z)
+                continue;
+
+            int distance_squared = dx * dx + dz * dz;
+            if (distance_squared > radius_squared)
+                continue;
+
+            size_t column = chunk_x * this->chunks_z + chunk_z;
+            if (this->states[column] == COLUMN_RESIDENT)
+                this->Touch(column);
+            else if (this->states[column] == COLUMN_UNLOADED)
+                missing.push_back(std::make_pair(distance_squared, column));
+        }
+    }
+
+    std::sort(missing.begin(), missing.end());
+
+    size_t requested = 0;
+    for (; requested < missing.size() && this->loads_in_flight < STREAMING_MAX_LOADS_IN_FLIGHT; ++requested)
+    {
+        size_t column = missing[requested].second;
+
+        g_JobSystem.Submit([this, column]() {
+            ProfileScope cpu_scope("chunk load");
+
+            ColumnLoad load;
+            load.column = column;
+            load.chunks = std::make_shared<std::vector<WorldChunk> >();
+            this->LoadColumn(column, *load.chunks);
+
+            std::lock_guard<std::mutex> lock(this->ready_mutex);
+            this->ready.push_back(load);
+        }, &this->jobs);
+
+        this->states[column] = COLUMN_LOADING;
+        this->loads_in_flight++;
+    }
+    this->missing_columns = missing.size() - requested;
+
+    // Acima do limite de memória, descarregamos as colunas usadas há mais
+    // tempo. As colunas dentro do raio estão todas no início da lista.
+    size_t evictions = 0;
+    while (this->world->LoadedChunks() * sizeof(WorldChunk) > this->budget_bytes
+           && evictions < STREAMING_MAX_EVICTIONS_PER_FRAME
+           && !this->lru.empty())
+    {
+        size_t column = this->lru.back();
+        int dx = (int)(column / this->chunks_z) - camera_x;
+        int dz = (int)(column % this->chunks_z) - camera_z;
+        if (dx * dx + dz * dz <= radius_squared)
+            break;
+
+        this->Evict(column, unloads);
+        evictions++;
+    }
+}
+
+void ChunkStreamer::LoadAroundNow(glm::vec4 camera_position, std::vector<ChunkLoad> &loads, std::vector<WorldPoint> &unloads)
+{
+    // Cada volta pede mais colunas e instala as carregadas na volta
+    // anterior, até não faltar nenhuma.
+    do
+    {
+        this->Update(camera_position, loads, unloads);
+        this->WaitForLoads();
+    } while (this->missing_columns > 0 || this->loads_in_flight > 0);
+}
+
+StreamingStats ChunkStreamer::Stats() const
+{
+    StreamingStats stats;
+    stats.resident_chunks = this->world->LoadedChunks();
+    stats.resident_bytes = stats.resident_chunks * sizeof(WorldChunk);
+    stats.stored_chunks = this->store.PendingChunks();
+    stats.stored_bytes = this->store.PendingBytes();
+    stats.loads_in_flight = this->loads_in_flight;
+    return stats;
+}
@@ -0,0 +1,343 @@
+#include <cmath>
+#include <vector>
+
+#include "terrain.hpp"
+#include "jobs.hpp"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+// Constantes do hash das coordenadas inteiras do reticulado.
+#define TERRAIN_HASH_X 0x8da6b343u
+#define TERRAIN_HASH_Y 0xd8163841u
+#define TERRAIN_HASH_Z 0xcb1ab31fu
+#define TERRAIN_HASH_M 0x5bd1e995u
+
+static inline uint32_t Terrain_Hash(int32_t x, int32_t y, int32_t z, uint32_t seed)
+{
+    uint32_t h = seed ^ ((uint32_t)x * TERRAIN_HASH_X) ^ ((uint32_t)y * TERRAIN_HASH_Y) ^ ((uint32_t)z * TERRAIN_HASH_Z);
+    h ^= h >> 13;
+    h *= TERRAIN_HASH_M;
+    h ^= h >> 15;
+    return h;
+}
+
+// Produto escalar entre o deslocamento até o canto e o gradiente do canto,
+// cujas componentes vêm de três grupos de 10 bits do hash.
+static inline float Terrain_Gradient(uint32_t h, float dx, float dy, float dz)
+{
+    float gx = (float)(int32_t)(h & 0x3FF) - 511.5f;
+    float gy = (float)(int32_t)((h >> 10) & 0x3FF) - 511.5f;
+    float gz = (float)(int32_t)((h >> 20) & 0x3FF) - 511.5f;
+    return (gx * dx + gy * dy + gz * dz) * (1.0f / 511.5f);
+}
+
+static inline float Terrain_Fade(float t)
+{
+    return t * t * t * (t * (t * 6.0f - 15.0f) + 10.0f);
+}
+
+static inline float Terrain_Lerp(float a, float b, float t)
+{
+    return a + t * (b - a);
+}
+
+float TerrainNoise(float x, float y, float z, uint32_t seed)
+{
+    float floor_x = floorf(x), floor_y = floorf(y), floor_z = floorf(z);
+    int32_t ix = (int32_t)floor_x, iy = (int32_t)floor_y, iz = (int32_t)floor_z;
+    float fx = x - floor_x, fy = y - floor_y, fz = z - floor_z;
+
+    float u = Terrain_Fade(fx), v = Terrain_Fade(fy), w = Terrain_Fade(fz);
+
+    float n000 = Terrain_Gradient(Terrain_Hash(ix,     iy,     iz,     seed), fx,        fy,        fz);
+    float n100 = Terrain_Gradient(Terrain_Hash(ix + 1, iy,     iz,     seed), fx - 1.0f, fy,        fz);
+    float n010 = Terrain_Gradient(Terrain_Hash(ix,     iy + 1, iz,     seed), fx,        fy - 1.0f, fz);
+    float n110 = Terrain_Gradient(Terrain_Hash(ix + 1, iy + 1, iz,     seed), fx - 1.0f, fy - 1.0f, fz);
+    float n001 = Terrain_Gradient(Terrain_Hash(ix,     iy,     iz + 1, seed), fx,        fy,        fz - 1.0f);
+    float n101 = Terrain_Gradient(Terrain_Hash(ix + 1, iy,     iz + 1, seed), fx - 1.0f, fy,        fz - 1.0f);
+    float n011 = Terrain_Gradient(Terrain_Hash(ix,     iy + 1, iz + 1, seed), fx,        fy - 1.0f, fz - 1.0f);
+    float n111 = Terrain_Gradient(Terrain_Hash(ix + 1, iy + 1, iz + 1, seed), fx - 1.0f, fy - 1.0f, fz - 1.0f);
+
+    float nx00 = Terrain_Lerp(n000, n100, u);
+    float nx10 = Terrain_Lerp(n010, n110, u);
+    float nx01 = Terrain_Lerp(n001, n101, u);
+    float nx11 = Terrain_Lerp(n011, n111, u);
+    float nxy0 = Terrain_Lerp(nx00, nx10, v);
+    float nxy1 = Terrain_Lerp(nx01, nx11, v);
+    return Terrain_Lerp(nxy0, nxy1, w);
+}
+
+#ifdef __SSE2__
+
+// SSE2 não tem multiplicação de inteiros de 32 bits (_mm_mullo_epi32 é
+// SSE4.1); multiplicamos as posições pares e ímpares separadamente.
+static inline __m128i Terrain_MulLo(__m128i a, __m128i b)
+{
+    __m128i even = _mm_mul_epu32(a, b);
+    __m128i odd = _mm_mul_epu32(_mm_srli_epi64(a, 32), _mm_srli_epi64(b, 32));
+    return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)), _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+}
+
+static inline __m128i Terrain_Hash4(__m128i x, __m128i y, __m128i z, __m128i seed)
+{
+    __m128i h = _mm_xor_si128(seed, Terrain_MulLo(x, _mm_set1_epi32((int)TERRAIN_HASH_X)));
+    h = _mm_xor_si128(h, Terrain_MulLo(y, _mm_set1_epi32((int)TERRAIN_HASH_Y)));
+    h = _mm_xor_si128(h, Terrain_MulLo(z, _mm_set1_epi32((int)TERRAIN_HASH_Z)));
+    h = _mm_xor_si128(h, _mm_srli_epi32(h, 13));
+    h = Terrain_MulLo(h, _mm_set1_epi32((int)TERRAIN_HASH_M));
+    h = _mm_xor_si128(h, _mm_srli_epi32(h, 15));
+    return h;
+}
+
+static inline __m128 Terrain_Gradient4(__m128i h, __m128 dx, __m128 dy, __m128 dz)
+{
+    const __m128i mask = _mm_set1_epi32(0x3FF);
+    const __m128 half = _mm_set1_ps(511.5f);
+
+    __m128 gx = _mm_sub_ps(_mm_cvtepi32_ps(_mm_and_si128(h, mask)), half);
+    __m128 gy = _mm_sub_ps(_mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(h, 10), mask)), half);
+    __m128 gz = _mm_sub_ps(_mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(h, 20), mask)), half);
+
+    __m128 dot = _mm_add_ps(_mm_add_ps(_mm_mul_ps(gx, dx), _mm_mul_ps(gy, dy)), _mm_mul_ps(gz, dz));
+    return _mm_mul_ps(dot, _mm_set1_ps(1.0f / 511.5f));
+}
+
+static inline __m128 Terrain_Fade4(__m128 t)
+{
+    __m128 inner = _mm_add_ps(_mm_mul_ps(t, _mm_sub_ps(_mm_mul_ps(t, _mm_set1_ps(6.0f)), _mm_set1_ps(15.0f))), _mm_set1_ps(10.0f));
+    return _mm_mul_ps(_mm_mul_ps(_mm_mul_ps(t, t), t), inner);
+}
+
+static inline __m128 Terrain_Lerp4(__m128 a, __m128 b, __m128 t)
+{
+    return _mm_add_ps(a, _mm_mul_ps(t, _mm_sub_ps(b, a)));
+}
+
+// floor() com SSE2: trunca e corrige os valores negativos não inteiros.
+static inline __m128i Terrain_Floor4(__m128 x, __m128 &floored)
+{
+    __m128i truncated = _mm_cvttps_epi32(x);
+    __m128 truncated_float = _mm_cvtepi32_ps(truncated);
+    __m128i correction = _mm_castps_si128(_mm_cmpgt_ps(truncated_float, x)); // -1 onde truncou para cima
+    __m128i result = _mm_add_epi32(truncated, correction);
+    floored = _mm_cvtepi32_ps(result);
+    return result;
+}
+
+void TerrainNoise4(float const x[4], float const y[4], float const z[4], uint32_t seed, float out[4])
+{
+    __m128 px = _mm_loadu_ps(x), py = _mm_loadu_ps(y), pz = _mm_loadu_ps(z);
+
+    __m128 floor_x, floor_y, floor_z;
+    __m128i ix = Terrain_Floor4(px, floor_x);
+    __m128i iy = Terrain_Floor4(py, floor_y);
+    __m128i iz = Terrain_Floor4(pz, floor_z);
+
+    __m128 fx = _mm_sub_ps(px, floor_x), fy = _mm_sub_ps(py, floor_y), fz = _mm_sub_ps(pz, floor_z);
+    __m128 fx1 = _mm_sub_ps(fx, _mm_set1_ps(1.0f));
+    __m128 fy1 = _mm_sub_ps(fy, _mm_set1_ps(1.0f));
+    __m128 fz1 = _mm_sub_ps(fz, _mm_set1_ps(1.0f));
+
+    __m128 u = Terrain_Fade4(fx), v = Terrain_Fade4(fy), w = Terrain_Fade4(fz);
+
+    const __m128i one = _mm_set1_epi32(1);
+    __m128i ix1 = _mm_add_epi32(ix, one), iy1 = _mm_add_epi32(iy, one), iz1 = _mm_add_epi32(iz, one);
+    __m128i s = _mm_set1_epi32((int)seed);
+
+    __m128 n000 = Terrain_Gradient4(Terrain_Hash4(ix,  iy,  iz,  s), fx,  fy,  fz);
+    __m128 n100 = Terrain_Gradient4(Terrain_Hash4(ix1, iy,  iz,  s), fx1, fy,  fz);
+    __m128 n010 = Terrain_Gradient4(Terrain_Hash4(ix,  iy1, iz,  s), fx,  fy1, fz);
+    __m128 n110 = Terrain_Gradient4(Terrain_Hash4(ix1, iy1, iz,  s), fx1, fy1, fz);
+    __m128 n001 = Terrain_Gradient4(Terrain_Hash4(ix,  iy,  iz1, s), fx,  fy,  fz1);
+    __m128 n101 = Terrain_Gradient4(Terrain_Hash4(ix1, iy,  iz1, s), fx1, fy,  fz1);
+    __m128 n011 = Terrain_Gradient4(Terrain_Hash4(ix,  iy1, iz1, s), fx,  fy1, fz1);
+    __m128 n111 = Terrain_Gradient4(Terrain_Hash4(ix1, iy1, iz1, s), fx1, fy1, fz1);
+
+    __m128 nx00 = Terrain_Lerp4(n000, n100, u);
+    __m128 nx10 = Terrain_Lerp4(n010, n110, u);
+    __m128 nx01 = Terrain_Lerp4(n001, n101, u);
+    __m128 nx11 = Terrain_Lerp4(n011, n111, u);
+    __m128 nxy0 = Terrain_Lerp4(nx00, nx10, v);
+    __m128 nxy1 = Terrain_Lerp4(nx01, nx11, v);
+    _mm_storeu_ps(out, Terrain_Lerp4(nxy0, nxy1, w));
+}
+
+bool TerrainUsesSimd()
+{
+    return true;
+}
+
+#else
+
+void TerrainNoise4(float const x[4], float const y[4], float const z[4], uint32_t seed, float out[4])
+{
+    for (int i = 0; i < 4; ++i)
+        out[i] = TerrainNoise(x[i], y[i], z[i], seed);
+}
+
+bool TerrainUsesSimd()
+{
+    return false;
+}
+
+#endif
+
+// Soma de oitavas de ruído (fBm): cada oitava tem o dobro da frequência e
+// metade da amplitude da anterior, e uma semente diferente.
+static void Terrain_Fbm4(float const x[4], float const y[4], float const z[4], float frequency, int octaves, uint32_t seed, float out[4])
+{
+    float amplitude = 1.0f;
+    float total_amplitude = 0.0f;
+    out[0] = out[1] = out[2] = out[3] = 0.0f;
+
+    for (int octave = 0; octave < octaves; ++octave)
+    {
+        float sx[4], sy[4], sz[4], noise[4];
+        for (int i = 0; i < 4; ++i)
+        {
+            sx[i] = x[i] * frequency;
+            sy[i] = y[i] * frequency;
+            sz[i] = z[i] * frequency;
+        }
+
+        TerrainNoise4(sx, sy, sz, seed + octave * 0x9E3779B9u, noise);
+        for (int i = 0; i < 4; ++i)
+            out[i] += amplitude * noise[i];
+
+        total_amplitude += amplitude;
+        amplitude *= 0.5f;
+        frequency *= 2.0f;
+    }
+
+    for (int i = 0; i < 4; ++i)
+        out[i] /= total_amplitude;
+}
+
+TerrainGenerator::TerrainGenerator(uint32_t seed):
+    seed(seed)
+{
+}
+
+void TerrainGenerator::GenerateColumn(size_t chunk_x, size_t chunk_z, WorldChunk *const *column, size_t chunks_y) const
+{
+    float size_y = chunks_y * CHUNK_SIZE;
+
+    float origin_x = chunk_x * CHUNK_SIZE;
+    float origin_z = chunk_z * CHUNK_SIZE;
+
+    // Mapa de altura da coluna, calculado uma única vez para todos os chunks
+    // empilhados. O ruído 2D é o ruído 3D no plano y = 0.5.
+    int heights[CHUNK_SIZE][CHUNK_SIZE];
+    int max_height = 0;
+    for (int x = 0; x < CHUNK_SIZE; ++x)
+    {
+        for (int z = 0; z < CHUNK_SIZE; z += 4)
+        {
+            float px[4], py[4], pz[4], noise[4];
+            for (int i = 0; i < 4; ++i)
+            {
+                px[i] = origin_x + x;
+                py[i] = 0.5f / TERRAIN_HEIGHT_FREQUENCY;
+                pz[i] = origin_z + z + i;
+            }
+
+            Terrain_Fbm4(px, py, pz, TERRAIN_HEIGHT_FREQUENCY, TERRAIN_HEIGHT_OCTAVES, this->seed, noise);
+
+            for (int i = 0; i < 4; ++i)
+            {
+                float height = size_y * (TERRAIN_BASE_HEIGHT + TERRAIN_HEIGHT_AMPLITUDE * noise[i]);
+                int h = (int)height;
+                h = h < 1 ? 1 : (h > (int)size_y - 1 ? (int)size_y - 1 : h);
+                heights[x][z + i] = h;
+                max_height = h > max_height ? h : max_height;
+            }
+        }
+    }
+
+    uint32_t cave_seed = this->seed ^ 0x68E31DA4u;
+
+    for (size_t chunk_y = 0; chunk_y < chunks_y; ++chunk_y)
+    {
+        WorldChunk &chunk = *column[chunk_y];
+        int origin_y = chunk_y * CHUNK_SIZE;
+
+        // Chunks inteiramente acima do terreno ficam só com ar.
+        if (origin_y > max_height)
+        {
+            for (int x = 0; x < CHUNK_SIZE; ++x)
+                for (int y = 0; y < CHUNK_SIZE; ++y)
+                    for (int z = 0; z < CHUNK_SIZE; ++z)
+                        chunk.blocks[x][y][z] = BLOCK_AIR;
+            continue;
+        }
+
+        for (int x = 0; x < CHUNK_SIZE; ++x)
+        {
+            for (int y = 0; y < CHUNK_SIZE; ++y)
+            {
+                int wy = origin_y + y;
+
+                for (int z = 0; z < CHUNK_SIZE; z += 4)
+                {
+                    // O ruído das cavernas só é avaliado se algum dos quatro
+                    // blocos está fundo o bastante para ser escavado.
+                    bool any_deep = false;
+                    for (int i = 0; i < 4; ++i)
+                        any_deep = any_deep || wy < heights[x][z + i] - TERRAIN_CAVE_MIN_DEPTH;
+
+                    float cave[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+                    if (any_deep)
+                    {
+                        float px[4], py[4], pz[4];
+                        for (int i = 0; i < 4; ++i)
+                        {
+                            px[i] = origin_x + x;
+                            py[i] = wy;
+                            pz[i] = origin_z + z + i;
+                        }
+                        Terrain_Fbm4(px, py, pz, TERRAIN_CAVE_FREQUENCY, TERRAIN_CAVE_OCTAVES, cave_seed, cave);
+                    }
+
+                    for (int i = 0; i < 4; ++i)
+                    {
+                        int height = heights[x][z + i];
+                        Block block;
+                        if (wy > height)
+                            block = BLOCK_AIR;
+                        else if (wy < height - TERRAIN_CAVE_MIN_DEPTH && cave[i] > TERRAIN_CAVE_THRESHOLD)
+                            block = BLOCK_AIR;
+                        else if (wy == height)
+                            block = BLOCK_GRASS;
+                        else
+                            block = BLOCK_STONE;
+
+                        chunk.blocks[x][y][z + i] = block;
+                    }
+                }
+            }
+        }
+    }
+}
+
+void TerrainGenerator::Generate(WorldBlockMatrix &world) const
+{
+    WorldPoint chunks = world.SizeInChunks();
+    size_t chunks_x = chunks.x;
+    size_t chunks_y = chunks.y;
+    size_t num_columns = chunks.x * chunks.z;
+
+    // Cada coluna escreve somente nos seus próprios chunks.
+    g_JobSystem.ParallelFor(0, num_columns, 1, [this, &world, chunks_x, chunks_y](size_t first, size_t last) {
+        std::vector<WorldChunk *> column(chunks_y);
+        for (size_t index = first; index < last; ++index)
+        {
+            size_t chunk_x = index % chunks_x;
+            size_t chunk_z = index / chunks_x;
+            for (size_t chunk_y = 0; chunk_y < chunks_y; ++chunk_y)
+                column[chunk_y] = &world.Chunk(chunk_x, chunk_y, chunk_z);
+            this->GenerateColumn(chunk_x, chunk_z, column.data(), chunks_y);
+        }
+    });
+}
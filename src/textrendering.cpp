@@ -1,6 +1,7 @@
 // Based on http://hamelot.io/visualization/opengl-text-without-any-external-libraries/
 //   and on https://github.com/rougier/freetype-gl
 #include <string>
+#include <unordered_map>
 
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
@@ -10,6 +11,8 @@
 
 #include "utils.h"
 #include "dejavufont.h"
+#include "textrendering.hpp"
+#include "streambuffer.hpp"
 
 GLuint CreateGpuProgram(GLuint vertex_shader_id, GLuint fragment_shader_id); // Função definida em main.cpp
 
@@ -83,15 +86,75 @@ void TextRendering_LoadShader(const GLchar* const shader_string, GLuint shader_i
 }
 
 GLuint textVAO;
-GLuint textVBO;
 GLuint textprogram_id;
 GLuint texttexture_id;
 
+float textscale = 1.5f;
+
+// Tabela de glifos indexada diretamente pelo codepoint para caracteres ASCII,
+// e tabela hash para os demais. Construídas uma única vez em TextRendering_Init().
+texture_glyph_t *g_GlyphsAscii[128];
+std::unordered_map<uint32_t, texture_glyph_t *> g_GlyphsOther;
+
+TextLayoutContext g_TextLayout = { 800, 600, textscale / 800, textscale / 600, 0.0f, 0.0f, 0 };
+
+// Vértices do último texto montado por TextRendering_PrintString(). Mantido
+// entre chamadas para evitar realocações.
+std::vector<float> g_TextVertices;
+
+void TextRendering_BuildGlyphTable()
+{
+    for (size_t i = 0; i < 128; ++i)
+        g_GlyphsAscii[i] = NULL;
+    g_GlyphsOther.clear();
+
+    for (size_t j = 0; j < dejavufont.glyphs_count; ++j)
+    {
+        texture_glyph_t *glyph = &dejavufont.glyphs[j];
+        if (glyph->codepoint < 128)
+            g_GlyphsAscii[glyph->codepoint] = glyph;
+        else
+            g_GlyphsOther.insert(std::make_pair(glyph->codepoint, glyph));
+    }
+}
+
+texture_glyph_t const *TextRendering_FindGlyph(uint32_t codepoint)
+{
+    if (codepoint < 128)
+        return g_GlyphsAscii[codepoint];
+
+    auto find_iter = g_GlyphsOther.find(codepoint);
+    if (find_iter == g_GlyphsOther.end())
+        return NULL;
+    return find_iter->second;
+}
+
+void TextRendering_OnWindowResize(int width, int height)
+{
+    if (width <= 0 || height <= 0)
+        return;
+
+    g_TextLayout.window_width = width;
+    g_TextLayout.window_height = height;
+    g_TextLayout.sx = textscale / width;
+    g_TextLayout.sy = textscale / height;
+    g_TextLayout.line_height = dejavufont.height / height * textscale;
+    g_TextLayout.char_width = dejavufont.glyphs[32].advance_x / width * textscale;
+    g_TextLayout.version++;
+}
+
+TextLayoutContext const &TextRendering_LayoutContext()
+{
+    return g_TextLayout;
+}
+
 void TextRendering_Init()
 {
+    TextRendering_BuildGlyphTable();
+    TextRendering_OnWindowResize(g_TextLayout.window_width, g_TextLayout.window_height);
+
     GLuint sampler;
 
-    glGenBuffers(1, &textVBO);
     glGenVertexArrays(1, &textVAO);
     glGenTextures(1, &texttexture_id);
     glGenSamplers(1, &sampler);
@@ -126,8 +189,9 @@ void TextRendering_Init()
 
     glBindVertexArray(textVAO);
 
-    glBindBuffer(GL_ARRAY_BUFFER, textVBO);
-    glBufferData(GL_ARRAY_BUFFER, 24 * sizeof(float), NULL, GL_DYNAMIC_DRAW);
+    // Os vértices de cada string vão para o anel de g_StreamBuffer, que já
+    // deve ter sido criado; o desenho começa no vértice onde foram escritos.
+    glBindBuffer(GL_ARRAY_BUFFER, g_StreamBuffer.Buffer());
     glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, 0, 0);
     glEnableVertexAttribArray(0);
     glCheckError();
@@ -142,28 +206,19 @@ void TextRendering_Init()
     glCheckError();
 }
 
-float textscale = 1.5f;
-
-void TextRendering_PrintString(GLFWwindow* window, const std::string &str, float x, float y, float scale = 1.0f)
+size_t TextRendering_LayoutString(std::vector<float> &vertices, const std::string &str, float x, float y, float scale)
 {
-    scale *= textscale;
-    int width, height;
-    glfwGetWindowSize(window, &width, &height);
-    float sx = scale / width;
-    float sy = scale / height;
+    float sx = scale * g_TextLayout.sx;
+    float sy = scale * g_TextLayout.sy;
+
+    float half_texel_s = 0.5f / dejavufont.tex_width;
+    float half_texel_t = 0.5f / dejavufont.tex_height;
+
+    size_t first = vertices.size();
 
     for (size_t i = 0; i < str.size(); i++)
     {
-        // Find the glyph for the character we are looking for
-        texture_glyph_t *glyph = 0;
-        for (size_t j = 0; j < dejavufont.glyphs_count; ++j)
-        {
-            if (dejavufont.glyphs[j].codepoint == (uint32_t)str[i])
-            {
-                glyph = &dejavufont.glyphs[j];
-                break;
-            }
-        }
+        texture_glyph_t const *glyph = TextRendering_FindGlyph((unsigned char)str[i]);
         if (!glyph) {
             continue;
         }
@@ -173,59 +228,81 @@ void TextRendering_PrintString(GLFWwindow* window, const std::string &str, float
         float x1 = (float) (x0 + glyph->width * sx);
         float y1 = (float) (y0 - glyph->height * sy);
 
-        float s0 = glyph->s0 - 0.5f/dejavufont.tex_width;
-        float t0 = glyph->t0 - 0.5f/dejavufont.tex_height;
-        float s1 = glyph->s1 - 0.5f/dejavufont.tex_width;
-        float t1 = glyph->t1 - 0.5f/dejavufont.tex_height;
-
-        struct {float x, y, s, t;} data[6] = {
-            { x0, y0, s0, t0 },
-            { x0, y1, s0, t1 },
-            { x1, y1, s1, t1 },
-            { x0, y0, s0, t0 },
-            { x1, y1, s1, t1 },
-            { x1, y0, s1, t0 }
+        float s0 = glyph->s0 - half_texel_s;
+        float t0 = glyph->t0 - half_texel_t;
+        float s1 = glyph->s1 - half_texel_s;
+        float t1 = glyph->t1 - half_texel_t;
+
+        float data[24] = {
+            x0, y0, s0, t0,
+            x0, y1, s0, t1,
+            x1, y1, s1, t1,
+            x0, y0, s0, t0,
+            x1, y1, s1, t1,
+            x1, y0, s1, t0
         };
+        vertices.insert(vertices.end(), data, data + 24);
+
+        x += (glyph->advance_x * sx);
+    }
+
+    return (vertices.size() - first) / 4;
+}
+
+void TextRendering_BeginDraw()
+{
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
-        glEnable(GL_BLEND);
-        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+    glDepthFunc(GL_ALWAYS);
 
-        glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
-        glDepthFunc(GL_ALWAYS);
-        glBindBuffer(GL_ARRAY_BUFFER, textVBO);
-        glBufferSubData(GL_ARRAY_BUFFER, 0, 24 * sizeof(float), data);
-        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glUseProgram(textprogram_id);
+}
+
+void TextRendering_EndDraw()
+{
+    glUseProgram(0);
+    glDepthFunc(GL_LESS);
+
+    glDisable(GL_BLEND);
+}
 
-        glUseProgram(textprogram_id);
-        glBindVertexArray(textVAO);
+void TextRendering_PrintString(GLFWwindow* window, const std::string &str, float x, float y, float scale)
+{
+    g_TextVertices.clear();
+    size_t num_vertices = TextRendering_LayoutString(g_TextVertices, str, x, y, scale);
+    if (num_vertices == 0)
+        return;
 
-        glDrawArrays(GL_TRIANGLES, 0, 6);
+    // Todos os glifos da string são enviados de uma vez e desenhados com uma
+    // única chamada. O anel não reescreve o intervalo enquanto a GPU não
+    // terminar de usá-lo, então a CPU não espera a GPU.
+    const size_t vertex_bytes = 4 * sizeof(float);
+    size_t offset = g_StreamBuffer.Write(g_TextVertices.data(), g_TextVertices.size() * sizeof(float), vertex_bytes);
+    if (offset == StreamBuffer::INVALID)
+        return;
 
-        glBindVertexArray(0);
-        glUseProgram(0);
-        glDepthFunc(GL_LESS);
+    TextRendering_BeginDraw();
 
-        glDisable(GL_BLEND);
+    glBindVertexArray(textVAO);
+    glDrawArrays(GL_TRIANGLES, offset / vertex_bytes, num_vertices);
+    glBindVertexArray(0);
 
-        x += (glyph->advance_x * sx);
-    }
+    TextRendering_EndDraw();
 }
 
 float TextRendering_LineHeight(GLFWwindow* window)
 {
-    int width, height;
-    glfwGetWindowSize(window, &width, &height);
-    return dejavufont.height / height * textscale;
+    return g_TextLayout.line_height;
 }
 
 float TextRendering_CharWidth(GLFWwindow* window)
 {
-    int width, height;
-    glfwGetWindowSize(window, &width, &height);
-    return dejavufont.glyphs[32].advance_x / width * textscale;
+    return g_TextLayout.char_width;
 }
 
-void TextRendering_PrintMatrix(GLFWwindow* window, glm::mat4 M, float x, float y, float scale = 1.0f)
+void TextRendering_PrintMatrix(GLFWwindow* window, glm::mat4 M, float x, float y, float scale)
 {
     char buffer[40];
     float lineheight = TextRendering_LineHeight(window) * scale;
@@ -240,7 +317,7 @@ void TextRendering_PrintMatrix(GLFWwindow* window, glm::mat4 M, float x, float y
     TextRendering_PrintString(window, buffer, x, y - 3*lineheight, scale);
 }
 
-void TextRendering_PrintVector(GLFWwindow* window, glm::vec4 v, float x, float y, float scale = 1.0f)
+void TextRendering_PrintVector(GLFWwindow* window, glm::vec4 v, float x, float y, float scale)
 {
     char buffer[10];
     float lineheight = TextRendering_LineHeight(window) * scale;
@@ -255,7 +332,7 @@ void TextRendering_PrintVector(GLFWwindow* window, glm::vec4 v, float x, float y
     TextRendering_PrintString(window, buffer, x, y - 3*lineheight, scale);
 }
 
-void TextRendering_PrintMatrixVectorProduct(GLFWwindow* window, glm::mat4 M, glm::vec4 v, float x, float y, float scale = 1.0f)
+void TextRendering_PrintMatrixVectorProduct(GLFWwindow* window, glm::mat4 M, glm::vec4 v, float x, float y, float scale)
 {
     char buffer[70];
     float lineheight = TextRendering_LineHeight(window) * scale;
@@ -271,7 +348,7 @@ void TextRendering_PrintMatrixVectorProduct(GLFWwindow* window, glm::mat4 M, glm
     TextRendering_PrintString(window, buffer, x, y - 3*lineheight, scale);
 }
 
-void TextRendering_PrintMatrixVectorProductMoreDigits(GLFWwindow* window, glm::mat4 M, glm::vec4 v, float x, float y, float scale = 1.0f)
+void TextRendering_PrintMatrixVectorProductMoreDigits(GLFWwindow* window, glm::mat4 M, glm::vec4 v, float x, float y, float scale)
 {
     char buffer[70];
     float lineheight = TextRendering_LineHeight(window) * scale;
@@ -287,7 +364,7 @@ void TextRendering_PrintMatrixVectorProductMoreDigits(GLFWwindow* window, glm::m
     TextRendering_PrintString(window, buffer, x, y - 3*lineheight, scale);
 }
 
-void TextRendering_PrintMatrixVectorProductDivW(GLFWwindow* window, glm::mat4 M, glm::vec4 v, float x, float y, float scale = 1.0f)
+void TextRendering_PrintMatrixVectorProductDivW(GLFWwindow* window, glm::mat4 M, glm::vec4 v, float x, float y, float scale)
 {
     auto r = M*v;
     auto w = r[3];